@@ -10,29 +10,54 @@
 
 void
 init_nodes() {
+  // Names
+  init_node(id_expr, "id");
   // Terms
   init_node(def_term, "def");
   init_node(init_term, "init");
   init_node(unit_term, "unit");
   init_node(true_term, "true");
   init_node(false_term, "false");
+  init_node(if_term, "if");
   init_node(int_term, "int");
+  init_node(succ_term, "succ");
+  init_node(pred_term, "pred");
+  init_node(iszero_term, "iszero");
+  init_node(str_term, "str");
   init_node(var_term, "var");
   init_node(abs_term, "abs");
+  init_node(fn_term, "fn");
   init_node(app_term, "app");
+  init_node(call_term, "call");
+  init_node(closure_term, "closure");
   init_node(tuple_term, "tuple");
   init_node(list_term, "list");
   init_node(record_term, "record");
+  init_node(variant_term, "variant");
   init_node(comma_term, "comma");
   init_node(proj_term, "proj");
   init_node(mem_term, "mem");
   init_node(col_term, "col");
   init_node(table_term, "table");
+  init_node(select_term, "select");
+  init_node(group_term, "group");
+  init_node(agg_term, "agg");
+  init_node(order_term, "order");
+  init_node(join_on_term, "join");
+  init_node(union_term, "union");
+  init_node(intersect_term, "intersect");
+  init_node(except_term, "except");
+  init_node(load_term, "load");
+  init_node(save_term, "save");
+  init_node(csv_term, "csv");
   init_node(and_term, "and");
   init_node(or_term, "or");
   init_node(not_term, "not");
   init_node(equals_term, "eq");
   init_node(less_term, "lt");
+  init_node(ref_term, "ref");
+  init_node(print_term, "print");
+  init_node(prog_term, "prog");
   // Types
   init_node(kind_type, "kind-type");
   init_node(unit_type, "unit-type");
@@ -40,8 +65,14 @@ init_nodes() {
   init_node(nat_type, "nat-type");
   init_node(str_type, "str-type");
   init_node(arrow_type, "arrow-type");
+  init_node(fn_type, "fn-type");
   init_node(tuple_type, "tuple-type");
   init_node(list_type, "list-type");
+  init_node(record_type, "record-type");
+  init_node(variant_type, "variant-type");
+  init_node(wild_type, "wild-type");
+  // Utilities
+  init_node(seq_node, "seq");
 }
 
 // -------------------------------------------------------------------------- //
@@ -167,6 +198,27 @@ pp_record(std::ostream& os, Record* t) {
   os << '{' << commas(t->members()) << '}';
 }
 
+// Tables are printed as lists of records.
+void
+pp_table(std::ostream& os, Table* t) {
+  List_type* lt = as<List_type>(t->tr);
+  Term_seq* vars = as<Record_type>(lt->type())->members();
+  Column_seq* cols = t->columns();
+  os << '[';
+  for (std::size_t i = 0; i < t->rows(); ++i) {
+    if (i != 0)
+      os << ", ";
+    os << '{';
+    for (std::size_t j = 0; j < vars->size(); ++j) {
+      if (j != 0)
+        os << ", ";
+      os << pretty(as<Var>((*vars)[j])->name()) << " = " << pretty((*(*cols)[j])[i]);
+    }
+    os << '}';
+  }
+  os << ']';
+}
+
 void
 pp_comma(std::ostream& os, Comma* t) {
   os << '(' << commas(t->elems()) << ')';
@@ -209,6 +261,21 @@ pp_print(std::ostream& os, Print* p) {
   os << "print " << pretty(p->expr());
 }
 
+void
+pp_load(std::ostream& os, Load* t) {
+  os << "load " << pretty(t->path());
+}
+
+void
+pp_save(std::ostream& os, Save* t) {
+  os << "save " << pretty(t->path()) << ' ' << pretty(t->table());
+}
+
+void
+pp_csv(std::ostream& os, Csv* t) {
+  os << "csv " << pretty(t->path()) << ' ' << pretty(t->tr);
+}
+
 void
 pp_prog(std::ostream& os, Prog* t) {
   for (Term* s : *t->stmts())
@@ -272,6 +339,29 @@ pp_select(std::ostream& os, Select_from_where* t) {
      << " where " << pretty(t->t3);
 }
 
+void
+pp_group(std::ostream& os, Group_by* t) {
+  os << "select " << pretty(t->t1)
+     << " from " << pretty(t->t2)
+     << " where " << pretty(t->t3)
+     << " group by " << pretty(t->t4);
+}
+
+void
+pp_agg(std::ostream& os, Agg* t) {
+  static const char* names[] = {"count", "sum", "min", "max"};
+  os << names[t->op()] << ' ' << pretty(t->column()) << " as " << pretty(t->name());
+}
+
+void
+pp_order(std::ostream& os, Order_by* t) {
+  os << pretty(t->t1);
+  if (t->t2)
+    os << " order by " << pretty(t->t2) << (t->t4 ? " desc" : "");
+  if (t->t3)
+    os << " limit " << pretty(t->t3);
+}
+
 void
 pp_join(std::ostream& os, Join* t) {
   os << pretty(t->t1) << " join " << pretty(t->t2) 
@@ -330,16 +420,21 @@ pp_expr(std::ostream& os, Node* t) {
   case fn_term: return pp_fn(os, as<Fn>(t));
   case app_term: return pp_app(os, as<App>(t));
   case call_term: return pp_call(os, as<Call>(t));
+  case closure_term: return pp_expr(os, as<Closure>(t)->fn());
   case ref_term: return pp_ref(os, as<Ref>(t));
   case def_term: return pp_def(os, as<Def>(t));
   case init_term: return pp_init(os, as<Init>(t));
   case tuple_term: return pp_tuple(os, as<Tuple>(t));
   case list_term: return pp_list(os, as<List>(t));
   case record_term: return pp_record(os, as<Record>(t));
+  case table_term: return pp_table(os, as<Table>(t));
   case comma_term: return pp_comma(os, as<Comma>(t));
   case proj_term: return pp_proj(os, as<Proj>(t));
   case mem_term: return pp_mem(os, as<Mem>(t));
   case print_term: return pp_print(os, as<Print>(t));
+  case load_term: return pp_load(os, as<Load>(t));
+  case save_term: return pp_save(os, as<Save>(t));
+  case csv_term: return pp_csv(os, as<Csv>(t));
   case prog_term: return pp_prog(os, as<Prog>(t));
   case and_term: return pp_and(os, as<And>(t));
   case or_term: return pp_or(os, as<Or>(t));
@@ -351,6 +446,9 @@ pp_expr(std::ostream& os, Node* t) {
   case intersect_term: return pp_intersect(os, as<Intersect>(t));
   case except_term: return pp_except(os, as<Except>(t));
   case col_term: return pp_col(os, as<Col>(t));
+  case group_term: return pp_group(os, as<Group_by>(t));
+  case agg_term: return pp_agg(os, as<Agg>(t));
+  case order_term: return pp_order(os, as<Order_by>(t));
   case join_on_term: return pp_join(os, as<Join>(t));
   // Types
   case unit_type: return pp_string(os, "Unit");
@@ -9,8 +9,12 @@
 #include "lang/location.hpp"
 #include "lang/nodes.hpp"
 
+#include <functional>
 #include <iosfwd>
 #include <map>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
 
 // -------------------------------------------------------------------------- //
 // Language terms
@@ -43,6 +47,7 @@ constexpr Node_kind abs_term     = make_term_node(31); // \v.t
 constexpr Node_kind fn_term      = make_term_node(32); // \(v1, ..., vn).t
 constexpr Node_kind app_term     = make_term_node(33); // t1 t2
 constexpr Node_kind call_term    = make_term_node(34); // (t1, ..., tn)
+constexpr Node_kind closure_term = make_term_node(35); // [E]\v.t
 // Tuples, records, and variants
 constexpr Node_kind tuple_term   = make_term_node(40); // {t1, ..., tn}
 constexpr Node_kind list_term    = make_term_node(41); // [t1, ..., tn]
@@ -55,13 +60,19 @@ constexpr Node_kind mem_term     = make_term_node(46); // t1.x
 constexpr Node_kind def_term     = make_term_node(50); // def n = t
 constexpr Node_kind init_term    = make_term_node(51); // n = t
 // Tables, Table attributes, Relational Algebra
-constexpr Node_kind table_term   = make_term_node(60); // {{x1:T1 = v:T1, x2:T2 = v:T2, ...}, ...}
+constexpr Node_kind table_term   = make_term_node(60); // [{x1 = v1, ..., xn = vn}, ...] (columnar)
 constexpr Node_kind select_term  = make_term_node(61);
 constexpr Node_kind join_on_term = make_term_node(62);
 constexpr Node_kind union_term   = make_term_node(63); // t1 union t2
 constexpr Node_kind intersect_term = make_term_node(64); // t1 intersect t2
 constexpr Node_kind except_term  = make_term_node(65); // t1 except t2
 constexpr Node_kind col_term     = make_term_node(66); // table.n (col proj)
+constexpr Node_kind load_term    = make_term_node(67); // load "path"
+constexpr Node_kind save_term    = make_term_node(68); // save "path" t
+constexpr Node_kind csv_term     = make_term_node(69); // csv "path" T
+constexpr Node_kind group_term   = make_term_node(70); // select t1 from t2 where t3 group by t4
+constexpr Node_kind agg_term     = make_term_node(71); // f t as n (e.g., sum x.a as s)
+constexpr Node_kind order_term   = make_term_node(72); // t1 order by t2 limit t3
 // Miscellaneous terms
 constexpr Node_kind ref_term     = make_term_node(100); // ref to decl
 constexpr Node_kind print_term   = make_term_node(101); // print t
@@ -88,6 +99,9 @@ struct Name;
 struct Type;
 struct Term;
 struct Cond;
+struct Env;
+struct Code;
+struct Memo_table;
 
 // Every distinct phrase in the language is an expression.
 //
@@ -95,6 +109,9 @@ struct Cond;
 // of the expression. This is generally assigned during elaboration or
 // when nodes are initialized by default.
 struct Expr : Node { 
+  static constexpr Node_kind first_kind = make_node_class(name_class);
+  static constexpr Node_kind last_kind = make_node_class(stmt_class) - 1;
+
   Expr(Node_kind k, Type* t) 
     : Node(k), tr(t) { }
   Expr(Node_kind k, const Location& l, Type* t) 
@@ -103,13 +120,28 @@ struct Expr : Node {
 };
 
 // The base class of all identifiers in the language.
-struct Name : Expr { using Expr::Expr; };
+struct Name : Expr {
+  static constexpr Node_kind first_kind = make_node_class(name_class);
+  static constexpr Node_kind last_kind = make_node_class(type_class) - 1;
+
+  using Expr::Expr;
+};
 
 // The base class of all types in the language.
-struct Type : Expr { using Expr::Expr; };
+struct Type : Expr {
+  static constexpr Node_kind first_kind = make_node_class(type_class);
+  static constexpr Node_kind last_kind = make_node_class(kind_class) - 1;
+
+  using Expr::Expr;
+};
 
 // The base class of all terms in the language.
-struct Term : Expr { using Expr::Expr; };
+struct Term : Expr {
+  static constexpr Node_kind first_kind = make_node_class(term_class);
+  static constexpr Node_kind last_kind = make_node_class(stmt_class) - 1;
+
+  using Expr::Expr;
+};
 
 // A sequence of expressions.
 using Expr_seq = Seq<Expr>;
@@ -129,6 +161,8 @@ using Type_seq = Seq<Type>;
 // Represents the name of a declared entity in the language (e.g.,
 // a function, variable, etc.).
 struct Id : Name {
+  static constexpr Node_kind node_kind = id_expr;
+
   Id(String n)
     : Name(id_expr, nullptr), t1(n) { }
   Id(const Location& l, String n)
@@ -142,6 +176,8 @@ struct Id : Name {
 
 // The unit value.
 struct Unit : Term {
+  static constexpr Node_kind node_kind = unit_term;
+
   Unit(Type* t) 
     : Term(unit_term, t) { }
   Unit(const Location& l, Type* t) 
@@ -150,6 +186,8 @@ struct Unit : Term {
 
 // Represents the constant term 'true'.
 struct True : Term {
+  static constexpr Node_kind node_kind = true_term;
+
   True(Type* t) 
     : Term(true_term, t) { }
   True(const Location& l, Type* t) 
@@ -158,6 +196,8 @@ struct True : Term {
 
 // Represents the constant term 'false'.
 struct False : Term {
+  static constexpr Node_kind node_kind = false_term;
+
   False(Type* t) 
     : Term(false_term, t) { }
   False(const Location& l, Type* t) 
@@ -166,6 +206,8 @@ struct False : Term {
 
 // Represents the conditional term 'if t1 then t2 else t3'.
 struct If : Term {
+  static constexpr Node_kind node_kind = if_term;
+
   If(Type* t0, Term* t1, Term* t2, Term* t3) 
     : Term(if_term, t0), t1(t1),  t2(t2), t3(t3) { }
   If(const Location& l, Type* t, Term* t1, Term* t2, Term* t3) 
@@ -182,6 +224,8 @@ struct If : Term {
 
 // Represents an integer literal.
 struct Int : Term {
+  static constexpr Node_kind node_kind = int_term;
+
   Int(Type* t, const Integer& n) 
     : Term(int_term, t), t1(n) { }
   Int(const Location& l, Type* t, const Integer& n) 
@@ -195,6 +239,8 @@ struct Int : Term {
 // Represents the boolean operator term t1 AND t2
 // t1 or t2 has to be type bool
 struct And :Term {
+  static constexpr Node_kind node_kind = and_term;
+
   And(Type* t, Term* t1, Term* t2)
     : Term(and_term, t), t1(t1), t2(t2) { }
   And(const Location& l, Type* t, Term* t1, Term* t2)
@@ -207,6 +253,8 @@ struct And :Term {
 // Represents the boolean operator term t1 OR t2
 // t1 or t2 has to be of type bool
 struct Or :Term {
+  static constexpr Node_kind node_kind = or_term;
+
   Or(Type* t, Term* t1, Term* t2)
     : Term(or_term, t), t1(t1), t2(t2) { }
   Or(const Location& l, Type* t, Term* t1, Term* t2)
@@ -219,6 +267,8 @@ struct Or :Term {
 // Represents the boolean operator term not t1
 // t1 or t2 has to be of type bool
 struct Not :Term {
+  static constexpr Node_kind node_kind = not_term;
+
   Not(Type* t, Term* t1)
     : Term(not_term, t), t1(t1){ }
   Not(const Location& l, Type* t, Term* t1)
@@ -229,6 +279,8 @@ struct Not :Term {
 
 // Represents the comparison operator term t1 == t2
 struct Equals :Term {
+  static constexpr Node_kind node_kind = equals_term;
+
   Equals(Type* t, Term* t1, Term* t2)
     : Term(equals_term, t), t1(t1), t2(t2) { }
   Equals(const Location& l, Type* t, Term* t1, Term* t2)
@@ -240,6 +292,8 @@ struct Equals :Term {
 
 // Represents the comparison operator term t1 < t2
 struct Less :Term {
+  static constexpr Node_kind node_kind = less_term;
+
   Less(Type* t, Term* t1, Term* t2)
     : Term(less_term, t), t1(t1), t2(t2) { }
   Less(const Location& l, Type* t, Term* t1, Term* t2)
@@ -251,6 +305,8 @@ struct Less :Term {
 
 // Represents the term 'succ t'.
 struct Succ : Term {
+  static constexpr Node_kind node_kind = succ_term;
+
   Succ(Type* t0, Term* t) 
     : Term(succ_term, t0), t1(t) { }
   Succ(const Location& l, Type* t0, Term* t) 
@@ -263,6 +319,8 @@ struct Succ : Term {
 
 // Represents the term 'pred t'.
 struct Pred : Term {
+  static constexpr Node_kind node_kind = pred_term;
+
   Pred(Type* t0, Term* t) 
     : Term(pred_term, t0), t1(t) { }
   Pred(const Location& l, Type* t0, Term* t) 
@@ -275,6 +333,8 @@ struct Pred : Term {
 
 // Represents the term 'iszero t'.
 struct Iszero : Term {
+  static constexpr Node_kind node_kind = iszero_term;
+
   Iszero(Type* t0, Term* t) 
     : Term(iszero_term, t0), t1(t) { }
   Iszero(const Location& l, Type* t0, Term* t) 
@@ -288,6 +348,8 @@ struct Iszero : Term {
 // Represents the string literal "...", a sequence of characters
 // enclosed in quotes.
 struct Str : Term {
+  static constexpr Node_kind node_kind = str_term;
+
   Str(Type* t, String s)
     : Term(str_term, t), t1(s) { }
   Str(const Location& l, Type* t, String s)
@@ -301,6 +363,8 @@ struct Str : Term {
 // A variable declaration of the form 'x : T' in a lambda
 // abstraction. 
 struct Var : Term {
+  static constexpr Node_kind node_kind = var_term;
+
   Var(Name* n, Type* t) 
     : Term(var_term, t), t1(n), t2(t) { }
   Var(const Location& l, Name* n, Type* t) 
@@ -315,38 +379,59 @@ struct Var : Term {
 
 // A lambda abstraction over a term, having the form '\v.t' where 'v' 
 // is a variable declaration and 't' is the abstracted term.
+//
+// The memo flag is set during elaboration when calls to the abstraction
+// can be memoized, and the memo table holds the remembered calls (see
+// memo.hpp). The table is destroyed with the abstraction.
 struct Abs : Term {
+  static constexpr Node_kind node_kind = abs_term;
+
   Abs(Type* t0, Term* x, Term* t)
-    : Term(abs_term, t0), t1(x), t2(t) { }
+    : Term(abs_term, t0), t1(x), t2(t), t3(false), t4(nullptr) { }
   Abs(const Location& l, Type* t0, Term* x, Term* t) 
-    : Term(abs_term, l, t0), t1(x), t2(t) { }
+    : Term(abs_term, l, t0), t1(x), t2(t), t3(false), t4(nullptr) { }
+  ~Abs();
 
   Term* var() const { return t1; }
   Term* term() const { return t2; }
+  bool memo() const { return t3; }
 
   Term* t1;
   Term* t2;
+  bool t3;
+  Memo_table* t4;
 };
 
 // A function of the form '\(v1, ..., vn).t' where 'vi' is a
 // variable declaration and 't' is the abstracted term. Unlike
 // an abstraction, a function can be called with many arguments.
+//
+// As with an abstraction, the memo flag and table determine the
+// memoization of calls to the function.
 struct Fn : Term {
+  static constexpr Node_kind node_kind = fn_term;
+
   Fn(Type* t0, Term_seq* ps, Term* t)
-    : Term(fn_term, t0), t1(ps), t2(t) { }
+    : Term(fn_term, t0), t1(ps), t2(t), t3(false), t4(nullptr) { }
   Fn(const Location& l, Type* t0, Term_seq* ps, Term* t) 
-    : Term(fn_term, l, t0), t1(ps), t2(t) { }
+    : Term(fn_term, l, t0), t1(ps), t2(t), t3(false), t4(nullptr) { }
+  ~Fn();
 
   Term_seq* parms() const { return t1; }
   Term* term() const { return t2; }
+  bool memo() const { return t3; }
 
   Term_seq* t1;
   Term* t2;
+  bool t3;
+  Memo_table* t4;
 };
 
 // An application of an abstraction to a term, having the form 't1 t2' 
 // where 't1' is the abstraction and 't2' is the argument.
 struct App : Term {
+  static constexpr Node_kind node_kind = app_term;
+
   App(Type* t0, Term* t1, Term* t2) 
     : Term(app_term, t0), t1(t1), t2(t2) { }
   App(const Location& l, Type* t0, Term* t1, Term* t2) 
@@ -362,6 +447,8 @@ struct App : Term {
 // A function call of the form 't(t1, ..., tn)' where 't' is a 
 // function (not an abstraction) and each 'ti' is an argument.
 struct Call : Term {
+  static constexpr Node_kind node_kind = call_term;
+
   Call(Type* t0, Term* t1, Term_seq* ts) 
     : Term(call_term, t0), t1(t1), t2(ts) { }
   Call(const Location& l, Type* t0, Term* t1, Term_seq* ts) 
@@ -374,12 +461,42 @@ struct Call : Term {
   Term_seq* t2;
 };
 
+// A closure pairs an abstraction or function with the environment
+// in which it was evaluated. These are the function values computed
+// by the environment-based evaluator (see env.hpp) and by the virtual
+// machine (see vm.hpp), which also records the compiled code of the
+// function in the closure.
+struct Closure : Term {
+  static constexpr Node_kind node_kind = closure_term;
+
+  Closure(Type* t, Term* f, Env* e, Code* c = nullptr)
+    : Term(closure_term, t), t1(f), t2(e), t3(c) { }
+  Closure(const Location& l, Type* t, Term* f, Env* e, Code* c = nullptr)
+    : Term(closure_term, l, t), t1(f), t2(e), t3(c) { }
+
+  Term* fn() const { return t1; }
+  Env* env() const { return t2; }
+  Code* code() const { return t3; }
+
+  Term* t1;
+  Env* t2;
+  Code* t3;
+};
+
+// A thunk computes the delayed value of a definition.
+using Thunk = std::function<Term*()>;
 
 // A definition of the form 'def n = t'.
 //
+// In lazy mode (see set_lazy_defs), evaluating a pure definition only
+// sets its thunk, which is forced once, when the definition is first
+// referenced (see eval_ref). The value t is then the result.
+//
 // TODO: Refactor this so that the 'n=t' part is an init
 // expression (see below);
 struct Def : Term {
+  static constexpr Node_kind node_kind = def_term;
+
   Def(Type* t, Name* n, Expr* v)
     : Term(def_term, t), t1(n), t2(v) { }
   Def(const Location& l ,Type* t, Name* n, Expr* v)
@@ -390,11 +507,15 @@ struct Def : Term {
 
   Name* t1;
   Expr* t2;
+  Thunk t3;           // The delayed value, if any
+  std::once_flag t4;  // Set when the thunk is forced
 };
 
 // An initializer term of the form 'n = t' where 'n' is a name
 // and 't' is the value that name takes on.
 struct Init : Term {
+  static constexpr Node_kind node_kind = init_term;
+
   Init(Type* t, Name* n, Expr* v)
     : Term(init_term, t), t1(n), t2(v) { }
   Init(const Location& l ,Type* t, Name* n, Expr* v)
@@ -409,6 +530,8 @@ struct Init : Term {
 
 // A tuple of the form '{t1, ..., tn}' where each 'ti' is a term.
 struct Tuple : Term {
+  static constexpr Node_kind node_kind = tuple_term;
+
   Tuple(Type* t, Term_seq* ts)
     : Term(tuple_term, t), t1(ts) { }
   Tuple(const Location& l, Type* t, Term_seq* ts)
@@ -421,6 +544,8 @@ struct Tuple : Term {
 
 // A list of the form '[t1, ..., tn]' where each 'ti' is a term.
 struct List : Term {
+  static constexpr Node_kind node_kind = list_term;
+
   List(Type* t, Term_seq* ts)
     : Term(list_term, t), t1(ts) { }
   List(const Location& l, Type* t, Term_seq* ts)
@@ -437,6 +562,8 @@ struct List : Term {
 // TODO: It might make sense to derive this from tupe. A
 // record is a tuple of named elements.
 struct Record : Term {
+  static constexpr Node_kind node_kind = record_term;
+
   Record(Type* t, Term_seq* ts)
     : Term(record_term, t), t1(ts) { }
   Record(const Location& l, Type* t, Term_seq* ts)
@@ -447,10 +574,52 @@ struct Record : Term {
   Term_seq* t1;
 };
 
+// A sequence of table columns. Each column is a sequence of values.
+using Column_seq = std::vector<Term_seq*>;
+
+// A mapping from column names to their index in a table.
+using Column_map = std::unordered_map<String, std::size_t>;
+
+// The indexes of a table, one entry per column (see table.hpp).
+struct Column_index;
+using Index_seq = std::vector<Column_index>;
+
+// A table is the columnar representation of a list of records. The
+// type of a table is the same as that of the list, '[{n1:T1, ..., nn:Tn}]'.
+// The ith column holds the values of the member ni, one per row. The
+// column map is computed once, when the table is constructed, so that
+// columns can be found by name without searching (see table.hpp).
+//
+// Indexes on the columns of a table are built on demand, and cached
+// with the table. A table owns its column sequence, column map, and
+// indexes, but not the columns themselves, which may be shared with
+// other tables.
+struct Table : Term {
+  static constexpr Node_kind node_kind = table_term;
+
+  Table(Type* t, Column_seq* cs, Column_map* m, std::size_t n)
+    : Term(table_term, t), t1(cs), t2(m), t3(n), t4(nullptr) { }
+  Table(const Location& l, Type* t, Column_seq* cs, Column_map* m, std::size_t n)
+    : Term(table_term, l, t), t1(cs), t2(m), t3(n), t4(nullptr) { }
+  ~Table();
+
+  Column_seq* columns() const { return t1; }
+  Column_map* names() const { return t2; }
+  std::size_t rows() const { return t3; }
+  Index_seq* indexes() const { return t4; }
+
+  Column_seq* t1;
+  Column_map* t2;
+  std::size_t t3;
+  Index_seq* t4;
+};
+
 // A comma term of the form '(e1, ..., en)' is simply a sequence
 // of expressions. These are used internally to represent
 // function arguments or parameter types. 
 struct Comma : Term {
+  static constexpr Node_kind node_kind = comma_term;
+
   Comma(Type* t, Expr_seq* ts)
     : Term(comma_term, t), t1(ts) { }
   Comma(const Location& l, Type* t, Expr_seq* ts)
@@ -463,6 +632,8 @@ struct Comma : Term {
 
 // A projection of an element in a tuple.
 struct Proj : Term {
+  static constexpr Node_kind node_kind = proj_term;
+
   Proj(Type* t, Term* t0, Term* n)
     : Term(proj_term, t), t1(t0), t2(n) { }
   Proj(const Location& l, Type* t, Term* t0, Term* n)
@@ -476,21 +647,32 @@ struct Proj : Term {
 };
 
 // A projection of a field of a record.
+//
+// The index of the member is its position in the record type of the
+// object (or in the row type of a table), resolved during elaboration.
+// The members of a record and the columns of a table are stored in
+// that order, so the member is found without comparing names.
 struct Mem : Term {
-  Mem(Type* t, Term* t0, Term* n)
-    : Term(mem_term, t), t1(t0), t2(n) { }
-  Mem(const Location& l, Type* t, Term* t0, Term* n)
-    : Term(mem_term, l, t), t1(t0), t2(n) { }
+  static constexpr Node_kind node_kind = mem_term;
+
+  Mem(Type* t, Term* t0, Term* n, std::size_t i)
+    : Term(mem_term, t), t1(t0), t2(n), t3(i) { }
+  Mem(const Location& l, Type* t, Term* t0, Term* n, std::size_t i)
+    : Term(mem_term, l, t), t1(t0), t2(n), t3(i) { }
 
   Term* record() const { return t1; }
   Term* member() const { return t2; }
+  std::size_t index() const { return t3; }
 
   Term* t1;
   Term* t2;
+  std::size_t t3;
 };
 
 // A column projection for a table
 struct Col : Term {
+  static constexpr Node_kind node_kind = col_term;
+
   Col(Type* t, Term* t0, Term* n)
     : Term(col_term, t), t1(t0), t2(n) { }
   Col(const Location& l, Type* t, Term* t0, Term* n)
@@ -506,19 +688,83 @@ struct Col : Term {
 // Represefnts a reference to a declared entity in the program 
 // (e.g., a variable, function, etc). Note that the type of the
 // reference is the same as that of its referred-to expression.
+//
+// A reference to the parameter of an enclosing abstraction or function
+// is resolved to a lexical slot during elaboration: the depth is the
+// number of abstractions between the reference and the parameter, and
+// the index is the position of the parameter. Other references have no
+// slot, and their depth is -1.
 struct Ref : Term {
+  static constexpr Node_kind node_kind = ref_term;
+
   Ref(Expr* e)
-    : Term(ref_term, e->tr), t1(e) { }
+    : Term(ref_term, e->tr), t1(e), t2(-1), t3(-1) { }
   Ref(const Location& l, Expr* e)
-    : Term(ref_term, l, e->tr), t1(e) { }
+    : Term(ref_term, l, e->tr), t1(e), t2(-1), t3(-1) { }
+  Ref(const Location& l, Expr* e, int d, int i)
+    : Term(ref_term, l, e->tr), t1(e), t2(d), t3(i) { }
 
   Expr* decl() const { return t1; }
+  int depth() const { return t2; }
+  int index() const { return t3; }
 
   Expr* t1;
+  int t2;
+  int t3;
+};
+
+// Loads a table from a table file (see table_file.hpp). The path is a
+// string literal, and the type of the term is the table type recorded
+// in the file when the term was elaborated.
+struct Load : Term {
+  static constexpr Node_kind node_kind = load_term;
+
+  Load(Type* t, Term* p)
+    : Term(load_term, t), t1(p) { }
+  Load(const Location& l, Type* t, Term* p)
+    : Term(load_term, l, t), t1(p) { }
+
+  Term* path() const { return t1; }
+
+  Term* t1;
+};
+
+// Saves a table to a table file. The path is a string literal, and t2
+// is the saved table.
+struct Save : Term {
+  static constexpr Node_kind node_kind = save_term;
+
+  Save(Type* t, Term* p, Term* t0)
+    : Term(save_term, t), t1(p), t2(t0) { }
+  Save(const Location& l, Type* t, Term* p, Term* t0)
+    : Term(save_term, l, t), t1(p), t2(t0) { }
+
+  Term* path() const { return t1; }
+  Term* table() const { return t2; }
+
+  Term* t1;
+  Term* t2;
+};
+
+// A table read from a CSV file (see csv.hpp). The path is a string
+// literal, and the type of the term is the declared table type.
+struct Csv : Term {
+  static constexpr Node_kind node_kind = csv_term;
+
+  Csv(Type* t, Term* p)
+    : Term(csv_term, t), t1(p) { }
+  Csv(const Location& l, Type* t, Term* p)
+    : Term(csv_term, l, t), t1(p) { }
+
+  Term* path() const { return t1; }
+
+  Term* t1;
 };
 
 // Prints an expression to the terminal.
 struct Print : Term {
+  static constexpr Node_kind node_kind = print_term;
+
   Print(Type* t, Expr* e)
     : Term(print_term, t), t1(e) { }
   Print(const Location& l, Type* t, Expr* e)
@@ -531,6 +777,8 @@ struct Print : Term {
 
 // A program is a sequence of terms called statements.
 struct Prog : Term {
+  static constexpr Node_kind node_kind = prog_term;
+
   Prog(Type* t, Term_seq* ts)
     : Term(prog_term, t), t1(ts) { }
 
@@ -544,6 +792,8 @@ struct Prog : Term {
 // t2 is a Table term
 // t3 is anything that has type bool. Most commonly a term like and, or, equals, less, not
 struct Select_from_where : Term {
+  static constexpr Node_kind node_kind = select_term;
+
   Select_from_where(Type* t, Term* t1, Term* t2, Term* t3)
     : Term(select_term, t), t1(t1), t2(t2), t3(t3) { }
   Select_from_where(const Location& l, Type* t, Term* t1, Term* t2, Term* t3)
@@ -558,11 +808,92 @@ struct Select_from_where : Term {
   Term* t3;
 };
 
+// select t1 from t2 where t3 group by t4
+// t1 is a Comma term whose subterms are key columns or aggregates
+// t2 is a Table term
+// t3 is the condition, as for Select_from_where
+// t4 is a Comma term whose subterms are columns of t2, or a single column
+// Evaluates to a table having a row for each group of rows of t2 with
+// the same key, whose members are those of t1.
+struct Group_by : Term {
+  static constexpr Node_kind node_kind = group_term;
+
+  Group_by(Type* t, Term* t1, Term* t2, Term* t3, Term* t4)
+    : Term(group_term, t), t1(t1), t2(t2), t3(t3), t4(t4) { }
+  Group_by(const Location& l, Type* t, Term* t1, Term* t2, Term* t3, Term* t4)
+    : Term(group_term, l, t), t1(t1), t2(t2), t3(t3), t4(t4) { }
+
+  Term* projection_list() const { return t1; }
+  Term* table() const { return t2; }
+  Term* cond() const { return t3; }
+  Term* key() const { return t4; }
+
+  Term* t1;
+  Term* t2;
+  Term* t3;
+  Term* t4;
+};
+
+// The aggregate functions of a grouped selection.
+enum Agg_op {
+  agg_count, // The number of rows
+  agg_sum,   // The sum of a column of Nat
+  agg_min,   // The least value of a column of Nat
+  agg_max,   // The greatest value of a column of Nat
+};
+
+// An aggregate 'f t2 as t1' in the projection list of a Group_by,
+// where t2 is a column of the grouped table. t1 is the name of the
+// aggregate in the rows of the result. Aggregates have type Nat.
+struct Agg : Term {
+  static constexpr Node_kind node_kind = agg_term;
+
+  Agg(Type* t, Name* t1, Term* t2, Agg_op op)
+    : Term(agg_term, t), t1(t1), t2(t2), t3(op) { }
+  Agg(const Location& l, Type* t, Name* t1, Term* t2, Agg_op op)
+    : Term(agg_term, l, t), t1(t1), t2(t2), t3(op) { }
+
+  Name* name() const { return t1; }
+  Term* column() const { return t2; }
+  Agg_op op() const { return t3; }
+
+  Name* t1;
+  Term* t2;
+  Agg_op t3;
+};
+
+// A term of form 't1 order by t2 [desc] limit t3', where t1 is a
+// selection or grouped selection. The key t2 is a column 'x.a' of the
+// selected table, or the name of an aggregate of a grouped selection;
+// it is null when the rows are not ordered. The limit t3 has type Nat,
+// and is null when the rows are not limited. The result has the type
+// of t1.
+struct Order_by : Term {
+  static constexpr Node_kind node_kind = order_term;
+
+  Order_by(Type* t, Term* t1, Expr* t2, Term* t3, bool desc)
+    : Term(order_term, t), t1(t1), t2(t2), t3(t3), t4(desc) { }
+  Order_by(const Location& l, Type* t, Term* t1, Expr* t2, Term* t3, bool desc)
+    : Term(order_term, l, t), t1(t1), t2(t2), t3(t3), t4(desc) { }
+
+  Term* query() const { return t1; }
+  Expr* key() const { return t2; }
+  Term* limit() const { return t3; }
+  bool desc() const { return t4; }
+
+  Term* t1;
+  Expr* t2;
+  Term* t3;
+  bool t4;
+};
+
 // A term of form t1 join t2 on t3
 // Evaluates to be a table
 // t1 and t2 must have type table
 // t3 must evaluate to bool
 struct Join : Term {
+  static constexpr Node_kind node_kind = join_on_term;
+
   Join(Type* t, Term* t1, Term* t2, Term* t3)
     : Term(join_on_term, t), t1(t1), t2(t2), t3(t3) { }
   Join(const Location& l, Type* t, Term* t1, Term* t2, Term* t3)
@@ -580,6 +911,8 @@ struct Join : Term {
 // t1 union t2
 // t1 and t2 is either a set, tuple, or table
 struct Union: Term {
+  static constexpr Node_kind node_kind = union_term;
+
   Union(Type* t, Term* t1, Term* t2)
     : Term(union_term, t), t1(t1), t2(t2) { }
   Union(const Location&l, Type* t, Term* t1, Term* t2)
@@ -592,6 +925,8 @@ struct Union: Term {
 // t1 intersect t2 
 // t1 and t2 is either a set, tuple, or table
 struct Intersect : Term {
+  static constexpr Node_kind node_kind = intersect_term;
+
   Intersect(Type* t, Term* t1, Term* t2)
     : Term(intersect_term, t), t1(t1), t2(t2) { }
   Intersect(const Location&l, Type* t, Term* t1, Term* t2)
@@ -604,6 +939,8 @@ struct Intersect : Term {
 // t1 except t2
 // t1 and t2 either a set, tuple, or table
 struct Except : Term {
+  static constexpr Node_kind node_kind = except_term;
+
   Except(Type* t, Term* t1, Term* t2)
     : Term(except_term, t), t1(t1), t2(t2) { }
   Except(const Location&l, Type* t, Term* t1, Term* t2)
@@ -618,6 +955,8 @@ struct Except : Term {
 
 // Represents the type of a type.
 struct Kind_type : Type {
+  static constexpr Node_kind node_kind = kind_type;
+
   Kind_type()
     : Type(kind_type, nullptr) { }
   Kind_type(const Location& l)
@@ -626,6 +965,8 @@ struct Kind_type : Type {
 
 // Represents the unit type.
 struct Unit_type : Type {
+  static constexpr Node_kind node_kind = unit_type;
+
   Unit_type(Type* k)
     : Type(unit_type, k) { }
   Unit_type(const Location& l, Type* k)
@@ -634,6 +975,8 @@ struct Unit_type : Type {
 
 // Represents the bool type.
 struct Bool_type : Type {
+  static constexpr Node_kind node_kind = bool_type;
+
   Bool_type(Type* k) 
     : Type(bool_type, k) { }
   Bool_type(const Location& l, Type* k) 
@@ -642,6 +985,8 @@ struct Bool_type : Type {
 
 // Represents the nat type.
 struct Nat_type : Type {
+  static constexpr Node_kind node_kind = nat_type;
+
   Nat_type(Type* k)
     : Type(nat_type, k) { }
   Nat_type(const Location& l, Type* k)
@@ -650,6 +995,8 @@ struct Nat_type : Type {
 
 // Represents the type of string vales.
 struct Str_type : Type {
+  static constexpr Node_kind node_kind = str_type;
+
   Str_type(Type* k)
     : Type(str_type, k) { }
   Str_type(const Location& l, Type* k)
@@ -658,6 +1005,8 @@ struct Str_type : Type {
 
 // An arrow type of the form 'T1->T2'.
 struct Arrow_type : Type {
+  static constexpr Node_kind node_kind = arrow_type;
+
   Arrow_type(Type* k, Type* t1, Type* t2)
     : Type(arrow_type, k), t1(t1), t2(t2) { }
   Arrow_type(const Location& l, Type* k, Type* t1, Type* t2)
@@ -672,6 +1021,8 @@ struct Arrow_type : Type {
 
 // A function type of the form '(T1, ..., Tn) -> T'.
 struct Fn_type : Type {
+  static constexpr Node_kind node_kind = fn_type;
+
   Fn_type(Type* k, Type_seq* ts, Type* t)
     : Type(fn_type, k), t1(ts), t2(t) { }
   Fn_type(const Location& l, Type* k, Type_seq* ts, Type* t)
@@ -686,6 +1037,8 @@ struct Fn_type : Type {
 
 // The type of a tuple has the form '{T1, ..., Tn}'.
 struct Tuple_type : Type {
+  static constexpr Node_kind node_kind = tuple_type;
+
   Tuple_type(Type* k, Type_seq* ts)
     : Type(tuple_type, k), t1(ts) { }
   Tuple_type(const Location& l, Type* k, Type_seq* ts)
@@ -698,6 +1051,8 @@ struct Tuple_type : Type {
 
 // The type of a list has the form [T].
 struct List_type : Type {
+  static constexpr Node_kind node_kind = list_type;
+
   List_type(Type* k, Type* ts)
     : Type(list_type, k), t1(ts) { }
   List_type(const Location& l, Type* k, Type* ts)
@@ -713,6 +1068,8 @@ struct List_type : Type {
 //
 // Note that each sub-term is a Var term.
 struct Record_type : Type {
+  static constexpr Node_kind node_kind = record_type;
+
   Record_type(Type* k, Term_seq* ts)
     : Type(record_type, k), t1(ts) { }
   Record_type(const Location& l, Type* k, Term_seq* ts)
@@ -728,6 +1085,8 @@ struct Record_type : Type {
 // the type of a term when its complete type must be deduced from
 // context.
 struct Wild_type : Type {
+  static constexpr Node_kind node_kind = wild_type;
+
   Wild_type(Type* k, Name* n, Type* t)
     : Type(wild_type, k), t1(n), t2(t) { }
   Wild_type(const Location& loc, Type* k, Name* n, Type* t)
@@ -753,12 +1112,22 @@ bool is_same(Expr*, Expr*);
 bool is_less(Expr*, Expr*);
 bool is_step(Term*, Term*);
 bool is_eval(Term*, Term*);
+bool is_same_row(Table*, std::size_t, Table*, std::size_t);
+
+// Hashing
+std::size_t hash_value(Expr*);
+std::size_t hash_row(Table*, std::size_t);
 
 // An equivalence relation on expressions.
 struct Expr_eq {
   bool operator()(Expr* e1, Expr* e2) const { return is_same(e1, e2); }
 };
 
+// A hash function on expressions that is consistent with Expr_eq.
+struct Expr_hash {
+  std::size_t operator()(Expr* e) const { return hash_value(e); }
+};
+
 // A strict weak order on expressions.
 struct Expr_less {
   bool operator()(Expr* e1, Expr* e2) const { return is_less(e1, e2); }
@@ -0,0 +1,459 @@
+
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <new>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <gmp.h>
+
+#include "language.hpp"
+#include "lexer.hpp"
+#include "parser.hpp"
+#include "elab.hpp"
+#include "ast.hpp"
+#include "eval.hpp"
+#include "vm.hpp"
+
+#include "lang/thread_pool.hpp"
+
+// This program measures the performance of each phase of the pipeline
+// (lexing, parsing, elaboration, compilation, and evaluation) on a set of generated
+// workloads. For each phase, it reports the elapsed time, the number
+// and size of heap allocations, and the number of bytes allocated in
+// the phase's arena.
+
+// -------------------------------------------------------------------------- //
+// Allocation counting
+//
+// The global allocation functions are replaced in order to count the
+// heap allocations made by each phase. The allocations made by GMP are
+// counted in the same way. Nodes are allocated in arenas, whose blocks
+// are obtained directly from malloc, and so they are not counted here
+// (see Arena::allocated).
+
+namespace {
+
+std::size_t allocs_ = 0; // The number of heap allocations
+std::size_t bytes_ = 0;  // The number of bytes allocated on the heap
+
+} // namespace
+
+void*
+operator new(std::size_t n) {
+  ++allocs_;
+  bytes_ += n;
+  if (void* p = std::malloc(n ? n : 1))
+    return p;
+  throw std::bad_alloc();
+}
+
+void
+operator delete(void* p) noexcept {
+  std::free(p);
+}
+
+namespace {
+
+void*
+gmp_allocate(std::size_t n) {
+  ++allocs_;
+  bytes_ += n;
+  return std::malloc(n);
+}
+
+void*
+gmp_reallocate(void* p, std::size_t, std::size_t n) {
+  ++allocs_;
+  bytes_ += n;
+  return std::realloc(p, n);
+}
+
+void
+gmp_free(void* p, std::size_t) {
+  std::free(p);
+}
+
+} // namespace
+
+
+namespace {
+
+// -------------------------------------------------------------------------- //
+// Measurement
+
+using Clock = std::chrono::steady_clock;
+
+// The cost of a phase.
+struct Measure {
+  double      ms = 0;     // Elapsed time in milliseconds
+  std::size_t allocs = 0; // Number of heap allocations
+  std::size_t bytes = 0;  // Bytes allocated on the heap
+  std::size_t arena = 0;  // Bytes allocated in the phase's arena
+};
+
+// A phase timer records the time and heap allocations between its
+// construction and a call to stop.
+struct Phase_timer {
+  Phase_timer()
+    : start(Clock::now()), allocs(allocs_), bytes(bytes_) { }
+
+  void stop(Measure&, const Arena* = nullptr);
+
+  Clock::time_point start;
+  std::size_t allocs;
+  std::size_t bytes;
+};
+
+void
+Phase_timer::stop(Measure& m, const Arena* a) {
+  std::chrono::duration<double, std::milli> d = Clock::now() - start;
+  m.ms = d.count();
+  m.allocs = allocs_ - allocs;
+  m.bytes = bytes_ - bytes;
+  m.arena = a ? a->allocated() : 0;
+}
+
+// The phases of the pipeline.
+enum Phase {
+  lex_phase,
+  parse_phase,
+  elab_phase,
+  compile_phase,
+  eval_phase,
+  num_phases
+};
+
+const char* phase_names[num_phases] = {
+  "lex",
+  "parse",
+  "elab",
+  "code",
+  "eval",
+};
+
+using Measures = Measure[num_phases];
+
+
+// -------------------------------------------------------------------------- //
+// Workloads
+//
+// Each workload generates the text of a program whose size is
+// determined by a parameter n.
+
+// Generate a definition of the table x having n rows of the form
+// {a = i, b = i % 7}, followed by the definition of the table y
+// having n rows of the form {c = i + k, d = i % 5}. The names of the
+// columns of y are a and b when same is true.
+void
+make_tables(std::ostream& os, int n, int k, bool same) {
+  os << "def x = [";
+  for (int i = 0; i < n; ++i) {
+    if (i)
+      os << ", ";
+    os << "{a = " << i << ", b = " << i % 7 << "}";
+  }
+  os << "];\n";
+
+  const char* c = same ? "a" : "c";
+  const char* d = same ? "b" : "d";
+  os << "def y = [";
+  for (int i = 0; i < n; ++i) {
+    if (i)
+      os << ", ";
+    os << "{" << c << " = " << i + k << ", " << d << " = " << i % 5 << "}";
+  }
+  os << "];\n";
+}
+
+// A single large table literal.
+std::string
+make_table_workload(int n) {
+  std::stringstream ss;
+  ss << "def x = [";
+  for (int i = 0; i < n; ++i) {
+    if (i)
+      ss << ", ";
+    ss << "{a = " << i << ", b = " << i % 7 << ", c = true}";
+  }
+  ss << "];\n";
+  ss << "x;\n";
+  return ss.str();
+}
+
+// A deeply nested abstraction, applied to n arguments.
+//
+//    def f = \x1:Nat => ... => \xn:Nat => x1;
+//    f 1 ... n;
+std::string
+make_lambda_workload(int n) {
+  std::stringstream ss;
+  ss << "def f = ";
+  for (int i = 1; i <= n; ++i)
+    ss << "\\x" << i << ":Nat => ";
+  ss << "x1;\n";
+  ss << "f";
+  for (int i = 1; i <= n; ++i)
+    ss << ' ' << i;
+  ss << ";\n";
+  return ss.str();
+}
+
+// A chain of n functions, each of which calls the previous one.
+// Definitions cannot refer to themselves, so the recursion is
+// unrolled into a sequence of definitions.
+//
+//    def f0 = \n:Nat => n;
+//    def fi = \n:Nat => if iszero n then 0 else fi-1 (pred n);
+//    fn n;
+std::string
+make_call_workload(int n) {
+  std::stringstream ss;
+  ss << "def f0 = \\n:Nat => n;\n";
+  for (int i = 1; i <= n; ++i)
+    ss << "def f" << i << " = \\n:Nat => "
+       << "if iszero n then 0 else f" << i - 1 << " (pred n);\n";
+  ss << "f" << n << ' ' << n << ";\n";
+  return ss.str();
+}
+
+// A selection over a table of n rows.
+std::string
+make_select_workload(int n) {
+  std::stringstream ss;
+  make_tables(ss, n, 0, false);
+  ss << "select x.a from x where (x.b eq 3) and (x.a lt " << n / 2 << ");\n";
+  return ss.str();
+}
+
+// An equijoin of two tables of n rows.
+std::string
+make_join_workload(int n) {
+  std::stringstream ss;
+  make_tables(ss, n, n / 2, false);
+  ss << "x join y on x.a eq y.c;\n";
+  return ss.str();
+}
+
+// The union of two tables of n rows, half of which overlap.
+std::string
+make_union_workload(int n) {
+  std::stringstream ss;
+  make_tables(ss, n, n / 2, true);
+  ss << "x union y;\n";
+  return ss.str();
+}
+
+struct Workload {
+  const char* name;
+  int size; // The default size of the workload
+  std::string (*make)(int);
+};
+
+Workload workloads[] = {
+  {"table", 20000, make_table_workload},
+  {"lambda", 500, make_lambda_workload},
+  {"call", 500, make_call_workload},
+  {"select", 20000, make_select_workload},
+  {"join", 5000, make_join_workload},
+  {"union", 5000, make_union_workload},
+};
+
+Workload*
+find_workload(const std::string& name) {
+  for (Workload& w : workloads)
+    if (name == w.name)
+      return &w;
+  return nullptr;
+}
+
+
+// -------------------------------------------------------------------------- //
+// Running workloads
+
+// Run the pipeline over the given program text, recording the cost
+// of each phase in ms. Returns false if any phase fails.
+bool
+run(const std::string& text, Engine engine, Measures& ms) {
+  Lexer lex;
+  Phase_timer lex_timer;
+  Tokens toks = lex(text);
+  lex_timer.stop(ms[lex_phase]);
+  if (not lex.diags.empty()) {
+    std::cerr << lex.diags;
+    return false;
+  }
+
+  Parser parse;
+  Phase_timer parse_timer;
+  Tree* tree = parse(toks);
+  parse_timer.stop(ms[parse_phase], &parse.arena);
+  if (not parse.diags.empty()) {
+    std::cerr << parse.diags;
+    return false;
+  }
+
+  Elaborator elab;
+  Phase_timer elab_timer;
+  Expr* prog = elab(tree);
+  elab_timer.stop(ms[elab_phase], &elab.arena);
+  if (not elab.diags.empty()) {
+    std::cerr << elab.diags;
+    return false;
+  }
+
+  Term* term = as<Term>(prog);
+  if (not term)
+    return false;
+  // Compilation is only measured for the virtual machine.
+  Evaluator eval(engine);
+  Code* code = nullptr;
+  Phase_timer compile_timer;
+  if (engine == vm_engine)
+    code = eval.compile(term);
+  compile_timer.stop(ms[compile_phase]);
+
+  Phase_timer eval_timer;
+  if (code)
+    eval(code);
+  else
+    eval(term);
+  eval_timer.stop(ms[eval_phase]);
+  ms[eval_phase].arena = eval.allocated();
+  return true;
+}
+
+// Print the cost of a phase of the workload.
+void
+report(const Workload& w, int size, const char* phase, const Measure& m) {
+  std::cout << std::left << std::setw(8) << w.name
+            << std::right << std::setw(8) << size << "  "
+            << std::left << std::setw(6) << phase
+            << std::right << std::fixed << std::setprecision(2)
+            << std::setw(12) << m.ms
+            << std::setw(12) << m.allocs
+            << std::setw(12) << m.bytes / 1024
+            << std::setw(12) << m.arena / 1024 << '\n';
+}
+
+// Run the workload the given number of times, and report the fastest
+// time for each phase. Allocations do not vary between runs.
+bool
+run(Workload& w, int size, int runs, Engine engine) {
+  std::string text = w.make(size);
+
+  Measures best;
+  for (int i = 0; i < runs; ++i) {
+    Measures ms;
+    if (not run(text, engine, ms))
+      return false;
+    for (int p = 0; p < num_phases; ++p)
+      if (i == 0 or ms[p].ms < best[p].ms)
+        best[p] = ms[p];
+  }
+
+  Measure total;
+  for (int p = 0; p < num_phases; ++p) {
+    const Measure& m = best[p];
+    report(w, size, phase_names[p], m);
+    total.ms += m.ms;
+    total.allocs += m.allocs;
+    total.bytes += m.bytes;
+    total.arena += m.arena;
+  }
+  report(w, size, "total", total);
+  return true;
+}
+
+void
+usage(const char* prog) {
+  std::cerr << "usage: " << prog
+            << " [--engine=vm|subst|env] [--runs=n] [--size=n]"
+            << " [--threads=n]"
+            << " [workload[=n] ...]\n";
+  std::cerr << "workloads:";
+  for (Workload& w : workloads)
+    std::cerr << ' ' << w.name;
+  std::cerr << '\n';
+}
+
+} // namespace
+
+
+int main(int argc, char* argv[]) {
+  Language lang;
+  mp_set_memory_functions(gmp_allocate, gmp_reallocate, gmp_free);
+
+  // ------------------------------------------------------------------------ //
+  // Options
+  //
+  // Each workload may be given a size (e.g., join=1000). Otherwise, the
+  // size given by --size is used, if any, or the default size of the
+  // workload. All workloads are run when none are named.
+  Engine engine = vm_engine;
+  int runs = 3;
+  int size = 0;
+  std::vector<std::pair<Workload*, int>> todo;
+  for (int i = 1; i < argc; ++i) {
+    const char* arg = argv[i];
+    if (std::strcmp(arg, "--engine=vm") == 0)
+      engine = vm_engine;
+    else if (std::strcmp(arg, "--engine=subst") == 0)
+      engine = subst_engine;
+    else if (std::strcmp(arg, "--engine=env") == 0)
+      engine = env_engine;
+    else if (std::strncmp(arg, "--runs=", 7) == 0)
+      runs = std::atoi(arg + 7);
+    else if (std::strncmp(arg, "--size=", 7) == 0)
+      size = std::atoi(arg + 7);
+    else if (std::strncmp(arg, "--threads=", 10) == 0)
+      set_thread_count(std::atoi(arg + 10));
+    else if (arg[0] != '-') {
+      std::string name = arg;
+      int n = 0;
+      std::size_t eq = name.find('=');
+      if (eq != std::string::npos) {
+        n = std::atoi(name.c_str() + eq + 1);
+        name.erase(eq);
+      }
+      Workload* w = find_workload(name);
+      if (not w) {
+        usage(argv[0]);
+        return -1;
+      }
+      todo.emplace_back(w, n);
+    } else {
+      usage(argv[0]);
+      return -1;
+    }
+  }
+  if (runs < 1) {
+    usage(argv[0]);
+    return -1;
+  }
+  if (todo.empty())
+    for (Workload& w : workloads)
+      todo.emplace_back(&w, 0);
+
+  // ------------------------------------------------------------------------ //
+  // Benchmarks
+  std::cout << std::left << std::setw(8) << "workload"
+            << std::right << std::setw(8) << "size" << "  "
+            << std::left << std::setw(6) << "phase"
+            << std::right
+            << std::setw(12) << "time (ms)"
+            << std::setw(12) << "allocs"
+            << std::setw(12) << "heap (kB)"
+            << std::setw(12) << "arena (kB)" << '\n';
+  for (auto& x : todo) {
+    int n = x.second ? x.second : size ? size : x.first->size;
+    if (not run(*x.first, n, runs, engine)) {
+      std::cerr << "error: workload '" << x.first->name << "' failed\n";
+      return -1;
+    }
+  }
+}
@@ -0,0 +1,1132 @@
+
+#include "cache.hpp"
+#include "plan.hpp"
+#include "table.hpp"
+#include "table_file.hpp"
+#include "type.hpp"
+
+#include "lang/debug.hpp"
+#include "lang/mapped_file.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <unordered_map>
+
+#include <unistd.h>
+
+// The file begins with a header containing the magic string, the
+// version of the format, the key of the source text, and the hash of
+// the body (see hash_source), which detects damaged files. Each value
+// that follows is an unsigned integer written in 7-bit groups (least
+// significant first). The body is the number of nodes, the record of
+// each node, and a reference to the root of the program.
+//
+// Nodes are numbered from 1 in the order of their records. Each record
+// starts with the node kind, the location of the node (as the difference
+// from the location of the previous record), and the number of its
+// type. The other nodes referred to by a record are written as the
+// distance back to them from the record (plus one), since those nodes
+// are usually written just before it. The null reference is 0. Strings
+// are written once, and referred to by number after that.
+
+namespace {
+
+const char magic[8] = {'w', 'a', 'f', 'f', 'l', 'e', 'p', 'c'};
+
+constexpr std::size_t header_size = sizeof(magic) + 4 + 8 + 8;
+
+// The kind of a node is written with its class in the low bits, so the
+// kinds of most nodes fit in one or two bytes.
+inline std::uint64_t
+encode_kind(Node_kind k) { return std::uint64_t(k & 0xffffff) << 3 | get_node_class(k); }
+
+inline Node_kind
+decode_kind(std::uint64_t n) { return Node_kind(n >> 3) | make_node_class(n & 7); }
+
+// Signed values (e.g., differences between lines) are interleaved with
+// unsigned ones, so that values near zero are small.
+inline std::uint64_t
+encode_signed(std::int64_t n) { return n < 0 ? ~std::uint64_t(n) * 2 + 1 : std::uint64_t(n) * 2; }
+
+inline std::int64_t
+decode_signed(std::uint64_t n) { return n & 1 ? ~std::int64_t(n >> 1) : std::int64_t(n >> 1); }
+
+// Returns the position of loc in the source starting at src. Internal
+// locations are at position 0, and the first character at position 1.
+inline std::int64_t
+get_pos(Location loc, Location src) {
+  return loc.is_internal() ? 0 : std::int64_t(loc.offset) - src.offset + 1;
+}
+
+// Returns the location at the position p of the source starting at src.
+inline Location
+get_loc(std::int64_t p, Location src) {
+  return p == 0 ? Location(no_location) : src + std::size_t(p - 1);
+}
+
+// Append the n byte little-endian representation of v to s.
+inline void
+put_fixed(std::string& s, std::uint64_t v, int n) {
+  for (int i = 0; i < n; ++i)
+    s += char((v >> (8 * i)) & 0xff);
+}
+
+// Returns the n byte little-endian value at p.
+inline std::uint64_t
+get_fixed(const char* p, int n) {
+  std::uint64_t v = 0;
+  for (int i = 0; i < n; ++i)
+    v |= std::uint64_t((unsigned char)p[i]) << (8 * i);
+  return v;
+}
+
+// -------------------------------------------------------------------------- //
+// Writing
+
+// A sequence of node references.
+using Refs = std::vector<std::size_t>;
+
+// The writer appends the records of an expression graph to a string.
+//
+// The writer is run twice over a program. The first pass finds the
+// record types of the program, so that a reference to a member of a
+// record type can be written as a reference into that type (the
+// interned type is created with its own members when it is loaded).
+struct Writer {
+  Writer(Location src)
+    : count(0), src(src), pos(0), dry(false), locs(true), effects(false) { }
+
+  std::size_t ref(Expr*);
+  void write(Expr*);
+  void reset();
+
+  void put(std::uint64_t);
+  void put_ref(std::size_t);
+  void put_refs(const Refs&);
+  void put_string(String);
+  void emit(Expr*, std::size_t, const Refs& = {});
+
+  template<typename T>
+    Refs seq(Seq<T>*);
+
+  template<typename T>
+    void write_unary(T* t) { emit(t, ref(t->tr), {ref(t->t1)}); }
+
+  template<typename T>
+    void write_binary(T* t) { emit(t, ref(t->tr), {ref(t->t1), ref(t->t2)}); }
+
+  template<typename T>
+    void write_ternary(T* t) {
+      emit(t, ref(t->tr), {ref(t->t1), ref(t->t2), ref(t->t3)});
+    }
+
+  template<typename T>
+    void write_seq(T* t) {
+      Refs ts = seq(t->t1);
+      emit(t, ref(t->tr));
+      put_refs(ts);
+    }
+
+  void write_int(Int*);
+  void write_record_type(Record_type*);
+
+  std::string out;
+  std::size_t count; // The number of the last node written
+  Location src;      // The location of the source of the program
+  std::int64_t pos;  // The position of the last node written
+  bool dry;          // True when finding record types
+  bool locs;         // False when locations are not written
+  bool effects;      // True when a print or save has been written
+  std::vector<Term*> files; // The paths of the loads and CSV sources
+  std::unordered_map<Expr*, std::size_t> ids;
+  std::unordered_map<const void*, std::size_t> strs;
+  std::unordered_map<Expr*, Record_type*> members;
+};
+
+// Discard the output of the first pass, keeping the record types.
+void
+Writer::reset() {
+  out.clear();
+  count = 0;
+  pos = 0;
+  dry = false;
+  ids.clear();
+  strs.clear();
+}
+
+// Append the integer n to the output.
+void
+Writer::put(std::uint64_t n) {
+  if (dry)
+    return;
+  while (n >= 0x80) {
+    out += char((n & 0x7f) | 0x80);
+    n >>= 7;
+  }
+  out += char(n);
+}
+
+// Append the reference to node r from the last node written.
+void
+Writer::put_ref(std::size_t r) {
+  put(r ? count - r + 1 : 0);
+}
+
+// Append the number of references in rs, followed by each reference.
+void
+Writer::put_refs(const Refs& rs) {
+  put(rs.size());
+  for (std::size_t r : rs)
+    put_ref(r);
+}
+
+void
+Writer::put_string(String s) {
+  auto iter = strs.find(s.ptr());
+  if (iter != strs.end()) {
+    put(iter->second + 1);
+    return;
+  }
+  std::size_t n = strs.size();
+  strs.emplace(s.ptr(), n);
+  put(0);
+  put(s.size());
+  if (not dry)
+    out.append(s.data(), s.size());
+}
+
+// Start the record of the node e, whose type is node t, and which is
+// given the next number. The references rs follow the header of the
+// record.
+void
+Writer::emit(Expr* e, std::size_t t, const Refs& rs) {
+  ids[e] = ++count;
+  put(encode_kind(e->kind));
+  std::int64_t p = locs ? get_pos(e->loc, src) : 0;
+  put(encode_signed(p - pos));
+  put(t);
+  pos = p;
+  for (std::size_t r : rs)
+    put_ref(r);
+}
+
+// Write the elements of the sequence, returning their references.
+template<typename T>
+  Refs
+  Writer::seq(Seq<T>* s) {
+    Refs rs;
+    rs.reserve(s->size());
+    for (T* t : *s)
+      rs.push_back(ref(t));
+    return rs;
+  }
+
+// Returns the reference to e, writing e if it has not been written.
+std::size_t
+Writer::ref(Expr* e) {
+  if (not e)
+    return 0;
+  auto iter = ids.find(e);
+  if (iter != ids.end())
+    return iter->second;
+
+  // A member of a record type is numbered when its type is written.
+  auto mem = members.find(e);
+  if (mem != members.end()) {
+    ref(mem->second);
+    return ids[e];
+  }
+
+  write(e);
+  return ids[e];
+}
+
+// A record type is written as the names and types of its members,
+// which are numbered after the type.
+void
+Writer::write_record_type(Record_type* t) {
+  Term_seq* vs = t->members();
+  Refs ts;
+  for (Term* v : *vs)
+    ts.push_back(ref(as<Var>(v)->type()));
+  emit(t, 0);
+  put(vs->size());
+  for (std::size_t i = 0; i < vs->size(); ++i) {
+    put_string(as<Id>(as<Var>((*vs)[i])->name())->t1);
+    put_ref(ts[i]);
+  }
+  for (Term* v : *vs) {
+    ids[v] = ++count;
+    members.emplace(v, t);
+  }
+}
+
+// An integer is written as its base, followed by twice its value when
+// it is small (and not negative). Otherwise, an odd number is followed
+// by the digits of the integer.
+void
+Writer::write_int(Int* t) {
+  const Integer& n = t->value();
+  emit(t, ref(t->tr));
+  put(n.base());
+  if (n.is_small() and n.word() >= 0) {
+    put(std::uint64_t(n.word()) * 2);
+  } else {
+    put(1);
+    put_string(to_string(n));
+  }
+}
+
+void
+Writer::write(Expr* e) {
+  switch (e->kind) {
+  case id_expr:
+    emit(e, ref(e->tr));
+    put_string(as<Id>(e)->t1);
+    return;
+
+  case unit_term:
+  case true_term:
+  case false_term:
+    return emit(e, ref(e->tr));
+
+  case int_term: return write_int(as<Int>(e));
+
+  case str_term:
+    emit(e, ref(e->tr));
+    put_string(as<Str>(e)->value());
+    return;
+
+  case if_term: return write_ternary(as<If>(e));
+  case select_term: return write_ternary(as<Select_from_where>(e));
+  case join_on_term: return write_ternary(as<Join>(e));
+  case group_term: {
+    Group_by* t = as<Group_by>(e);
+    return emit(t, ref(t->tr), {ref(t->t1), ref(t->t2), ref(t->t3), ref(t->t4)});
+  }
+  case agg_term: {
+    // The operation follows the name and column.
+    Agg* t = as<Agg>(e);
+    emit(t, ref(t->tr), {ref(t->t1), ref(t->t2)});
+    put(t->op());
+    return;
+  }
+  case order_term: {
+    // The direction follows the query, key, and limit.
+    Order_by* t = as<Order_by>(e);
+    emit(t, ref(t->tr), {ref(t->t1), ref(t->t2), ref(t->t3)});
+    put(t->t4);
+    return;
+  }
+
+  case and_term: return write_binary(as<And>(e));
+  case or_term: return write_binary(as<Or>(e));
+  case equals_term: return write_binary(as<Equals>(e));
+  case less_term: return write_binary(as<Less>(e));
+  case var_term: return write_binary(as<Var>(e));
+  case abs_term: {
+    // The memo flag of an abstraction follows its operands.
+    Abs* t = as<Abs>(e);
+    write_binary(t);
+    put(t->memo());
+    return;
+  }
+  case app_term: return write_binary(as<App>(e));
+  case proj_term: return write_binary(as<Proj>(e));
+  case mem_term: {
+    // The index follows the object and member.
+    Mem* t = as<Mem>(e);
+    write_binary(t);
+    put(t->t3);
+    return;
+  }
+  case col_term: return write_binary(as<Col>(e));
+  case def_term: return write_binary(as<Def>(e));
+  case init_term: return write_binary(as<Init>(e));
+  case union_term: return write_binary(as<Union>(e));
+  case intersect_term: return write_binary(as<Intersect>(e));
+  case except_term: return write_binary(as<Except>(e));
+  case save_term:
+    effects = true;
+    return write_binary(as<Save>(e));
+
+  case not_term: return write_unary(as<Not>(e));
+  case succ_term: return write_unary(as<Succ>(e));
+  case pred_term: return write_unary(as<Pred>(e));
+  case iszero_term: return write_unary(as<Iszero>(e));
+  case ref_term: {
+    // The slot of a reference follows the referred-to declaration.
+    // Since the depth of a reference without a slot is -1, both are
+    // written plus one.
+    Ref* t = as<Ref>(e);
+    emit(t, ref(t->tr), {ref(t->decl())});
+    put(std::uint64_t(t->depth() + 1));
+    put(std::uint64_t(t->index() + 1));
+    return;
+  }
+  case print_term:
+    effects = true;
+    return write_unary(as<Print>(e));
+  case load_term:
+    files.push_back(as<Load>(e)->t1);
+    return write_unary(as<Load>(e));
+  case csv_term:
+    files.push_back(as<Csv>(e)->t1);
+    return write_unary(as<Csv>(e));
+
+  case tuple_term: return write_seq(as<Tuple>(e));
+  case list_term: return write_seq(as<List>(e));
+  case record_term: return write_seq(as<Record>(e));
+  case comma_term: return write_seq(as<Comma>(e));
+  case prog_term: return write_seq(as<Prog>(e));
+
+  case table_term: {
+    // The number of rows and of columns follow the header, and then
+    // the cells of each column.
+    Table* t = as<Table>(e);
+    std::vector<Refs> cols;
+    cols.reserve(t->columns()->size());
+    for (Term_seq* col : *t->columns())
+      cols.push_back(seq(col));
+    emit(t, ref(t->tr));
+    put(t->rows());
+    put(cols.size());
+    for (const Refs& col : cols)
+      put_refs(col);
+    return;
+  }
+
+  case fn_term: {
+    Fn* t = as<Fn>(e);
+    Refs ps = seq(t->parms());
+    emit(t, ref(t->tr), {ref(t->term())});
+    put_refs(ps);
+    put(t->memo());
+    return;
+  }
+
+  case call_term: {
+    Call* t = as<Call>(e);
+    Refs args = seq(t->args());
+    emit(t, ref(t->tr), {ref(t->fn())});
+    put_refs(args);
+    return;
+  }
+
+  case kind_type:
+  case unit_type:
+  case bool_type:
+  case nat_type:
+  case str_type:
+    return emit(e, 0);
+
+  case arrow_type: {
+    Arrow_type* t = as<Arrow_type>(e);
+    return emit(t, 0, {ref(t->t1), ref(t->t2)});
+  }
+
+  case fn_type: {
+    Fn_type* t = as<Fn_type>(e);
+    Refs ts = seq(t->parms());
+    emit(t, 0, {ref(t->result())});
+    put_refs(ts);
+    return;
+  }
+
+  case tuple_type: {
+    Tuple_type* t = as<Tuple_type>(e);
+    Refs ts = seq(t->types());
+    emit(t, 0);
+    put_refs(ts);
+    return;
+  }
+
+  case list_type: {
+    List_type* t = as<List_type>(e);
+    return emit(t, 0, {ref(t->type())});
+  }
+
+  case record_type: return write_record_type(as<Record_type>(e));
+
+  case wild_type: {
+    Wild_type* t = as<Wild_type>(e);
+    return emit(t, 0, {ref(t->name()), ref(t->type())});
+  }
+
+  default:
+    break;
+  }
+  lang_unreachable(format("cannot save expression '{}'", node_name(e)));
+}
+
+
+// -------------------------------------------------------------------------- //
+// Reading
+
+// The reader reconstructs the nodes of a file, allocating them in the
+// current arena. Any malformed value causes the read to fail.
+struct Reader {
+  Reader(const char* f, const char* l, Location src)
+    : ptr(f), end(l), ok(true), src(src), pos(0) { }
+
+  std::uint64_t get();
+  String get_string();
+
+  template<typename T>
+    T* get_ref(bool = true);
+
+  template<typename T>
+    T* get_node();
+
+  template<typename T>
+    Seq<T>* get_seq();
+
+  Expr* read();
+  Expr* read_record_type();
+  Expr* read_table(const Location&, Type*);
+
+  template<typename T, typename T1>
+    Expr* read_unary(const Location&, Type*);
+
+  template<typename T, typename T1, typename T2>
+    Expr* read_binary(const Location&, Type*);
+
+  template<typename T>
+    Expr* read_ternary(const Location&, Type*);
+
+  template<typename T, typename T1>
+    Expr* read_seq(const Location&, Type*);
+
+  const char* ptr;
+  const char* end;
+  bool ok;
+  Location src;     // The location of the source of the program
+  std::int64_t pos; // The position of the last node read
+  std::vector<Expr*> nodes;
+  std::vector<String> strs;
+};
+
+std::uint64_t
+Reader::get() {
+  std::uint64_t n = 0;
+  for (int shift = 0; shift < 64; shift += 7) {
+    if (ptr == end)
+      break;
+    unsigned char c = *ptr++;
+    n |= std::uint64_t(c & 0x7f) << shift;
+    if (not (c & 0x80))
+      return n;
+  }
+  ok = false;
+  return 0;
+}
+
+String
+Reader::get_string() {
+  std::uint64_t n = get();
+  if (n != 0) {
+    if (n > strs.size()) {
+      ok = false;
+      return String();
+    }
+    return strs[n - 1];
+  }
+  std::uint64_t len = get();
+  if (not ok or len > std::uint64_t(end - ptr)) {
+    ok = false;
+    return String();
+  }
+  String s(ptr, ptr + len);
+  ptr += len;
+  strs.push_back(s);
+  return s;
+}
+
+// Returns the node referred to by the next reference, which may be
+// null. The reference is relative to the record being read, unless
+// rel is false. The read fails if that node is not a T.
+template<typename T>
+  T*
+  Reader::get_ref(bool rel) {
+    std::uint64_t n = get();
+    if (n == 0)
+      return nullptr;
+    if (rel)
+      n = n <= nodes.size() + 1 ? nodes.size() + 2 - n : 0;
+    if (n == 0 or n > nodes.size()) {
+      ok = false;
+      return nullptr;
+    }
+    T* t = as<T>(nodes[n - 1]);
+    if (not t)
+      ok = false;
+    return t;
+  }
+
+// Returns the node referred to by the next reference, which must not
+// be null.
+template<typename T>
+  T*
+  Reader::get_node() {
+    T* t = get_ref<T>();
+    if (not t)
+      ok = false;
+    return t;
+  }
+
+template<typename T>
+  Seq<T>*
+  Reader::get_seq() {
+    std::uint64_t n = get();
+    if (not ok or n > std::uint64_t(end - ptr)) {
+      ok = false;
+      return nullptr;
+    }
+    Seq<T>* s = new Seq<T>();
+    s->reserve(n);
+    for (std::uint64_t i = 0; i < n; ++i)
+      s->push_back(get_ref<T>());
+    return s;
+  }
+
+template<typename T, typename T1>
+  Expr*
+  Reader::read_unary(const Location& loc, Type* type) {
+    T1* t1 = get_ref<T1>();
+    if (not ok)
+      return nullptr;
+    return new T(loc, type, t1);
+  }
+
+template<typename T, typename T1, typename T2>
+  Expr*
+  Reader::read_binary(const Location& loc, Type* type) {
+    T1* t1 = get_ref<T1>();
+    T2* t2 = get_ref<T2>();
+    if (not ok)
+      return nullptr;
+    return new T(loc, type, t1, t2);
+  }
+
+template<typename T>
+  Expr*
+  Reader::read_ternary(const Location& loc, Type* type) {
+    Term* t1 = get_ref<Term>();
+    Term* t2 = get_ref<Term>();
+    Term* t3 = get_ref<Term>();
+    if (not ok)
+      return nullptr;
+    return new T(loc, type, t1, t2, t3);
+  }
+
+template<typename T, typename T1>
+  Expr*
+  Reader::read_seq(const Location& loc, Type* type) {
+    Seq<T1>* ts = get_seq<T1>();
+    if (not ok)
+      return nullptr;
+    return new T(loc, type, ts);
+  }
+
+// Read a table, whose type must have a member for each column, and
+// whose columns must each have a cell for each row.
+Expr*
+Reader::read_table(const Location& loc, Type* type) {
+  std::uint64_t rows = get();
+  std::uint64_t n = get();
+  Record_type* rt = type ? get_row_type(type) : nullptr;
+  if (not ok or not rt or n != rt->members()->size()) {
+    ok = false;
+    return nullptr;
+  }
+  Column_seq* cols = new Column_seq();
+  cols->reserve(n);
+  for (std::uint64_t i = 0; i < n; ++i) {
+    Term_seq* col = get_seq<Term>();
+    if (not ok or col->size() != rows
+        or std::count(col->begin(), col->end(), nullptr) != 0) {
+      ok = false;
+      return nullptr;
+    }
+    cols->push_back(col);
+  }
+  Table* table = make_table(type, cols, rows);
+  table->loc = loc;
+  return table;
+}
+
+// Read a record type, which is interned. Its members are numbered
+// after the type.
+Expr*
+Reader::read_record_type() {
+  std::uint64_t n = get();
+  if (not ok or n > std::uint64_t(end - ptr)) {
+    ok = false;
+    return nullptr;
+  }
+  Term_seq* vs = new Term_seq();
+  for (std::uint64_t i = 0; i < n; ++i) {
+    String s = get_string();
+    Type* t = get_node<Type>();
+    if (not ok)
+      return nullptr;
+    vs->push_back(new Var(new Id(s), t));
+  }
+  Record_type* r = as<Record_type>(get_record_type(vs));
+  nodes.push_back(r);
+  for (Term* v : *r->members())
+    nodes.push_back(v);
+  return r;
+}
+
+// Read the next record, returning the new node, or nullptr if the read
+// fails.
+Expr*
+Reader::read() {
+  Node_kind k = decode_kind(get());
+  pos += decode_signed(get());
+  if (pos < 0 or pos > std::int64_t(UINT32_MAX - src.offset))
+    ok = false;
+  Location loc = get_loc(pos, src);
+  Type* type = get_ref<Type>(false);
+  if (not ok)
+    return nullptr;
+
+  switch (k) {
+  case id_expr: {
+    String s = get_string();
+    return ok ? new Id(loc, s) : nullptr;
+  }
+
+  case unit_term: return new Unit(loc, type);
+  case true_term: return new True(loc, type);
+  case false_term: return new False(loc, type);
+
+  case int_term: {
+    std::uint64_t base = get();
+    std::uint64_t n = get();
+    if (base < 2 or base > 16)
+      ok = false;
+    if (n % 2 == 0)
+      return ok ? new Int(loc, type, Integer(long(n / 2), int(base))) : nullptr;
+    String s = get_string();
+    return ok ? new Int(loc, type, Integer(s, int(base))) : nullptr;
+  }
+
+  case str_term: {
+    String s = get_string();
+    return ok ? new Str(loc, type, s) : nullptr;
+  }
+
+  case if_term: return read_ternary<If>(loc, type);
+  case select_term: return read_ternary<Select_from_where>(loc, type);
+  case join_on_term: return read_ternary<Join>(loc, type);
+  case group_term: {
+    Term* t1 = get_ref<Term>();
+    Term* t2 = get_ref<Term>();
+    Term* t3 = get_ref<Term>();
+    Term* t4 = get_ref<Term>();
+    if (not ok)
+      return nullptr;
+    return new Group_by(loc, type, t1, t2, t3, t4);
+  }
+  case agg_term: {
+    Name* n = get_node<Name>();
+    Term* c = get_node<Term>();
+    std::uint64_t op = get();
+    if (not ok or op > agg_max) {
+      ok = false;
+      return nullptr;
+    }
+    return new Agg(loc, type, n, c, Agg_op(op));
+  }
+  case order_term: {
+    Term* t1 = get_node<Term>();
+    Expr* t2 = get_ref<Expr>();
+    Term* t3 = get_ref<Term>();
+    std::uint64_t desc = get();
+    if (not ok or desc > 1) {
+      ok = false;
+      return nullptr;
+    }
+    return new Order_by(loc, type, t1, t2, t3, desc);
+  }
+
+  case and_term: return read_binary<And, Term, Term>(loc, type);
+  case or_term: return read_binary<Or, Term, Term>(loc, type);
+  case equals_term: return read_binary<Equals, Term, Term>(loc, type);
+  case less_term: return read_binary<Less, Term, Term>(loc, type);
+  case abs_term: {
+    Term* v = get_ref<Term>();
+    Term* t = get_ref<Term>();
+    bool memo = get();
+    if (not ok)
+      return nullptr;
+    Abs* abs = new Abs(loc, type, v, t);
+    abs->t3 = memo;
+    return abs;
+  }
+  case app_term: return read_binary<App, Term, Term>(loc, type);
+  case proj_term: return read_binary<Proj, Term, Term>(loc, type);
+  case mem_term: {
+    Term* t1 = get_ref<Term>();
+    Term* t2 = get_ref<Term>();
+    std::uint64_t i = get();
+    if (not ok)
+      return nullptr;
+    Type* obj = get_type(t1);
+    if (List_type* l = as<List_type>(obj))
+      obj = l->type();
+    Record_type* r = as<Record_type>(obj);
+    if (not r or i >= r->members()->size()) {
+      ok = false;
+      return nullptr;
+    }
+    return new Mem(loc, type, t1, t2, i);
+  }
+  case col_term: return read_binary<Col, Term, Term>(loc, type);
+  case def_term: return read_binary<Def, Name, Expr>(loc, type);
+  case init_term: return read_binary<Init, Name, Expr>(loc, type);
+  case union_term: return read_binary<Union, Term, Term>(loc, type);
+  case intersect_term: return read_binary<Intersect, Term, Term>(loc, type);
+  case except_term: return read_binary<Except, Term, Term>(loc, type);
+  case save_term: return read_binary<Save, Term, Term>(loc, type);
+
+  case var_term: {
+    Name* n = get_ref<Name>();
+    Type* t = get_ref<Type>();
+    if (not ok)
+      return nullptr;
+    Var* v = new Var(loc, n, t);
+    v->tr = type;
+    return v;
+  }
+
+  case not_term: return read_unary<Not, Term>(loc, type);
+  case succ_term: return read_unary<Succ, Term>(loc, type);
+  case pred_term: return read_unary<Pred, Term>(loc, type);
+  case iszero_term: return read_unary<Iszero, Term>(loc, type);
+  case print_term: return read_unary<Print, Expr>(loc, type);
+  case load_term: {
+    // The type of a load is the schema of its file when the program
+    // was elaborated. If the schema has changed since, the program
+    // must be elaborated again.
+    Term* t1 = get_ref<Term>();
+    if (not ok)
+      return nullptr;
+    std::string path = get_file_path(t1);
+    if (load_table_type(path) != type) {
+      ok = false;
+      return nullptr;
+    }
+    preload_table(path, type);
+    return new Load(loc, type, t1);
+  }
+  case csv_term: return read_unary<Csv, Term>(loc, type);
+
+  case ref_term: {
+    Expr* d = get_node<Expr>();
+    int depth = int(get()) - 1;
+    int index = int(get()) - 1;
+    if (not ok)
+      return nullptr;
+    Ref* r = new Ref(loc, d, depth, index);
+    r->tr = type;
+    return r;
+  }
+
+  case tuple_term: return read_seq<Tuple, Term>(loc, type);
+  case list_term: return read_seq<List, Term>(loc, type);
+  case record_term: return read_seq<Record, Term>(loc, type);
+  case comma_term: return read_seq<Comma, Expr>(loc, type);
+
+  case table_term: return read_table(loc, type);
+
+  case prog_term: {
+    Term_seq* ts = get_seq<Term>();
+    if (not ok)
+      return nullptr;
+    return new Prog(type, ts);
+  }
+
+  case fn_term: {
+    Term* t = get_ref<Term>();
+    Term_seq* ps = get_seq<Term>();
+    bool memo = get();
+    if (not ok)
+      return nullptr;
+    Fn* fn = new Fn(loc, type, ps, t);
+    fn->t3 = memo;
+    return fn;
+  }
+
+  case call_term: {
+    Term* f = get_ref<Term>();
+    Term_seq* args = get_seq<Term>();
+    if (not ok)
+      return nullptr;
+    return new Call(loc, type, f, args);
+  }
+
+  case kind_type: return get_kind_type();
+  case unit_type: return get_unit_type();
+  case bool_type: return get_bool_type();
+  case nat_type: return get_nat_type();
+  case str_type: return get_str_type();
+
+  case arrow_type: {
+    Type* t1 = get_node<Type>();
+    Type* t2 = get_node<Type>();
+    return ok ? get_arrow_type(t1, t2) : nullptr;
+  }
+
+  case fn_type: {
+    Type* t = get_node<Type>();
+    Type_seq* ts = get_seq<Type>();
+    return ok ? get_fn_type(ts, t) : nullptr;
+  }
+
+  case tuple_type: {
+    Type_seq* ts = get_seq<Type>();
+    return ok ? get_tuple_type(ts) : nullptr;
+  }
+
+  case list_type: {
+    Type* t = get_node<Type>();
+    return ok ? get_list_type(t) : nullptr;
+  }
+
+  case record_type: return read_record_type();
+
+  case wild_type: {
+    Name* n = get_ref<Name>();
+    Type* t = get_ref<Type>();
+    return ok ? new Wild_type(loc, get_kind_type(), n, t) : nullptr;
+  }
+
+  default:
+    break;
+  }
+  ok = false;
+  return nullptr;
+}
+
+} // namespace
+
+
+// -------------------------------------------------------------------------- //
+// Files
+
+// Returns the key of the source text in [first, last). This is the
+// 64-bit FNV-1a hash of the text.
+std::uint64_t
+hash_source(const char* first, const char* last) {
+  std::uint64_t h = 14695981039346656037ull;
+  for (; first != last; ++first) {
+    h ^= (unsigned char)*first;
+    h *= 1099511628211ull;
+  }
+  return h;
+}
+
+// Returns the path of the cached program having the given key in the
+// directory dir.
+std::string
+cache_path(const std::string& dir, std::uint64_t key) {
+  char name[32];
+  std::snprintf(name, sizeof(name), "%016llx.wpc", (unsigned long long)key);
+  return dir + '/' + name;
+}
+
+// Save the program e to the file at path, under the given key. The
+// file is written under a temporary name and then renamed, so that a
+// concurrent load never sees a partial file. Returns false if the
+// program cannot be saved.
+bool
+save_program(const std::string& path, std::uint64_t key, Location src, Expr* e) {
+  Writer w(src);
+  std::size_t root;
+  try {
+    // Find the record types, and then write the program.
+    w.dry = true;
+    w.ref(e);
+    w.reset();
+    root = w.ref(e);
+  } catch (Assertion_error&) {
+    return false;
+  }
+
+  // The body is the number of nodes, the records, and the root.
+  std::string records;
+  std::swap(records, w.out);
+  w.put(w.count);
+  w.out += records;
+  w.put(root);
+  const std::string& body = w.out;
+
+  std::string file(magic, sizeof(magic));
+  put_fixed(file, cache_version, 4);
+  put_fixed(file, key, 8);
+  put_fixed(file, hash_source(body.data(), body.data() + body.size()), 8);
+  file += body;
+
+  std::string tmp = path + '.' + std::to_string(::getpid());
+  {
+    std::ofstream os(tmp, std::ios::binary);
+    if (not os.write(file.data(), file.size()))
+      return false;
+  }
+  if (std::rename(tmp.c_str(), path.c_str()) != 0) {
+    std::remove(tmp.c_str());
+    return false;
+  }
+  return true;
+}
+
+// Load the program saved in the file at path under the given key. The
+// nodes of the program are allocated in the current arena. Returns
+// nullptr if there is no such file, if it was written for another key
+// or by another version, or if a table that it loads no longer has the
+// schema that it had when the program was saved.
+Expr*
+load_program(const std::string& path, std::uint64_t key, Location src) {
+  std::ifstream is(path, std::ios::binary);
+  if (not is)
+    return nullptr;
+  std::stringstream ss;
+  ss << is.rdbuf();
+  std::string buf = ss.str();
+  if (buf.size() < header_size
+      or std::memcmp(buf.data(), magic, sizeof(magic)) != 0
+      or get_fixed(buf.data() + sizeof(magic), 4) != cache_version
+      or get_fixed(buf.data() + sizeof(magic) + 4, 8) != key)
+    return nullptr;
+  const char* first = buf.data() + header_size;
+  const char* last = buf.data() + buf.size();
+  if (get_fixed(buf.data() + sizeof(magic) + 12, 8) != hash_source(first, last))
+    return nullptr;
+
+  Reader r(first, last, src);
+  std::uint64_t n = r.get();
+  if (not r.ok or n > buf.size())
+    return nullptr;
+  r.nodes.reserve(n);
+  try {
+    while (r.ok and r.nodes.size() < n) {
+      std::size_t k = r.nodes.size();
+      Expr* e = r.read();
+      if (not e)
+        r.ok = false;
+      else if (r.nodes.size() == k)
+        r.nodes.push_back(e);
+    }
+  } catch (Assertion_error&) {
+    // The file is malformed (e.g., an invalid integer).
+    return nullptr;
+  }
+  Expr* e = r.get_ref<Expr>(false);
+  if (not r.ok or r.ptr != r.end or r.nodes.size() != n)
+    return nullptr;
+  return e;
+}
+
+
+// -------------------------------------------------------------------------- //
+// Results
+
+namespace {
+
+// Returns the path of the result having the given key in the directory
+// dir.
+std::string
+result_path(const std::string& dir, std::uint64_t key) {
+  char name[32];
+  std::snprintf(name, sizeof(name), "%016llx.wtr", (unsigned long long)key);
+  return dir + '/' + name;
+}
+
+// Computes the key of the result of the term t, which is the hash of
+// the records of its expression graph (written without locations, so
+// that moving a definition does not change its key), the versions of
+// the file formats, and the contents of each file read by t. The graph
+// of t includes the definitions that t refers to. Returns false if t
+// or one of those definitions prints or saves, or if a file cannot be
+// read.
+bool
+get_result_key(Term* t, std::uint64_t& key) {
+  Writer w(no_location);
+  w.locs = false;
+  try {
+    w.ref(t);
+  } catch (Assertion_error&) {
+    return false;
+  }
+  if (w.effects)
+    return false;
+  std::string body;
+  std::swap(body, w.out);
+  put_fixed(body, cache_version, 4);
+  put_fixed(body, table_file_version, 4);
+  for (Term* p : w.files) {
+    Mapped_file f;
+    if (not is<Str>(p) or not f.open(get_file_path(p).c_str()))
+      return false;
+    put_fixed(body, hash_source(f.first, f.last), 8);
+  }
+  key = hash_source(body.data(), body.data() + body.size());
+  return true;
+}
+
+} // namespace
+
+// Replace the value of each definition of the program p whose result
+// was saved by an earlier run with the saved table. The tables are
+// allocated in the current arena. The results of the other definitions
+// are saved once the program has been evaluated (see save). The keys
+// are computed before any value is replaced, since the key of a
+// definition includes the definitions that it refers to.
+void
+Result_cache::load(Prog* p) {
+  std::vector<std::pair<Def*, std::uint64_t>> defs;
+  for (Term* s : *p->stmts()) {
+    Def* d = as<Def>(s);
+    Term* t = d ? as<Term>(d->value()) : nullptr;
+    if (not t or not (is<Csv>(t) or is_plan_term(t)))
+      continue;
+    std::uint64_t key;
+    if (get_result_key(t, key))
+      defs.emplace_back(d, key);
+  }
+
+  for (auto& x : defs) {
+    std::string path = result_path(dir, x.second);
+    Table* t = nullptr;
+    if (Type* type = load_table_type(path))
+      t = load_table(path, type);
+    if (t)
+      x.first->t2 = t;
+    else
+      misses.push_back(x);
+  }
+}
+
+// Save the result of each definition that was not found by load, if it
+// was evaluated to a table that can be saved (see table_file.hpp). As
+// with programs, each file is written under a temporary name and then
+// renamed.
+void
+Result_cache::save() {
+  for (auto& x : misses) {
+    Table* t = as<Table>(x.first->value());
+    if (not t)
+      continue;
+    std::string path = result_path(dir, x.second);
+    std::string tmp = path + '.' + std::to_string(::getpid());
+    if (not save_table(tmp, t) or std::rename(tmp.c_str(), path.c_str()) != 0)
+      std::remove(tmp.c_str());
+  }
+  misses.clear();
+}
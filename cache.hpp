@@ -0,0 +1,67 @@
+
+#ifndef CACHE_HPP
+#define CACHE_HPP
+
+#include "ast.hpp"
+
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+// -------------------------------------------------------------------------- //
+// Program cache
+//
+// This module saves elaborated programs to a compact binary file, and
+// loads them again, so that a program whose source has not changed
+// need not be lexed, parsed, or elaborated.
+//
+// A cached program is identified by a key computed from its source
+// text (see hash_source), and by the schemas of the table files that
+// it loads, which determine the types of its loads. The schemas are
+// read again when the program is loaded, and a program whose loads no
+// longer match is elaborated again. The file records the expression graph of
+// the program, including the types of each term and the declarations
+// referred to by each Ref. Nodes are written after the nodes that they
+// refer to, and are identified by their position in the file. Types
+// are interned again when they are loaded, so a loaded program shares
+// its types with the rest of the process; the members of a record type
+// are identified with those of the interned type. Locations are saved
+// relative to the start of the source, and are given the location of
+// the source when they are loaded.
+//
+// The format of the file is specific to this version of the language,
+// and a file that was written by another version, or whose key does
+// not match, is ignored.
+//
+// The results of expensive definitions (those of CSV sources and
+// queries) are kept in the same directory as table files, so that a
+// program run again over the same inputs need not recompute them. A
+// result is identified by a key computed from the elaborated value of
+// its definition, including the definitions it refers to, and from the
+// contents of the files it reads. The results of definitions that
+// print or save are not kept.
+
+// The version of the file format. This must be changed whenever the
+// representation of elaborated programs changes.
+constexpr std::uint32_t cache_version = 7;
+
+std::uint64_t hash_source(const char*, const char*);
+std::string cache_path(const std::string&, std::uint64_t);
+
+bool save_program(const std::string&, std::uint64_t, Location, Expr*);
+Expr* load_program(const std::string&, std::uint64_t, Location);
+
+// The cached results of the definitions of a program.
+struct Result_cache {
+  explicit Result_cache(const std::string& d)
+    : dir(d) { }
+
+  void load(Prog*);
+  void save();
+
+  std::string dir;
+  std::vector<std::pair<Def*, std::uint64_t>> misses;
+};
+
+#endif
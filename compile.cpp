@@ -0,0 +1,523 @@
+
+#include "vm.hpp"
+#include "type.hpp"
+#include "value.hpp"
+#include "memo.hpp"
+#include "sched.hpp"
+
+#include "lang/debug.hpp"
+
+#include <iostream>
+
+// -------------------------------------------------------------------------- //
+// Compilation
+//
+// The compilation of a term emits instructions that leave the value
+// of that term on the top of the stack.
+
+namespace {
+
+// A compilation context records the code being compiled, and the
+// context of the enclosing function, if any.
+struct Context {
+  Context(Compiler& c, Code* k, Context* p)
+    : comp(c), code(k), parent(p) { }
+
+  Compiler& comp;
+  Code*     code;
+  Context*  parent;
+};
+
+void compile(Context&, Term*);
+
+// Append an instruction to the code, returning its position.
+inline std::size_t
+emit(Context& cxt, Opcode op, int a = 0, int b = 0) {
+  Instr_seq& instrs = cxt.code->instrs;
+  instrs.push_back({op, std::uint16_t(b), std::int32_t(a)});
+  return instrs.size() - 1;
+}
+
+// Add a term to the constant pool, returning its index.
+inline int
+add_const(Context& cxt, Term* t) {
+  Term_seq& consts = cxt.code->consts;
+  consts.push_back(t);
+  return consts.size() - 1;
+}
+
+// Add the term t of a call to the constant pool, returning its index
+// plus one, or 0 if the index does not fit in the b operand. The term
+// names the frame of the call in profiles.
+inline int
+add_site(Context& cxt, Term* t) {
+  int n = add_const(cxt, t) + 1;
+  return n <= 0xffff ? n : 0;
+}
+
+// Set the target of the jump at position i to the next instruction.
+inline void
+patch(Context& cxt, std::size_t i) {
+  Instr_seq& instrs = cxt.code->instrs;
+  instrs[i].a = instrs.size();
+}
+
+// Emit an instruction that evaluates t in the current environment.
+// The parameters of the current function must be bound in that
+// environment.
+inline void
+compile_eval(Context& cxt, Term* t) {
+  cxt.code->env = true;
+  emit(cxt, op_eval, add_const(cxt, t));
+}
+
+// A value is its own constant.
+inline void
+compile_value(Context& cxt, Term* t) {
+  emit(cxt, op_const, add_const(cxt, t));
+}
+
+// Compile an if term.
+//
+//          cond
+//          branch L1
+//          if_true
+//          jump L2
+//    L1:   if_false
+//    L2:
+void
+compile_if(Context& cxt, If* t) {
+  compile(cxt, t->cond());
+  std::size_t l1 = emit(cxt, op_branch);
+  compile(cxt, t->if_true());
+  std::size_t l2 = emit(cxt, op_jump);
+  patch(cxt, l1);
+  compile(cxt, t->if_false());
+  patch(cxt, l2);
+}
+
+// Compile a unary operation. The term is added to the constant pool
+// when the instruction needs its type or location.
+template<typename T>
+  void
+  compile_unary(Context& cxt, T* t, Opcode op, bool term = false) {
+    compile(cxt, t->t1);
+    emit(cxt, op, term ? add_const(cxt, t) : 0);
+  }
+
+// Compile a binary operation. Both operands are always evaluated.
+template<typename T>
+  void
+  compile_binary(Context& cxt, T* t, Opcode op) {
+    compile(cxt, t->t1);
+    compile(cxt, t->t2);
+    emit(cxt, op);
+  }
+
+// Compile 't1 and t2', which evaluates t2 only when t1 is true.
+//
+//          t1
+//          branch L1
+//          t2
+//          jump L2
+//    L1:   const false
+//    L2:
+void
+compile_and(Context& cxt, And* t) {
+  compile(cxt, t->t1);
+  std::size_t l1 = emit(cxt, op_branch);
+  compile(cxt, t->t2);
+  std::size_t l2 = emit(cxt, op_jump);
+  patch(cxt, l1);
+  compile_value(cxt, get_false());
+  patch(cxt, l2);
+}
+
+// Compile 't1 or t2', which evaluates t2 only when t1 is false.
+//
+//          t1
+//          branch L1
+//          const true
+//          jump L2
+//    L1:   t2
+//    L2:
+void
+compile_or(Context& cxt, Or* t) {
+  compile(cxt, t->t1);
+  std::size_t l1 = emit(cxt, op_branch);
+  compile_value(cxt, get_true());
+  std::size_t l2 = emit(cxt, op_jump);
+  patch(cxt, l1);
+  compile(cxt, t->t2);
+  patch(cxt, l2);
+}
+
+// Compile the term t in tail position, where its value is returned
+// from the current function. When t is a call, the called function
+// returns in place of the current one. The branches of an if term are
+// also in tail position.
+//
+//          cond
+//          branch L1
+//          if_true
+//    L1:   if_false
+void
+compile_tail(Context& cxt, Term* t) {
+  if (If* t1 = as<If>(t)) {
+    compile(cxt, t1->cond());
+    std::size_t l1 = emit(cxt, op_branch);
+    compile_tail(cxt, t1->if_true());
+    patch(cxt, l1);
+    compile_tail(cxt, t1->if_false());
+  } else if (App* t1 = as<App>(t)) {
+    compile(cxt, t1->abs());
+    compile(cxt, t1->arg());
+    emit(cxt, op_tail, 1, add_site(cxt, t1));
+  } else if (Call* t1 = as<Call>(t)) {
+    compile(cxt, t1->fn());
+    for (Term* a : *t1->args())
+      compile(cxt, a);
+    emit(cxt, op_tail, t1->args()->size(), add_site(cxt, t1));
+  } else {
+    compile(cxt, t);
+    emit(cxt, op_return);
+  }
+}
+
+// Returns the parameters of the abstraction or function f.
+void
+get_vars(Term* f, std::vector<Expr*>& vars) {
+  if (Abs* abs = as<Abs>(f)) {
+    vars.push_back(abs->var());
+  } else if (Fn* fn = as<Fn>(f)) {
+    for (Term* p : *fn->parms())
+      vars.push_back(p);
+  } else {
+    lang_unreachable(format("'{}' is not a function", pretty(f)));
+  }
+}
+
+// Returns the body of the abstraction or function f.
+inline Term*
+get_body(Term* f) {
+  if (Abs* abs = as<Abs>(f))
+    return abs->term();
+  else
+    return as<Fn>(f)->term();
+}
+
+// Compile the abstraction or function f in the given context, and
+// register its code with the compiler. The context is null when the
+// lexical context of f is unknown. The value of a memoized call is
+// remembered when it returns, so the body of a memoized function is
+// not compiled with tail calls.
+Code*
+compile_fn(Compiler& comp, Term* f, Context* parent) {
+  Code* code = new Code(f);
+  comp.codes.emplace(f, code);
+  get_vars(f, code->vars);
+  Context cxt(comp, code, parent);
+  if (is_memo_fn(f)) {
+    compile(cxt, get_body(f));
+    emit(cxt, op_return);
+  } else {
+    compile_tail(cxt, get_body(f));
+  }
+  return code;
+}
+
+// Compile an abstraction or function, which evaluates to a closure
+// over the current environment. The function is compiled once, when
+// it is first encountered. This requires an environment for the
+// parameters of the current function.
+void
+compile_abs(Context& cxt, Term* t) {
+  Code* code;
+  auto iter = cxt.comp.codes.find(t);
+  if (iter == cxt.comp.codes.end())
+    code = compile_fn(cxt.comp, t, &cxt);
+  else
+    code = iter->second;
+  cxt.code->env = true;
+  cxt.code->fns.push_back(code);
+  emit(cxt, op_closure, cxt.code->fns.size() - 1);
+}
+
+// Compile an application.
+//
+//    abs
+//    arg
+//    call 1
+void
+compile_app(Context& cxt, App* t) {
+  compile(cxt, t->abs());
+  compile(cxt, t->arg());
+  emit(cxt, op_call, 1, add_site(cxt, t));
+}
+
+// Compile a function call.
+//
+//    fn
+//    arg1 ... argn
+//    call n
+void
+compile_call(Context& cxt, Call* t) {
+  compile(cxt, t->fn());
+  for (Term* a : *t->args())
+    compile(cxt, a);
+  emit(cxt, op_call, t->args()->size(), add_site(cxt, t));
+}
+
+// Returns the position of x in the parameters of the code.
+inline int
+find_var(Code* code, Expr* x) {
+  std::vector<Expr*>& vars = code->vars;
+  for (std::size_t i = 0; i < vars.size(); ++i)
+    if (vars[i] == x)
+      return i;
+  return -1;
+}
+
+// Compile a reference. A reference to a parameter of the current
+// function is a stack slot. A reference to the parameter of an
+// enclosing function is resolved to its position in the environment
+// of that function. References to definitions yield the defined value.
+// Other references are evaluated in the current environment.
+void
+compile_ref(Context& cxt, Ref* t) {
+  Expr* d = t->decl();
+  if (is<Def>(d)) {
+    emit(cxt, op_global, add_const(cxt, t));
+    return;
+  }
+
+  int depth = 0;
+  for (Context* c = &cxt; c and c->code->fn; c = c->parent, ++depth) {
+    int i = find_var(c->code, d);
+    if (i >= 0) {
+      if (depth == 0)
+        emit(cxt, op_local, i);
+      else
+        emit(cxt, op_free, i, depth);
+      return;
+    }
+  }
+  compile_eval(cxt, t);
+}
+
+// Compile a definition. When the defined value is not a term, there
+// is nothing to evaluate. In lazy mode, a pure defined value is
+// compiled into code of its own, which is run when the definition is
+// first referenced.
+void
+compile_def(Context& cxt, Def* t) {
+  if (Term* t0 = as<Term>(t->value())) {
+    if (cxt.comp.lazy and is_pure_def(t)) {
+      Code* code = new Code(nullptr, t);
+      cxt.comp.progs.push_back(code);
+      Context thunk(cxt.comp, code, nullptr);
+      compile(thunk, t0);
+      emit(thunk, op_return);
+      cxt.code->fns.push_back(code);
+      emit(cxt, op_delay, cxt.code->fns.size() - 1);
+      return;
+    }
+    compile(cxt, t0);
+    emit(cxt, op_define, add_const(cxt, t));
+  } else {
+    compile_value(cxt, t);
+  }
+}
+
+// Compile a print statement. When the printed expression is not a
+// term, the expression itself is printed.
+void
+compile_print(Context& cxt, Print* t) {
+  if (Term* t0 = as<Term>(t->expr())) {
+    compile(cxt, t0);
+    emit(cxt, op_print, add_const(cxt, t), 1);
+  } else {
+    emit(cxt, op_print, add_const(cxt, t), 0);
+  }
+}
+
+void
+compile(Context& cxt, Term* t) {
+  switch (t->kind) {
+  case unit_term:
+  case true_term:
+  case false_term:
+  case int_term:
+  case str_term:
+  case closure_term:
+  case table_term:
+    return compile_value(cxt, t);
+  case if_term: return compile_if(cxt, as<If>(t));
+  case and_term: return compile_and(cxt, as<And>(t));
+  case or_term: return compile_or(cxt, as<Or>(t));
+  case not_term: return compile_unary(cxt, as<Not>(t), op_not);
+  case equals_term: return compile_binary(cxt, as<Equals>(t), op_equals);
+  case less_term: return compile_binary(cxt, as<Less>(t), op_less);
+  case succ_term: return compile_unary(cxt, as<Succ>(t), op_succ, true);
+  case pred_term: return compile_unary(cxt, as<Pred>(t), op_pred, true);
+  case iszero_term: return compile_unary(cxt, as<Iszero>(t), op_iszero);
+  case abs_term: return compile_abs(cxt, t);
+  case fn_term: return compile_abs(cxt, t);
+  case app_term: return compile_app(cxt, as<App>(t));
+  case call_term: return compile_call(cxt, as<Call>(t));
+  case ref_term: return compile_ref(cxt, as<Ref>(t));
+  case def_term: return compile_def(cxt, as<Def>(t));
+  case print_term: return compile_print(cxt, as<Print>(t));
+  default: break;
+  }
+  compile_eval(cxt, t);
+}
+
+} // namespace
+
+
+// -------------------------------------------------------------------------- //
+// Compiler class
+
+Compiler::~Compiler() {
+  for (auto& x : codes)
+    delete x.second;
+  for (Code* c : progs)
+    delete c;
+}
+
+// Compile the program (or term) t. Each statement of a program is
+// compiled separately.
+Code*
+Compiler::operator()(Term* t) {
+  std::lock_guard<std::mutex> lock(mutex);
+  Code* code = new Code(nullptr, t);
+  progs.push_back(code);
+  if (Prog* p = as<Prog>(t)) {
+    for (Term* s : *p->stmts()) {
+      Code* stmt = new Code(nullptr, s);
+      progs.push_back(stmt);
+      Context cxt(*this, stmt, nullptr);
+      compile(cxt, s);
+      emit(cxt, op_return);
+      code->stmts.push_back(stmt);
+    }
+  } else {
+    Context cxt(*this, code, nullptr);
+    compile(cxt, t);
+    emit(cxt, op_return);
+  }
+  return code;
+}
+
+// Returns the code of the abstraction or function f, compiling it if
+// needed. Because the lexical context of f is not known, references
+// to the parameters of enclosing functions are looked up in the
+// environment when the code is run.
+Code*
+Compiler::get_code(Term* f) {
+  std::lock_guard<std::mutex> lock(mutex);
+  auto iter = codes.find(f);
+  if (iter != codes.end())
+    return iter->second;
+  return compile_fn(*this, f, nullptr);
+}
+
+
+// -------------------------------------------------------------------------- //
+// Disassembly
+
+namespace {
+
+const char* opcode_names[] = {
+  "const",
+  "local",
+  "free",
+  "global",
+  "eval",
+  "pop",
+  "jump",
+  "branch",
+  "not",
+  "equals",
+  "less",
+  "succ",
+  "pred",
+  "iszero",
+  "closure",
+  "call",
+  "tail",
+  "return",
+  "define",
+  "delay",
+  "print",
+};
+
+void
+dump_code(std::ostream& os, const Code* code) {
+  if (code->fn)
+    os << "code " << pretty(code->fn) << '\n';
+  else
+    os << "code " << pretty(code->term) << '\n';
+  for (std::size_t i = 0; i < code->instrs.size(); ++i) {
+    const Instr& ins = code->instrs[i];
+    os << "  " << i << ": " << opcode_names[ins.op];
+    switch (ins.op) {
+    case op_closure:
+      os << ' ' << pretty(code->fns[ins.a]->fn);
+      break;
+    case op_delay:
+      os << ' ' << pretty(as<Def>(code->fns[ins.a]->term)->name());
+      break;
+    case op_const:
+    case op_global:
+    case op_eval:
+    case op_define:
+    case op_print:
+      os << ' ' << pretty(code->consts[ins.a]);
+      break;
+    case op_free:
+      os << ' ' << ins.b << ' ' << ins.a;
+      break;
+    case op_local:
+    case op_jump:
+    case op_branch:
+    case op_call:
+    case op_tail:
+      os << ' ' << ins.a;
+      break;
+    default:
+      break;
+    }
+    os << '\n';
+  }
+}
+
+// Dump the code of each function created by the given code.
+void
+dump_fns(std::ostream& os, const Code* code) {
+  for (const Code* c : code->fns) {
+    dump_code(os, c);
+    dump_fns(os, c);
+  }
+}
+
+} // namespace
+
+// Returns the name of the opcode op.
+const char*
+get_opcode_name(Opcode op) { return opcode_names[op]; }
+
+// Print the instructions of the code, followed by those of the
+// functions it creates. The code of a program is printed for each
+// statement.
+void
+dump(std::ostream& os, const Code* code) {
+  if (not code->stmts.empty()) {
+    for (const Code* s : code->stmts)
+      dump(os, s);
+    return;
+  }
+  dump_code(os, code);
+  dump_fns(os, code);
+}
@@ -0,0 +1,237 @@
+#include "csv.hpp"
+#include "table.hpp"
+#include "type.hpp"
+#include "value.hpp"
+
+#include "lang/debug.hpp"
+
+namespace {
+
+// Returns the string literal whose value is the text s. Quotes and
+// backslashes within the text are escaped.
+String
+make_literal(const std::string& s) {
+  std::string lit;
+  lit.reserve(s.size() + 2);
+  lit += '"';
+  for (char c : s) {
+    if (c == '"' or c == '\\')
+      lit += '\\';
+    lit += c;
+  }
+  lit += '"';
+  return lit;
+}
+
+} // namespace
+
+Csv_reader::Csv_reader(const std::string& p, Type* t)
+  : path(p), type(t), pos_(nullptr), line_(1), start_(1) { }
+
+// Map the file, and find the columns of the table among the fields
+// named by its first record. Returns false if the file cannot be read.
+bool
+Csv_reader::open() {
+  if (not file_.open(path.c_str()))
+    return false;
+  pos_ = file_.first;
+
+  Record_type* rt = get_row_type(type);
+  lang_assert(rt, format("'{}' is not a table type", pretty(type)));
+  Term_seq* vars = rt->members();
+  types_.clear();
+  for (Term* v : *vars)
+    types_.push_back(as<Var>(v)->type());
+
+  // Map each field to the column of the same name.
+  if (not read_record())
+    lang_unreachable(format("{}: missing header", path));
+  std::vector<char> found(vars->size());
+  fields_.assign(record_.size(), no_column);
+  for (std::size_t i = 0; i < record_.size(); ++i) {
+    for (std::size_t j = 0; j < vars->size(); ++j) {
+      String name = as<Id>(as<Var>((*vars)[j])->name())->t1;
+      if (not found[j] and name.str() == record_[i]) {
+        fields_[i] = j;
+        found[j] = true;
+        break;
+      }
+    }
+  }
+  for (std::size_t j = 0; j < vars->size(); ++j) {
+    if (not found[j])
+      lang_unreachable(format("{}: no field named '{}'", path,
+                              pretty(as<Var>((*vars)[j])->name())));
+  }
+  return true;
+}
+
+// Read the next chunk of at most n rows, returning a table of those
+// rows. Returns nullptr when there are no more rows.
+Table*
+Csv_reader::next(std::size_t n) {
+  Column_seq* cols = new Column_seq();
+  cols->reserve(types_.size());
+  for (std::size_t j = 0; j < types_.size(); ++j) {
+    cols->push_back(new Term_seq());
+    cols->back()->reserve(n);
+  }
+
+  // Strings are shared within a chunk, since the nodes of a chunk
+  // may be released before the next chunk is read.
+  strs_.assign(types_.size(), {});
+  std::size_t rows = 0;
+  while (rows < n and read_record()) {
+    if (record_.size() != fields_.size())
+      lang_unreachable(format("{}:{}: expected {} fields but found {}",
+                              path, start_, fields_.size(), record_.size()));
+    for (std::size_t i = 0; i < record_.size(); ++i) {
+      std::size_t j = fields_[i];
+      if (j != no_column)
+        (*cols)[j]->push_back(read_cell(j, record_[i]));
+    }
+    ++rows;
+  }
+  if (rows == 0) {
+    delete cols;
+    return nullptr;
+  }
+  return make_table(type, cols, rows);
+}
+
+// Read the fields of the next record. Blank lines are skipped. Returns
+// false at the end of the file.
+bool
+Csv_reader::read_record() {
+  const char* last = file_.last;
+  while (pos_ != last and (*pos_ == '\n' or *pos_ == '\r')) {
+    if (*pos_ == '\n')
+      ++line_;
+    ++pos_;
+  }
+  if (pos_ == last)
+    return false;
+
+  start_ = line_;
+  std::size_t n = 0;
+  while (true) {
+    if (record_.size() == n)
+      record_.emplace_back();
+    record_[n].clear();
+    bool more = read_field(record_[n]);
+    ++n;
+    if (not more)
+      break;
+  }
+  record_.resize(n);
+  return true;
+}
+
+// Read the next field into s. Returns true if another field of the
+// same record follows.
+bool
+Csv_reader::read_field(std::string& s) {
+  const char* last = file_.last;
+  if (pos_ != last and *pos_ == '"') {
+    std::size_t start = line_;
+    ++pos_;
+    while (true) {
+      if (pos_ == last)
+        lang_unreachable(format("{}:{}: unterminated quoted field", path, start));
+      if (*pos_ == '"') {
+        ++pos_;
+        if (pos_ == last or *pos_ != '"')
+          break;
+      }
+      if (*pos_ == '\n')
+        ++line_;
+      s += *pos_++;
+    }
+  } else {
+    const char* first = pos_;
+    while (pos_ != last and *pos_ != ',' and *pos_ != '\n' and *pos_ != '\r')
+      ++pos_;
+    s.assign(first, pos_);
+  }
+
+  if (pos_ == last)
+    return false;
+  if (*pos_ == ',') {
+    ++pos_;
+    return true;
+  }
+  if (*pos_ == '\r')
+    ++pos_;
+  if (pos_ != last and *pos_ != '\n')
+    lang_unreachable(format("{}:{}: expected ',' or end of line after field",
+                            path, line_));
+  if (pos_ != last) {
+    ++pos_;
+    ++line_;
+  }
+  return false;
+}
+
+// Returns the value of the field s in the column j.
+Term*
+Csv_reader::read_cell(std::size_t j, const std::string& s) {
+  Type* t = types_[j];
+  if (is_nat_type(t)) {
+    bool ok = not s.empty();
+    for (char c : s)
+      ok = ok and '0' <= c and c <= '9';
+    if (not ok)
+      lang_unreachable(format("{}:{}: '{}' is not a number", path, start_, s));
+
+    // Fields of fewer than 19 digits fit in a machine word.
+    if (s.size() < 19) {
+      long n = 0;
+      for (char c : s)
+        n = n * 10 + (c - '0');
+      return new Int(t, Integer(n));
+    }
+    return new Int(t, Integer(String(s)));
+  }
+  if (is_bool_type(t)) {
+    if (s == "true")
+      return get_true();
+    if (s == "false")
+      return get_false();
+    lang_unreachable(format("{}:{}: '{}' is not a boolean", path, start_, s));
+  }
+  if (is_str_type(t)) {
+    String lit = make_literal(s);
+    Term*& str = strs_[j][lit];
+    if (not str)
+      str = new Str(t, lit);
+    return str;
+  }
+  lang_unreachable(format("cannot read a value of type '{}'", pretty(t)));
+}
+
+// Load the table of type t from the CSV file at path. The rows are
+// read a chunk at a time, and appended to the columns of the table.
+Table*
+load_csv(const std::string& path, Type* t) {
+  Csv_reader r(path, t);
+  if (not r.open())
+    lang_unreachable(format("cannot read '{}'", path));
+  Column_seq* cols = nullptr;
+  std::size_t rows = 0;
+  while (Table* chunk = r.next()) {
+    if (not cols) {
+      cols = new Column_seq(*chunk->columns());
+    } else {
+      for (std::size_t j = 0; j < cols->size(); ++j) {
+        Term_seq* col = (*chunk->columns())[j];
+        (*cols)[j]->insert((*cols)[j]->end(), col->begin(), col->end());
+      }
+    }
+    rows += chunk->rows();
+  }
+
+  // A file with no rows is an empty table.
+  if (not cols)
+    return make_table(t);
+  return make_table(t, cols, rows);
+}
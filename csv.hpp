@@ -0,0 +1,64 @@
+
+#ifndef CSV_HPP
+#define CSV_HPP
+
+#include "ast.hpp"
+
+#include "lang/mapped_file.hpp"
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// -------------------------------------------------------------------------- //
+// CSV sources
+//
+// This module reads tables from CSV files. The first record of a file
+// names its fields, and each following record is a row. The columns of
+// the table are found by name among the fields, so a file may have
+// fields that are not read, in any order. Fields may be quoted, in
+// which case they may contain commas, line breaks, and quotes written
+// as '""'.
+//
+// The type of the table is declared by the 'csv' term, and each column
+// may have type Bool, Nat, or Str. A boolean field is 'true' or 'false',
+// and a numeric field is a sequence of decimal digits.
+//
+// A file is read in chunks of rows, each of which is a table of its
+// own. A query that filters the rows of a file (see plan.hpp) keeps
+// only the selected rows of each chunk, so the rows of a large file are
+// never all in memory at once.
+
+// The default number of rows in a chunk.
+constexpr std::size_t csv_chunk_rows = 64 * 1024;
+
+// The reader produces the rows of a CSV file of a given table type, a
+// chunk at a time. The file is mapped into memory when it is opened,
+// and read from front to back.
+struct Csv_reader {
+  Csv_reader(const std::string&, Type*);
+
+  bool open();
+  Table* next(std::size_t = csv_chunk_rows);
+
+  std::string path;
+  Type* type;
+
+private:
+  bool read_record();
+  bool read_field(std::string&);
+  Term* read_cell(std::size_t, const std::string&);
+
+  Mapped_file file_;
+  const char* pos_;            // The next character
+  std::size_t line_;           // The line of the next character
+  std::size_t start_;          // The line of the current record
+  std::vector<Type*> types_;   // The type of each column
+  std::vector<std::size_t> fields_; // The column of each field
+  std::vector<std::string> record_; // The fields of the current record
+  std::vector<std::unordered_map<String, Term*>> strs_; // Each chunk's strings
+};
+
+Table* load_csv(const std::string&, Type*);
+
+#endif
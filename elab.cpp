@@ -6,15 +6,22 @@
 #include "scope.hpp"
 #include "type.hpp"
 #include "language.hpp"
+#include "memo.hpp"
+#include "sched.hpp"
+#include "table.hpp"
+#include "table_file.hpp"
 
 #include "lang/debug.hpp"
+#include "lang/prefetch.hpp"
 
+#include <algorithm>
 #include <iostream>
 
 namespace {
 
 // Declarations
 Expr* elab_expr(Tree*);
+Expr* elab_group(Select_tree*);
 
 
 // -------------------------------------------------------------------------- //
@@ -89,6 +96,24 @@ elab_term(Tree* t) {
 // -------------------------------------------------------------------------- //
 // Elaboration rules
 
+// Returns true if an abstraction encloses the current scope.
+bool
+in_abstraction() {
+  for (Scope* s = current_scope(); s; s = s->parent) {
+    if (s->kind == lambda_scope)
+      return true;
+  }
+  return false;
+}
+
+// Returns true if decl is a definition whose value is not pure (see
+// is_pure_def), such as a function that prints.
+inline bool
+is_impure_def(Expr* decl) {
+  Def* def = as<Def>(decl);
+  return def and not is_pure_def(def);
+}
+
 // Elaborate an id by looking it up in the current cntext.
 //
 //    n : T in G
@@ -96,12 +121,23 @@ elab_term(Tree* t) {
 //    G |- n : T
 //
 // The result of an elaborated id is a reference to its declaring
-// expression.
+// expression. A reference to a parameter is resolved to its slot.
 Expr*
 elab_id(Id_tree* t) { 
   Name* name = elab_name(t);
-  if (Expr* decl = lookup(name))
-    return new Ref(t->loc, decl);
+  int depth, index;
+  if (Expr* decl = lookup(name, depth, index)) {
+    // A reference to the parameter of an enclosing abstraction, or to
+    // a member (whose value is given by each row), is impure, as is a
+    // reference to an impure definition.
+    if (depth > 0)
+      mark_impure(depth);
+    else if (depth < 0 and is<Var>(decl))
+      mark_impure();
+    else if (in_abstraction() and is_impure_def(decl))
+      mark_impure();
+    return new Ref(t->loc, decl, depth, index);
+  }
   else
     error(t->loc) << format("no matching declaration for '{}'", pretty(name));
   return nullptr; 
@@ -140,11 +176,13 @@ elab_lit(Lit_tree* t) {
   case string_literal_tok:
     return new Str(t->loc, get_str_type(), as_string(*k));
   case unit_type_tok: 
-    return new Unit_type(t->loc, get_kind_type());
+    return get_unit_type();
   case bool_type_tok: 
-    return new Bool_type(t->loc, get_kind_type());
+    return get_bool_type();
   case nat_type_tok: 
-    return new Nat_type(t->loc, get_kind_type());
+    return get_nat_type();
+  case str_type_tok: 
+    return get_str_type();
   default: 
     break;
   }
@@ -231,13 +269,15 @@ elab_abs(Abs_tree* t) {
     return nullptr;
 
   // Create the result type.
-  Type* kind = get_kind_type();
   Type* t0 = get_type(var);
   Type* u0 = get_type(term);
-  Type* type = new Arrow_type(no_location, kind, t0, u0);
+  Type* type = get_arrow_type(t0, u0);
 
-  // Create the abstraction.
-  return new Abs(t->loc, type, var, term);
+  // Create the abstraction. Calls to a pure abstraction over scalar
+  // values can be memoized.
+  Abs* abs = new Abs(t->loc, type, var, term);
+  abs->t3 = scope.scope.pure and is_memo_type(type);
+  return abs;
 }
 
 // Elaborate an anonymous multi-parameter function.
@@ -270,13 +310,15 @@ elab_fn(Fn_tree* t) {
     return nullptr;
 
   // Create the result type.
-  Type* kind = get_kind_type();
   Type_seq* t0 = get_type(parms);
   Type* u0 = get_type(term);
-  Type* type = new Fn_type(no_location, kind, t0, u0);
+  Type* type = get_fn_type(t0, u0);
 
-  // Create the abstraction.
-  return new Fn(t->loc, type, parms, term);
+  // Create the abstraction. Calls to a pure function over scalar
+  // values can be memoized.
+  Fn* fn = new Fn(t->loc, type, parms, term);
+  fn->t3 = scope.scope.pure and is_memo_type(type);
+  return fn;
 }
 
 
@@ -536,11 +578,10 @@ elab_arrow(Arrow_tree* t) {
     error(t2->loc) << format("'{}' does not name a type", pretty(t2));
     return nullptr;
   }
-  Type* kind_type = get_kind_type();
   Type* type1 = static_cast<Type*>(t1);
   Type* type2 = static_cast<Type*>(t2);
 
-  return new Arrow_type(t->loc, kind_type, type1, type2);
+  return get_arrow_type(type1, type2);
 }
 
 // Elaborate a tuple.
@@ -574,7 +615,7 @@ elab_tuple(Tuple_tree* t, Term* t0) {
     ++iter;
   }
 
-  Type* type = new Tuple_type(get_kind_type(), types);
+  Type* type = get_tuple_type(types);
   return new Tuple(t->loc, type, terms);
 }
 
@@ -606,7 +647,7 @@ elab_tuple_type(Tuple_tree* t, Type* t0) {
     ++iter;
   }
 
-  return new Tuple_type(t->loc, get_kind_type(), types);
+  return get_tuple_type(types);
 }
 
 
@@ -651,7 +692,7 @@ elab_record(Tuple_tree* t, Init* t0) {
     ++iter;
   }
 
-  Type* type = new Record_type(get_kind_type(), vars);
+  Type* type = get_record_type(vars);
   return new Record(t->loc, type, inits);
 }
 
@@ -683,7 +724,7 @@ elab_record_type(Tuple_tree* t, Var* t0) {
     ++iter;
   }
 
-  return new Record_type(get_kind_type(), vars);
+  return get_record_type(vars);
 }
 
 // Elaborate a tuple expression. Note that there are many
@@ -695,7 +736,7 @@ elab_record_type(Tuple_tree* t, Var* t0) {
 Expr*
 elab_tuple(Tuple_tree* t) {
   if (t->elems()->empty()) {
-    Tuple_type* type = new Tuple_type(get_kind_type(), new Type_seq());
+    Type* type = get_tuple_type(new Type_seq());
     return new Tuple(t->loc, type, new Term_seq());
   }
 
@@ -723,12 +764,132 @@ elab_list_type(List_tree* t, Type* t0) {
     error(t->loc) << format("ill-formed list type '{}'", pretty(t));
     return nullptr;
   }
-  return new List_type(get_kind_type(), t0);
+  return get_list_type(t0);
+}
+
+// Returns true if t is a literal value that can be stored directly in a
+// column of a table literal.
+inline bool
+is_cell_literal(Tree* t) {
+  Lit_tree* lit = as<Lit_tree>(t);
+  if (not lit)
+    return false;
+  switch (lit->value()->kind) {
+  case unit_tok:
+  case true_tok:
+  case false_tok:
+  case decimal_literal_tok:
+  case string_literal_tok:
+    return true;
+  default:
+    return false;
+  }
+}
+
+// Returns true if t is a literal value stored in a table literal.
+inline bool
+is_cell_literal(Expr* t) {
+  switch (t->kind) {
+  case unit_term:
+  case true_term:
+  case false_term:
+  case int_term:
+  case str_term:
+    return true;
+  default:
+    return false;
+  }
+}
+
+// Returns the members of the record r0 if it can be the first row of a
+// table literal: its members are literals with distinct names. Returns
+// nullptr otherwise.
+Term_seq*
+get_table_row(Record* r0) {
+  Term_seq* vars = as<Record_type>(get_type(r0))->members();
+  for (std::size_t i = 0; i < vars->size(); ++i) {
+    Init* init = as<Init>((*r0->members())[i]);
+    if (not is_cell_literal(init->value()))
+      return nullptr;
+    for (std::size_t j = 0; j < i; ++j) {
+      if (is_same(as<Var>((*vars)[i])->name(), as<Var>((*vars)[j])->name()))
+        return nullptr;
+    }
+  }
+  return vars;
+}
+
+// Elaborate the record literal t as a row of a table whose members are
+// vars, appending its values to the columns cols. Returns false if t is
+// not a record of literals having the names and types of vars, in which
+// case the columns are unchanged. Literals are elaborated without
+// diagnostics, so a row may be elaborated again when it is rejected.
+bool
+elab_table_row(Tree* t, Term_seq* vars, Column_seq* cols) {
+  Tuple_tree* tup = as<Tuple_tree>(t);
+  if (not tup or tup->elems()->size() != vars->size())
+    return false;
+  Tree_seq* elems = tup->elems();
+  for (std::size_t i = 0; i < vars->size(); ++i) {
+    Init_tree* init = as<Init_tree>((*elems)[i]);
+    if (not init or not is_cell_literal(init->term()))
+      return false;
+    Id_tree* id = as<Id_tree>(init->name());
+    Id* name = as<Id>(as<Var>((*vars)[i])->name());
+    if (not id or id->value()->text != name->t1)
+      return false;
+  }
+  for (std::size_t i = 0; i < vars->size(); ++i) {
+    Init_tree* init = as<Init_tree>((*elems)[i]);
+    Expr* value = elab_lit(as<Lit_tree>(init->term()));
+    if (get_type(value) != as<Var>((*vars)[i])->type()) {
+      for (std::size_t j = 0; j < i; ++j)
+        (*cols)[j]->pop_back();
+      return false;
+    }
+    (*cols)[i]->push_back(as<Term>(value));
+  }
+  return true;
+}
+
+// Elaborate a list of records whose members are literals as a table
+// literal, so that the rows of a large literal are not elaborated into
+// records and then converted to a table when evaluated. The first row
+// r0 has members vars. Returns nullptr if any row is not a record of
+// literals having the same names and types; the list is then elaborated
+// as a list.
+Table*
+elab_table(List_tree* t, Record* r0, Term_seq* vars) {
+  Column_seq* cols = new Column_seq();
+  cols->reserve(vars->size());
+  for (Term* m : *r0->members()) {
+    cols->push_back(new Term_seq());
+    cols->back()->reserve(t->elems()->size());
+    cols->back()->push_back(as<Term>(as<Init>(m)->value()));
+  }
+
+  auto iter = std::next(t->elems()->begin());
+  auto end = t->elems()->end();
+  for (; iter != end; ++iter) {
+    if (not elab_table_row(*iter, vars, cols))
+      return nullptr;
+  }
+
+  Table* table = make_table(get_list_type(get_type(r0)), cols, t->elems()->size());
+  table->loc = t->loc;
+  return table;
 }
 
 // Elaborate a list of terms.
 Expr*
 elab_list(List_tree* t, Term* t0) {
+  if (Record* r0 = as<Record>(t0)) {
+    if (Term_seq* vars = get_table_row(r0)) {
+      if (Table* table = elab_table(t, r0, vars))
+        return table;
+    }
+  }
+
   Term_seq* terms = new Term_seq {t0};
   Type* value_type = get_type(t0);
 
@@ -753,7 +914,7 @@ elab_list(List_tree* t, Term* t0) {
     ++iter;
   }
 
-  Type* type = new List_type(get_kind_type(), value_type);
+  Type* type = get_list_type(value_type);
   return new List(t->loc, type, terms);
 }
 
@@ -775,7 +936,7 @@ elab_list(List_tree *t) {
   if (t->elems()->empty()) {
     Name* n = fresh_name();
     Type* wild = new Wild_type(get_kind_type(), n, get_kind_type());
-    Type* type = new List_type(get_kind_type(), wild);
+    Type* type = get_list_type(wild);
     Term* list = new List(type, new Term_seq());
     return list;
   }
@@ -787,6 +948,7 @@ elab_list(List_tree *t) {
     return elab_list(t, term);
 
   error(t->loc) << format("ill-formed list expression '{}'", pretty(t));
+  return nullptr;
 }
 
 
@@ -806,9 +968,92 @@ elab_print(Print_tree* t) {
   Expr* t1 = elab_expr(t->expr());
   if (not t1)
     return nullptr;
+  mark_impure();
   return new Print(t->loc, get_unit_type(), t1);
 }
 
+// Elaborate a load expression. The type of the term is the type of the
+// table saved in the named file, which must exist when the program is
+// elaborated.
+//
+//    p names a table file of type T
+//    ------------------------------ T-load
+//         G |- load p : T
+Expr*
+elab_load(Load_tree* t) {
+  Term* p = elab_term(t->path());
+  if (not p)
+    return nullptr;
+  std::string path = get_file_path(p);
+  Type* type = load_table_type(path);
+  if (not type) {
+    error(t->loc) << format("cannot load a table from '{}'", path);
+    return nullptr;
+  }
+
+  // Start reading the table now, so that elaboration of the rest of
+  // the program overlaps with its reading; evaluation of the load then
+  // waits only for the rest of the table.
+  preload_table(path, type);
+  return new Load(t->loc, type, p);
+}
+
+// Elaborate a save expression. The saved term must be a table whose
+// columns can be saved (see is_table_file_type). The type of a select
+// term is not yet computed by elaboration, so the columns of a selected
+// table are checked when it is saved.
+//
+//    G |- t : [{l1:T1, ..., ln:Tn}]   each Ti in {Bool, Nat, Str}
+//    ------------------------------------------------------------ T-save
+//                    G |- save p t : Unit
+Expr*
+elab_save(Save_tree* t) {
+  Term* p = elab_term(t->path());
+  Term* t1 = elab_term(t->expr());
+  if (not p or not t1)
+    return nullptr;
+  Type* type = get_type(t1);
+  if (not is_kind(type) and not is_table_file_type(type)) {
+    error(t->loc) << format("cannot save a term of type '{}' as a table", 
+                            pretty(type));
+    return nullptr;
+  }
+  mark_impure();
+  return new Save(t->loc, get_unit_type(), p, t1);
+}
+
+// Elaborate a CSV source. The declared type must be a table type whose
+// columns can be read from a file (see is_table_file_type). The file
+// is not read until the term is evaluated.
+//
+//    G |- T :: *   T = [{l1:T1, ..., ln:Tn}]   each Ti in {Bool, Nat, Str}
+//    ------------------------------------------------------------------ T-csv
+//                          G |- csv p T : T
+Expr*
+elab_csv(Csv_tree* t) {
+  Term* p = elab_term(t->path());
+  if (not p)
+    return nullptr;
+
+  // The members of the row type are declared in a scope of their own,
+  // so that sources of the same type can be written more than once.
+  Type* type;
+  {
+    Scope_guard scope(member_scope);
+    type = elab_type(t->type());
+  }
+  if (not type)
+    return nullptr;
+  if (not is_table_file_type(type)) {
+    error(t->loc) << format("cannot read a table of type '{}' from a file", 
+                            pretty(type));
+    return nullptr;
+  }
+  if (is<Str>(p))
+    prefetch_file(get_file_path(p));
+  return new Csv(t->loc, type, p);
+}
+
 // A typeof expression is an alias for the type of the 
 // given term. It is not a term in the abstract syntax.
 //
@@ -850,6 +1095,17 @@ elab_proj(Dot_tree* t, Term* t1, Term* t2, Tuple_type* tup_type) {
   return new Unit(t->loc, get_unit_type());
 }
 
+// Returns the position in vs, the members of a record type, of the
+// member referred to by t, or the size of vs if t does not refer to
+// one of them.
+std::size_t
+get_member_index(Term_seq* vs, Term* t) {
+  Ref* r = as<Ref>(t);
+  if (not r)
+    return vs->size();
+  return std::find(vs->begin(), vs->end(), r->decl()) - vs->begin();
+}
+
 // Returns a Mem term whose t1 is a record and whose t2 is a Var
 Expr*
 elab_mem(Dot_tree* t, Term* t1, Tree* t2, Record_type* rec_type) {
@@ -862,8 +1118,15 @@ elab_mem(Dot_tree* t, Term* t1, Tree* t2, Record_type* rec_type) {
   // now we elaborate the second term with 
   // the scope so it'll recognize the label following the '.'
   Term* proj = elab_term(t2);
+  if (not proj)
+    return nullptr;
 
-  return new Mem(t->loc, get_unit_type(), t1, proj);
+  std::size_t i = get_member_index(vars, proj);
+  if (i == vars->size()) {
+    error(t->loc) << format("'{}' is not a member of '{}'", pretty(proj), pretty(t1));
+    return nullptr;
+  }
+  return new Mem(t->loc, get_unit_type(), t1, proj, i);
 }
 
 // Elaboration for a column projection 
@@ -879,7 +1142,15 @@ elab_col(Dot_tree* t, Term* t1, Tree* t2, List_type* list_type) {
       declare(v);
     }
     Term* col = elab_term(t2);
-    return new Mem(t->loc, get_unit_type(), t1, col);
+    if (not col)
+      return nullptr;
+
+    std::size_t i = get_member_index(r->members(), col);
+    if (i == r->members()->size()) {
+      error(t->loc) << format("'{}' is not a column of '{}'", pretty(col), pretty(t1));
+      return nullptr;
+    }
+    return new Mem(t->loc, get_unit_type(), t1, col, i);
   }
   else
     return nullptr; // TODO: should try some other form of proj
@@ -922,18 +1193,41 @@ elab_dot(Dot_tree* t) {
   return nullptr;
 }
 
+// Returns the type of the rows projected by the projection list t,
+// whose members are columns of the form 'x.a', or nullptr if a member
+// of t is not a column.
+Type*
+get_projection_type(Term* t) {
+  Expr_seq elems;
+  if (Comma* c = as<Comma>(t))
+    elems = *c->elems();
+  else
+    elems.push_back(t);
+  Term_seq* vars = new Term_seq();
+  for (Expr* e : elems) {
+    Mem* m = as<Mem>(e);
+    Ref* member = m ? as<Ref>(m->member()) : nullptr;
+    if (not member or not is<Var>(member->decl()))
+      return nullptr;
+    vars->push_back(as<Var>(member->decl()));
+  }
+  return get_list_type(get_record_type(vars));
+}
+
 // Elaboration for the table term
 Expr*
 elab_select(Select_tree* t) { 
+  if (t->t4)
+    return elab_group(t);
+
   //elab the table
   Term* t2 = elab_term(t->t2);
+  if (not t2)
+    return nullptr;
 
   //check for the table type
   if (List_type* l_type = as<List_type>(get_type(t2))) {
-    if (Record_type* r_type = as<Record_type>(l_type->type())) {
-
-    }
-    else
+    if (not is<Record_type>(l_type->type()))
       error(t->loc) << format("'{}' is not a list of records", pretty(t2));
   }
 
@@ -941,42 +1235,310 @@ elab_select(Select_tree* t) {
   Term* t1 = elab_term(t->t1);
   //elab the condition
   Term* t3 = elab_term(t->t3);
+  if (not t1 or not t3)
+    return nullptr;
+
+  // The rows of the result have the projected columns as members.
+  Type* type = get_projection_type(t1);
+  if (not type) {
+    error(t1->loc) << format("'{}' is not a list of columns", pretty(t1));
+    return nullptr;
+  }
+  return new Select_from_where(t->loc, type, t1, t2, t3);
+}
 
-  return new Select_from_where(get_kind_type(), t1, t2, t3);
+// Returns the record type of the rows of the table term t, or
+// nullptr if t is not a list of records.
+Record_type*
+get_row_type(Term* t) {
+  if (List_type* l_type = as<List_type>(get_type(t)))
+    return as<Record_type>(l_type->type());
+  return nullptr;
 }
 
+// Returns the elements of the comma-separated trees t, or t itself.
+Tree_seq
+get_comma_elems(Tree* t) {
+  if (Comma_tree* c = as<Comma_tree>(t))
+    return *c->elems();
+  return {t};
+}
+
+// Returns the member named by the column c of the table t2, when c has
+// the form 'x.a' and x refers to t2 (written 't as x') or to the same
+// declaration as t2. Returns nullptr otherwise.
+Var*
+get_group_column(Term* c, Term* t2) {
+  Mem* m = as<Mem>(c);
+  Ref* x = m ? as<Ref>(m->record()) : nullptr;
+  Ref* t = as<Ref>(t2);
+  if (not x or x->decl() != (t ? t->decl() : as<Def>(t2)))
+    return nullptr;
+  if (Ref* a = as<Ref>(m->member()))
+    return as<Var>(a->decl());
+  return nullptr;
+}
+
+// Elaborate an aggregate of a column of the table t2. The aggregate is
+// named n, or by its function if n is null.
+//
+//    G |- x.a : T
+//    -------------- T-count
+//    G |- count x.a : Nat
+//
+//    G |- x.a : Nat   f in {sum, min, max}
+//    ------------------------------------- T-agg
+//    G |- f x.a : Nat
+Agg*
+elab_agg(Agg_tree* t, Name* n, Term* t2) {
+  Term* c = elab_term(t->column());
+  if (not c)
+    return nullptr;
+  Var* v = get_group_column(c, t2);
+  if (not v) {
+    error(c->loc) << format("'{}' is not a column of '{}'", pretty(c), pretty(t2));
+    return nullptr;
+  }
+
+  String f = t->op()->text;
+  Agg_op op = f == "count" ? agg_count
+            : f == "sum" ? agg_sum
+            : f == "min" ? agg_min
+            : agg_max;
+  if (op != agg_count and not is_same(v->type(), get_nat_type())) {
+    error(c->loc) << format("aggregate '{} {}' requires a column of type 'Nat'",
+                            f, pretty(c));
+    return nullptr;
+  }
+  if (not n)
+    n = new Id(t->loc, f);
+  return new Agg(t->loc, get_nat_type(), n, c, op);
+}
+
+// Elaborate a grouped selection. The rows of t2 that satisfy t3 are
+// grouped by the key columns t4. The result has a row for each group,
+// whose members are the key columns and aggregates of the projection
+// list t1. An aggregate 'f x.a as n' is named n.
+//
+//    G |- t2 : [R]   G |- t3 : Bool   each ki is a column of R
+//    each pi is some ki, or an aggregate of a column of R
+//    ------------------------------------------------------------ T-group
+//    G |- select (p1, ..., pm) from t2 where t3 group by (k1, ..., kn)
+//           : [{p1:T1, ..., pm:Tm}]
 Expr*
-elab_join(Join_on_tree* t) {
-  Term* t1 = elab_term(t->t1);
+elab_group(Select_tree* t) {
   Term* t2 = elab_term(t->t2);
+  if (not t2)
+    return nullptr;
+  if (not get_row_type(t2)) {
+    error(t->loc) << format("'{}' is not a list of records", pretty(t2));
+    return nullptr;
+  }
+  if (not is<Ref>(t2)) {
+    error(t2->loc) << format("'{}' is not a named table", pretty(t2));
+    return nullptr;
+  }
+
   Term* t3 = elab_term(t->t3);
+  if (not t3)
+    return nullptr;
+  Type* type_t3 = get_type(t3);
+  if (not is_same(type_t3, get_bool_type())) {
+    error(t3->loc) << format("mismatched types '{0}'", pretty(type_t3));
+    return nullptr;
+  }
 
-  Type* type_t1 = get_type(t1);
-  Type* type_t2 = get_type(t2);
+  // Elaborate the key columns.
+  Expr_seq* keys = new Expr_seq();
+  Term_seq* key_vars = new Term_seq();
+  for (Tree* k : get_comma_elems(t->t4)) {
+    Term* c = elab_term(k);
+    if (not c)
+      return nullptr;
+    Var* v = get_group_column(c, t2);
+    if (not v) {
+      error(c->loc) << format("'{}' is not a column of '{}'", pretty(c), pretty(t2));
+      return nullptr;
+    }
+    keys->push_back(c);
+    key_vars->push_back(v);
+  }
+
+  // Elaborate the projection list, whose members are key columns or
+  // aggregates. Aggregates are elaborated only here.
+  Expr_seq* items = new Expr_seq();
+  Term_seq* vars = new Term_seq();
+  for (Tree* p : get_comma_elems(t->t1)) {
+    Name* name = nullptr;
+    if (As_tree* a = as<As_tree>(p)) {
+      if (is<Agg_tree>(a->term())) {
+        name = elab_name(a->name());
+        p = a->term();
+      }
+    }
+    if (Agg_tree* a = as<Agg_tree>(p)) {
+      Agg* agg = elab_agg(a, name, t2);
+      if (not agg)
+        return nullptr;
+      items->push_back(agg);
+      vars->push_back(new Var(agg->loc, agg->name(), get_nat_type()));
+      continue;
+    }
+    Term* c = elab_term(p);
+    if (not c)
+      return nullptr;
+    Var* v = get_group_column(c, t2);
+    if (not v or std::find(key_vars->begin(), key_vars->end(), v) == key_vars->end()) {
+      error(c->loc) << format("'{}' is not a grouping column", pretty(c));
+      return nullptr;
+    }
+    items->push_back(c);
+    vars->push_back(v);
+  }
+
+  // The members of the result must have distinct names.
+  for (std::size_t i = 0; i < vars->size(); ++i) {
+    Name* ni = as<Var>((*vars)[i])->name();
+    for (std::size_t j = 0; j < i; ++j) {
+      if (is_same(ni, as<Var>((*vars)[j])->name())) {
+        error((*items)[i]->loc) << format("duplicate column '{}' in the projection list", pretty(ni));
+        return nullptr;
+      }
+    }
+  }
 
-  //check that t1 and t2 are the same type
-  //if(!is_same(type_t1, type_t2))
-    //error(t->loc) << format("mismatched types '{0}' and '{1}'", 
-      //                      pretty(type_t1), 
-        //                    pretty(type_t2));
+  Term* t1 = items->size() == 1 ? as<Term>(items->front())
+                                : new Comma(t->t1->loc, get_unit_type(), items);
+  Term* t4 = keys->size() == 1 ? as<Term>(keys->front())
+                               : new Comma(t->t4->loc, get_unit_type(), keys);
+  Type* type = get_list_type(get_record_type(vars));
+  return new Group_by(t->loc, type, t1, t2, t3, t4);
+}
 
-  //check that t1 and t2 are table type
-  if (List_type* l_type = as<List_type>(get_type(t1))) {
-    if (Record_type* r_type = as<Record_type>(l_type->type())) {
+// Returns true if the rows of a table can be ordered by a column of
+// type t.
+bool
+is_order_type(Type* t) {
+  return is_same(t, get_unit_type()) or is_same(t, get_bool_type())
+      or is_same(t, get_nat_type()) or is_same(t, get_str_type());
+}
+
+// Elaborate the key of an ordered grouped selection t1. The key is a
+// key column in the projection list of t1, or the name of one of its
+// aggregates.
+Expr*
+elab_group_order(Group_by* t1, Tree* k) {
+  Term_seq items;
+  if (Comma* c = as<Comma>(t1->projection_list())) {
+    for (Expr* e : *c->elems())
+      items.push_back(as<Term>(e));
+  } else {
+    items.push_back(t1->projection_list());
+  }
 
+  if (Id_tree* id = as<Id_tree>(k)) {
+    Name* n = elab_name(id);
+    for (Term* i : items) {
+      Agg* agg = as<Agg>(i);
+      if (agg and is_same(agg->name(), n))
+        return agg->name();
     }
-    else
-      error(t->loc) << format("'{}' is not a list of records", pretty(t2));
   }
+  Term* c = elab_term(k);
+  if (not c)
+    return nullptr;
+  Var* v = get_group_column(c, t1->table());
+  for (Term* i : items) {
+    if (v and not is<Agg>(i) and get_group_column(i, t1->table()) == v)
+      return c;
+  }
+  error(c->loc) << format("'{}' is not a column of the grouped selection", pretty(c));
+  return nullptr;
+}
 
-  if (List_type* l_type = as<List_type>(get_type(t2))) {
-    if (Record_type* r_type = as<Record_type>(l_type->type())) {
+// Elaborate an ordered or limited selection. The rows of a selection
+// are ordered by a column 'x.a' of its table, and those of a grouped
+// selection by one of its columns or aggregates. The limit is the
+// greatest number of rows in the result.
+//
+//    G |- t1 : [R]   G |- k : T   T in {Unit, Bool, Nat, Str}   G |- n : Nat
+//    ----------------------------------------------------------------------- T-order
+//    G |- t1 order by k limit n : [R]
+Expr*
+elab_order(Order_tree* t) {
+  Term* t1 = elab_term(t->select());
+  if (not t1)
+    return nullptr;
 
+  Expr* t2 = nullptr;
+  if (t->key()) {
+    Type* type;
+    if (Group_by* g = as<Group_by>(t1)) {
+      t2 = elab_group_order(g, t->key());
+      if (not t2)
+        return nullptr;
+      type = is<Name>(t2) ? get_nat_type() : get_type(t2);
+    } else {
+      Select_from_where* s = as<Select_from_where>(t1);
+      Term* c = elab_term(t->key());
+      if (not c)
+        return nullptr;
+      if (not get_group_column(c, s->table())) {
+        error(c->loc) << format("'{}' is not a column of '{}'", pretty(c),
+                                pretty(s->table()));
+        return nullptr;
+      }
+      t2 = c;
+      type = get_type(c);
+    }
+    if (not is_order_type(type)) {
+      error(t2->loc) << format("cannot order by {}", typed(t2));
+      return nullptr;
+    }
+  }
+
+  Term* t3 = nullptr;
+  if (t->limit()) {
+    t3 = elab_term(t->limit());
+    if (not t3)
+      return nullptr;
+    if (not is_same(get_type(t3), get_nat_type())) {
+      error(t3->loc) << format("the limit {} is not a natural number", typed(t3));
+      return nullptr;
     }
-    else
-      error(t->loc) << format("'{}' is not a list of records", pretty(t2));
   }
+  return new Order_by(t->loc, get_type(t1), t1, t2, t3, t->desc);
+}
 
+// Elaborate a join. The rows of the joined table have the members
+// of the rows of t1 followed by those of the rows of t2.
+//
+//    G |- t1 : [R1]   G |- t2 : [R2]   G |- t3 : Bool
+//    ------------------------------------------------ T-join
+//           G |- t1 join t2 on t3 : [R1 ++ R2]
+Expr*
+elab_join(Join_on_tree* t) {
+  Term* t1 = elab_term(t->t1);
+  if (not t1)
+    return nullptr;
+  Term* t2 = elab_term(t->t2);
+  if (not t2)
+    return nullptr;
+  Term* t3 = elab_term(t->t3);
+  if (not t3)
+    return nullptr;
+
+  //check that t1 and t2 are table type
+  Record_type* r1 = get_row_type(t1);
+  if (not r1) {
+    error(t->loc) << format("'{}' is not a list of records", pretty(t1));
+    return nullptr;
+  }
+  Record_type* r2 = get_row_type(t2);
+  if (not r2) {
+    error(t->loc) << format("'{}' is not a list of records", pretty(t2));
+    return nullptr;
+  }
 
   //check that t3 is bool type
   Type* type_t3 = get_type(t3);
@@ -986,21 +1548,32 @@ elab_join(Join_on_tree* t) {
     return nullptr;
   }
 
-  return new Join(type_t1, t1, t2, t3);
+  // The row type of the result concatenates both row types.
+  Term_seq* vars = new Term_seq();
+  vars->insert(vars->end(), r1->members()->begin(), r1->members()->end());
+  vars->insert(vars->end(), r2->members()->begin(), r2->members()->end());
+  Type* row_type = get_record_type(vars);
+  Type* type = get_list_type(row_type);
+
+  return new Join(t->loc, type, t1, t2, t3);
 }
 
 Expr*
 elab_union(Union_tree* t) {
   Term* t1 = elab_term(t->t1);
   Term* t2 = elab_term(t->t2);
+  if (not t1 or not t2)
+    return nullptr;
 
   Type* type_t1 = get_type(t1);
   Type* type_t2 = get_type(t2);
 
-  if(!is_same(type_t1, type_t2))
+  if(!is_same(type_t1, type_t2)) {
     error(t->loc) << format("mismatched types '{0}' and '{1}'", 
                             pretty(type_t1), 
                             pretty(type_t2));
+    return nullptr;
+  }
 
   Type* type1 = get_type(t1);
   return new Union(type1, t1, t2);
@@ -1010,14 +1583,18 @@ Expr*
 elab_intersect(Intersect_tree* t) {
   Term* t1 = elab_term(t->t1);
   Term* t2 = elab_term(t->t2);
+  if (not t1 or not t2)
+    return nullptr;
 
   Type* type_t1 = get_type(t1);
   Type* type_t2 = get_type(t2);
 
-  if(!is_same(type_t1, type_t2))
+  if(!is_same(type_t1, type_t2)) {
     error(t->loc) << format("mismatched types '{0}' and '{1}'", 
                             pretty(type_t1), 
                             pretty(type_t2));
+    return nullptr;
+  }
 
   Type* type1 = get_type(t1);
   return new Intersect(type1, t1, t2);
@@ -1027,14 +1604,18 @@ Expr*
 elab_except(Except_tree* t) {
   Term* t1 = elab_term(t->t1);
   Term* t2 = elab_term(t->t2);
+  if (not t1 or not t2)
+    return nullptr;
 
   Type* type_t1 = get_type(t1);
   Type* type_t2 = get_type(t2);
 
-  if(!is_same(type_t1, type_t2))
+  if(!is_same(type_t1, type_t2)) {
     error(t->loc) << format("mismatched types '{0}' and '{1}'", 
                             pretty(type_t1), 
                             pretty(type_t2));
+    return nullptr;
+  }
 
   Type* type1 = get_type(t1);
   return new Except(type1, t1, t2);
@@ -1110,6 +1691,8 @@ Expr*
 elab_eq(Eq_comp_tree* t) {
   Term* t1 = elab_term(t->t1);
   Term* t2 = elab_term(t->t2);
+  if (not t1 or not t2)
+    return nullptr;
   return new Equals(t1->loc, get_bool_type(), t1, t2);
 }
 
@@ -1117,6 +1700,8 @@ Expr*
 elab_less(Less_tree* t) {
   Term* t1 = elab_term(t->t1);
   Term* t2 = elab_term(t->t2);
+  if (not t1 or not t2)
+    return nullptr;
   return new Less(t1->loc, get_bool_type(), t1, t2);
 }
 
@@ -1124,6 +1709,8 @@ Expr*
 elab_as(As_tree* t) {
   if(Id* id = as<Id>(elab_name(t->name()))) {
     Expr* value = elab_expr(t->term());
+    if (not value)
+      return nullptr;
     Def* def = new Def(get_type(value), id, value);
     declare(id, def);
     return elab_id(as<Id_tree>(t->name()));
@@ -1131,19 +1718,14 @@ elab_as(As_tree* t) {
   return nullptr;
 }
 
-// Elaborate a program. The result type of the entire program
-// is that of the last statement.
+// Elaborate the statements of a program. The result type of the
+// entire program is that of the last statement.
 //
 //    for each i  G, ei-1 : Ti-1 |- ei : Ti
 //    ------------------------------------- T-prog
 //           G |- e1; ...; en; : Tn
-//
-// Note that we push the global scope before elaborating each
-// statement in the program.
 Expr*
-elab_prog(Prog_tree* t) {
-  Scope_guard scope(global_scope);
-
+elab_stmts(Prog_tree* t) {
   // Elaborate each statement in turn.
   Term_seq* stmts = new Term_seq();
   for (Tree* s : *t->stmts()) {
@@ -1159,6 +1741,17 @@ elab_prog(Prog_tree* t) {
   return new Prog(type, stmts);
 }
 
+// Elaborate a program. Note that we push the global scope before
+// elaborating the statements of the program, unless there is already
+// a current scope (e.g., in a session; see session.hpp).
+Expr*
+elab_prog(Prog_tree* t) {
+  if (current_context()->scope)
+    return elab_stmts(t);
+  Scope_guard scope(global_scope);
+  return elab_stmts(t);
+}
+
 Expr* 
 elab_expr(Tree* t) {
   if (not t)
@@ -1183,10 +1776,20 @@ elab_expr(Tree* t) {
   case list_tree: return elab_list(as<List_tree>(t));
   case variant_tree: return elab_variant(as<Variant_tree>(t));
   case print_tree: return elab_print(as<Print_tree>(t));
+  case load_tree: return elab_load(as<Load_tree>(t));
+  case save_tree: return elab_save(as<Save_tree>(t));
+  case csv_tree: return elab_csv(as<Csv_tree>(t));
+  case insert_tree:
+    error(t->loc) << "rows can be inserted only in a session";
+    return nullptr;
   case typeof_tree: return elab_typeof(as<Typeof_tree>(t));
   case comma_tree: return elab_comma(as<Comma_tree>(t));
   case dot_tree: return elab_dot(as<Dot_tree>(t));
   case select_tree: return elab_select(as<Select_tree>(t));
+  case order_tree: return elab_order(as<Order_tree>(t));
+  case agg_tree:
+    error(t->loc) << format("aggregate '{}' outside of a grouped selection", pretty(t));
+    return nullptr;
   case join_on_tree: return elab_join(as<Join_on_tree>(t));
   case and_tree: return elab_and(as<And_tree>(t));
   case or_tree: return elab_or(as<Or_tree>(t));
@@ -1207,6 +1810,6 @@ elab_expr(Tree* t) {
 
 Expr*
 Elaborator::operator()(Tree* t) {
-  use_diagnostics(diags);
+  Context_guard guard(cxt);
   return elab_expr(t);
 }
@@ -1,16 +1,24 @@
 
 #ifndef ELAB_HPP
-#define EALB_HPP
+#define ELAB_HPP
 
-#include "lang/error.hpp"
+#include "lang/context.hpp"
 
 struct Expr;
 struct Tree;
 
+// The elaborator transforms a parse tree into a fully typed abstract
+// syntax tree. The nodes of that tree are allocated in the elaborator's
+// arena, and are destroyed with the elaborator. The scopes of the
+// program are kept in the elaborator's context.
 struct Elaborator {
+  Elaborator() : cxt(diags, &arena) { }
+
   Expr* operator()(Tree* t);
 
   Diagnostics diags;
+  Arena arena;
+  Context cxt;
 };
 
 #endif
@@ -0,0 +1,384 @@
+
+#include "env.hpp"
+#include "eval.hpp"
+#include "type.hpp"
+#include "value.hpp"
+#include "subst.hpp"
+#include "memo.hpp"
+#include "stats.hpp"
+#include "profile.hpp"
+#include "output.hpp"
+
+#include "lang/debug.hpp"
+
+#include <vector>
+
+// -------------------------------------------------------------------------- //
+// Environment
+
+// Bind the declaration x to the value v.
+void
+Env::bind(Expr* x, Term* v) {
+  emplace_back(x, v);
+}
+
+// Returns the value bound to the declaration x in this environment
+// or any of its parents, or nullptr if x is not bound.
+Term*
+Env::get(Expr* x) const {
+  const Env* e = this;
+  while (e) {
+    for (const Binding& b : *e)
+      if (b.first == x)
+        return b.second;
+    e = e->parent;
+  }
+  return nullptr;
+}
+
+// Returns the value bound to the declaration x, which is bound in the
+// slot (depth, index). The environments of a program that is evaluated
+// in place follow its lexical structure, so the slot is normally that
+// of x. If it is not (e.g., in the environment of a machine frame; see
+// vm.hpp), x is searched for instead.
+Term*
+Env::get(Expr* x, int depth, int index) const {
+  const Env* e = this;
+  for (int i = 0; e and i < depth; ++i)
+    e = e->parent;
+  if (e and std::size_t(index) < e->size()) {
+    const Binding& b = (*e)[index];
+    if (b.first == x)
+      return b.second;
+  }
+  return get(x);
+}
+
+
+// -------------------------------------------------------------------------- //
+// Evaluation in an environment
+//
+// The following functions compute the evaluation of a term t in an
+// environment E, written E |- t ->* v. The rules mirror those in
+// eval.cpp, except for references to variables, which are looked up
+// in E, and for abstractions, which evaluate to closures.
+
+namespace {
+
+// Close the term t over the environment e. That is, substitute the
+// value of each binding in e for references to its declaration. Inner
+// bindings take precedence over those in enclosing environments.
+Term*
+close_term(Term* t, Env* e) {
+  if (not e)
+    return t;
+  Subst sub;
+  while (e) {
+    for (const Binding& b : *e)
+      sub.insert(b);
+    e = e->parent;
+  }
+  return subst_term(t, sub);
+}
+
+// Terms without specific rules in this module are evaluated by
+// substitution after being closed over the environment.
+//
+//    E |- [E]t ->* v
+//    --------------- E-env-subst
+//       E |- t ->* v
+inline Term*
+eval_closed(Term* t, Env* e) {
+  return eval(close_term(t, e));
+}
+
+// Evaluate a reference.
+//
+//    x = v in E
+//    ---------- E-env-var
+//    E |- x ->* v
+//
+// References that are not bound in E are evaluated as in eval.cpp:
+// references to definitions evaluate to the defined value, and other
+// references are preserved.
+Term*
+eval_ref(Ref* t, Env* e) {
+  if (e) {
+    Term* v;
+    if (t->depth() >= 0)
+      v = e->get(t->decl(), t->depth(), t->index());
+    else
+      v = e->get(t->decl());
+    if (v)
+      return v;
+  }
+  return eval(t);
+}
+
+// An abstraction or function evaluates to a closure over the
+// current environment.
+//
+//    ---------------------- E-env-abs
+//    E |- \x:T.t ->* [E]\x:T.t
+Term*
+eval_abs(Term* t, Env* e) {
+  return new Closure(t->loc, get_type(t), t, e);
+}
+
+// Returns the closure that is the target of an application or call,
+// and the environment in which its definition was evaluated.
+Term*
+get_fn(Term* f, Env*& e) {
+  if (Closure* c = as<Closure>(f)) {
+    e = c->env();
+    return c->fn();
+  }
+  e = nullptr;
+  return f;
+}
+
+// Evaluate an application.
+//
+//    E |- t1 ->* [E']\x:T.t   E |- t2 ->* v   E', x=v |- t ->* v'
+//    ------------------------------------------------------------ E-env-app
+//                       E |- t1 t2 ->* v'
+//
+// The abstracted term is in tail position, so it is returned to be
+// evaluated by eval (see below), and e is updated to the environment
+// in which it is evaluated. The same is true of calls, of the branches
+// of if terms, and of the last statement of a program.
+Term*
+eval_app(App* t, Env*& e) {
+  Env* fe;
+  Abs* fn = as<Abs>(get_fn(eval(t->abs(), e), fe));
+  lang_assert(fn, format("ill-formed application target '{}'", pretty(t->abs())));
+
+  Term* arg = eval(t->arg(), e);
+
+  Env* env = new Env(fe);
+  env->bind(fn->var(), arg);
+  if (is_memo_fn(fn)) {
+    if (Term* v = find_memo(fn, &arg, 1))
+      return v;
+    Term* v = eval(fn->term(), env);
+    save_memo(fn, &arg, 1, v);
+    return v;
+  }
+  e = env;
+  return fn->term();
+}
+
+// Evaluate a function call. Each argument is evaluated in turn, and
+// bound to the corresponding parameter.
+//
+//    E |- t ->* [E']\(x1:T1, ..., xn:Tn).t'   for each i E |- ti ->* vi
+//           E', x1=v1, ..., xn=vn |- t' ->* v
+//    ------------------------------------------------------------------ E-env-call
+//                       E |- t(t1, ..., tn) ->* v
+Term*
+eval_call(Call* t, Env*& e) {
+  Env* fe;
+  Fn* fn = as<Fn>(get_fn(eval(t->fn(), e), fe));
+  lang_assert(fn, format("ill-formed call target '{}'", pretty(t->fn())));
+
+  Term_seq* parms = fn->parms();
+  Term_seq* args = t->args();
+  lang_assert(parms->size() == args->size(), "invalid function call");
+
+  Env* env = new Env(fe);
+  env->reserve(parms->size());
+  if (is_memo_fn(fn)) {
+    std::vector<Term*> vals;
+    vals.reserve(args->size());
+    for (std::size_t i = 0; i < parms->size(); ++i) {
+      vals.push_back(eval((*args)[i], e));
+      env->bind((*parms)[i], vals.back());
+    }
+    if (Term* v = find_memo(fn, vals.data(), vals.size()))
+      return v;
+    Term* v = eval(fn->term(), env);
+    save_memo(fn, vals.data(), vals.size(), v);
+    return v;
+  }
+  for (std::size_t i = 0; i < parms->size(); ++i)
+    env->bind((*parms)[i], eval((*args)[i], e));
+  e = env;
+  return fn->term();
+}
+
+// Evaluate an if term.
+Term*
+eval_if(If* t, Env* e) {
+  Term* bv = eval(t->cond(), e);
+  if (is_true(bv))
+    return t->if_true();
+  if (is_false(bv))
+    return t->if_false();
+  lang_unreachable(format("'{}' is not a boolean value", pretty(bv)));
+}
+
+// Evaluate a successor term.
+Term*
+eval_succ(Succ* t, Env* e) {
+  Term* t1 = eval(t->arg(), e);
+  if (Int* n = as<Int>(t1))
+    return new Int(t->loc, get_type(t), n->value() + 1);
+  lang_unreachable(format("'{}' is not a numeric value", pretty(t1)));
+}
+
+// Evaluate a predecessor term.
+Term*
+eval_pred(Pred* t, Env* e) {
+  Term* t1 = eval(t->arg(), e);
+  if (Int* n = as<Int>(t1)) {
+    const Integer& z = n->value();
+    if (z == 0)
+      return n;
+    else
+      return new Int(t->loc, get_type(t), z - 1);
+  }
+  lang_unreachable(format("'{}' is not a numeric value", pretty(t1)));
+}
+
+// Evaluate an iszero term.
+Term*
+eval_iszero(Iszero* t, Env* e) {
+  Term* t1 = eval(t->arg(), e);
+  if (Int* n = as<Int>(t1))
+    return n->value() == 0 ? get_true() : get_false();
+  lang_unreachable(format("'{}' is not a numeric value", pretty(t1)));
+}
+
+// Evaluate 't1 and t2'. Returns the term t2, in tail position, when
+// t1 is true.
+Term*
+eval_and(And* t, Env* e) {
+  Term* t1 = eval(t->t1, e);
+  if (is_true(t1))
+    return t->t2;
+  if (is_false(t1))
+    return get_false();
+  lang_unreachable(format("'{}' is not a boolean value", pretty(t1)));
+}
+
+// Evaluate 't1 or t2'. Returns the term t2, in tail position, when
+// t1 is false.
+Term*
+eval_or(Or* t, Env* e) {
+  Term* t1 = eval(t->t1, e);
+  if (is_true(t1))
+    return get_true();
+  if (is_false(t1))
+    return t->t2;
+  lang_unreachable(format("'{}' is not a boolean value", pretty(t1)));
+}
+
+// Evaluate 'not t1'.
+Term*
+eval_not(Not* t, Env* e) {
+  Term* t1 = eval(t->t1, e);
+  if (is_true(t1))
+    return get_false();
+  if (is_false(t1))
+    return get_true();
+  lang_unreachable(format("'{}' is not a boolean value", pretty(t1)));
+}
+
+// Evaluate 't1 eq t2'.
+Term*
+eval_equals(Equals* t, Env* e) {
+  Term* t1 = eval(t->t1, e);
+  Term* t2 = eval(t->t2, e);
+  return is_same(t1, t2) ? get_true() : get_false();
+}
+
+// Evaluate 't1 lt t2'.
+Term*
+eval_less(Less* t, Env* e) {
+  Term* t1 = eval(t->t1, e);
+  Term* t2 = eval(t->t2, e);
+  return is_less(t1, t2) ? get_true() : get_false();
+}
+
+// Evaluate the definition by evaluating the defined term, and
+// updating the definition with that value (see eval_def in eval.cpp).
+Term*
+eval_def(Def* t, Env* e) {
+  if (Term* t0 = as<Term>(t->value())) {
+    if (not is_lazy_def(t))
+      t->t2 = eval(t0, e);
+    else if (not t->t3)
+      t->t3 = [t0, e] { return eval(t0, e); };
+  }
+  return t;
+}
+
+// Evaluate a print statement. If the expression cannot be
+// evaluated, print the expression instead.
+Term*
+eval_print(Print* t, Env* e) {
+  Term* val = nullptr;
+  if (Term* term = as<Term>(t->expr()))
+    val = eval(term, e);
+  if (val)
+    get_output().print(val);
+  else
+    get_output().print(t->expr());
+  return new Unit(t->loc, get_unit_type());
+}
+
+// Evaluate each statement in turn; the result of the program is
+// the result of the last statement.
+Term*
+eval_prog(Prog* t, Env* e) {
+  Term_seq* ts = t->stmts();
+  if (ts->empty())
+    return get_unit();
+  for (std::size_t i = 0; i < ts->size() - 1; ++i)
+    eval((*ts)[i], e);
+  return ts->back();
+}
+
+} // namespace
+
+// Compute the evalutation of the term t in the environment e. The
+// environment may be null, in which case no variables are bound.
+// Terms in tail position are evaluated by iterating, not by recursion,
+// so that a chain of tail calls runs in constant native stack.
+// Applications are recorded in the frame of this evaluation when
+// profiling.
+Term*
+eval(Term* t, Env* e) {
+  Profile_frame frame;
+  while (true) {
+    count_eval(t->kind);
+    switch (t->kind) {
+    case if_term: t = eval_if(as<If>(t), e); break;
+    case app_term: frame.enter(t); t = eval_app(as<App>(t), e); break;
+    case call_term: frame.enter(t); t = eval_call(as<Call>(t), e); break;
+    case prog_term: t = eval_prog(as<Prog>(t), e); break;
+    case and_term: t = eval_and(as<And>(t), e); break;
+    case or_term: t = eval_or(as<Or>(t), e); break;
+    case not_term: return eval_not(as<Not>(t), e);
+    case equals_term: return eval_equals(as<Equals>(t), e);
+    case less_term: return eval_less(as<Less>(t), e);
+    case succ_term: return eval_succ(as<Succ>(t), e);
+    case pred_term: return eval_pred(as<Pred>(t), e);
+    case iszero_term: return eval_iszero(as<Iszero>(t), e);
+    case abs_term: return eval_abs(t, e);
+    case fn_term: return eval_abs(t, e);
+    case ref_term: return eval_ref(as<Ref>(t), e);
+    case print_term: return eval_print(as<Print>(t), e);
+    case def_term: return eval_def(as<Def>(t), e);
+    case unit_term:
+    case true_term:
+    case false_term:
+    case int_term:
+    case str_term:
+    case closure_term:
+    case table_term:
+      return t;
+    default: return eval_closed(t, e);
+    }
+  }
+}
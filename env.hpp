@@ -0,0 +1,46 @@
+
+#ifndef ENV_HPP
+#define ENV_HPP
+
+#include "ast.hpp"
+
+#include <utility>
+#include <vector>
+
+// -------------------------------------------------------------------------- //
+// Environments
+//
+// This module defines an evaluator that computes the values of terms
+// in an environment of variable bindings. Unlike the substitution-based
+// rules in eval.cpp, applying an abstraction binds its argument in a
+// new environment and evaluates the abstracted term in place. The body
+// of the abstraction is never copied.
+
+// A binding associates a variable declaration with its value.
+using Binding = std::pair<Expr*, Term*>;
+
+// An environment records the values bound to the parameters of an
+// abstraction or function. Each environment is linked to its parent,
+// the environment captured by the closure being applied, allowing
+// lookup to work "outwards", just like the lookup of names in a scope.
+//
+// Environments are typically small (one binding per parameter), so
+// the bindings are searched linearly. A reference that was resolved to
+// a slot (see Ref in ast.hpp) is found without searching: the depth
+// selects the environment and the index selects the binding.
+struct Env : std::vector<Binding> {
+  Env()
+    : parent(nullptr) { }
+  Env(Env* p)
+    : parent(p) { }
+
+  void bind(Expr*, Term*);
+  Term* get(Expr*) const;
+  Term* get(Expr*, int, int) const;
+
+  Env* parent;
+};
+
+Term* eval(Term*, Env*);
+
+#endif
@@ -1,24 +1,132 @@
 
 #include "eval.hpp"
 #include "ast.hpp"
+#include "env.hpp"
 #include "scope.hpp"
 #include "type.hpp"
 #include "value.hpp"
 #include "subst.hpp"
+#include "memo.hpp"
+#include "stats.hpp"
+#include "profile.hpp"
+#include "output.hpp"
+#include "table.hpp"
+#include "plan.hpp"
+#include "table_file.hpp"
+#include "csv.hpp"
+#include "vm.hpp"
+#include "sched.hpp"
 
 #include "lang/debug.hpp"
+#include "lang/thread_pool.hpp"
 
-#include <iostream>
+#include <algorithm>
 #include <set>
+#include <unordered_map>
+#include <unordered_set>
 
 // -------------------------------------------------------------------------- //
 // Evaluator class
 
+namespace {
+
+// The shared scans of a program (see find_shared_scans) are found when
+// its evaluation starts, and discarded when it ends, so that terms
+// evaluated later (e.g., by a session) scan their tables again.
+struct Shared_scan_guard {
+  Shared_scan_guard(Prog* p)
+    : prog(p) { if (prog) find_shared_scans(prog); }
+  ~Shared_scan_guard() { if (prog) clear_shared_scans(); }
+
+  Prog* prog;
+};
+
+} // namespace
+
+// The arena of each thread of the pool is created with the evaluator.
+// The main thread uses the evaluator's own arena.
+Evaluator::Evaluator(Engine e, Output* o)
+  : engine(e), cxt(diags, &arena), comp(new Compiler()),
+    out(o ? o : &get_standard_output())
+{
+  arenas.push_back(&arena);
+  for (std::size_t i = 1; i < get_thread_pool().size(); ++i)
+    arenas.push_back(new Arena());
+  comp->lazy = lazy_defs();
+}
+
+Evaluator::~Evaluator() {
+  for (std::size_t i = 1; i < arenas.size(); ++i)
+    delete arenas[i];
+  delete comp;
+}
+
 Term*
 Evaluator::operator()(Term* t) {
+  if (engine == vm_engine)
+    return (*this)(compile(t));
+  Context_guard guard(cxt);
+  Output_guard output(*out);
+  Prog* p = as<Prog>(t);
+  Shared_scan_guard scans(p);
+  if (p and arenas.size() > 1) {
+    Term_seq* stmts = p->stmts();
+    auto eval_stmt = [&](std::size_t i) {
+      if (engine == env_engine)
+        return eval((*stmts)[i], nullptr);
+      return eval((*stmts)[i]);
+    };
+    return eval_stmts(Stmt_graph(p), eval_stmt, arenas);
+  }
+  if (engine == env_engine)
+    return eval(t, nullptr);
   return eval(t);
 }
 
+// Run the compiled code. Under a fuel limit, the code is run as a task
+// (see vm.hpp), whose statements are run in order. The task is resumed
+// a slice of its fuel at a time, and the output printed in each slice
+// is flushed before the next, so that a long evaluation writes its
+// output as it runs.
+Term*
+Evaluator::operator()(Code* c) {
+  Context_guard guard(cxt);
+  Output_guard output(*out);
+  Prog* p = as<Prog>(c->term);
+  Shared_scan_guard scans(p);
+  if (std::size_t fuel = get_fuel_limit()) {
+    Task task(*comp, c);
+    while (not task.resume(std::min(fuel - task.spent, fuel_slice))) {
+      if (task.spent == fuel)
+        throw Fuel_error(fuel);
+      out->flush();
+    }
+    return task.result;
+  }
+  if (p and arenas.size() > 1) {
+    auto run_stmt = [&](std::size_t i) {
+      return run(*comp, c->stmts[i]);
+    };
+    return eval_stmts(Stmt_graph(p), run_stmt, arenas);
+  }
+  return run(*comp, c);
+}
+
+// Compile the term t into code for the virtual machine.
+Code*
+Evaluator::compile(Term* t) {
+  return (*comp)(t);
+}
+
+// Returns the number of bytes allocated in the arenas of the evaluator.
+std::size_t
+Evaluator::allocated() const {
+  std::size_t n = 0;
+  for (Arena* a : arenas)
+    n += a->allocated();
+  return n;
+}
+
 
 // -------------------------------------------------------------------------- //
 // Multi-step evaluation
@@ -32,6 +140,29 @@ Term* eval(Term*);
 
 namespace {
 
+bool lazy_defs_ = false;
+
+} // namespace
+
+// Set the evaluation of definitions by need.
+void
+set_lazy_defs(bool b) { lazy_defs_ = b; }
+
+bool
+lazy_defs() { return lazy_defs_; }
+
+// Returns true if the definition d is evaluated by need: in lazy mode,
+// when its value is pure (see is_pure_def), so that delaying it does
+// not reorder its effects.
+bool
+is_lazy_def(Def* d) {
+  return lazy_defs() and is_pure_def(d);
+}
+
+namespace {
+
+Term* eval_list(List*);
+
 // Compute the multistep evaluation of an if term
 //
 //             t1 ->* true
@@ -41,13 +172,18 @@ namespace {
 //             t1 ->* true
 //    ---------------------------- E-if-false
 //    if t1 then t2 else t3 ->* t2
+//
+// The selected branch is in tail position, so it is returned to be
+// evaluated by eval (see below) instead of being evaluated here. The
+// same is true of the results of applications and calls, and of the
+// last statement of a program.
 Term*
 eval_if(If* t) {
   Term* bv = eval(t->cond());
   if (is_true(bv))
-    return eval(t->if_true());
+    return t->if_true();
   if (is_false(bv))
-    return eval(t->if_false());
+    return t->if_false();
   lang_unreachable(format("'{}' is not a boolean value", pretty(bv)));
 }
 
@@ -130,10 +266,17 @@ eval_app(App* t) {
 
   Term* arg = eval(t->arg()); // E-app-2
     
-  // Perform a beta reduction and evaluate the result.
+  // Perform a beta reduction. The result is evaluated by eval, unless
+  // the call is memoized.
   Subst sub {fn->var(), arg};
-  Term* res = subst_term(fn->term(), sub);
-  return eval(res);
+  if (is_memo_fn(fn)) {
+    if (Term* v = find_memo(fn, &arg, 1))
+      return v;
+    Term* v = eval(subst_term(fn->term(), sub));
+    save_memo(fn, &arg, 1, v);
+    return v;
+  }
+  return subst_term(fn->term(), sub);
 }
 
 // Evaluate a function call. This is virtually identical to
@@ -146,17 +289,24 @@ eval_call(Call* t) {
   Fn* fn = as<Fn>(eval(t->fn()));
   lang_assert(fn, format("ill-formed call target '{}'", pretty(t->fn())));
 
-  // Evaluate arguments in place. That is, we're not creating
-  // a new sequence of arguments, just replacing the entries
-  // in the existing sequence.
-  Term_seq* args = t->args();
-  for (Term*& a : *args)
-    a = eval(a);
+  // Evaluate the arguments into a new sequence, so that the call is
+  // not changed by its evaluation.
+  Term_seq* args = new Term_seq();
+  args->reserve(t->args()->size());
+  for (Term* a : *t->args())
+    args->push_back(eval(a));
 
-  // Beta reduce and evaluate.
+  // Beta reduce. The result is evaluated by eval, unless the call is
+  // memoized.
   Subst sub {fn->parms(), args};
-  Term* result = subst_term(fn->term(), sub);
-  return eval(result);
+  if (is_memo_fn(fn)) {
+    if (Term* v = find_memo(fn, args->data(), args->size()))
+      return v;
+    Term* v = eval(subst_term(fn->term(), sub));
+    save_memo(fn, args->data(), args->size(), v);
+    return v;
+  }
+  return subst_term(fn->term(), sub);
 }
 
 // Elaborate a declaration reference. When the reference
@@ -169,10 +319,19 @@ eval_call(Call* t) {
 Term*
 eval_ref(Ref* t) {
   if (Def* def = as<Def>(t->decl())) {
-    if (Term* replace = as<Term>(def->value()))
+    if (def->t3)
+      std::call_once(def->t4, [def] { def->t2 = def->t3(); });
+    if (Term* replace = as<Term>(def->value())) {
+      // A table named by 't as x' is not evaluated as a definition.
+      // Convert it to a table when it is first referenced, and keep
+      // the result. The table may itself be named by a reference.
+      if (List* list = as<List>(replace))
+        def->t2 = replace = eval_list(list);
+      else if (is<Csv>(replace) or is<Ref>(replace) or is_plan_term(replace))
+        def->t2 = replace = eval(replace);
       return replace;
-    else
-      return nullptr;
+    }
+    return nullptr;
   } else {
     return t;
   }
@@ -180,10 +339,16 @@ eval_ref(Ref* t) {
 
 // Evaluate the definition by evaluating the defined term. When the
 // definition's value is not a term, then there isn't anything
-// interesting that we can do. Just return the value.
+// interesting that we can do. Just return the value. In lazy mode,
+// a pure defined term is evaluated when it is first referenced.
 Term*
 eval_def(Def* t) {
   if (Term* t0 = as<Term>(t->value())) {
+    if (is_lazy_def(t)) {
+      if (not t->t3)
+        t->t3 = [t0] { return eval(t0); };
+      return t;
+    }
     // This is a little weird. We're actually going to update
     // the defined term with its evaluated initializer. We do this
     // because other expressions may already refer to t and we don't
@@ -218,9 +383,9 @@ eval_print(Print* t) {
   // Print the result, or if the expression is not
   // evaluable, just print the expression.
   if (val)
-    std::cout << pretty(val) << '\n';
+    get_output().print(val);
   else
-    std::cout << pretty(t->expr()) << '\n';
+    get_output().print(t->expr());
 
   return new Unit(t->loc, get_unit_type());
 }
@@ -237,69 +402,56 @@ eval_comma(Comma* t) {
 //    for each i ei ->* vi
 //    -------------------- E-prog
 //     e1; ...; en ->* vn
+//
+// The last statement is returned to be evaluated by eval.
 Term*
 eval_prog(Prog* t) {
-  Term* tn;
-  for (Term* ti : *t->stmts())
-    tn = eval(ti);
-  return tn;
+  Term_seq* ts = t->stmts();
+  if (ts->empty())
+    return get_unit();
+  for (std::size_t i = 0; i < ts->size() - 1; ++i)
+    eval((*ts)[i]);
+  return ts->back();
 }
 
-// Evaluation for 't1 and t2'
+// Evaluation for 't1 and t2'. The operand t2 is evaluated only when
+// t1 is true, in tail position.
 //
-// t1 ->* true   t2 -> true
-// ------------------------
-// t1 and t2 ->* true
-//
-// t1 ->* false   t2 -> true
-// ------------------------
-// t1 and t2 ->* false
-//
-// t1 ->* true   t2 -> false
-// ------------------------
+// t1 ->* false
+// ------------------
 // t1 and t2 ->* false
 //
-// t1 ->* false  t2 -> false
-// ------------------------
-// t1 and t2 ->* false
+// t1 ->* true   t2 ->* v
+// ----------------------
+// t1 and t2 ->* v
 Term*
 eval_and(And* t) {
   Term* t1 = eval(t->t1);
-  Term* t2 = eval(t->t2);
-
-  if(is_true(t1) && is_true(t2))
-    return get_true();
-  else 
+  if (is_true(t1))
+    return t->t2;
+  if (is_false(t1))
     return get_false();
+  lang_unreachable(format("'{}' is not a boolean value", pretty(t1)));
 }
 
-// Evaluation for 't1 or t2'
-//
-// t1 ->* true   t2 -> true
-// ------------------------
-// t1 or t2 ->* true
+// Evaluation for 't1 or t2'. The operand t2 is evaluated only when
+// t1 is false, in tail position.
 //
-// t1 ->* false   t2 -> true
-// ------------------------
-// t1 or t2 ->* true
-//
-// t1 ->* true   t2 -> false
-// ------------------------
+// t1 ->* true
+// -----------------
 // t1 or t2 ->* true
 //
-// t1 ->* false  t2 -> false
-// ------------------------
-// t1 or t2 ->* false
-//
+// t1 ->* false   t2 ->* v
+// -----------------------
+// t1 or t2 ->* v
 Term*
 eval_or(Or* t) {
   Term* t1 = eval(t->t1);
-  Term* t2 = eval(t->t2);
-
-  if(is_false(t1) && is_false(t2))
-    return get_false();
-  else 
+  if (is_true(t1))
     return get_true();
+  if (is_false(t1))
+    return t->t2;
+  lang_unreachable(format("'{}' is not a boolean value", pretty(t1)));
 }
 
 // Evaluation for 'not t1'
@@ -320,6 +472,7 @@ eval_not(Not* t) {
     return get_false();
   if(is_false(t1))
     return get_true();
+  lang_unreachable(format("'{}' is not a boolean value", pretty(t1)));
 }
 
 // Evaluation for t1 == t2
@@ -363,381 +516,380 @@ eval_proj(Proj* t) {
   return nullptr;
 }
 
-// Returns a column projection for tables
+// Evaluate a list. A list of records is a table, and evaluates to
+// its columnar representation. Other lists are values.
 Term*
-eval_col(Mem* t) {
-  List* table = as<List>(eval(t->t1));
-  Ref* member = as<Ref>(t->member());
-  Var* v = as<Var>(member->decl());
-  Name* n = v->name();
-
-  Term_seq* records = table->elems();
-  Term_seq* vars = new Term_seq();
-  vars->push_back(v);
-  Type* rec_type = new Record_type(get_kind_type(), vars);
-
-  // resulting column
-  Term_seq* col = new Term_seq();
-  for (auto r : *records) {
-    for (auto i : *as<Record>(r)->members()) {
-      if (is_same(n, as<Init>(i)->name())) {
-        Term_seq* e = new Term_seq();
-        e->push_back(i);
-        col->push_back(new Record(rec_type, e));
-      }
-    }
-  }
-  Type* type = new List_type(get_kind_type(), rec_type);
-  return new List(type, col);
+eval_list(List* t) {
+  if (get_row_type(get_type(t)))
+    return make_table(t);
+  return t;
 }
 
-// Returns a term from the record such that the label in the record matches l
-// Returns nullptr if the label l does not match anything in record r
+// Evaluate a load term. The table is read from the named file, which
+// must still have the type recorded when the term was elaborated.
+//
+//    p names a table file holding v
+//    ------------------------------ E-load
+//           load p ->* v
 Term*
-eval_mem(Mem* t) {
-  Term* t1 = eval(t->t1);
-
-  // If its a record type get the term with the corresponding label
-  if (Record_type* r_type = as<Record_type>(get_type(t1))) {
-    Term_seq* r = as<Record>(t1)->members();
-    Ref* ref = as<Ref>(t->member());
-    Name* n = as<Var>(ref->decl())->name();
-
-    for (auto i : *r) {
-      if (is_same(n, as<Init>(i)->name())) {
-        return as<Term>(as<Init>(i)->value());
-      }
-    }
-  }
-
-  // Else return the column
-  if (List_type* l_type = as<List_type>(get_type(t1))) {
-    return eval_col(t);
-  }
-
-  return nullptr;
+eval_load(Load* t) {
+  std::string path = get_file_path(t->path());
+  Table* table = load_table(path, get_type(t));
+  if (not table)
+    lang_unreachable(format("cannot load a table from '{}'", path));
+  return table;
 }
 
-// Merges records a and b
-Record*
-merge_records(Record* a, Record* b) {
-  Term_seq* a_mem = a->members();
-  Term_seq* b_mem = b->members();
-  Term_seq* elems = new Term_seq();
-
-  elems->insert(elems->end(), a_mem->begin(), a_mem->end());
-  elems->insert(elems->end(), b_mem->begin(), b_mem->end());
-  
-  Record_type* ar_type = as<Record_type>(get_type(a));
-  Record_type* br_type = as<Record_type>(get_type(b));
-
-  Term_seq* vars = new Term_seq();
-  vars->insert(vars->end(), ar_type->members()->begin(), ar_type->members()->end());
-  vars->insert(vars->end(), br_type->members()->begin(), br_type->members()->end());
-
-  Record_type* type = new Record_type(get_kind_type(), vars);
-  return new Record(type, elems);
-}
-
-// Appends table b to the rhs of table a
-// a and b must be a list of Records to work
-// else bad things happen
-List*
-merge_tables(List* a, List* b) {
-  // assume the record type because these are supposed to be tables
-  List_type* al_type = as<List_type>(get_type(a));
-  List_type* bl_type = as<List_type>(get_type(b));
-  Record_type* ar_type = as<Record_type>(al_type->type());
-  Record_type* br_type = as<Record_type>(bl_type->type());
-
-  Term_seq* vars = new Term_seq();
-  vars->insert(vars->end(), ar_type->members()->begin(), ar_type->members()->end());
-  vars->insert(vars->end(), br_type->members()->begin(), br_type->members()->end());
-  Record_type* nr_type = new Record_type(get_kind_type(), vars);
-
-  //merge the individual records in the table
-  Term_seq* rec = new Term_seq();
-  auto it_a = a->elems()->begin();
-  auto it_b = b->elems()->begin();
-  while (it_a != a->elems()->end()) {
-    rec->push_back(merge_records(as<Record>(*it_a), as<Record>(*it_b)));
-    ++it_a;
-    ++it_b;
-  }
-
-  List_type* l_type = new List_type(get_kind_type(), nr_type);
-  List* res = new List(l_type, rec);
-  return res;
+// Evaluate a save term. The table is written to the named file.
+//
+//        t ->* v
+//    ----------------- E-save
+//    save p t ->* unit
+Term*
+eval_save(Save* t) {
+  std::string path = get_file_path(t->path());
+  Table* table = eval_table(t->table());
+  if (not save_table(path, table))
+    lang_unreachable(format("cannot save a table to '{}'", path));
+  return get_unit();
 }
 
-//evaluation for select t1 from t2 where t3
+// Evaluate a CSV source, reading the entire file into a table.
+//
+//    p names a CSV file holding v
+//    ---------------------------- E-csv
+//          csv p T ->* v
 Term*
-eval_select_from_where(Select_from_where* t) {
-  //evaluate the list first
-  List* t2 = as<List>(eval(t->t2));
+eval_csv(Csv* t) {
+  return load_csv(get_file_path(t->path()), get_type(t));
+}
 
-  //new term seq to hold var list for record type
-  Term_seq* cols = new Term_seq();
-  //if its more than one projection operator
-  if (Comma* c = as<Comma>(t->t1)) {
-    for (auto p : *c->elems()) {
-      Mem* m = as<Mem>(p);
-      List* col = as<List>(eval(m));
-      cols->push_back(col);
-    }
-  }
+// Returns a column projection for tables. The column of the result
+// is the column of the projected table; its values are not copied.
+Term*
+eval_col(Term* attr, Table* table) {
+  Ref* member = as<Ref>(attr);
+  Var* v = as<Var>(member->decl());
+  Term_seq* col = find_column(table, v->name());
+  lang_assert(col, format("no column named '{}'", pretty(v->name())));
 
-  //in case its just one projection
-  if (Mem* m = as<Mem>(t->t1)) {
-    cols->push_back(eval(m));
-  }
+  Term_seq* vars = new Term_seq {v};
+  Type* rec_type = get_record_type(vars);
+  Type* type = get_list_type(rec_type);
+  return make_table(type, new Column_seq {col}, table->rows());
+}
 
-  //construct the new table after projection
-  List* n_table = as<List>(*cols->begin());
-  if(cols->size() > 1) {
-    auto it1 = cols->begin() + 1;
-    while (it1 != cols->end()) {
-      n_table = merge_tables(n_table, as<List>(*it1));
-      ++it1;
-    }
-  }
+// Returns the member of a record, or the column of a table, at the
+// index of the member term t (see Mem).
+//
+//    t ->* {l1=v1, ..., ln=vn}
+//    ------------------------- E-mem
+//           t.li ->* vi
+Term*
+eval_mem(Mem* t) {
+  Term* t1 = eval(t->t1);
+  std::size_t i = t->index();
 
-  // t2 should be a Def or a Ref
-  // we cannot have a table with no name here
-  Term* subst;
-  if (Ref* ref = as<Ref>(t->t2))
-    subst = eval(as<Def>(ref->decl()));
-  if (Def* def = as<Def>(t->t2))
-    subst = eval(def);
-
-  // first we need to produce a set of conditions
-  // t3 is not just 1 condition, it is a condition for every record in the list
-  // for each record in t2, we need to substitute the ref t2 in t3 with that record
-  // this gives us a list of conditions which we can evaluate
-  Term_seq* records = t2->elems();
-  Term_seq* conds = new Term_seq();
-  for(auto r : *records) {
-    Subst sub { subst, r };
-    Term* res = subst_term(t->cond(), sub);
-    conds->push_back(res);
+  if (Record* r = as<Record>(t1)) {
+    Init* m = as<Init>((*r->members())[i]);
+    lang_assert(is_same(m->name(), as<Var>(as<Ref>(t->member())->decl())->name()),
+                "record member does not match its index");
+    return as<Term>(m->value());
   }
 
-  // iterate through the table's records and the conditions
-  // if the condition evaluates to true then add the record to result
-  auto cond_it = conds->begin();
-  auto table_it = n_table->elems()->begin();
-  if(conds->size() == n_table->elems()->size()) {
-    Term_seq* sel_rec = new Term_seq();
-    // true
-    Term* _true = get_true();
-    while(cond_it != conds->end()) {
-      //check if the evaluation of the condition is true
-      if(is_same(_true, eval(*cond_it))) {
-        sel_rec->push_back(*table_it);
-      }
-      ++cond_it;
-      ++table_it;
-    }
-    n_table->t1 = sel_rec;
+  if (Table* table = as<Table>(t1)) {
+    Var* v = as<Var>(as<Ref>(t->member())->decl());
+    lang_assert(find_column_index(table, v->name()) == i,
+                "table column does not match its index");
+    Term_seq* vars = new Term_seq {v};
+    Type* type = get_list_type(get_record_type(vars));
+    return make_table(type, new Column_seq {(*table->columns())[i]}, table->rows());
   }
 
-  return eval(n_table);
+  return nullptr;
 }
 
+// Evaluate the column projection t.
 Term*
-eval_join(Join* t) {
-  //evaluate the list first
-  List* t1 = as<List>(eval(t->t1));
-  List* t2 = as<List>(eval(t->t2));
-
-  Term_seq* records1 = t1->elems();
-  Term_seq* records2 = t2->elems();
-
-  //std::cout << "T1" << pretty(t1);
-
-  //merge the individual records in the table
-  Term_seq* crossproduct = new Term_seq();
-  
-
-  //make cross product for t1 and t2
-  for (auto it_a : *records1) {
-    for (auto it_b : *records2) {
-      //std::cout << "MERGE" << pretty(it_a) << "AND" << pretty(it_b) << '\n';
-      crossproduct->push_back(merge_records(as<Record>(it_a), as<Record>(it_b)));
-    }
-  }
-  
-  Term* subst_t1;
-  if (Ref* ref = as<Ref>(t->t1)) {
-    subst_t1 = eval(as<Def>(ref->decl()));
-  }
+eval_col(Col* t) {
+  return eval_col(t->attr(), eval_table(t->table()));
+}
 
-  Term* subst_t2;
-  if (Ref* ref = as<Ref>(t->t2)) {
-    subst_t2 = eval(as<Def>(ref->decl()));
+// An element of a set operation over lists. Set operations over tables
+// are evaluated by query plans (see plan.hpp). The hash of each element
+// is computed once, when the elements are collected.
+struct Elem {
+  Term* term;
+  std::size_t hash;
+};
+
+struct Elem_hash {
+  std::size_t operator()(Elem e) const { return e.hash; }
+};
+
+struct Elem_eq {
+  bool operator()(Elem a, Elem b) const {
+    return a.hash == b.hash and is_same(a.term, b.term);
   }
+};
+
+using Elem_set = std::unordered_set<Elem, Elem_hash, Elem_eq>;
+using Elem_seq = std::vector<Elem>;
+
+// Returns the elements of the list t. Elements are hashed in parallel.
+Elem_seq
+get_elems(Term* t) {
+  Term_seq* ts = as<List>(t)->elems();
+  std::size_t n = ts->size();
+  Elem_seq elems(n);
+  auto hash_elems = [&](std::size_t, std::size_t first, std::size_t last) {
+    for (std::size_t i = first; i < last; ++i)
+      elems[i] = {(*ts)[i], hash_value((*ts)[i])};
+  };
+  get_thread_pool().run(n, hash_elems);
+  return elems;
+}
 
-  
-  Term_seq* conds = new Term_seq();
-  for(auto r : *crossproduct) {
-    // std::cout<<pretty(r)<<std::endl;
-    // std::cout << "SUBST: " << pretty(subst) << " INTO " << pretty(r); 
-    Subst sub1 {subst_t1, r};
-    Subst sub2 {subst_t2, r};
-    Term* res1 = subst_term(t->join_cond(), sub1);
-    Term* res2 = subst_term(res1, sub2);
-    /*
-    Equals* eq = as<Equals>(res);
-    Mem* mem = as<Mem>(eq->t1);
-    Expr* record = as<Ref>(mem->t1)->decl();
-    std::cout << pretty(subst_t2) << '\n';
-    std::cout << pretty(record) << '\n'<<'\n';
-    */
-    //conds->push_back(res1);
-    conds->push_back(res2);
-
-  }
- 
- 
-  Term_seq* result = new Term_seq();
-  auto crossproduct_it = crossproduct->begin();
-  for (auto cond_it : *conds) {
-    Term* _true = get_true();
-    std::cout<<"condition :" << pretty(cond_it) << '\n';
-    if(is_same(_true, eval(cond_it))) {
-        result->push_back(*crossproduct_it);
-    }
-    ++crossproduct_it;
-  }
+// Returns the set of distinct elements.
+Elem_set
+make_elem_set(const Elem_seq& elems) {
+  return Elem_set(elems.begin(), elems.end(), elems.size());
+}
 
-  for (auto it : *result) {
-    std::cout<<pretty(it)<<'\n';
-  }
+// Returns a vector whose ith value is true when the ith element is in
+// the set. Elements are looked up in parallel.
+std::vector<char>
+find_elems(const Elem_seq& elems, const Elem_set& set) {
+  std::vector<char> found(elems.size());
+  auto find = [&](std::size_t, std::size_t first, std::size_t last) {
+    for (std::size_t i = first; i < last; ++i)
+      found[i] = set.count(elems[i]) != 0;
+  };
+  get_thread_pool().run(elems.size(), find);
+  return found;
+}
 
-  //perform product between tables
-  //perform selection of resulting product
-  //perform projection on table
-  //populate new table
-  //ereturn new table
-  //return new List(get_type(result->begin(), result);
-  
-  return nullptr;
+// Returns a list of type t containing the given elements.
+//
+// When the result of a set operation has the same elements as its
+// first operand, that operand is the result, and its elements are not
+// copied.
+Term*
+make_elems(Type* t, const Elem_seq& elems) {
+  Term_seq* u = new Term_seq();
+  u->reserve(elems.size());
+  for (Elem e : elems)
+    u->push_back(e.term);
+  return new List(t, u);
 }
 
+// Evaluation for 't1 intersect t2'. The result contains the distinct
+// elements of t1 that are also elements of t2, in the order of t1.
+//
+// Assume t1 and t2 are both lists or both tables.
 Term*
 eval_intersect(Intersect* t) {
-  //eval t1
+  if (is_plan_term(t))
+    return eval_plan(t);
   Term* t1 = eval(t->t1);
-  Term_seq* e1 = as<List>(t1)->elems();
-  //eval t2
   Term* t2 = eval(t->t2);
-  Term_seq* e2 = as<List>(t2)->elems();
-  //perform intersect
-  Term_seq* u = new Term_seq();
-  for(auto re1 : *e1) {
-    bool contained = false;
-    for(auto re2: *e2) {
-      if(is_same(re1, re2)) {
-        contained = true;
-        break;
-      }
-    }
-    if(contained)
-      u->push_back(re1);
-  }
 
-  //remove duplicates
-  return new List(get_type(t1), u);
+  Elem_seq e1 = get_elems(t1);
+  std::vector<char> found = find_elems(e1, make_elem_set(get_elems(t2)));
+  Elem_set seen;
+  Elem_seq u;
+  for (std::size_t i = 0; i < e1.size(); ++i) {
+    if (found[i] and seen.insert(e1[i]).second)
+      u.push_back(e1[i]);
+  }
+  if (u.size() == e1.size())
+    return t1;
+  return make_elems(get_type(t1), u);
 }
 
-//Assum t1 and t2 are both lists
+// Evaluation for 't1 union t2'. The result contains the distinct
+// elements of t1 followed by those of t2, each in its first position.
+//
+// Assume t1 and t2 are both lists or both tables.
 Term*
 eval_union(Union* t) {
-  //eval t1
+  if (is_plan_term(t))
+    return eval_plan(t);
   Term* t1 = eval(t->t1);
-  Term_seq* e1 = as<List>(t1)->elems();
-  //eval t2
   Term* t2 = eval(t->t2);
-  Term_seq* e2 = as<List>(t2)->elems();
 
-  //perform union
-  Term_seq* u = new Term_seq();
-  u->assign(e1->begin(), e1->end());
-  for(auto e0 : *e2) {
-    bool contained = false;
-    for(auto elem : *u) {
-      //if we find it in the union set already break
-      if(is_same(e0, elem)) {
-        contained = true;
-        break;
-      } 
-    }
-    if(!contained)
-      u->push_back(e0);
+  Elem_set seen;
+  seen.reserve(as<List>(t1)->elems()->size() + as<List>(t2)->elems()->size());
+  Elem_seq u;
+  for (Elem e : get_elems(t1)) {
+    if (seen.insert(e).second)
+      u.push_back(e);
+  }
+  std::size_t n = u.size(); // The distinct elements of t1
+  for (Elem e : get_elems(t2)) {
+    if (seen.insert(e).second)
+      u.push_back(e);
   }
-  return new List(get_type(t1), u);
+  if (u.size() == n and n == as<List>(t1)->elems()->size())
+    return t1;
+  return make_elems(get_type(t1), u);
 }
 
-//Assume t1 and t2 are both lists
+// Evaluation for 't1 except t2'. The result contains the distinct
+// elements of t1 that are not elements of t2, in the order of t1.
+//
+// Assume t1 and t2 are both lists or both tables.
 Term*
 eval_except(Except* t) {
-  //eval t1
+  if (is_plan_term(t))
+    return eval_plan(t);
   Term* t1 = eval(t->t1);
-  Term_seq* e1 = as<List>(t1)->elems();
-  //eval t2
   Term* t2 = eval(t->t2);
-  Term_seq* e2 = as<List>(t2)->elems();
-  //perform except
-  Term_seq* u = new Term_seq();
-  for(auto re1 : *e1) {
-    bool contained = false;
-    for(auto re2: *e2) {
-      if(is_same(re1, re2)) {
-        contained = true;
-        break;
-      }
-    }
-    if(!contained)
-      u->push_back(re1);
+
+  Elem_seq e1 = get_elems(t1);
+  std::vector<char> found = find_elems(e1, make_elem_set(get_elems(t2)));
+  Elem_set seen;
+  Elem_seq u;
+  for (std::size_t i = 0; i < e1.size(); ++i) {
+    if (not found[i] and seen.insert(e1[i]).second)
+      u.push_back(e1[i]);
   }
+  if (u.size() == e1.size())
+    return t1;
+  return make_elems(get_type(t1), u);
+}
+
+} // namespace
 
-  //remove duplicates
-  return new List(get_type(t1), u);
+// Evaluate the term t, which must have table type, to a table. A
+// table named by 't as x' is a definition whose value is the table.
+Table*
+eval_table(Term* t) {
+  Term* t1 = eval(t);
+  if (Def* def = as<Def>(t1))
+    t1 = as<Term>(def->value());
+  Table* table = as<Table>(t1);
+  lang_assert(table, format("'{}' is not a table", pretty(t1)));
+  return table;
 }
 
+// -------------------------------------------------------------------------- //
+// Evaluation rules
+//
+// The rule for each kind of term is found in a table indexed by kind
+// (see Node_table in lang/nodes.hpp). A rule in tail position returns
+// the term to be evaluated next instead of a value. Applications and
+// queries are recorded in the profile frame of the evaluation.
+
+namespace {
+
+struct Eval_rule {
+  Term* (*fn)(Term*);
+  bool tail;  // True if the result is evaluated next
+  bool frame; // True if the term is recorded in the profile frame
+};
+
+Term*
+eval_unknown(Term* t) {
+  lang_unreachable(format("evaluation of unknown term '{}'", node_name(t)));
+}
+
+Node_table<Eval_rule> eval_rules_({eval_unknown, false, false});
+
+// A value evaluates to itself.
+Term*
+eval_value(Term* t) { return t; }
+
+Term*
+eval_query(Term* t) { return eval_plan(t); }
+
+template<typename T, Term* (*F)(T*)>
+  Term*
+  eval_node(Term* t) { return F(static_cast<T*>(t)); }
+
+// Define the rule for terms of type T.
+template<typename T, Term* (*F)(T*)>
+  inline void
+  define_eval(bool tail = false, bool frame = false) {
+    eval_rules_.define(T::node_kind, {eval_node<T, F>, tail, frame});
+  }
+
+template<typename T>
+  inline void
+  define_value() {
+    eval_rules_.define(T::node_kind, {eval_value, false, false});
+  }
+
 } // namespace
 
-// Compute the multi-step evaluation of the term t. 
+// Initialize the evaluation rules. Every kind of term has a rule.
+void
+init_eval() {
+  define_eval<If, eval_if>(true);
+  define_eval<App, eval_app>(true, true);
+  define_eval<Call, eval_call>(true, true);
+  define_eval<Prog, eval_prog>(true);
+  define_eval<And, eval_and>(true);
+  define_eval<Or, eval_or>(true);
+  define_eval<Not, eval_not>();
+  define_eval<Equals, eval_equals>();
+  define_eval<Less, eval_less>();
+  define_eval<Succ, eval_succ>();
+  define_eval<Pred, eval_pred>();
+  define_eval<Iszero, eval_iszero>();
+  define_eval<Ref, eval_ref>();
+  define_eval<Print, eval_print>();
+  define_eval<Load, eval_load>();
+  define_eval<Save, eval_save>();
+  define_eval<Csv, eval_csv>();
+  define_eval<Def, eval_def>();
+  define_eval<Comma, eval_comma>();
+  define_eval<List, eval_list>();
+  define_eval<Proj, eval_proj>();
+  define_eval<Mem, eval_mem>();
+  define_eval<Col, eval_col>();
+  define_eval<Union, eval_union>();
+  define_eval<Intersect, eval_intersect>();
+  define_eval<Except, eval_except>();
+  eval_rules_.define(select_term, {eval_query, false, true});
+  eval_rules_.define(join_on_term, {eval_query, false, true});
+  eval_rules_.define(group_term, {eval_query, false, true});
+  eval_rules_.define(order_term, {eval_query, false, true});
+  // Aggregates are evaluated by the plan of their grouped selection.
+  eval_rules_.define(agg_term, {eval_unknown, false, false});
+  define_value<Unit>();
+  define_value<True>();
+  define_value<False>();
+  define_value<Int>();
+  define_value<Str>();
+  define_value<Var>();
+  define_value<Abs>();
+  define_value<Fn>();
+  define_value<Closure>();
+  define_value<Tuple>();
+  define_value<Record>();
+  define_value<Init>();
+  define_value<Table>();
+  // No variant terms are constructed.
+  eval_rules_.define(variant_term, {eval_unknown, false, false});
+  eval_rules_.check(term_class, "evaluation");
+}
+
+// Compute the multi-step evaluation of the term t. Terms in tail
+// position are evaluated by iterating, not by recursion, so that a
+// chain of tail calls runs in constant native stack.
 Term*
 eval(Term* t) {
-  switch (t->kind) {
-  case if_term: return eval_if(as<If>(t));
-  case and_term: return eval_and(as<And>(t));
-  case or_term: return eval_or(as<Or>(t));
-  case not_term: return eval_not(as<Not>(t));
-  case equals_term: return eval_equals(as<Equals>(t));
-  case less_term: return eval_less(as<Less>(t));
-  case succ_term: return eval_succ(as<Succ>(t));
-  case pred_term: return eval_pred(as<Pred>(t));
-  case iszero_term: return eval_iszero(as<Iszero>(t));
-  case app_term: return eval_app(as<App>(t));
-  case call_term: return eval_call(as<Call>(t));
-  case ref_term: return eval_ref(as<Ref>(t));
-  case print_term: return eval_print(as<Print>(t));
-  case def_term: return eval_def(as<Def>(t));
-  case prog_term: return eval_prog(as<Prog>(t));
-  case comma_term: return eval_comma(as<Comma>(t));
-  case proj_term: return eval_proj(as<Proj>(t));
-  case mem_term: return eval_mem(as<Mem>(t));
-  //case col_term: return eval_col(as<Col>(t));
-  case select_term: return eval_select_from_where(as<Select_from_where>(t));
-  case join_on_term: return eval_join(as<Join>(t));
-  case union_term: return eval_union(as<Union>(t));
-  case intersect_term: return eval_intersect(as<Intersect>(t));
-  case except_term: return eval_except(as<Except>(t));
-  default: break;
+  Profile_frame frame;
+  while (true) {
+    count_eval(t->kind);
+    const Eval_rule& r = eval_rules_[t->kind];
+    if (r.frame)
+      frame.enter(t);
+    t = r.fn(t);
+    if (not r.tail)
+      return t;
   }
-  return t;
 }
 
 
@@ -2,22 +2,86 @@
 #ifndef EVAL_HPP
 #define EVAL_HPP
 
-#include "lang/error.hpp"
+#include "lang/context.hpp"
+
+#include <vector>
 
 // This module defines the interface to the evaluation rules of
 // the programming language.
 
 struct Term;
+struct Def;
+struct Code;
+struct Compiler;
+struct Output;
+
+// The evaluation strategies supported by the evaluator. The
+// substitution engine rewrites terms by copying and substituting
+// arguments into the bodies of abstractions. The environment engine
+// binds arguments in an environment instead (see env.hpp). The
+// virtual machine engine compiles terms into bytecode before running
+// them (see vm.hpp).
+enum Engine {
+  subst_engine,
+  env_engine,
+  vm_engine,
+};
 
 // The evaluator class is the primary interface for evaluating
-// terms. Note that it keeps its own 
+// terms. Note that it keeps its own context, diagnostics and arena.
+// The terms computed during evaluation are destroyed with the
+// evaluator.
+//
+// With the virtual machine engine, a term can be compiled separately
+// from its evaluation. The compiled code is owned by the evaluator.
+//
+// When the global thread pool has more than one thread, independent
+// statements of a program are evaluated concurrently (see sched.hpp).
+// The evaluator keeps an additional arena for each thread of the pool.
+// Under a fuel limit, compiled code is instead run as a single task,
+// which fails once it has spent its fuel (see Task in vm.hpp).
+//
+// Printed values are written to the output sink of the evaluator,
+// which is the standard output unless another sink is given. The sink
+// is flushed when an evaluation returns (see output.hpp).
 struct Evaluator {
+  Evaluator(Engine e = subst_engine, Output* o = nullptr);
+  ~Evaluator();
+
+  Evaluator(const Evaluator&) = delete;
+  Evaluator& operator=(const Evaluator&) = delete;
+
   Term* operator()(Term*);
+  Term* operator()(Code*);
 
+  Code* compile(Term*);
+
+  std::size_t allocated() const;
+
+  Engine engine;
   Diagnostics diags;
+  Arena arena;
+  Context cxt;
+  std::vector<Arena*> arenas;
+  Compiler* comp;
+  Output* out;
 };
 
+struct Table;
+
 Term* step(Term*);
 Term* eval(Term*);
+Table* eval_table(Term*);
+
+// In lazy mode, definitions are evaluated by need: the value of a
+// definition is computed when it is first referenced, by the engine
+// that evaluated the definition, and is then kept (see Def in
+// ast.hpp). A definition that is never referenced is never evaluated.
+// Only pure definitions are delayed: a definition with effects (e.g.,
+// one that prints, or reads a table) is evaluated in program order.
+// Lazy mode is set before evaluation starts.
+void set_lazy_defs(bool);
+bool lazy_defs();
+bool is_lazy_def(Def*);
 
 #endif
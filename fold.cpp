@@ -0,0 +1,328 @@
+#include "fold.hpp"
+#include "sched.hpp"
+#include "type.hpp"
+#include "value.hpp"
+
+#include "lang/debug.hpp"
+
+#include <unordered_map>
+
+namespace {
+
+// Apply f to each subterm of e, in place. The parameters of
+// abstractions, the members named by projections, and types are not
+// subterms in this sense.
+template<typename F>
+  void
+  for_each_subterm(Expr* e, F& f) {
+    switch (e->kind) {
+    case if_term: {
+      If* t = as<If>(e);
+      f(t->t1);
+      f(t->t2);
+      f(t->t3);
+      return;
+    }
+    case and_term: f(as<And>(e)->t1); f(as<And>(e)->t2); return;
+    case or_term: f(as<Or>(e)->t1); f(as<Or>(e)->t2); return;
+    case equals_term: f(as<Equals>(e)->t1); f(as<Equals>(e)->t2); return;
+    case less_term: f(as<Less>(e)->t1); f(as<Less>(e)->t2); return;
+    case not_term: f(as<Not>(e)->t1); return;
+    case succ_term: f(as<Succ>(e)->t1); return;
+    case pred_term: f(as<Pred>(e)->t1); return;
+    case iszero_term: f(as<Iszero>(e)->t1); return;
+    case abs_term: f(as<Abs>(e)->t2); return;
+    case fn_term: f(as<Fn>(e)->t2); return;
+    case app_term: f(as<App>(e)->t1); f(as<App>(e)->t2); return;
+    case call_term: {
+      Call* t = as<Call>(e);
+      f(t->t1);
+      for (Term*& a : *t->args())
+        f(a);
+      return;
+    }
+    case def_term: f(as<Def>(e)->t2); return;
+    case init_term: f(as<Init>(e)->t2); return;
+    case tuple_term:
+      for (Term*& t : *as<Tuple>(e)->elems())
+        f(t);
+      return;
+    case list_term:
+      for (Term*& t : *as<List>(e)->elems())
+        f(t);
+      return;
+    case record_term:
+      for (Term*& t : *as<Record>(e)->members())
+        f(t);
+      return;
+    case comma_term:
+      for (Expr*& t : *as<Comma>(e)->elems())
+        f(t);
+      return;
+    case proj_term: f(as<Proj>(e)->t1); return;
+    case mem_term: f(as<Mem>(e)->t1); return;
+    case col_term: f(as<Col>(e)->t1); return;
+    case save_term: f(as<Save>(e)->t2); return;
+    case print_term: f(as<Print>(e)->t1); return;
+    case prog_term:
+      for (Term*& t : *as<Prog>(e)->stmts())
+        f(t);
+      return;
+    case select_term: {
+      Select_from_where* t = as<Select_from_where>(e);
+      f(t->t2);
+      f(t->t3);
+      return;
+    }
+    case group_term: {
+      Group_by* t = as<Group_by>(e);
+      f(t->t2);
+      f(t->t3);
+      return;
+    }
+    case order_term: {
+      Order_by* t = as<Order_by>(e);
+      f(t->t1);
+      if (t->t3)
+        f(t->t3);
+      return;
+    }
+    case join_on_term: {
+      Join* t = as<Join>(e);
+      f(t->t1);
+      f(t->t2);
+      f(t->t3);
+      return;
+    }
+    case union_term: f(as<Union>(e)->t1); f(as<Union>(e)->t2); return;
+    case intersect_term: f(as<Intersect>(e)->t1); f(as<Intersect>(e)->t2); return;
+    case except_term: f(as<Except>(e)->t1); f(as<Except>(e)->t2); return;
+    default: return;
+    }
+  }
+
+// Returns true if the term e is pure (see find_deps). The definitions
+// that e refers to are searched as part of e, so a term that calls a
+// function that prints is not pure, nor is a reference to a table read
+// from a file.
+inline bool
+is_pure(Expr* e) {
+  Stmt_seq deps;
+  std::vector<Def*> defs;
+  return find_deps(e, Def_map(), deps, &defs);
+}
+
+// Counts the references to each definition.
+struct Ref_count {
+  template<typename T>
+    void operator()(T* e) {
+      if (Ref* r = as<Ref>(e)) {
+        if (Def* d = as<Def>(r->decl()))
+          ++counts[d];
+        return;
+      }
+      for_each_subterm(e, *this);
+    }
+
+  std::unordered_map<Def*, std::size_t> counts;
+};
+
+// Returns true if t is a literal value of a scalar type.
+inline bool
+is_literal(Expr* t) {
+  switch (t->kind) {
+  case unit_term:
+  case true_term:
+  case false_term:
+  case int_term:
+  case str_term:
+    return true;
+  default:
+    return false;
+  }
+}
+
+inline Term*
+get_bool(bool b) { return b ? get_true() : get_false(); }
+
+// Fold the condition of an if term.
+//
+//    if true then t2 else t3 => t2
+//    if false then t2 else t3 => t3
+Term*
+fold_if(If* t) {
+  if (is_true(t->cond()))
+    return t->if_true();
+  if (is_false(t->cond()))
+    return t->if_false();
+  return t;
+}
+
+// Fold a conjunction. When an operand is false, the other operand is
+// discarded only if it is pure.
+//
+//    true and t => t
+//    t and true => t
+//    false and t => false
+//    t and false => false
+Term*
+fold_and(And* t) {
+  if (is_true(t->t1))
+    return t->t2;
+  if (is_true(t->t2))
+    return t->t1;
+  if (is_false(t->t1) and is_pure(t->t2))
+    return t->t1;
+  if (is_false(t->t2) and is_pure(t->t1))
+    return t->t2;
+  return t;
+}
+
+// Fold a disjunction. This is the dual of fold_and.
+//
+//    false or t => t
+//    t or false => t
+//    true or t => true
+//    t or true => true
+Term*
+fold_or(Or* t) {
+  if (is_false(t->t1))
+    return t->t2;
+  if (is_false(t->t2))
+    return t->t1;
+  if (is_true(t->t1) and is_pure(t->t2))
+    return t->t1;
+  if (is_true(t->t2) and is_pure(t->t1))
+    return t->t2;
+  return t;
+}
+
+Term*
+fold_not(Not* t) {
+  if (is_true(t->t1))
+    return get_false();
+  if (is_false(t->t1))
+    return get_true();
+  return t;
+}
+
+Term*
+fold_equals(Equals* t) {
+  if (is_literal(t->t1) and is_literal(t->t2))
+    return get_bool(is_same(t->t1, t->t2));
+  return t;
+}
+
+Term*
+fold_less(Less* t) {
+  if (is_literal(t->t1) and is_literal(t->t2))
+    return get_bool(is_less(t->t1, t->t2));
+  return t;
+}
+
+Term*
+fold_succ(Succ* t) {
+  if (Int* n = as<Int>(t->t1))
+    return new Int(t->loc, get_type(t), n->value() + 1);
+  return t;
+}
+
+// The predecessor of 0 is 0.
+Term*
+fold_pred(Pred* t) {
+  if (Int* n = as<Int>(t->t1)) {
+    if (n->value() == 0)
+      return n;
+    return new Int(t->loc, get_type(t), n->value() - 1);
+  }
+  return t;
+}
+
+Term*
+fold_iszero(Iszero* t) {
+  if (Int* n = as<Int>(t->t1))
+    return get_bool(n->value() == 0);
+  return t;
+}
+
+// A reference to a definition whose value is a literal is replaced
+// by that literal.
+Term*
+fold_ref(Ref* t) {
+  if (Def* d = as<Def>(t->decl()))
+    if (is_literal(d->value()))
+      return as<Term>(d->value());
+  return t;
+}
+
+// Returns true if e is a tuple, list, record, or comma term. The
+// elements of these terms are not evaluated (see eval_list), and so
+// they are not folded.
+inline bool
+is_data(Expr* e) {
+  switch (e->kind) {
+  case tuple_term:
+  case list_term:
+  case record_term:
+  case comma_term:
+    return true;
+  default:
+    return false;
+  }
+}
+
+// Folds each subterm in place.
+struct Folder {
+  void operator()(Term*& t) { t = as<Term>(fold(t)); }
+  void operator()(Expr*& e) { e = fold(e); }
+};
+
+} // namespace
+
+// Returns the folding of the expression e. The subterms of e are folded
+// first, so that the simplification of e sees their values.
+Expr*
+fold(Expr* e) {
+  if (not is_data(e)) {
+    Folder f;
+    for_each_subterm(e, f);
+  }
+  switch (e->kind) {
+  case if_term: return fold_if(as<If>(e));
+  case and_term: return fold_and(as<And>(e));
+  case or_term: return fold_or(as<Or>(e));
+  case not_term: return fold_not(as<Not>(e));
+  case equals_term: return fold_equals(as<Equals>(e));
+  case less_term: return fold_less(as<Less>(e));
+  case succ_term: return fold_succ(as<Succ>(e));
+  case pred_term: return fold_pred(as<Pred>(e));
+  case iszero_term: return fold_iszero(as<Iszero>(e));
+  case ref_term: return fold_ref(as<Ref>(e));
+  default: return e;
+  }
+}
+
+// Returns the folding of the program e, without the definitions that
+// are no longer referenced.
+Expr*
+fold_program(Expr* e) {
+  Prog* p = as<Prog>(fold(e));
+  if (not p)
+    return e;
+  Ref_count refs;
+  refs(p);
+  Term_seq* ss = p->stmts();
+  std::size_t n = 0;
+  for (std::size_t i = 0; i < ss->size(); ++i) {
+    Term* s = (*ss)[i];
+    if (Def* d = as<Def>(s)) {
+      bool last = i + 1 == ss->size();
+      if (not last and is<Term>(d->value()) and not refs.counts.count(d)
+          and is_pure(d))
+        continue;
+    }
+    (*ss)[n++] = s;
+  }
+  ss->resize(n);
+  return p;
+}
@@ -0,0 +1,28 @@
+#ifndef FOLD_HPP
+#define FOLD_HPP
+
+#include "ast.hpp"
+
+// -------------------------------------------------------------------------- //
+// Constant folding
+//
+// This module simplifies elaborated terms before they are evaluated.
+// Operations whose operands are literals are replaced by their values
+// (e.g., 'succ succ 0' becomes 2), references to definitions whose
+// values are literals are replaced by those literals, and conditional
+// and logical terms whose operands are known are reduced (e.g., 'true
+// and x' becomes x). Each simplification is an evaluation step of the
+// language, so a folded term evaluates to the same value as the term
+// it replaces. An operand is discarded only when it is pure: neither it
+// nor the definitions it refers to (e.g., the functions it calls)
+// print, save, or read a table.
+//
+// Terms are folded in place, since a definition must keep its identity
+// for the references to it. A folded program also drops definitions of
+// terms that are pure and no longer referenced. The last statement of a
+// program is kept, since its value is the value of the program.
+
+Expr* fold(Expr*);
+Expr* fold_program(Expr*);
+
+#endif
@@ -0,0 +1,140 @@
+
+#include "ast.hpp"
+
+#include "lang/debug.hpp"
+
+#include <functional>
+
+// -------------------------------------------------------------------------- //
+// Hashing
+//
+// The hash function computes a structural hash of values. It agrees
+// with the same-term relation: whenever is_same(a, b) holds, a and b
+// have the same hash value. This allows values to be used as keys in
+// unordered containers (e.g., the build side of a hash join).
+
+namespace {
+
+inline std::size_t
+hash_combine(std::size_t seed, std::size_t h) {
+  return seed ^ (h + 0x9e3779b9 + (seed << 6) + (seed >> 2));
+}
+
+inline std::size_t
+hash_value(String s) { return std::hash<String>()(s); }
+
+// The hash of a term whose operands are compared by is_same combines
+// its kind with the hash of each operand, in order. These are the
+// terms that remain unevaluated in the cells of lists and records
+// (e.g., 'succ 3').
+template<typename T>
+  inline std::size_t
+  hash_unary(T* t) { return hash_combine(t->kind, hash_value(t->t1)); }
+
+template<typename T>
+  inline std::size_t
+  hash_binary(T* t) { return hash_combine(hash_unary(t), hash_value(t->t2)); }
+
+template<typename T>
+  inline std::size_t
+  hash_ternary(T* t) { return hash_combine(hash_binary(t), hash_value(t->t3)); }
+
+// The hash of a variable combines its name and type.
+inline std::size_t
+hash_var(Var* t) {
+  std::size_t h = hash_value(t->name());
+  return hash_combine(h, hash_value(t->type()));
+}
+
+// References are the same when they refer to the same declaration, and
+// composite types are interned, so both are hashed by their identity.
+inline std::size_t
+hash_identity(const void* p) { return std::hash<const void*>()(p); }
+
+// The hash of an initializer combines its name and value.
+inline std::size_t
+hash_init(Init* t) {
+  std::size_t h = hash_value(t->name());
+  return hash_combine(h, hash_value(t->value()));
+}
+
+// The hash of a record combines the hash of each member in order.
+inline std::size_t
+hash_record(Record* t) {
+  std::size_t h = t->kind;
+  for (Term* m : *t->members())
+    h = hash_combine(h, hash_value(m));
+  return h;
+}
+
+// The hash of a sequence combines the hash of each element in order.
+inline std::size_t
+hash_seq(Node_kind k, Term_seq* ts) {
+  std::size_t h = k;
+  for (Term* t : *ts)
+    h = hash_combine(h, hash_value(t));
+  return h;
+}
+
+// The hash of a table combines the hash of each row in order.
+inline std::size_t
+hash_table(Table* t) {
+  std::size_t h = t->kind;
+  for (std::size_t i = 0; i < t->rows(); ++i)
+    h = hash_combine(h, hash_row(t, i));
+  return h;
+}
+
+} // namespace
+
+// Returns the hash of the ith row of the table t. This is the same
+// as the hash of that row as a record.
+std::size_t
+hash_row(Table* t, std::size_t i) {
+  Term_seq* vars = as<Record_type>(as<List_type>(t->tr)->type())->members();
+  std::size_t h = record_term;
+  for (std::size_t j = 0; j < vars->size(); ++j) {
+    std::size_t m = hash_value(as<Var>((*vars)[j])->name());
+    m = hash_combine(m, hash_value((*(*t->columns())[j])[i]));
+    h = hash_combine(h, m);
+  }
+  return h;
+}
+
+std::size_t
+hash_value(Expr* e) {
+  switch (e->kind) {
+  case id_expr: return hash_value(as<Id>(e)->t1);
+  case unit_term: return e->kind;
+  case true_term: return e->kind;
+  case false_term: return e->kind;
+  case int_term: return std::hash<Integer>()(as<Int>(e)->value());
+  case str_term: return hash_value(as<Str>(e)->value());
+  case init_term: return hash_init(as<Init>(e));
+  case record_term: return hash_record(as<Record>(e));
+  case tuple_term: return hash_seq(e->kind, as<Tuple>(e)->elems());
+  case list_term: return hash_seq(e->kind, as<List>(e)->elems());
+  case table_term: return hash_table(as<Table>(e));
+  case if_term: return hash_ternary(as<If>(e));
+  case succ_term: return hash_unary(as<Succ>(e));
+  case pred_term: return hash_unary(as<Pred>(e));
+  case iszero_term: return hash_unary(as<Iszero>(e));
+  case abs_term: return hash_binary(as<Abs>(e));
+  case app_term: return hash_binary(as<App>(e));
+  case var_term: return hash_var(as<Var>(e));
+  case ref_term: return hash_identity(as<Ref>(e)->decl());
+  case kind_type:
+  case unit_type:
+  case bool_type:
+  case nat_type:
+  case str_type: return e->kind;
+  case arrow_type:
+  case fn_type:
+  case tuple_type:
+  case list_type:
+  case record_type:
+  case wild_type: return hash_identity(e);
+  default: break;
+  }
+  lang_unreachable(format("hashing unknown node '{}'", node_name(e)));
+}
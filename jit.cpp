@@ -0,0 +1,526 @@
+#include "jit.hpp"
+#include "type.hpp"
+#include "value.hpp"
+
+#include "lang/debug.hpp"
+
+#if WAFFLE_JIT
+#  include <llvm/ExecutionEngine/Orc/LLJIT.h>
+#  include <llvm/IR/IRBuilder.h>
+#  include <llvm/IR/Intrinsics.h>
+#  include <llvm/IR/LLVMContext.h>
+#  include <llvm/IR/Module.h>
+#  include <llvm/IR/Verifier.h>
+#  include <llvm/Passes/PassBuilder.h>
+#  include <llvm/Support/TargetSelect.h>
+#endif
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace {
+
+std::size_t jit_threshold_ = 0;
+
+} // namespace
+
+void
+set_jit_threshold(std::size_t n) { jit_threshold_ = n; }
+
+std::size_t
+get_jit_threshold() { return jit_threshold_; }
+
+#if WAFFLE_JIT
+
+// The largest number of parameters of a kernel.
+constexpr std::size_t max_native_parms = 16;
+
+// The native code of a kernel is called with its arguments, and stores
+// its result. It returns false if the computation overflows.
+using Native_entry = bool (*)(const std::int64_t*, std::int64_t*);
+
+struct Native_fn {
+  Native_entry      entry;
+  std::size_t       parms;  // The number of parameters
+  bool              bool_result;
+  Location          loc;    // The location of the body
+};
+
+namespace {
+
+// -------------------------------------------------------------------------- //
+// Kernels
+
+// Returns true if values of type t can be represented in native code.
+inline bool
+is_kernel_type(Type* t) {
+  return is_nat_type(t) or is_bool_type(t);
+}
+
+// Returns the parameters of the abstraction or function f.
+Term_seq
+get_parms(Term* f) {
+  if (Abs* abs = as<Abs>(f))
+    return {abs->var()};
+  return *as<Fn>(f)->parms();
+}
+
+// Returns the body of the abstraction or function f.
+inline Term*
+get_body(Term* f) {
+  if (Abs* abs = as<Abs>(f))
+    return abs->term();
+  return as<Fn>(f)->term();
+}
+
+// Returns the abstraction or function named by the definition referred
+// to by t, or nullptr if t does not name one. Kernels do not refer to
+// the environment of a closure.
+Term*
+get_kernel_callee(Term* t) {
+  Ref* ref = as<Ref>(t);
+  Def* def = ref ? as<Def>(ref->decl()) : nullptr;
+  Term* v = def ? as<Term>(def->value()) : nullptr;
+  if (Closure* c = as<Closure>(v))
+    v = c->fn();
+  if (is<Abs>(v) or is<Fn>(v))
+    return v;
+  return nullptr;
+}
+
+// -------------------------------------------------------------------------- //
+// Code generation
+//
+// Each kernel is emitted as a function taking its arguments as 64-bit
+// integers (booleans are 0 or 1), and a pointer to a flag that is set
+// when the computation overflows; the result is then meaningless. A
+// call to another kernel is a call to its function, which is emitted
+// in the same module, so that it can be inlined.
+
+struct Emitter {
+  Emitter(llvm::LLVMContext& c, llvm::Module& m)
+    : cxt(c), mod(m), b(c) { }
+
+  llvm::Function* get_fn(Term*);
+
+  llvm::Value* emit(Term*);
+  llvm::Value* emit_ref(Ref*);
+  llvm::Value* emit_succ(Succ*);
+  llvm::Value* emit_cond(Term*, Term*, Term*);
+  llvm::Value* emit_call(Term*, const Term_seq&);
+
+  llvm::BasicBlock* get_fail();
+
+  llvm::LLVMContext& cxt;
+  llvm::Module& mod;
+  llvm::IRBuilder<> b;
+
+  // The functions of the kernels emitted so far. The entry of a kernel
+  // being emitted is null, so that it cannot be called.
+  std::unordered_map<Term*, llvm::Function*> fns;
+
+  // The function being emitted.
+  llvm::Function* fn = nullptr;
+  std::unordered_map<Expr*, llvm::Value*> parms;
+  llvm::BasicBlock* fail = nullptr;
+};
+
+// Returns the function of the kernel f, emitting it if needed, or
+// nullptr if f is not a kernel.
+llvm::Function*
+Emitter::get_fn(Term* f) {
+  auto iter = fns.find(f);
+  if (iter != fns.end())
+    return iter->second;
+  fns[f] = nullptr;
+
+  Term_seq vars = get_parms(f);
+  Term* body = get_body(f);
+  if (vars.size() > max_native_parms or not is_kernel_type(get_type(body)))
+    return nullptr;
+  for (Term* v : vars)
+    if (not is_kernel_type(as<Var>(v)->type()))
+      return nullptr;
+
+  // Save the state of the function being emitted, if any.
+  llvm::Function* outer = fn;
+  std::unordered_map<Expr*, llvm::Value*> outer_parms;
+  std::swap(parms, outer_parms);
+  llvm::BasicBlock* outer_fail = fail;
+  llvm::IRBuilderBase::InsertPoint outer_ip = b.saveIP();
+
+  std::vector<llvm::Type*> types(vars.size(), b.getInt64Ty());
+  types.push_back(llvm::PointerType::getUnqual(b.getInt1Ty()));
+  llvm::FunctionType* type = llvm::FunctionType::get(b.getInt64Ty(), types, false);
+  fn = llvm::Function::Create(type, llvm::Function::InternalLinkage, "kernel", &mod);
+  for (std::size_t i = 0; i < vars.size(); ++i)
+    parms[vars[i]] = fn->getArg(i);
+  fail = nullptr;
+  b.SetInsertPoint(llvm::BasicBlock::Create(cxt, "entry", fn));
+  llvm::Value* v = emit(body);
+  llvm::Function* result = fn;
+  if (v) {
+    b.CreateRet(v);
+  } else {
+    fn->eraseFromParent();
+    result = nullptr;
+  }
+
+  fn = outer;
+  std::swap(parms, outer_parms);
+  fail = outer_fail;
+  b.restoreIP(outer_ip);
+  return fns[f] = result;
+}
+
+// Returns the block that sets the overflow flag and returns.
+llvm::BasicBlock*
+Emitter::get_fail() {
+  if (not fail) {
+    llvm::IRBuilderBase::InsertPoint ip = b.saveIP();
+    fail = llvm::BasicBlock::Create(cxt, "fail", fn);
+    b.SetInsertPoint(fail);
+    b.CreateStore(b.getTrue(), fn->getArg(fn->arg_size() - 1));
+    b.CreateRet(b.getInt64(0));
+    b.restoreIP(ip);
+  }
+  return fail;
+}
+
+// Returns the value of the term t, or nullptr if t cannot be compiled.
+llvm::Value*
+Emitter::emit(Term* t) {
+  switch (t->kind) {
+  case true_term:
+    return b.getInt64(1);
+
+  case false_term:
+    return b.getInt64(0);
+
+  case int_term: {
+    const Integer& n = as<Int>(t)->value();
+    if (not n.is_small() or n.word() < 0)
+      return nullptr;
+    return b.getInt64(n.word());
+  }
+
+  case ref_term:
+    return emit_ref(as<Ref>(t));
+
+  case succ_term:
+    return emit_succ(as<Succ>(t));
+
+  case pred_term: {
+    llvm::Value* x = emit(as<Pred>(t)->arg());
+    if (not x)
+      return nullptr;
+    llvm::Value* zero = b.CreateICmpEQ(x, b.getInt64(0));
+    return b.CreateSelect(zero, x, b.CreateSub(x, b.getInt64(1)));
+  }
+
+  case iszero_term: {
+    llvm::Value* x = emit(as<Iszero>(t)->arg());
+    if (not x)
+      return nullptr;
+    return b.CreateZExt(b.CreateICmpEQ(x, b.getInt64(0)), b.getInt64Ty());
+  }
+
+  case equals_term: {
+    Equals* e = as<Equals>(t);
+    if (not is_kernel_type(get_type(e->t1)))
+      return nullptr;
+    llvm::Value* x = emit(e->t1);
+    llvm::Value* y = x ? emit(e->t2) : nullptr;
+    if (not y)
+      return nullptr;
+    return b.CreateZExt(b.CreateICmpEQ(x, y), b.getInt64Ty());
+  }
+
+  case less_term: {
+    Less* e = as<Less>(t);
+    if (not is_nat_type(get_type(e->t1)))
+      return nullptr;
+    llvm::Value* x = emit(e->t1);
+    llvm::Value* y = x ? emit(e->t2) : nullptr;
+    if (not y)
+      return nullptr;
+    return b.CreateZExt(b.CreateICmpULT(x, y), b.getInt64Ty());
+  }
+
+  case not_term: {
+    llvm::Value* x = emit(as<Not>(t)->t1);
+    if (not x)
+      return nullptr;
+    return b.CreateXor(x, b.getInt64(1));
+  }
+
+  // The operands of 'and' and 'or' are evaluated only when needed, as
+  // in the evaluators.
+  case and_term:
+    return emit_cond(as<And>(t)->t1, as<And>(t)->t2, nullptr);
+
+  case or_term:
+    return emit_cond(as<Or>(t)->t1, nullptr, as<Or>(t)->t2);
+
+  case if_term: {
+    If* e = as<If>(t);
+    return emit_cond(e->cond(), e->if_true(), e->if_false());
+  }
+
+  case app_term: {
+    App* e = as<App>(t);
+    return emit_call(e->abs(), {e->arg()});
+  }
+
+  case call_term: {
+    Call* e = as<Call>(t);
+    return emit_call(e->fn(), *e->args());
+  }
+
+  default:
+    return nullptr;
+  }
+}
+
+// A reference is to a parameter of the kernel, or to a definition
+// whose value is a literal.
+llvm::Value*
+Emitter::emit_ref(Ref* t) {
+  auto iter = parms.find(t->decl());
+  if (iter != parms.end())
+    return iter->second;
+  if (Def* def = as<Def>(t->decl())) {
+    Term* v = as<Term>(def->value());
+    if (is<Int>(v) or is<True>(v) or is<False>(v))
+      return emit(v);
+  }
+  return nullptr;
+}
+
+llvm::Value*
+Emitter::emit_succ(Succ* t) {
+  llvm::Value* x = emit(t->arg());
+  if (not x)
+    return nullptr;
+  llvm::Value* r = b.CreateBinaryIntrinsic(llvm::Intrinsic::sadd_with_overflow,
+                                           x, b.getInt64(1));
+  llvm::BasicBlock* ok = llvm::BasicBlock::Create(cxt, "succ", fn);
+  b.CreateCondBr(b.CreateExtractValue(r, 1), get_fail(), ok);
+  b.SetInsertPoint(ok);
+  return b.CreateExtractValue(r, 0);
+}
+
+// Returns the value of 'if c then t1 else t2'. When t1 (or t2) is null,
+// the value of that branch is that of the condition, so that 'c1 and
+// c2' is 'if c1 then c2 else c1', and 'c1 or c2' is 'if c1 then c1
+// else c2'.
+llvm::Value*
+Emitter::emit_cond(Term* c, Term* t1, Term* t2) {
+  llvm::Value* x = emit(c);
+  if (not x)
+    return nullptr;
+  llvm::BasicBlock* from = b.GetInsertBlock();
+  llvm::BasicBlock* b1 = llvm::BasicBlock::Create(cxt, "then", fn);
+  llvm::BasicBlock* b2 = llvm::BasicBlock::Create(cxt, "else", fn);
+  llvm::BasicBlock* end = llvm::BasicBlock::Create(cxt, "end", fn);
+  b.CreateCondBr(b.CreateICmpNE(x, b.getInt64(0)), t1 ? b1 : end, t2 ? b2 : end);
+
+  llvm::PHINode* phi = nullptr;
+  auto branch = [&](llvm::BasicBlock* bb, Term* t) -> bool {
+    if (not t) {
+      bb->eraseFromParent();
+      return true;
+    }
+    b.SetInsertPoint(bb);
+    llvm::Value* v = emit(t);
+    if (not v)
+      return false;
+    llvm::BasicBlock* last = b.GetInsertBlock();
+    b.CreateBr(end);
+    b.SetInsertPoint(end);
+    if (not phi)
+      phi = b.CreatePHI(b.getInt64Ty(), 2);
+    phi->addIncoming(v, last);
+    return true;
+  };
+  if (not branch(b1, t1) or not branch(b2, t2))
+    return nullptr;
+  if (not t1 or not t2)
+    phi->addIncoming(x, from);
+  b.SetInsertPoint(end);
+  return phi;
+}
+
+// Returns the value of a call of the kernel named by f with the given
+// arguments. When the callee overflows, so does the caller.
+llvm::Value*
+Emitter::emit_call(Term* f, const Term_seq& args) {
+  Term* callee = get_kernel_callee(f);
+  llvm::Function* k = callee ? get_fn(callee) : nullptr;
+  if (not k or k->arg_size() != args.size() + 1)
+    return nullptr;
+  std::vector<llvm::Value*> vals;
+  for (Term* a : args) {
+    llvm::Value* v = emit(a);
+    if (not v)
+      return nullptr;
+    vals.push_back(v);
+  }
+  llvm::Value* flag = fn->getArg(fn->arg_size() - 1);
+  vals.push_back(flag);
+  llvm::Value* r = b.CreateCall(k, vals);
+  llvm::BasicBlock* ok = llvm::BasicBlock::Create(cxt, "call", fn);
+  b.CreateCondBr(b.CreateLoad(b.getInt1Ty(), flag), get_fail(), ok);
+  b.SetInsertPoint(ok);
+  return r;
+}
+
+// Emit the entry of the kernel k, which has n parameters. The entry
+// loads the arguments, calls the kernel, and stores its result.
+void
+emit_entry(Emitter& e, llvm::Function* k, std::size_t n, const std::string& name) {
+  llvm::IRBuilder<>& b = e.b;
+  llvm::Type* ptr = llvm::PointerType::getUnqual(b.getInt64Ty());
+  llvm::FunctionType* type = llvm::FunctionType::get(b.getInt1Ty(), {ptr, ptr}, false);
+  llvm::Function* fn = llvm::Function::Create(type, llvm::Function::ExternalLinkage, name, &e.mod);
+  b.SetInsertPoint(llvm::BasicBlock::Create(e.cxt, "entry", fn));
+  llvm::Value* flag = b.CreateAlloca(b.getInt1Ty());
+  b.CreateStore(b.getFalse(), flag);
+  std::vector<llvm::Value*> args;
+  for (std::size_t i = 0; i < n; ++i) {
+    llvm::Value* p = b.CreateConstGEP1_64(b.getInt64Ty(), fn->getArg(0), i);
+    args.push_back(b.CreateLoad(b.getInt64Ty(), p));
+  }
+  args.push_back(flag);
+  b.CreateStore(b.CreateCall(k, args), fn->getArg(1));
+  b.CreateRet(b.CreateNot(b.CreateLoad(b.getInt1Ty(), flag)));
+}
+
+// Optimize the module m.
+void
+optimize(llvm::Module& m) {
+  llvm::LoopAnalysisManager lam;
+  llvm::FunctionAnalysisManager fam;
+  llvm::CGSCCAnalysisManager cgam;
+  llvm::ModuleAnalysisManager mam;
+  llvm::PassBuilder pb;
+  pb.registerModuleAnalyses(mam);
+  pb.registerCGSCCAnalyses(cgam);
+  pb.registerFunctionAnalyses(fam);
+  pb.registerLoopAnalyses(lam);
+  pb.crossRegisterProxies(lam, fam, cgam, mam);
+  pb.buildPerModuleDefaultPipeline(llvm::OptimizationLevel::O2).run(m, mam);
+}
+
+// -------------------------------------------------------------------------- //
+// The JIT
+//
+// Kernels are compiled by a single JIT, which is created when the first
+// kernel is compiled. The JIT and the native code of each kernel live
+// until the end of the process. Compilation is guarded by a mutex.
+
+std::mutex jit_mutex_;
+std::unique_ptr<llvm::orc::LLJIT> jit_;
+std::vector<std::unique_ptr<Native_fn>> natives_;
+
+// Returns the JIT, or nullptr if it cannot be created.
+llvm::orc::LLJIT*
+get_jit() {
+  static bool init = false;
+  if (not init) {
+    init = true;
+    llvm::InitializeNativeTarget();
+    llvm::InitializeNativeTargetAsmPrinter();
+    auto jit = llvm::orc::LLJITBuilder().create();
+    if (jit)
+      jit_ = std::move(*jit);
+    else
+      llvm::consumeError(jit.takeError());
+  }
+  return jit_.get();
+}
+
+} // namespace
+
+// Returns the native code of the abstraction or function f, or nullptr
+// if f is not a kernel.
+Native_fn*
+compile_native(Term* f) {
+  std::lock_guard<std::mutex> lock(jit_mutex_);
+  llvm::orc::LLJIT* jit = get_jit();
+  if (not jit)
+    return nullptr;
+
+  std::unique_ptr<llvm::LLVMContext> cxt(new llvm::LLVMContext());
+  std::unique_ptr<llvm::Module> mod(new llvm::Module("kernel", *cxt));
+  mod->setDataLayout(jit->getDataLayout());
+  Emitter e(*cxt, *mod);
+  llvm::Function* k = e.get_fn(f);
+  if (not k)
+    return nullptr;
+  std::size_t n = get_parms(f).size();
+  std::string name = "kernel." + std::to_string(natives_.size());
+  emit_entry(e, k, n, name);
+  lang_assert(not llvm::verifyModule(*mod), "ill-formed native code");
+  optimize(*mod);
+
+  llvm::orc::ThreadSafeModule tsm(std::move(mod), std::move(cxt));
+  if (llvm::Error err = jit->addIRModule(std::move(tsm))) {
+    llvm::consumeError(std::move(err));
+    return nullptr;
+  }
+  auto sym = jit->lookup(name);
+  if (not sym) {
+    llvm::consumeError(sym.takeError());
+    return nullptr;
+  }
+  Native_entry entry = reinterpret_cast<Native_entry>(sym->getAddress());
+  bool bool_result = is_bool_type(get_type(get_body(f)));
+  natives_.emplace_back(new Native_fn {entry, n, bool_result, get_body(f)->loc});
+  return natives_.back().get();
+}
+
+// Returns the value of the call of the native code f with the n
+// arguments args, or nullptr if the call cannot be completed natively.
+Term*
+call_native(Native_fn* f, Term* const* args, std::size_t n) {
+  lang_assert(n == f->parms, "invalid native call");
+  std::int64_t vals[max_native_parms];
+  for (std::size_t i = 0; i < n; ++i) {
+    Term* a = args[i];
+    if (Int* x = as<Int>(a)) {
+      const Integer& v = x->value();
+      if (not v.is_small() or v.word() < 0)
+        return nullptr;
+      vals[i] = v.word();
+    } else if (is_true(a)) {
+      vals[i] = 1;
+    } else if (is_false(a)) {
+      vals[i] = 0;
+    } else {
+      return nullptr;
+    }
+  }
+  std::int64_t r;
+  if (not f->entry(vals, &r))
+    return nullptr;
+  if (f->bool_result)
+    return r ? get_true() : get_false();
+  return new Int(f->loc, get_nat_type(), Integer(long(r)));
+}
+
+#else
+
+struct Native_fn { };
+
+Native_fn*
+compile_native(Term*) { return nullptr; }
+
+Term*
+call_native(Native_fn*, Term* const*, std::size_t) { return nullptr; }
+
+#endif
@@ -0,0 +1,39 @@
+#ifndef JIT_HPP
+#define JIT_HPP
+
+#include "ast.hpp"
+
+#include <cstddef>
+
+// -------------------------------------------------------------------------- //
+// Native code
+//
+// Functions over natural numbers and booleans can be compiled to native
+// code through LLVM. A function is compiled when it is a kernel: each of
+// its parameters and its result are of type Nat or Bool, and its body
+// is made only of literals, references to its parameters, 'succ',
+// 'pred', 'iszero', 'if', 'eq', 'lt', 'and', 'or', 'not', and calls to
+// other kernels named by definitions. The types of terms are those
+// computed by elaboration.
+//
+// Natural numbers are represented by 64-bit integers in native code. A
+// call whose arguments do not fit, or whose computation overflows, is
+// not completed natively; it is run by the virtual machine instead.
+// Kernels are pure, so the call is simply run again.
+//
+// The virtual machine counts the calls of each function, and compiles
+// a function when the count reaches the threshold set with
+// set_jit_threshold (see Code in vm.hpp). The compiled code is kept for
+// the rest of the process. Compilation is disabled unless a threshold
+// is set, or when the interpreter is built without LLVM.
+
+void set_jit_threshold(std::size_t);
+std::size_t get_jit_threshold();
+
+// The native code of a kernel.
+struct Native_fn;
+
+Native_fn* compile_native(Term*);
+Term* call_native(Native_fn*, Term* const*, std::size_t);
+
+#endif
@@ -0,0 +1,107 @@
+
+#include "arena.hpp"
+#include "nodes.hpp"
+
+#include <cstdlib>
+#include <new>
+
+namespace {
+
+// The alignment of all allocations.
+constexpr std::size_t align = alignof(std::max_align_t);
+
+// Returns n rounded up to a multiple of the alignment.
+inline std::size_t
+aligned(std::size_t n) { return (n + align - 1) & ~(align - 1); }
+
+// The current arena of each thread. When null, nodes are allocated
+// in the global arena.
+thread_local Arena* current_ = nullptr;
+
+} // namespace
+
+// -------------------------------------------------------------------------- //
+// Arena
+
+// Create an arena that allocates blocks of the given size.
+Arena::Arena(std::size_t n)
+  : block_(n), ptr_(nullptr), end_(nullptr), bytes_(0) { }
+
+Arena::~Arena() { release(); }
+
+// Allocate n bytes of storage from the arena. Requests larger than a
+// block are given a block of their own.
+void*
+Arena::allocate(std::size_t n) {
+  n = aligned(n);
+  if (std::size_t(end_ - ptr_) < n)
+    ptr_ = grow(n);
+  void* p = ptr_;
+  ptr_ += n;
+  bytes_ += n;
+  return p;
+}
+
+// Allocate a new block able to hold at least n bytes, and return a
+// pointer to its first byte. Blocks are aligned by malloc.
+char*
+Arena::grow(std::size_t n) {
+  std::size_t size = n > block_ ? n : block_;
+  char* p = static_cast<char*>(std::malloc(size));
+  if (not p)
+    throw std::bad_alloc();
+  blocks_.push_back(p);
+  end_ = p + size;
+  return p;
+}
+
+// Register the node n for destruction when the arena is released.
+void
+Arena::own(Node* n) { nodes_.push_back(n); }
+
+// Unregister the most recently allocated node n. This happens only
+// when the construction of n fails.
+void
+Arena::disown(Node* n) {
+  if (not nodes_.empty() and nodes_.back() == n)
+    nodes_.pop_back();
+}
+
+// Destroy all nodes in the arena, in the reverse order of their
+// allocation, and release its memory.
+void
+Arena::release() {
+  for (auto iter = nodes_.rbegin(); iter != nodes_.rend(); ++iter)
+    (*iter)->~Node();
+  nodes_.clear();
+  for (char* b : blocks_)
+    std::free(b);
+  blocks_.clear();
+  ptr_ = end_ = nullptr;
+  bytes_ = 0;
+}
+
+
+// -------------------------------------------------------------------------- //
+// Current arena
+
+// Returns the arena in which nodes created outside of any phase are
+// allocated. It is never released.
+Arena&
+global_arena() {
+  static Arena* a = new Arena();
+  return *a;
+}
+
+// Returns the arena in which new nodes are allocated.
+Arena&
+current_arena() { return current_ ? *current_ : global_arena(); }
+
+// Set the current arena.
+void
+use_arena(Arena& a) { current_ = &a; }
+
+Arena_guard::Arena_guard(Arena& a)
+  : prev(current_) { current_ = &a; }
+
+Arena_guard::~Arena_guard() { current_ = prev; }
@@ -0,0 +1,72 @@
+#ifndef ARENA_HPP
+#define ARENA_HPP
+
+#include <cstddef>
+#include <vector>
+
+// This module provides facilities for allocating nodes in bulk.
+//
+// An arena is a region of memory from which nodes are allocated by
+// bumping a pointer through a list of large blocks. Nodes are never
+// freed individually. Instead, every node allocated in an arena is
+// destroyed, and its memory released, when the arena is released
+// (or destroyed).
+//
+// Each phase of the pipeline (parsing, elaboration, evaluation) owns
+// an arena, and allocates the nodes it creates in that arena. Nodes
+// created outside of any phase (e.g., the built-in types and values)
+// are allocated in a global arena that lives for the duration of the
+// program. The current arena is specific to each thread, and threads
+// other than the main thread must make their own arena current before
+// creating nodes.
+
+struct Node;
+
+// -------------------------------------------------------------------------- //
+// Arena
+
+struct Arena {
+  static constexpr std::size_t block_size = 64 * 1024;
+
+  Arena(std::size_t = block_size);
+  ~Arena();
+
+  Arena(const Arena&) = delete;
+  Arena& operator=(const Arena&) = delete;
+
+  void* allocate(std::size_t);
+  void own(Node*);
+  void disown(Node*);
+  void release();
+
+  std::size_t allocated() const { return bytes_; }
+
+private:
+  char* grow(std::size_t);
+
+  std::size_t block_;         // The size of each block
+  std::vector<char*> blocks_; // Allocated blocks
+  std::vector<Node*> nodes_;  // Nodes to be destroyed on release
+  char* ptr_;                 // The next free byte in the current block
+  char* end_;                 // Past the end of the current block
+  std::size_t bytes_;         // Total bytes allocated
+};
+
+
+// -------------------------------------------------------------------------- //
+// Current arena
+
+Arena& global_arena();
+Arena& current_arena();
+void use_arena(Arena&);
+
+// The arena guard makes the given arena current for the duration of
+// a phase, restoring the previous arena on exit.
+struct Arena_guard {
+  Arena_guard(Arena&);
+  ~Arena_guard();
+
+  Arena* prev;
+};
+
+#endif
@@ -0,0 +1,30 @@
+
+#include "context.hpp"
+
+namespace {
+
+// The current context of each thread.
+thread_local Context* current_ = nullptr;
+
+} // namespace
+
+// Returns the current context, or nullptr if no phase is running on
+// the calling thread.
+Context*
+current_context() { return current_; }
+
+Context_guard::Context_guard(Context& c)
+  : prev(current_), prev_arena(nullptr)
+{
+  current_ = &c;
+  if (c.arena) {
+    prev_arena = &current_arena();
+    use_arena(*c.arena);
+  }
+}
+
+Context_guard::~Context_guard() {
+  if (prev_arena)
+    use_arena(*prev_arena);
+  current_ = prev;
+}
@@ -0,0 +1,50 @@
+#ifndef CONTEXT_HPP
+#define CONTEXT_HPP
+
+#include "arena.hpp"
+#include "error.hpp"
+
+// This module defines the state shared by the functions of a phase
+// of the pipeline.
+//
+// A context refers to the diagnostics in which errors are recorded,
+// the arena in which nodes are allocated, and the current scope (which
+// is defined by the language, and used only during elaboration). Each
+// phase (lexing, parsing, elaboration, evaluation) owns a context,
+// and makes it current while it runs. The current context is specific
+// to each thread, so independent pipelines can run concurrently on
+// different threads, or be interleaved on the same thread (e.g., the
+// lexer is advanced by the parser).
+
+struct Scope;
+
+// -------------------------------------------------------------------------- //
+// Context
+
+struct Context {
+  Context(Diagnostics& d, Arena* a = nullptr)
+    : diags(&d), arena(a), scope(nullptr) { }
+
+  Diagnostics* diags; // The current diagnostics
+  Arena*       arena; // The arena of the phase, if any
+  Scope*       scope; // The current scope, if any
+};
+
+
+// -------------------------------------------------------------------------- //
+// Current context
+
+Context* current_context();
+
+// The context guard makes the given context current for the duration
+// of a phase, restoring the previous context on exit. If the context
+// has an arena, that arena is made current as well.
+struct Context_guard {
+  Context_guard(Context&);
+  ~Context_guard();
+
+  Context* prev;
+  Arena* prev_arena;
+};
+
+#endif
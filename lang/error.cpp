@@ -1,14 +1,12 @@
 
 #include "error.hpp"
+#include "context.hpp"
 #include "debug.hpp"
 
 #include <iostream>
 
 namespace {
 
-// The global diagnostics pointer.
-Diagnostics* diags_ = nullptr;
-
 // Register a diagnostic with the diagnostic list.
 template<typename D>
   inline Diagnostic*
@@ -18,21 +16,32 @@ template<typename D>
     return d;
   }
 
-// Make sure that diagnostics are installed.
-inline void
-check_diagnostics() {
-  lang_assert(diags_, "diagnostics not initialized");
+// Returns the diagnostics of the current context, which must exist.
+inline Diagnostics&
+get_diagnostics() {
+  Context* c = current_context();
+  lang_assert(c, "diagnostics not initialized");
+  return *c->diags;
 }
 
 } // namespace
 
-// The set the global diagnostics pointer to the give diagnostics. This
-// is generally set in the constructor of a processing phase (e.g.,
-// the parser). All calls to diagnostic constructors will modify this
-// object.
+// Set the diagnostics of the current context to the given diagnostics.
+// All calls to diagnostic constructors will modify this object until
+// the phase ends (e.g., during a tentative parse).
 void
 use_diagnostics(Diagnostics& ds) {
-  diags_ = &ds;
+  Context* c = current_context();
+  lang_assert(c, "no current context");
+  c->diags = &ds;
+}
+
+// Returns the current diagnostics, or nullptr if no phase is running
+// on the calling thread.
+Diagnostics*
+current_diagnostics() {
+  Context* c = current_context();
+  return c ? c->diags : nullptr;
 }
 
 // -------------------------------------------------------------------------- //
@@ -81,8 +90,7 @@ operator<<(Diagnostic_stream ds, Integer n) {
 // Create a new error diagnostic.
 Diagnostic_stream
 error(const Location& loc) { 
-  check_diagnostics();
-  return {make_diag<Error>(*diags_, loc)};
+  return {make_diag<Error>(get_diagnostics(), loc)};
 }
 
 // Create a new error diagnostic.
@@ -94,8 +102,7 @@ error(Diagnostics& ds, const Location& loc) {
 // Create a new warning diagnostic.
 Diagnostic_stream
 warn(const Location& loc) { 
-  check_diagnostics();
-  return warn(*diags_, loc); 
+  return warn(get_diagnostics(), loc);
 }
 
 // Create a new warning diagnostic.
@@ -107,8 +114,7 @@ warn(Diagnostics& ds, const Location& loc) {
 // Create a new note diagnostic.
 Diagnostic_stream
 note(const Location& loc) { 
-  check_diagnostics();
-  return note(*diags_, loc); 
+  return note(get_diagnostics(), loc);
 }
 
 // Create a new note diagnostic.
@@ -120,8 +126,7 @@ note(Diagnostics& ds, const Location& loc) {
 // Create a new sorry diagnostic.
 Diagnostic_stream
 sorry(const Location& loc) { 
-  check_diagnostics();
-  return sorry(*diags_, loc); 
+  return sorry(get_diagnostics(), loc);
 }
 
 // Create a new sorry diagnostic.
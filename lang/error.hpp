@@ -3,6 +3,7 @@
 #define ERROR_HPP
 
 #include <iosfwd>
+#include <vector>
 
 #include "string.hpp"
 #include "integer.hpp"
@@ -123,6 +124,7 @@ Diagnostic_stream sorry(const Location&);
 Diagnostic_stream sorry(Diagnostics&, const Location&);
 
 void use_diagnostics(Diagnostics&);
+Diagnostics* current_diagnostics();
 
 void print(std::ostream&, const Diagnostics&);
 
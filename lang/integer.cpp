@@ -1,14 +1,148 @@
 
+#include <cstring>
 #include <stdexcept>
 
 #include "integer.hpp"
 #include "debug.hpp"
 
+namespace {
+
+// Returns the value of the digit c, or 36 if c is not a digit.
+inline int
+digit_value(char c) {
+  if ('0' <= c and c <= '9')
+    return c - '0';
+  if ('a' <= c and c <= 'z')
+    return c - 'a' + 10;
+  if ('A' <= c and c <= 'Z')
+    return c - 'A' + 10;
+  return 36;
+}
+
+// Parse the digits in s as a machine word in base b. Returns false if
+// s is not a sequence of digits in base b, or if the value does not
+// fit in a word.
+bool
+parse_word(const char* s, int b, long& n) {
+  bool neg = *s == '-';
+  if (neg)
+    ++s;
+  if (not *s)
+    return false;
+  long r = 0;
+  for (; *s; ++s) {
+    int d = digit_value(*s);
+    if (d >= b)
+      return false;
+    if (__builtin_mul_overflow(r, b, &r) or __builtin_add_overflow(r, d, &r))
+      return false;
+  }
+  n = neg ? -r : r;
+  return true;
+}
+
+// Initialize z with the value of x.
+inline void
+init_mpz(mpz_t z, const Integer& x) {
+  if (x.is_small())
+    mpz_init_set_si(z, x.word());
+  else
+    mpz_init_set(z, x.data());
+}
+
+} // namespace
+
 // Consruct an integer with the value in s in base b. Behavior is undefined
 // if s does not represent an integer in base b.
+//
+// Most literals fit in a word, and are parsed without involving GMP.
 Integer::Integer(String s, int b) 
-  : base_(b)
+  : word_(0), base_(b), small_(true)
 {
-  if (mpz_init_set_str(value_, s.data(), base_) == -1)
+  if (parse_word(s.data(), b, word_))
+    return;
+  mpz_t z;
+  if (mpz_init_set_str(z, s.data(), base_) == -1) {
+    mpz_clear(z);
     lang_unreachable("invalid integer representation");
+  }
+  assign(z);
+}
+
+// Set this value to z, taking ownership of z. The value is demoted to
+// a word if it fits.
+void
+Integer::assign(mpz_t z) {
+  clear();
+  if (mpz_fits_slong_p(z)) {
+    word_ = mpz_get_si(z);
+    mpz_clear(z);
+  } else {
+    value_[0] = z[0];
+    small_ = false;
+  }
+}
+
+// Compute the binary operation f on this value and x using GMP. This
+// is the slow path of arithmetic, taken when either operand is large
+// or when the result overflows a word.
+Integer&
+Integer::apply(Binary_fn f, const Integer& x) {
+  mpz_t a, b;
+  init_mpz(a, *this);
+  init_mpz(b, x);
+  f(a, a, b);
+  mpz_clear(b);
+  assign(a);
+  return *this;
+}
+
+// Compute the unary operation f on this value using GMP.
+Integer&
+Integer::apply(Unary_fn f) {
+  mpz_t a;
+  init_mpz(a, *this);
+  f(a, a);
+  assign(a);
+  return *this;
+}
+
+// Compare two integers, at least one of which is large. Returns a
+// negative value when a < b, 0 when a == b, and a positive value when
+// a > b.
+int
+compare_large(const Integer& a, const Integer& b) {
+  if (a.is_small())
+    return -mpz_cmp_si(b.data(), a.word());
+  if (b.is_small())
+    return mpz_cmp_si(a.data(), b.word());
+  return mpz_cmp(a.data(), b.data());
+}
+
+// Returns the textual representation of z in its base, which is
+// at most 16.
+std::string
+to_string(const Integer& z) {
+  int base = z.base();
+  lang_assert(2 <= base and base <= 16, "unsupported base");
+  if (z.is_small()) {
+    // Format the magnitude from right to left.
+    char buf[sizeof(long) * CHAR_BIT + 2];
+    char* p = buf + sizeof(buf);
+    long n = z.word();
+    unsigned long m = n < 0 ? 0ul - n : n;
+    do {
+      *--p = "0123456789abcdef"[m % base];
+      m /= base;
+    } while (m);
+    if (n < 0)
+      *--p = '-';
+    return std::string(p, buf + sizeof(buf));
+  }
+
+  std::size_t n = mpz_sizeinbase(z.data(), base) + 2;
+  std::string str(n, '\0');
+  mpz_get_str(&str[0], base, z.data());
+  str.resize(std::strlen(str.c_str()));
+  return str;
 }
@@ -2,22 +2,33 @@
 #ifndef INTEGER_HPP
 #define INTEGER_HPP
 
-#include <memory>
+#include <climits>
+#include <string>
 
 #include <gmp.h>
 
 #include "string.hpp"
 
 // The Integer class represents arbitrary integer values.
+//
+// Values that fit in a machine word are stored inline, and arithmetic
+// on those values does not allocate. A value is promoted to a GMP
+// integer only when an operation overflows, and is demoted when a
+// result fits in a word again. The representation is canonical: an
+// integer is large only if its value does not fit in a word.
 class Integer {
 public:
   // Default constructor
-  Integer(int = 10);
+  Integer();
 
   // Copy semantics
   Integer(const Integer&);
   Integer& operator=(const Integer&);
 
+  // Move semantics
+  Integer(Integer&&);
+  Integer& operator=(Integer&&);
+
   // Value initialization
   Integer(long, int = 10);
   Integer(String, int = 10);
@@ -36,15 +47,31 @@ public:
   Integer& abs();
 
   // Observers
+  bool is_small() const;
+  long word() const;
   int bits() const;
   int base() const;
   const mpz_t& data() const;
-  
+
 private:
-  mpz_t value_;
-  int   base_;
+  using Binary_fn = void (*)(mpz_ptr, mpz_srcptr, mpz_srcptr);
+  using Unary_fn = void (*)(mpz_ptr, mpz_srcptr);
+
+  Integer& apply(Binary_fn, const Integer&);
+  Integer& apply(Unary_fn);
+  void assign(mpz_t);
+  void clear();
+
+  union {
+    long  word_;  // The value, when small
+    mpz_t value_; // The value, when large
+  };
+  int  base_;
+  bool small_;
 };
 
+int compare_large(const Integer&, const Integer&);
+
 // Equality
 bool operator==(const Integer&, const Integer&);
 bool operator!=(const Integer&, const Integer&);
@@ -73,9 +100,21 @@ bool operator<=(const Integer&, const Integer&);
 bool operator>=(const Integer&, const Integer&);
 
 // Streaming
+std::string to_string(const Integer&);
+
 template<typename C, typename T>
   std::basic_ostream<C, T>& operator<<(std::basic_ostream<C, T>&, const Integer&);
 
+// Hash support for Integers.
+namespace std {
+
+template<>
+  struct hash<Integer> {
+    std::size_t operator()(const Integer& z) const;
+  };
+
+} // namespace std
+
 #include "integer.ipp"
 
 #endif
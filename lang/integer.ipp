@@ -1,22 +1,65 @@
-// Default initialize the integer value.
-//
-// Note that GMP does not optimize for default-intialized values. 
+// Default initialize the integer value to 0.
 inline
-Integer::Integer(int b) : base_(b) { mpz_init(value_); }
+Integer::Integer() : word_(0), base_(10), small_(true) { }
 
 // Copy initialize this object with x.
 inline
 Integer::Integer(const Integer& x) 
-  : base_(x.base_) 
-{ mpz_init_set(value_, x.value_); }
+  : base_(x.base_), small_(x.small_)
+{
+  if (small_)
+    word_ = x.word_;
+  else
+    mpz_init_set(value_, x.value_);
+}
 
 // Copy assign this object to the value of x.
 inline Integer&
 Integer::operator=(const Integer& x) {
   if (this != &x) {
-    mpz_clear(value_);
-    mpz_set(value_, x.value_);
+    if (x.small_) {
+      clear();
+      word_ = x.word_;
+    } else if (small_) {
+      mpz_init_set(value_, x.value_);
+      small_ = false;
+    } else {
+      mpz_set(value_, x.value_);
+    }
+    base_ = x.base_;
+  }
+  return *this;
+}
+
+// Move initialize this object with x. If x is large, its value is
+// taken, and x becomes 0.
+inline
+Integer::Integer(Integer&& x)
+  : base_(x.base_), small_(x.small_)
+{
+  if (small_) {
+    word_ = x.word_;
+  } else {
+    value_[0] = x.value_[0];
+    x.word_ = 0;
+    x.small_ = true;
+  }
+}
+
+// Move assign this object to the value of x.
+inline Integer&
+Integer::operator=(Integer&& x) {
+  if (this != &x) {
+    clear();
+    small_ = x.small_;
     base_ = x.base_;
+    if (small_) {
+      word_ = x.word_;
+    } else {
+      value_[0] = x.value_[0];
+      x.word_ = 0;
+      x.small_ = true;
+    }
   }
   return *this;
 }
@@ -24,39 +67,68 @@ Integer::operator=(const Integer& x) {
 // Construct an integer with the value n.
 inline
 Integer::Integer(long n, int b)
-  : base_(b)
-{ mpz_init_set_si(value_, n); }
+  : word_(n), base_(b), small_(true) { }
 
 // Destroy the ionteger, releasing resources.
 inline
-Integer::~Integer() { mpz_clear(value_); }
+Integer::~Integer() { clear(); }
+
+// Release the large value, if any, leaving this integer small.
+inline void
+Integer::clear() {
+  if (not small_) {
+    mpz_clear(value_);
+    small_ = true;
+  }
+}
 
 inline Integer& 
 Integer::operator+=(const Integer& x) {
-  mpz_add(value_, value_, x.value_);
-  return *this;
+  long r;
+  if (small_ and x.small_ and not __builtin_add_overflow(word_, x.word_, &r)) {
+    word_ = r;
+    return *this;
+  }
+  return apply(mpz_add, x);
 }
 
 inline Integer& 
 Integer::operator-=(const Integer& x) {
-  mpz_sub(value_, value_, x.value_);
-  return *this;
+  long r;
+  if (small_ and x.small_ and not __builtin_sub_overflow(word_, x.word_, &r)) {
+    word_ = r;
+    return *this;
+  }
+  return apply(mpz_sub, x);
 }
 
 inline Integer& 
 Integer::operator*=(const Integer& x) {
-  mpz_mul(value_, value_, x.value_);
-  return *this;
+  long r;
+  if (small_ and x.small_ and not __builtin_mul_overflow(word_, x.word_, &r)) {
+    word_ = r;
+    return *this;
+  }
+  return apply(mpz_mul, x);
 }
 
 // Divide this integer value by x. Integer division is implemented as
 // floor division. A discussion of alternatives can be found in the paper,
 // "The Euclidean definition of the functions div and mod" by Raymond T.
 // Boute (http://dl.acm.org/citation.cfm?id=128862).
+//
+// Division by 0, and the overflowing division of the least value by
+// -1, are handled by GMP.
 inline Integer& 
 Integer::operator/=(const Integer& x) {
-  mpz_fdiv_q(value_, value_, x.value_);
-  return *this;
+  if (small_ and x.small_ and x.word_ != 0 and x.word_ != -1) {
+    long q = word_ / x.word_;
+    if (word_ % x.word_ != 0 and (word_ < 0) != (x.word_ < 0))
+      --q;
+    word_ = q;
+    return *this;
+  }
+  return apply(mpz_fdiv_q, x);
 }
 
 // Compute the remainder of the division of this value_ by x. Integer division
@@ -64,39 +136,77 @@ Integer::operator/=(const Integer& x) {
 // discussion.
 inline Integer& 
 Integer::operator%=(const Integer& x) {
-  mpz_fdiv_r(value_, value_, x.value_);
-  return *this;
+  if (small_ and x.small_ and x.word_ != 0 and x.word_ != -1) {
+    long r = word_ % x.word_;
+    if (r != 0 and (r < 0) != (x.word_ < 0))
+      r += x.word_;
+    word_ = r;
+    return *this;
+  }
+  return apply(mpz_fdiv_r, x);
 }
 
 // Negate this value.
 inline Integer&
 Integer::neg() {
-  mpz_neg(value_, value_);
-  return *this;
+  if (small_ and word_ != LONG_MIN) {
+    word_ = -word_;
+    return *this;
+  }
+  return apply(mpz_neg);
 }
 
 // Set this value to its absolute value.
 inline Integer&
 Integer::abs() {
-  mpz_abs(value_, value_);
-  return *this;
+  if (small_ and word_ != LONG_MIN) {
+    if (word_ < 0)
+      word_ = -word_;
+    return *this;
+  }
+  return apply(mpz_abs);
 }
 
-// Returns the number of bits in the integer representation.
+// Returns true if the value is stored in a machine word.
+inline bool
+Integer::is_small() const { return small_; }
+
+// Returns the value of a small integer.
+inline long
+Integer::word() const { return word_; }
+
+// Returns the number of bits in the integer representation. As with
+// GMP, the value 0 has 1 bit.
 inline int
-Integer::bits() const { return mpz_sizeinbase(value_, 2); }
+Integer::bits() const {
+  if (small_) {
+    if (word_ == 0)
+      return 1;
+    unsigned long m = word_ < 0 ? 0ul - word_ : word_;
+    return sizeof(long) * CHAR_BIT - __builtin_clzl(m);
+  }
+  return mpz_sizeinbase(value_, 2);
+}
 
 // Returns the base of in which the inteer should be formatted.
 inline int
 Integer::base() const { return base_; }
 
+// Returns the GMP representation of a large integer. Behavior is
+// undefined if the integer is small.
 inline const mpz_t& 
 Integer::data() const { return value_; }
 
 // Equality comparison
-// Returns true when the two integers have the same value.
+// Returns true when the two integers have the same value. Because small
+// values are never stored as large integers, integers of different
+// representations are never equal.
 inline bool
 operator==(const Integer& a, const Integer& b) {
+  if (a.is_small() and b.is_small())
+    return a.word() == b.word();
+  if (a.is_small() or b.is_small())
+    return false;
   return mpz_cmp(a.data(), b.data()) == 0;
 }
 
@@ -109,7 +219,9 @@ operator!=(const Integer& a, const Integer& b) {
 // Returns true when a is less than b.
 inline bool
 operator<(const Integer& a, const Integer& b) {
-  return mpz_cmp(a.data(), b.data()) < 0;
+  if (a.is_small() and b.is_small())
+    return a.word() < b.word();
+  return compare_large(a, b) < 0;
 }
 
 inline bool
@@ -130,32 +242,44 @@ operator>=(const Integer& a, const Integer& b) {
 // Arithmetic
 inline Integer
 operator+(const Integer& a, const Integer& b) {
-  return Integer(a) += b;
+  Integer r(a);
+  r += b;
+  return r;
 }
 
 inline Integer
 operator-(const Integer& a, const Integer& b) {
-  return Integer(a) -= b;
+  Integer r(a);
+  r -= b;
+  return r;
 }
 
 inline Integer
 operator*(const Integer& a, const Integer& b) {
-  return Integer(a) *= b;
+  Integer r(a);
+  r *= b;
+  return r;
 }
 
 inline Integer
 operator/(const Integer& a, const Integer& b) {
-  return Integer(a) /= b;
+  Integer r(a);
+  r /= b;
+  return r;
 }
 
 inline Integer
 operator%(const Integer& a, const Integer& b) {
-  return Integer(a) %= b;
+  Integer r(a);
+  r %= b;
+  return r;
 }
 
 inline Integer 
 operator-(const Integer& x) { 
-  return Integer(x).neg(); 
+  Integer r(x);
+  r.neg();
+  return r;
 }
 
 inline Integer 
@@ -167,20 +291,22 @@ operator+(const Integer& x) {
 template<typename C, typename T>
   inline std::basic_ostream<C, T>&
   operator<<(std::basic_ostream<C, T>& os, const Integer& z) {
-    int  base = z.base();
-    std::size_t n = mpz_sizeinbase(z.data(), base) + 1;
-    std::unique_ptr<char[]> buf(new char[n]);
-    switch (base) {
-      case 8:
-        gmp_snprintf(buf.get(), n, "%Zo", z.data());
-        break;
-      case 10:
-        gmp_snprintf(buf.get(), n, "%Zd", z.data());
-        break;
-      case 16:
-        gmp_snprintf(buf.get(), n, "%Zx", z.data());
-        break;
-    }
-    return os << buf.get(); 
+    return os << to_string(z); 
   }
 
+namespace std {
+
+// Integers that fit into a machine word hash as that word. Larger values
+// are hashed over their limbs.
+inline std::size_t
+hash<Integer>::operator()(const Integer& z) const {
+  if (z.is_small())
+    return hash<long>()(z.word());
+  const mpz_t& x = z.data();
+  std::size_t h = mpz_sgn(x);
+  for (std::size_t i = 0; i < mpz_size(x); ++i)
+    h = h * 31 + mpz_getlimbn(x, i);
+  return h;
+}
+
+} // namespace std
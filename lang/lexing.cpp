@@ -1,2 +1,35 @@
 
 #include "lexing.hpp"
+
+namespace lex {
+
+namespace {
+
+// Build the class table at compile time from the class of each code.
+constexpr unsigned char
+get_char_class(int c) {
+  return ((c >= 'a' and c <= 'z') or (c >= 'A' and c <= 'Z') or c == '_'
+            ? id_head_char | id_rest_char : 0)
+       | (c >= '0' and c <= '9' ? id_rest_char | digit_char | hex_digit_char : 0)
+       | ((c >= 'a' and c <= 'f') or (c >= 'A' and c <= 'F') ? hex_digit_char : 0)
+       | (c == ' ' or c == '\t' ? space_char : 0);
+}
+
+#define LANG_CHARS_4(n) \
+  get_char_class(n), get_char_class(n + 1), get_char_class(n + 2), get_char_class(n + 3)
+#define LANG_CHARS_16(n) \
+  LANG_CHARS_4(n), LANG_CHARS_4(n + 4), LANG_CHARS_4(n + 8), LANG_CHARS_4(n + 12)
+#define LANG_CHARS_64(n) \
+  LANG_CHARS_16(n), LANG_CHARS_16(n + 16), LANG_CHARS_16(n + 32), LANG_CHARS_16(n + 48)
+
+} // namespace
+
+const unsigned char char_classes[256] = {
+  LANG_CHARS_64(0), LANG_CHARS_64(64), LANG_CHARS_64(128), LANG_CHARS_64(192)
+};
+
+#undef LANG_CHARS_64
+#undef LANG_CHARS_16
+#undef LANG_CHARS_4
+
+} // namespace lex
@@ -6,16 +6,37 @@
 #include "location.hpp"
 #include "error.hpp"
 
+#include <cstdint>
+#include <cstring>
+
 namespace lex {
 
 // -------------------------------------------------------------------------- //
 // Characters
 
+// The class of each character is a set of bits in a table indexed by
+// the character's code.
+constexpr unsigned char id_head_char   = 0x01;
+constexpr unsigned char id_rest_char   = 0x02;
+constexpr unsigned char digit_char     = 0x04;
+constexpr unsigned char hex_digit_char = 0x08;
+constexpr unsigned char space_char     = 0x10;
+
+extern const unsigned char char_classes[256];
+
 bool is_id_head(char c);
 bool is_id_rest(char c);
 bool is_digit(char c);
 bool is_bin_digit(char c);
 bool is_hex_digit(char c);
+bool is_space(char c);
+
+// -------------------------------------------------------------------------- //
+// Scanning
+
+const char* scan_space(const char*, const char*);
+const char* scan_id_rest(const char*, const char*);
+const char* scan_digits(const char*, const char*);
 
 // -------------------------------------------------------------------------- //
 // Lexer control
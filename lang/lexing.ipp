@@ -11,31 +11,35 @@ template<typename L>
   inline void
   advance(L& lex, int n) {
     lex.first += n;
-    lex.loc.col += n;
   }
 
-// Save a token having the given location, symbol, and text.
+// Save a token of the given kind and text, starting at the current
+// character. The text is null when it is implied by the kind.
 template<typename L>
   inline void
   save(L& lex, Token_kind k, String str) {
-    lex.toks.emplace_back(lex.loc, k, str);
+    lex.toks.push(k, lex.location(), str);
   }
 
 
 // -------------------------------------------------------------------------- //
 // Characters
 
+// Returns the class of the character c.
+inline unsigned char
+get_char_class(char c) { return char_classes[static_cast<unsigned char>(c)]; }
+
 // Returns true if c is in [a-zA-Z_].
 inline bool
-is_id_head(char c) { return std::isalpha(c) || c == '_'; }
+is_id_head(char c) { return get_char_class(c) & id_head_char; }
 
 // Returns true if c is in [a-zA-Z0-9_].
 inline bool
-is_id_rest(char c) {return std::isalpha(c) || std::isdigit(c) || c == '_'; }
+is_id_rest(char c) { return get_char_class(c) & id_rest_char; }
 
 // Returns true if c is in [0-9].
 inline bool
-is_digit(char c) { return std::isdigit(c); }
+is_digit(char c) { return get_char_class(c) & digit_char; }
 
 // Returns true if c is in [0-1].
 inline bool
@@ -43,7 +47,105 @@ is_bin_digit(char c) { return c == '0' || c == '1'; }
 
 // Returns true if c is in [0-9a-fA-F]
 inline bool
-is_hex_digit(char c) { return std::isxdigit(c); }
+is_hex_digit(char c) { return get_char_class(c) & hex_digit_char; }
+
+// Returns true if c is a space or tab.
+inline bool
+is_space(char c) { return get_char_class(c) & space_char; }
+
+
+// -------------------------------------------------------------------------- //
+// Scanning
+//
+// Runs of spaces, identifier characters, and digits are scanned a word
+// (8 characters) at a time. Each byte of a word is tested for membership
+// in the class at once, leaving the high bit of each byte set when the
+// byte is in the class. The first byte that is not is found by counting
+// trailing zeros, which requires a little-endian load; on other targets,
+// and for the final characters of the input, bytes are scanned one at a
+// time using the class table. The tests are exact: no byte outside a
+// class (including those above 0x7f) is taken to be in it.
+
+namespace scan_impl {
+
+using Word = std::uint64_t;
+
+constexpr Word ones = 0x0101010101010101ull;
+constexpr Word highs = 0x8080808080808080ull;
+constexpr Word lows = 0x7f7f7f7f7f7f7f7full;
+
+inline Word
+load(const char* p) {
+  Word w;
+  std::memcpy(&w, p, sizeof(Word));
+  return w;
+}
+
+// Returns the high bit of each byte of w that is 0.
+inline Word
+zero_bytes(Word w) { return ~(((w & lows) + lows) | w | lows); }
+
+// Returns the high bit of each byte of w that is c.
+inline Word
+equal_bytes(Word w, unsigned char c) { return zero_bytes(w ^ (ones * c)); }
+
+// Returns the high bit of each byte of w in [a, b], for ASCII a and b.
+inline Word
+range_bytes(Word w, unsigned char a, unsigned char b) {
+  Word x = w & lows;
+  Word ge = x + ones * (0x80 - a);
+  Word gt = x + ones * (0x7f - b);
+  return ge & ~gt & ~w & highs;
+}
+
+inline Word
+space_bytes(Word w) { return equal_bytes(w, ' ') | equal_bytes(w, '\t'); }
+
+inline Word
+id_rest_bytes(Word w) {
+  return range_bytes(w, 'a', 'z') | range_bytes(w, 'A', 'Z') |
+         range_bytes(w, '0', '9') | equal_bytes(w, '_');
+}
+
+inline Word
+digit_bytes(Word w) { return range_bytes(w, '0', '9'); }
+
+// Returns the first character in [p, l) that is not in the class given
+// by the word test f and the class bits c.
+template<typename F>
+  inline const char*
+  scan(const char* p, const char* l, F f, unsigned char c) {
+#if defined(__GNUC__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    while (l - p >= 8) {
+      if (Word m = ~f(load(p)) & highs)
+        return p + (__builtin_ctzll(m) >> 3);
+      p += 8;
+    }
+#endif
+    while (p != l and (get_char_class(*p) & c))
+      ++p;
+    return p;
+  }
+
+} // namespace scan_impl
+
+// Returns the first character in [p, l) that is not a space or tab.
+inline const char*
+scan_space(const char* p, const char* l) {
+  return scan_impl::scan(p, l, scan_impl::space_bytes, space_char);
+}
+
+// Returns the first character in [p, l) that is not in [a-zA-Z0-9_].
+inline const char*
+scan_id_rest(const char* p, const char* l) {
+  return scan_impl::scan(p, l, scan_impl::id_rest_bytes, id_rest_char);
+}
+
+// Returns the first character in [p, l) that is not in [0-9].
+inline const char*
+scan_digits(const char* p, const char* l) {
+  return scan_impl::scan(p, l, scan_impl::digit_bytes, digit_char);
+}
 
 
 // -------------------------------------------------------------------------- //
@@ -59,10 +161,11 @@ template<typename L>
       return false;
   }
 
-// Consume horizontal whitespace starting at the current character.
+// Consume the run of horizontal whitespace starting at the current
+// character.
 template<typename L>
   inline void
-  space(L& lex) { advance(lex); }
+  space(L& lex) { advance(lex, scan_space(lex.first + 1, lex.last) - lex.first); }
 
 // Consume a newline starting at the current character.
 //
@@ -72,8 +175,6 @@ template<typename L>
   inline void
   newline(L& lex) {
     ++lex.first;
-    ++lex.loc.line;
-    lex.loc.col = 1;
   }
 
 // Consume a comment, starting with "//" and up to (but not including)
@@ -82,16 +183,16 @@ template<typename L>
   inline void
   comment(L& lex) {
     lex.first += 2;
-    while (lex.first != lex.last and *lex.first != '\n')
-      ++lex.first;
+    const void* p = std::memchr(lex.first, '\n', lex.last - lex.first);
+    lex.first = p ? static_cast<const char*>(p) : lex.last;
   }
 
-// Consume an n-character lexeme, creating a token.
+// Consume an n-character symbol, creating a token. The spelling of the
+// symbol is implied by its kind.
 template<typename L>
   inline void
   ngraph(L& lex, Token_kind sym, int n) {
-    String str(lex.first, lex.first + n);
-    save(lex, sym, str);
+    save(lex, sym, String());
     advance(lex, n);
   }
 
@@ -109,7 +210,7 @@ template<typename L>
 template<typename L>
   inline void
   error(L& lex) {
-    ::error(lex.loc) << format("unrecognized character '{}'", *lex.first); 
+    ::error(lex.location()) << format("unrecognized character '{}'", *lex.first); 
     advance(lex);
   }
 
@@ -118,16 +219,15 @@ template<typename L>
 template<typename L>
   inline void
   id(L& lex) {
-    auto iter = lex.first + 1;
-    while (iter != lex.last and is_id_rest(*iter))
-      ++iter;
+    auto iter = scan_id_rest(lex.first + 1, lex.last);
 
-    // Build the token.
-    String str(lex.first, iter);
-    if (Token_kind k = keyword(str))
+    // Build the token. Keywords are found before interning the spelling,
+    // which the keyword table already holds.
+    String str;
+    if (Token_kind k = keyword(lex.first, iter - lex.first, str))
       save(lex, k, str);
     else
-      save(lex, identifier_tok, str);
+      save(lex, identifier_tok, String(lex.first, iter));
     advance(lex, iter - lex.first);
   }
 
@@ -137,9 +237,7 @@ template<typename L>
 template<typename L>
   inline void
   integer(L& lex) {
-    auto iter = lex.first + 1;
-    while (iter != lex.last and is_digit(*iter))
-      ++iter;
+    auto iter = scan_digits(lex.first + 1, lex.last);
     String str(lex.first, iter);
     save(lex, decimal_literal_tok, str);
     advance(lex, iter - lex.first);
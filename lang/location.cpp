@@ -1,2 +1,88 @@
 
 #include "location.hpp"
+#include "debug.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <vector>
+
+// -------------------------------------------------------------------------- //
+// Source table
+//
+// Each source occupies the offsets [base, base + n] where n is the number
+// of its characters, so that the end of each source has a location of its
+// own. The first source starts at offset 1.
+//
+// The line table of a source holds the offset (relative to its base) of
+// the first character of each line. It is built when the source is
+// added, so the text of a source need not outlive its registration.
+// The most recently added source can be removed once no location refers
+// to it (e.g., a request of a session whose nodes were discarded), so
+// that its offsets are given to the next source.
+
+namespace {
+
+struct Source {
+  std::string name;
+  std::uint32_t base;
+  std::vector<std::uint32_t> lines;
+};
+
+std::mutex mutex_;
+std::deque<Source> sources_;
+std::uint32_t next_ = 1;
+
+} // namespace
+
+// Add the source text [first, last) having the given name to the table
+// of sources, and return the location of its first character. Throws an
+// error when the offsets of the sources would exceed 32 bits.
+Location
+add_source(const std::string& name, const char* first, const char* last) {
+  Source src {name, 0, {0}};
+  // An empty source may have no characters at all (i.e., first is
+  // null), so it is not scanned.
+  for (const char* p = first; p != last;) {
+    const void* q = std::memchr(p, '\n', last - p);
+    if (not q)
+      break;
+    p = static_cast<const char*>(q) + 1;
+    src.lines.push_back(std::uint32_t(p - first));
+  }
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  std::uint64_t n = std::uint64_t(last - first) + 1;
+  if (next_ + n >= UINT32_MAX)
+    lang_unreachable("the sources of the program are too large");
+  src.base = next_;
+  next_ += std::uint32_t(n);
+  sources_.push_back(std::move(src));
+  return Location(sources_.back().base);
+}
+
+// Remove the source whose first character has the location loc, if it
+// is the most recently added source. Its offsets are reused.
+void
+remove_source(Location loc) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (sources_.empty() or sources_.back().base != loc.offset)
+    return;
+  next_ = loc.offset;
+  sources_.pop_back();
+}
+
+// Returns the file, line, and column of the location, which must be in a
+// registered source.
+Position
+get_position(Location loc) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto iter = std::upper_bound(sources_.begin(), sources_.end(), loc.offset,
+    [](std::uint32_t n, const Source& s) { return n < s.base; });
+  lang_assert(iter != sources_.begin(), "location outside of any source");
+  const Source& src = *--iter;
+  std::uint32_t off = loc.offset - src.base;
+  auto line = std::upper_bound(src.lines.begin(), src.lines.end(), off) - 1;
+  return {&src.name, int(line - src.lines.begin()) + 1, int(off - *line) + 1};
+}
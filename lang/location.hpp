@@ -1,31 +1,54 @@
-
 #ifndef LOCATION_HPP
 #define LOCATION_HPP
 
+#include <cstdint>
 #include <iosfwd>
+#include <string>
 
 // Types for special location constructors.
 enum no_location_t { no_location };
 enum eof_location_t { eof_location };
 
-// A location represents a position in a source file, indicated by its
-// line and character offset.
-//
-// TODO: Ensure that we can enregister source locations.
+// A location represents a position in the sources of a program, as the
+// offset of a character of some source file. Each source is given a
+// range of offsets when it is registered (see add_source), so a single
+// word identifies both the file and the position within it.
 //
-// TODO: Map source locations to files? 
+// Locations are mapped to lines and columns only when they are printed
+// (or otherwise resolved; see get_position), using the line table of
+// their source. Offset 0 is the location of internal nodes, which have
+// no source, and the largest offset is the end of the input.
 struct Location {
   Location() = default;
   Location(no_location_t);
   Location(eof_location_t);
-  
+  explicit Location(std::uint32_t n) : offset(n) { }
+
   bool is_internal() const;
   bool is_eof() const;
 
-  int line = 1;
-  int col = 1;
+  std::uint32_t offset = 0;
 };
 
+// Returns the location n characters after loc.
+Location operator+(Location loc, std::size_t n);
+
+
+// -------------------------------------------------------------------------- //
+// Sources
+
+// The position of a location within its source. The file is empty when
+// the source has no name.
+struct Position {
+  const std::string* file;
+  int line;
+  int col;
+};
+
+Location add_source(const std::string&, const char*, const char*);
+void remove_source(Location);
+Position get_position(Location);
+
 // Output formatting
 template<typename C, typename T>
   std::basic_ostream<C, T>&
@@ -1,19 +1,23 @@
-
 // Initialize an empty location.
 inline
 Location::Location(no_location_t)
-  : line(0), col(0) { }
+  : offset(0) { }
 
-// Initialize an empty location.
+// Initialize the location of the end of the input.
 inline
 Location::Location(eof_location_t)
-  : line(-1), col(0) { }
+  : offset(UINT32_MAX) { }
 
 inline bool
-Location::is_internal() const { return line == 0; }
+Location::is_internal() const { return offset == 0; }
 
 inline bool
-Location::is_eof() const { return line == -1; }
+Location::is_eof() const { return offset == UINT32_MAX; }
+
+inline Location
+operator+(Location loc, std::size_t n) {
+  return Location(loc.offset + std::uint32_t(n));
+}
 
 // Output for source locations.
 template<typename C, typename T>
@@ -23,5 +27,6 @@ template<typename C, typename T>
       return os ;
     if (loc.is_eof())
       return os << "<eof>:";
-    return os << loc.line << ':' << loc.col;
+    Position pos = get_position(loc);
+    return os << pos.line << ':' << pos.col;
   }
@@ -0,0 +1,43 @@
+
+#include "mapped_file.hpp"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Map the named file into memory. When seq is true, the file is
+// expected to be read from front to back. Returns false if the file
+// cannot be opened or mapped.
+bool
+Mapped_file::open(const char* path, bool seq) {
+  int fd = ::open(path, O_RDONLY);
+  if (fd < 0)
+    return false;
+  struct stat st;
+  if (::fstat(fd, &st) < 0) {
+    ::close(fd);
+    return false;
+  }
+
+  // An empty file cannot be mapped, but it is a valid input.
+  size = st.st_size;
+  if (size != 0) {
+    void* p = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (p == MAP_FAILED) {
+      ::close(fd);
+      return false;
+    }
+    if (seq)
+      ::madvise(p, size, MADV_SEQUENTIAL);
+    first = static_cast<const char*>(p);
+  }
+  last = first + size;
+  ::close(fd);
+  return true;
+}
+
+Mapped_file::~Mapped_file() {
+  if (first)
+    ::munmap(const_cast<char*>(first), size);
+}
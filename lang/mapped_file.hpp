@@ -0,0 +1,28 @@
+#ifndef MAPPED_FILE_HPP
+#define MAPPED_FILE_HPP
+
+#include <cstddef>
+
+// This module provides read-only access to files that are mapped into
+// memory, so that their contents can be used in place rather than
+// copied into a buffer.
+
+// A file mapped into memory. The mapping is read-only, and is
+// released when the object is destroyed. The contents of an empty
+// file are the empty range.
+struct Mapped_file {
+  Mapped_file()
+    : first(nullptr), last(nullptr), size(0) { }
+  ~Mapped_file();
+
+  Mapped_file(const Mapped_file&) = delete;
+  Mapped_file& operator=(const Mapped_file&) = delete;
+
+  bool open(const char*, bool = true);
+
+  const char* first;
+  const char* last;
+  std::size_t size;
+};
+
+#endif
@@ -1,7 +1,9 @@
 
 #include "nodes.hpp"
+#include "arena.hpp"
 #include "debug.hpp"
 
+#include <algorithm>
 #include <unordered_map>
 
 namespace {
@@ -15,6 +17,9 @@ void
 node_name(Node_kind k, const char* s) {
   lang_assert(node_names_.count(k) == 0, 
               format("node kind '{0}' already named", s));
+  lang_assert(get_node_class(k) < max_node_class and 
+              (k & 0xffffff) < max_node_id,
+              format("node kind '{0}' out of range", s));
   node_names_.insert({k, s});
 }
 
@@ -36,7 +41,73 @@ node_name(Node_kind k) {
     return "<unknown node>";
 }
 
+// Returns the kinds named in the class c, in order of kind.
+std::vector<Node_kind>
+get_node_kinds(Node_class c) {
+  std::vector<Node_kind> ks;
+  for (const auto& n : node_names_)
+    if (get_node_class(n.first) == c)
+      ks.push_back(n.first);
+  std::sort(ks.begin(), ks.end());
+  return ks;
+}
+
+bool node_counting = false;
+Node_counter node_counts;
+
+// Returns the kinds of nodes whose counts are not zero, and their
+// counts, in order of kind.
+Node_counts
+get_counts(const Node_counter& c) {
+  Node_counts r;
+  for (std::uint32_t i = 0; i < max_node_class; ++i) {
+    for (std::uint32_t j = 0; j < max_node_id; ++j) {
+      std::uint64_t n = c.counts[i][j].load(std::memory_order_relaxed);
+      if (n != 0)
+        r.emplace_back(make_node_class(i) | j, n);
+    }
+  }
+  return r;
+}
+
+// Returns the counts of a less those of b, for the kinds whose counts
+// differ. Both lists are in order of kind, and the counts of a are no
+// less than those of b.
+Node_counts
+get_difference(const Node_counts& a, const Node_counts& b) {
+  Node_counts r;
+  auto j = b.begin();
+  for (const auto& x : a) {
+    while (j != b.end() and j->first < x.first)
+      ++j;
+    std::uint64_t n = x.second;
+    if (j != b.end() and j->first == x.first)
+      n -= j->second;
+    if (n != 0)
+      r.emplace_back(x.first, n);
+  }
+  return r;
+}
+
 // Return a string representation of the node category.
 String
 node_name(Node* t) { return node_name(t->kind); }
 
+// Allocate a node in the current arena. The node is registered with
+// the arena so that it is destroyed when the arena is released.
+void*
+Node::operator new(std::size_t n) {
+  Arena& a = current_arena();
+  void* p = a.allocate(n);
+  a.own(static_cast<Node*>(p));
+  return p;
+}
+
+// Nodes are not freed individually. This is only called when the
+// construction of a node fails, in which case the node must not
+// be destroyed with its arena.
+void
+Node::operator delete(void* p) {
+  current_arena().disown(static_cast<Node*>(p));
+}
+
@@ -4,8 +4,12 @@
 
 #include "string.hpp"
 #include "location.hpp"
+#include "debug.hpp"
 
+#include <atomic>
 #include <cstdint>
+#include <utility>
+#include <vector>
 
 // -------------------------------------------------------------------------- //
 // Node classification
@@ -103,6 +107,100 @@ void init_node(Node_kind, const char*);
 String node_name(Node_kind);
 
 
+// -------------------------------------------------------------------------- //
+// Node counters
+
+// The number of node classes, and the bound on the id of each node.
+// The kind of each node is checked against these when it is named.
+constexpr std::uint32_t max_node_class = 8;
+constexpr std::uint32_t max_node_id = 1024;
+
+// A node counter holds a count for each kind of node. Counts may be
+// incremented concurrently.
+struct Node_counter {
+  void add(Node_kind k, std::uint64_t n = 1) {
+    counts[get_node_class(k)][k & 0xffffff].fetch_add(n, std::memory_order_relaxed);
+  }
+
+  std::uint64_t get(Node_kind k) const {
+    return counts[get_node_class(k)][k & 0xffffff].load(std::memory_order_relaxed);
+  }
+
+  std::atomic<std::uint64_t> counts[max_node_class][max_node_id];
+};
+
+// A list of node kinds and their counts.
+using Node_counts = std::vector<std::pair<Node_kind, std::uint64_t>>;
+
+Node_counts get_counts(const Node_counter&);
+Node_counts get_difference(const Node_counts&, const Node_counts&);
+
+// When node_counting is set, each node is counted by kind in node_counts
+// as it is constructed.
+extern bool node_counting;
+extern Node_counter node_counts;
+
+
+// -------------------------------------------------------------------------- //
+// Node tables
+
+std::vector<Node_kind> get_node_kinds(Node_class);
+
+// A node table maps each kind of node to an entry, which is typically
+// the function that implements a traversal for nodes of that kind. The
+// table is indexed by the class and id of a kind, so that dispatching
+// on a kind is a single indexed load. Kinds that are not defined map to
+// the default entry of the table.
+//
+// When a traversal is initialized, check that its table defines each
+// kind named (with init_node) in the classes it covers, so that a
+// new kind of node cannot be silently missing from a traversal.
+template<typename F>
+  struct Node_table {
+    explicit Node_table(F f = F()) {
+      for (std::uint32_t i = 0; i < max_node_class; ++i) {
+        for (std::uint32_t j = 0; j < max_node_id; ++j) {
+          entries[i][j] = f;
+          defined[i][j] = false;
+        }
+      }
+    }
+
+    const F& operator[](Node_kind k) const {
+      return entries[get_node_class(k)][k & 0xffffff];
+    }
+
+    void define(Node_kind k, F f) {
+      lang_assert(not defined[get_node_class(k)][k & 0xffffff],
+                  "node kind already defined");
+      entries[get_node_class(k)][k & 0xffffff] = f;
+      defined[get_node_class(k)][k & 0xffffff] = true;
+    }
+
+    void check(Node_class, const char*) const;
+
+    F entries[max_node_class][max_node_id];
+    bool defined[max_node_class][max_node_id];
+  };
+
+// Check that the table defines every named kind of the class c. The
+// traversal is named by what in the error.
+template<typename F>
+  void
+  Node_table<F>::check(Node_class c, const char* what) const {
+    std::string missing;
+    for (Node_kind k : get_node_kinds(c)) {
+      if (defined[c][k & 0xffffff])
+        continue;
+      if (not missing.empty())
+        missing += ", ";
+      missing += node_name(k).str();
+    }
+    if (not missing.empty())
+      lang_unreachable(std::string(what) + " does not handle " + missing);
+  }
+
+
 // -------------------------------------------------------------------------- //
 // Default nodes
 
@@ -113,13 +211,35 @@ constexpr Node_kind seq_node = make_util_node(1);
 // Nodes
 
 // The base class of all terms and types.
+//
+// Nodes are allocated in the current arena (see arena.hpp), and are
+// destroyed when that arena is released. Deleting a node does not
+// release its memory. Note that Node must be the first base class of
+// every node so that the arena can destroy it.
+//
+// Each node class declares the kinds of its nodes, so that conversions
+// between node classes (see as<U> below) test the kind of a node rather
+// than its dynamic type. A class of nodes with a single kind declares
+// that kind as node_kind. A base class declares the range of the kinds
+// of its derived classes as first_kind and last_kind.
 struct Node {
+  static constexpr Node_kind first_kind = 0;
+  static constexpr Node_kind last_kind = Node_kind(-1);
+
   Node(Node_kind k) 
-    : loc(no_location), kind(k) { }
+    : loc(no_location), kind(k) { count(); }
   Node(Node_kind k, const Location& loc) 
-    : loc(loc), kind(k) { }
+    : loc(loc), kind(k) { count(); }
   virtual ~Node() { }
 
+  static void* operator new(std::size_t);
+  static void operator delete(void*);
+
+  void count() const {
+    if (node_counting)
+      node_counts.add(kind);
+  }
+
   Node_kind kind;
   Location loc;
 };
@@ -129,9 +249,13 @@ struct Node {
 // of nodes. This class also provides the same interface as
 // std::vector<T*> where T is the type of aggregated node.
 //
-// Note that T must be derived from Node.
+// Note that T must be derived from Node. The kind of a sequence does not
+// depend on T, so a conversion to a sequence does not check the types of
+// its elements.
 template<typename T>
   struct Seq : Node, std::vector<T*> {
+    static constexpr Node_kind node_kind = seq_node;
+
     Seq()
       : Node(seq_node) { }
     Seq(std::initializer_list<T*> list)
@@ -1,16 +1,53 @@
+namespace node_impl {
 
-// Returns the node t dynamically converted to the node type U. If t does
-// not have the dynamic type U, the resulting term is null.
+// Returns true if k is the kind of the node class U, when U declares a
+// single kind.
+template<typename U>
+  constexpr auto
+  has_kind(Node_kind k, int) -> decltype(U::node_kind, bool()) {
+    return k == U::node_kind;
+  }
+
+// Returns true if k is in the range of kinds of the node class U.
+template<typename U>
+  constexpr bool
+  has_kind(Node_kind k, long) {
+    return U::first_kind <= k and k <= U::last_kind;
+  }
+
+} // namespace node_impl
+
+// Returns true if k is a kind of the node class U.
+template<typename U>
+  constexpr bool
+  has_kind(Node_kind k) { return node_impl::has_kind<U>(k, 0); }
+
+// Returns the node t converted to the node type U. If t does not have
+// the dynamic type U, the resulting term is null. The conversion tests
+// the kind of t. In debug builds, the result is checked against that
+// of a dynamic cast, so that a node class that does not declare its
+// kinds is detected.
 template<typename U, typename T>
   inline U*
-  as(T* t) { return dynamic_cast<U*>(t); }
+  as(T* t) {
+    U* u = t and has_kind<U>(t->kind)
+      ? static_cast<U*>(static_cast<Node*>(t))
+      : nullptr;
+    lang_assert(u == dynamic_cast<U*>(t), "node kind does not match its class");
+    return u;
+  }
 
 template<typename U, typename T>
   inline const U*
-  as(const T* t) { return dynamic_cast<const U*>(t); }
+  as(const T* t) {
+    const U* u = t and has_kind<U>(t->kind)
+      ? static_cast<const U*>(static_cast<const Node*>(t))
+      : nullptr;
+    lang_assert(u == dynamic_cast<const U*>(t), "node kind does not match its class");
+    return u;
+  }
 
 // Returns true if node t has dynamic type U.
 template<typename U, typename T>
-  inline bool 
+  inline bool
   is(const T* t) { return as<U>(t); }
-
@@ -5,6 +5,9 @@
 #include "location.hpp"
 #include "tokens.hpp"
 #include "error.hpp"
+#include "arena.hpp"
+
+#include <new>
 
 // This is a library of generic parsing algorithms. There are two
 // concepts, Parser and Token, that must be supplied by a concrete
@@ -18,10 +21,15 @@ namespace parse {
 template<typename P>
   using Token_type = typename P::Token_type;
 
+// An alias naming the type through which a parser refers to the tokens
+// of its stream.
+template<typename P>
+  using View_type = typename P::View_type;
+
 template<typename P> bool end_of_stream(const P&);
 
-template<typename P> const Token_type<P>* peek(const P&);
-template<typename P> const Token_type<P>* peek(const P&, std::size_t);
+template<typename P> View_type<P> peek(const P&);
+template<typename P> View_type<P> peek(const P&, std::size_t);
 
 template<typename P> bool next_token_is(const P&, Token_kind);
 template<typename P> bool next_token_is_not(const P&, Token_kind);
@@ -8,38 +8,26 @@ template<typename P>
 // Returns true if there are no more tokens.
 template<typename P>
   inline bool 
-  end_of_stream(const P& p) { return p.current == p.last; }
+  end_of_stream(const P& p) { return p.toks->kind(p.current) == error_tok; }
 
-// Returns a pointer to the current token or nullptr if
-// the parser has consume the last token.
+// Returns a view of the current token, which is null if the parser
+// has consumed the last token.
 template<typename P>
-  inline const Token_type<P>*
-  peek(const P& p) { 
-    if (end_of_stream(p))
-      return nullptr;
-    else
-      return &*p.current; 
-  }
+  inline View_type<P>
+  peek(const P& p) { return p.toks->get(p.current); }
 
-// Returns a pointer to the nth token past the current token. If the
-// nth token is past the end of the token stream, returns nullptr.
+// Returns a view of the nth token past the current token. If the nth
+// token is past the end of the token stream, the view is null.
 template<typename P>
-  inline const Token_type<P>*
-  peek(const P& p, std::size_t n) {
-    if (p.last - p.current > std::ptrdiff_t(n))
-      return &*(p.current + n); 
-    else
-      return nullptr;
-  }
+  inline View_type<P>
+  peek(const P& p, std::size_t n) { return p.toks->get(p.current + n); }
 
-// Returns true if the next token has type t.
+// Returns true if the next token has type t. Only the kind of the
+// token is read.
 template<typename P>
   inline bool
   next_token_is(const P& p, Token_kind t) {
-    if (auto* k = peek(p))
-      return k->kind == t;
-    else
-      return false;
+    return p.toks->kind(p.current) == t;
   }
 
 // Returns true if the next token is something other than type t.
@@ -53,20 +41,17 @@ template<typename P>
 template<typename P>
   inline bool
   last_token_was(const P& p, Token_kind t) {
-    if (p.current == p.first)
+    if (p.prev)
+      return p.prev->kind == t;
+    else
       return false;
-    auto iter = std::prev(p.current);
-    return iter->kind == t;
   }
 
 // Returns true if the nth token has type t.
 template<typename P>
   inline bool
   nth_token_is(const P& p, std::size_t n, Token_kind t) { 
-    if (auto* tok = peek(p, n))
-      return tok->kind == t;
-    else
-      return false;
+    return p.toks->kind(p.current + n) == t;
   }
 
 // Returns the current location in the program source.
@@ -75,8 +60,8 @@ template<typename P>
 template<typename P>
   Location
   location(const P& p) { 
-    if (auto* k = peek(p))
-      return peek(p)->loc; 
+    if (auto k = peek(p))
+      return k.location();
     else
       return eof_location;
   }
@@ -86,14 +71,20 @@ template<typename P>
   inline Diagnostic_stream
   parse_error(const P& p) { return error(location(p)); }
 
-// Returns the current token, and advances the parser.
+// Returns the current token, and advances the parser. The consumed
+// token is created in the current arena from its view so that it
+// outlives its position in the token stream, which may then be
+// discarded.
 //
 // TODO: Implement brace matching for consumed tokens.
 template<typename P>
   inline const Token_type<P>*
   consume(P& p) {
-    auto* tok = &*p.current;
+    using T = Token_type<P>;
+    T* tok = new (current_arena().allocate(sizeof(T))) T(peek(p).token());
     ++p.current;
+    p.toks->discard(p.current);
+    p.prev = tok;
     return tok;
   }
 
@@ -102,10 +93,8 @@ template<typename P>
 template<typename P>
   inline const Token_type<P>*
   accept(P& p, Token_kind k) {
-    if (auto* tok = peek(p)) {
-      if (tok->kind == k)
-        return consume(p);
-    }
+    if (next_token_is(p, k))
+      return consume(p);
     return nullptr;
   }
 
@@ -123,7 +112,7 @@ template<typename P>
     } else {
       error(location(p)) << format("expected '{}' but found '{}'",
                                    token_name(k), 
-                                   token_name(p.current->kind));
+                                   token_name(peek(p).kind()));
     }
 
     return nullptr;
@@ -239,9 +228,10 @@ namespace {
 template<typename P>
   inline void
   begin_tentative_parse(P& op, P& tp) {
-    tp.first = op.first;
-    tp.last = op.last;
+    tp.toks = op.toks;
     tp.current = op.current;
+    tp.prev = op.prev;
+    tp.toks->hold();
     use_diagnostics(tp.diags);
   }
 
@@ -253,6 +243,9 @@ template<typename P>
   inline void
   commit_tentative_parse(P& op, P& tp) {
     op.current = tp.current;
+    op.prev = tp.prev;
+    op.toks->unhold();
+    op.toks->discard(op.current);
     op.diags.insert(op.diags.end(), tp.diags.begin(), tp.diags.end());
     use_diagnostics(op.diags);
   }
@@ -262,6 +255,7 @@ template<typename P>
 template<typename P>
   inline void
   abort_tentative_parse(P& op, P& tp) { 
+    op.toks->unhold();
     use_diagnostics(op.diags);
   }
 
@@ -0,0 +1,99 @@
+#include "prefetch.hpp"
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace {
+
+// The size of each read of a prefetched file.
+constexpr std::size_t prefetch_block = 1 << 20;
+
+struct Prefetcher {
+  ~Prefetcher();
+
+  void request(const std::string&);
+  void work();
+  void read(const std::string&);
+
+  std::mutex mutex;
+  std::condition_variable ready;
+  std::deque<std::string> queue;
+  std::unordered_set<std::string> seen;
+  std::thread thread;
+  std::atomic<bool> stop{false};
+};
+
+Prefetcher::~Prefetcher() {
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    stop = true;
+  }
+  ready.notify_one();
+  if (thread.joinable())
+    thread.join();
+}
+
+void
+Prefetcher::request(const std::string& path) {
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (not seen.insert(path).second)
+      return;
+    queue.push_back(path);
+    if (not thread.joinable())
+      thread = std::thread(&Prefetcher::work, this);
+  }
+  ready.notify_one();
+}
+
+void
+Prefetcher::work() {
+  while (true) {
+    std::string path;
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      ready.wait(lock, [this] { return stop or not queue.empty(); });
+      if (stop)
+        return;
+      path = std::move(queue.front());
+      queue.pop_front();
+    }
+    read(path);
+  }
+}
+
+// Read the file into the page cache, stopping early when the program
+// exits.
+void
+Prefetcher::read(const std::string& path) {
+  int fd = ::open(path.c_str(), O_RDONLY);
+  if (fd < 0)
+    return;
+  ::posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+  std::vector<char> buf(prefetch_block);
+  while (not stop and ::read(fd, buf.data(), buf.size()) > 0)
+    ;
+  ::close(fd);
+}
+
+Prefetcher&
+get_prefetcher() {
+  static Prefetcher p;
+  return p;
+}
+
+} // namespace
+
+// Request that the named file be read in the background.
+void
+prefetch_file(const std::string& path) {
+  get_prefetcher().request(path);
+}
@@ -0,0 +1,19 @@
+#ifndef PREFETCH_HPP
+#define PREFETCH_HPP
+
+#include <string>
+
+// This module reads files ahead of their use, so that a file that is
+// later mapped (see mapped_file.hpp) is read from memory rather than
+// waiting on the disk.
+//
+// Requested files are read by a single background thread, in the order
+// in which they are requested, into the page cache of the system; their
+// contents are not kept. Each file is read at most once. A file that
+// cannot be read is ignored, since the error is reported when the file
+// is used. The thread is started by the first request, and is stopped
+// when the program exits, abandoning any file not yet read.
+
+void prefetch_file(const std::string&);
+
+#endif
@@ -1,20 +1,123 @@
-
 #include <cctype>
 #include <algorithm>
-#include <unordered_set>
+#include <mutex>
+#include <new>
+#include <vector>
 
 #include "string.hpp"
+#include "arena.hpp"
+
+// -------------------------------------------------------------------------- //
+// String table
+//
+// The string table is divided into shards, each guarded by its own
+// mutex, so that threads interning different strings rarely contend
+// for the same lock. The shard of a string is selected by the high
+// bits of its hash.
+//
+// Each shard is an open-addressed hash table of string representations,
+// whose characters are allocated in an arena owned by the shard. An
+// interned string costs the size of its representation and characters,
+// and one slot in the table.
 
 namespace {
 
-// The string table.
-static std::unordered_set<std::string> strings_;
+using Rep = String::Rep;
+
+constexpr std::size_t shard_bits = 5;
+constexpr std::size_t num_shards = 1 << shard_bits;
+
+// The size of the blocks from which characters are allocated.
+constexpr std::size_t chars_block_size = 4096;
+
+// Returns the FNV-1a hash of the n characters of s.
+inline std::uint32_t
+hash_chars(const char* s, std::size_t n) {
+  std::uint32_t h = 2166136261u;
+  for (std::size_t i = 0; i < n; ++i) {
+    h ^= static_cast<unsigned char>(s[i]);
+    h *= 16777619u;
+  }
+  return h;
+}
+
+// Returns true if the representation r has the given characters.
+inline bool
+has_chars(const Rep* r, const char* s, std::size_t n, std::uint32_t h) {
+  return r->hash == h and r->size == n and std::memcmp(r->data(), s, n) == 0;
+}
+
+struct Shard {
+  Shard()
+    : chars(chars_block_size), count(0), slots(16, nullptr) { }
+
+  const Rep* intern(const char*, std::size_t, std::uint32_t);
+  void grow();
+
+  std::mutex mutex;
+  Arena chars;                   // Storage for representations
+  std::size_t count;             // The number of strings
+  std::vector<const Rep*> slots; // The table (its size is a power of 2)
+};
 
-} // namesapce
+// Returns the interned string having the n characters of s, whose
+// hash is h, inserting it if needed.
+const Rep*
+Shard::intern(const char* s, std::size_t n, std::uint32_t h) {
+  std::size_t mask = slots.size() - 1;
+  std::size_t i = h & mask;
+  for (; slots[i]; i = (i + 1) & mask)
+    if (has_chars(slots[i], s, n, h))
+      return slots[i];
 
-// Returns a pointer to a unique string with the same spelling as str.
-const std::string* 
-String::intern(const std::string& str) { return &*strings_.insert(str).first; }
+  void* p = chars.allocate(sizeof(Rep) + n + 1);
+  Rep* r = new (p) Rep {std::uint32_t(n), h};
+  char* d = const_cast<char*>(r->data());
+  std::memcpy(d, s, n);
+  d[n] = 0;
+  slots[i] = r;
+
+  // Keep the table at most half full.
+  if (2 * ++count > slots.size())
+    grow();
+  return r;
+}
+
+// Double the size of the table.
+void
+Shard::grow() {
+  std::vector<const Rep*> old(2 * slots.size(), nullptr);
+  old.swap(slots);
+  std::size_t mask = slots.size() - 1;
+  for (const Rep* r : old) {
+    if (not r)
+      continue;
+    std::size_t i = r->hash & mask;
+    while (slots[i])
+      i = (i + 1) & mask;
+    slots[i] = r;
+  }
+}
+
+// Returns the shards of the string table. The table is never destroyed,
+// since strings may be used during the destruction of static objects.
+Shard*
+get_shards() {
+  static Shard* shards = new Shard[num_shards];
+  return shards;
+}
+
+} // namespace
+
+// Returns the unique string with the same spelling as the n characters
+// of s.
+const String::Rep*
+String::intern(const char* s, std::size_t n) {
+  std::uint32_t h = hash_chars(s, n);
+  Shard& shard = get_shards()[h >> (32 - shard_bits)];
+  std::lock_guard<std::mutex> lock(shard.mutex);
+  return shard.intern(s, n, h);
+}
 
 // Convert a string to lowercase.
 String
@@ -1,6 +1,7 @@
 #ifndef STRING_HPP
 #define STRING_HPP
 
+#include <cstdint>
 #include <cstring>
 #include <string>
 #include <iosfwd>
@@ -11,17 +12,21 @@
 // that each unique occurrence of a string in the text of a program appears
 // only once in the memory of the program.
 //
+// The characters of interned strings are stored in arenas, and are never
+// freed. Strings may be interned concurrently from any thread.
+//
 // The String class is a regular, but reference semantic type.
 class String {
 public:
-  using iterator       = std::string::const_iterator;
-  using const_iterator = std::string::const_iterator;
+  using iterator       = const char*;
+  using const_iterator = const char*;
 
   // Constructors
   String();
   String(const std::string& s);
   String(const char* s);
   String(const char* s, std::size_t n);
+  String(const char* first, const char* last);
 
   template<typename I> String(I first, I last);
 
@@ -30,8 +35,8 @@ public:
 
   // Observers
   std::size_t size() const;
-  const std::string* ptr() const;
-  const std::string& str() const;
+  const void* ptr() const;
+  std::string str() const;
   const char* data() const;
 
   // Iterators
@@ -41,11 +46,20 @@ public:
   const_iterator begin() const;
   const_iterator end() const;
 
+  // The representation of an interned string. The null-terminated
+  // characters of the string immediately follow the representation.
+  struct Rep {
+    std::uint32_t size;
+    std::uint32_t hash;
+
+    const char* data() const { return reinterpret_cast<const char*>(this + 1); }
+  };
+
 private:
-  static const std::string* intern(const std::string&);
+  static const Rep* intern(const char*, std::size_t);
 
 private:
-  const std::string* str_;
+  const Rep* rep_;
 };
 
 // Equality comparison
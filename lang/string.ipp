@@ -1,19 +1,23 @@
 
 inline 
 String::String() 
-  : str_(nullptr) { }
+  : rep_(nullptr) { }
   
 inline
 String::String(const std::string& s)
-  : str_(intern(s)) { }
+  : rep_(intern(s.data(), s.size())) { }
 
 inline
 String::String(const char* s)
-  : String(std::string(s)) { }
+  : rep_(intern(s, std::strlen(s))) { }
 
 inline
 String::String(const char* s, std::size_t n)
-  : String(std::string(s, n)) { }
+  : rep_(intern(s, n)) { }
+
+inline
+String::String(const char* first, const char* last)
+  : rep_(intern(first, last - first)) { }
 
 template<typename I>
 inline
@@ -23,36 +27,36 @@ String::String(I first, I last)
 
 /// Returns true if the string is non-null.
 inline 
-String::operator bool() const { return str_; }
+String::operator bool() const { return rep_; }
 
 /// Returns the number of characters in the string.
 inline std::size_t 
-String::size() const { return str_->size(); }
+String::size() const { return rep_->size; }
 
-/// Returns the underlying string pointer.
-inline const std::string* 
-String::ptr() const { return str_; }
+/// Returns a pointer that uniquely identifies the string.
+inline const void* 
+String::ptr() const { return rep_; }
 
-/// Returns a reference to the underlying string.
-inline const std::string& 
-String::str() const { return *str_; }
+/// Returns a copy of the string.
+inline std::string
+String::str() const { return std::string(data(), size()); }
 
-/// Returns a pointer to the underlying character data.
+/// Returns a pointer to the underlying (null-terminated) character data.
 inline const char* 
-String::data() const { return str().c_str(); }
+String::data() const { return rep_->data(); }
 
 // Iterators
 inline String::iterator 
-String::begin() { return str_->begin(); }
+String::begin() { return data(); }
 
 inline String::iterator 
-String::end() { return str_->end(); }
+String::end() { return data() + size(); }
 
 inline String::const_iterator
-String::begin() const { return str_->begin(); }
+String::begin() const { return data(); }
 
 inline String::const_iterator 
-String::end() const { return str_->end(); }
+String::end() const { return data() + size(); }
 
 // Equality comparison
 // Returns true when two strings refer to the same object.
@@ -89,7 +93,7 @@ template<typename C>
 // Streaming
 template<typename C, typename T>
   inline std::basic_ostream<C, T>&
-  operator<<(std::basic_ostream<C, T>& os, String s) { return os << s.str(); }
+  operator<<(std::basic_ostream<C, T>& os, String s) { return os << s.data(); }
 
 namespace std {
 
@@ -0,0 +1,200 @@
+
+#include "thread_pool.hpp"
+
+#include <algorithm>
+
+namespace {
+
+// True for the threads of a pool, and for a thread running a loop.
+thread_local bool in_loop_ = false;
+
+// The index of a thread of a pool. This is 0 for other threads.
+thread_local std::size_t index_ = 0;
+
+// The number of threads requested for the global pool. When zero, one
+// thread per core is used.
+std::size_t thread_count_ = 0;
+
+} // namespace
+
+// -------------------------------------------------------------------------- //
+// Thread pool
+
+// Create a pool of n threads, including the calling thread. A pool
+// of one thread runs every loop serially.
+Thread_pool::Thread_pool(std::size_t n)
+  : job_(nullptr), gen_(0), active_(0), busy_(false), stop_(false)
+{
+  for (std::size_t i = 1; i < n; ++i)
+    threads_.emplace_back(&Thread_pool::work, this, i);
+}
+
+Thread_pool::~Thread_pool() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stop_ = true;
+  }
+  start_.notify_all();
+  for (std::thread& t : threads_)
+    t.join();
+}
+
+// Returns the number of chunks of the given size in a loop over n
+// elements.
+std::size_t
+Thread_pool::chunk_count(std::size_t n, std::size_t grain) {
+  return (n + grain - 1) / grain;
+}
+
+// Returns the index of the calling thread in its pool, which is in
+// the range [1, size()), or 0 if the thread is not in a pool. Loops
+// may use the index to select storage owned by each thread.
+std::size_t
+Thread_pool::thread_index() { return index_; }
+
+// Returns true if the calling thread is in a pool, or is running a
+// loop.
+bool
+Thread_pool::in_loop() { return in_loop_; }
+
+// Run every loop started by the calling thread serially. This is used
+// by a process forked from one using a pool, since the threads of the
+// pool are not copied into the new process.
+void
+Thread_pool::run_serially() { in_loop_ = true; }
+
+// Run f for each chunk of a loop over n elements, where each chunk
+// has the given number of elements, returning when all chunks have
+// been run. If f throws an exception for any chunk, the first such 
+// exception is rethrown after the loop.
+void
+Thread_pool::run(std::size_t n, const Chunk_fn& f, std::size_t grain) {
+  std::size_t k = chunk_count(n, grain);
+  bool serial = k <= 1 or threads_.empty() or in_loop_;
+  if (not serial) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    serial = busy_;
+    busy_ = true;
+  }
+  if (serial) {
+    for (std::size_t c = 0; c < k; ++c)
+      f(c, c * grain, std::min(n, (c + 1) * grain));
+    return;
+  }
+
+  // Divide the chunks between the threads. The caller takes the first
+  // share.
+  std::size_t p = size();
+  Job job {&f, n, grain, std::vector<Share>(p), {0}, nullptr};
+  for (std::size_t i = 0; i < p; ++i) {
+    job.shares[i].next = k * i / p;
+    job.shares[i].last = k * (i + 1) / p;
+  }
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    job_ = &job;
+    ++gen_;
+  }
+  start_.notify_all();
+
+  in_loop_ = true;
+  run_share(job, 0);
+  in_loop_ = false;
+
+  // Wait for the threads that joined the job to finish. No thread can
+  // join once the job has been withdrawn.
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    end_.wait(lock, [&] { return job.done == k and active_ == 0; });
+    job_ = nullptr;
+    busy_ = false;
+  }
+  if (job.error)
+    std::rethrow_exception(job.error);
+}
+
+// The main loop of the ith thread in the pool, which first runs the
+// ith share of each job.
+void
+Thread_pool::work(std::size_t i) {
+  in_loop_ = true;
+  index_ = i;
+  std::size_t seen = 0;
+  while (true) {
+    Job* job;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      start_.wait(lock, [&] { return stop_ or (job_ and gen_ != seen); });
+      if (stop_)
+        return;
+      seen = gen_;
+      job = job_;
+      ++active_;
+    }
+    run_share(*job, i);
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      --active_;
+    }
+    end_.notify_all();
+  }
+}
+
+// Run the chunks of the ith share of the job, and then those of the
+// other shares.
+void
+Thread_pool::run_share(Job& job, std::size_t i) {
+  std::size_t p = job.shares.size();
+  for (std::size_t j = 0; j < p; ++j) {
+    Share& s = job.shares[(i + j) % p];
+    while (run_chunk(job, s))
+      ;
+  }
+}
+
+// Run the next chunk of the share, if any. Returns false when the
+// share is empty.
+bool
+Thread_pool::run_chunk(Job& job, Share& s) {
+  std::size_t c = s.next++;
+  if (c >= s.last)
+    return false;
+  try {
+    std::size_t first = c * job.grain;
+    (*job.fn)(c, first, std::min(job.n, first + job.grain));
+  } catch (...) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (not job.error)
+      job.error = std::current_exception();
+  }
+  if (++job.done == chunk_count(job.n, job.grain)) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    end_.notify_all();
+  }
+  return true;
+}
+
+
+// -------------------------------------------------------------------------- //
+// Global thread pool
+
+// Set the number of threads in the global pool. This has no effect
+// once the pool has been created.
+void
+set_thread_count(std::size_t n) { thread_count_ = n; }
+
+// Returns the global thread pool, creating it on first use.
+Thread_pool&
+get_thread_pool() {
+  static Thread_pool* pool = nullptr;
+  static std::once_flag once;
+  std::call_once(once, [] {
+    std::size_t n = thread_count_;
+    if (n == 0)
+      n = std::thread::hardware_concurrency();
+    if (n == 0)
+      n = 1;
+    pool = new Thread_pool(n);
+  });
+  return *pool;
+}
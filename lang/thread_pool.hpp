@@ -0,0 +1,111 @@
+#ifndef THREAD_POOL_HPP
+#define THREAD_POOL_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// This module provides a pool of threads for running data-parallel
+// loops over large sequences (e.g., the rows of a table).
+//
+// A loop over n elements is divided into chunks of consecutive
+// elements (by default, chunk_size elements), and the chunks are divided evenly between the threads of
+// the pool and the calling thread. Each thread runs the chunks of its
+// own share in order, and then steals chunks from the shares of other
+// threads until none remain. A loop returns when every chunk has
+// been run.
+//
+// The function run for each chunk is given the index of the chunk,
+// so that results computed for each chunk can be combined in the
+// order of the sequence. That function must not allocate nodes (the
+// current arena is not shared), and so must not evaluate terms by
+// substitution, unless it makes the arena of its thread current (see
+// thread_index). Loops are run serially when they are too small to
+// be worth dividing, and when they are started within another loop.
+
+struct Thread_pool {
+  // The number of elements in a chunk.
+  static constexpr std::size_t chunk_size = 1024;
+
+  // The function run for each chunk: f(chunk, first, last).
+  using Chunk_fn = std::function<void(std::size_t, std::size_t, std::size_t)>;
+
+  Thread_pool(std::size_t);
+  ~Thread_pool();
+
+  Thread_pool(const Thread_pool&) = delete;
+  Thread_pool& operator=(const Thread_pool&) = delete;
+
+  std::size_t size() const { return threads_.size() + 1; }
+
+  static std::size_t chunk_count(std::size_t, std::size_t = chunk_size);
+  static std::size_t thread_index();
+  static bool in_loop();
+  static void run_serially();
+
+  void run(std::size_t, const Chunk_fn&, std::size_t = chunk_size);
+
+private:
+  // The chunks assigned to a thread. Chunks are taken from the front
+  // of the share by its owner and by thieves alike.
+  struct Share {
+    std::atomic<std::size_t> next;
+    std::size_t last;
+  };
+
+  // A loop in progress.
+  struct Job {
+    const Chunk_fn* fn;
+    std::size_t n;
+    std::size_t grain;
+    std::vector<Share> shares;
+    std::atomic<std::size_t> done;
+    std::exception_ptr error;
+  };
+
+  void work(std::size_t);
+  void run_share(Job&, std::size_t);
+  bool run_chunk(Job&, Share&);
+
+  std::vector<std::thread> threads_;
+  std::mutex mutex_;              // Guards the members below
+  std::condition_variable start_; // Signals a new job (or stop)
+  std::condition_variable end_;   // Signals the end of a job
+  Job* job_;                      // The current job
+  std::size_t gen_;               // The number of jobs started
+  std::size_t active_;            // Threads working on the job
+  bool busy_;                     // True when a job is running
+  bool stop_;                     // True when the pool is shut down
+};
+
+
+// Returns the concatenation of the results computed for each chunk of
+// a loop, in the order of the chunks.
+template<typename T>
+  std::vector<T>
+  concat_chunks(std::vector<std::vector<T>>& parts) {
+    if (parts.size() == 1)
+      return std::move(parts.front());
+    std::size_t n = 0;
+    for (const std::vector<T>& p : parts)
+      n += p.size();
+    std::vector<T> result;
+    result.reserve(n);
+    for (const std::vector<T>& p : parts)
+      result.insert(result.end(), p.begin(), p.end());
+    return result;
+  }
+
+
+// -------------------------------------------------------------------------- //
+// Global thread pool
+
+void set_thread_count(std::size_t);
+Thread_pool& get_thread_pool();
+
+#endif
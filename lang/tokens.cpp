@@ -1,5 +1,8 @@
 
+#include <algorithm>
+#include <cstring>
 #include <unordered_map>
+#include <vector>
 
 #include "tokens.hpp"
 #include "debug.hpp"
@@ -11,9 +14,66 @@ namespace {
 // of values expected tokens.
 std::unordered_map<Token_kind, String> tokens_;
 
-// A mapping from keyword strings to tokens. This is used by the
-// lexer to find token kinds based on the spelling of strings
-std::unordered_map<String, Token_kind> keywords_;
+// A keyword and its token kind.
+struct Keyword {
+  String str;
+  Token_kind kind;
+};
+
+// The keywords are found by the lexer in a perfect hash table: each
+// keyword has a slot of its own, which is found from a hash of its
+// spelling and a seed. The seed (and size) of the table are chosen
+// when it is built, so that no two keywords share a slot. The table is
+// rebuilt as keywords are registered; lookups just hash the characters
+// of a word and compare them with those of a single keyword.
+std::vector<Keyword> keywords_;
+std::vector<Keyword> keyword_slots_;
+std::uint32_t keyword_seed_ = 0;
+std::size_t keyword_size_ = 0;
+
+// Returns the hash of the n characters at s for the given seed.
+inline std::uint32_t
+hash_keyword(std::uint32_t seed, const char* s, std::size_t n) {
+  std::uint32_t h = seed ^ std::uint32_t(n);
+  for (std::size_t i = 0; i < n; ++i)
+    h = (h ^ static_cast<unsigned char>(s[i])) * 16777619u;
+  return h ^ (h >> 15);
+}
+
+// Returns true if the keywords have distinct slots in a table of n
+// slots using the given seed, filling those slots.
+bool
+fill_keyword_slots(std::uint32_t seed, std::size_t n) {
+  keyword_slots_.assign(n, Keyword {String(), error_tok});
+  for (const Keyword& k : keywords_) {
+    Keyword& slot = keyword_slots_[hash_keyword(seed, k.str.data(), k.str.size()) & (n - 1)];
+    if (slot.kind != error_tok)
+      return false;
+    slot = k;
+  }
+  return true;
+}
+
+// Build the keyword table, starting with a table of at least twice as
+// many slots as keywords.
+void
+build_keywords() {
+  std::size_t n = 8;
+  while (n < 2 * keywords_.size())
+    n *= 2;
+  keyword_size_ = 0;
+  for (const Keyword& k : keywords_)
+    keyword_size_ = std::max(keyword_size_, k.str.size());
+  while (true) {
+    for (std::uint32_t seed = 1; seed <= 1024; ++seed) {
+      if (fill_keyword_slots(seed, n)) {
+        keyword_seed_ = seed;
+        return;
+      }
+    }
+    n *= 2;
+  }
+}
 
 inline String
 get_name(Token_kind k) {
@@ -36,9 +96,10 @@ save_token(Token_kind k, const char* s) {
 // Insert the token as a keyword.
 void
 save_keyword(Token_kind k, const char* s) { 
-  lang_assert(keywords_.count(s) == 0, 
+  lang_assert(keyword(s) == error_tok,
               format("keyword '{0}' already registered", s));
-  keywords_.insert({s, k}); 
+  keywords_.push_back({s, k});
+  build_keywords();
 }
 
 } // namespace
@@ -72,10 +133,23 @@ token_name(Token_kind k) {
 // or error_tok if no such keyword is availble.
 Token_kind
 keyword(String s) {
-  auto iter = keywords_.find(s);
-  if (iter != keywords_.end())
-    return iter->second;
-  return error_tok;
+  String str;
+  return keyword(s.data(), s.size(), str);
+}
+
+// Returns the token kind of the keyword spelled by the n characters at
+// s, or error_tok if they do not spell a keyword. The spelling of the
+// keyword is assigned to str, so that the lexer need not intern it.
+Token_kind
+keyword(const char* s, std::size_t n, String& str) {
+  if (n > keyword_size_)
+    return error_tok;
+  std::size_t mask = keyword_slots_.size() - 1;
+  const Keyword& k = keyword_slots_[hash_keyword(keyword_seed_, s, n) & mask];
+  if (k.kind == error_tok or k.str.size() != n or std::memcmp(k.str.data(), s, n) != 0)
+    return error_tok;
+  str = k.str;
+  return k.kind;
 }
 
 String
@@ -100,3 +174,31 @@ as_integer(const Token& k) {
   }
   lang_unreachable("invalid integer token");
 }
+
+
+// -------------------------------------------------------------------------- //
+// Token buffer
+
+// Append a token of kind k at the given location. The spelling s is
+// null if it is implied by the kind.
+void
+Token_buffer::push(Token_kind k, Location loc, String s) {
+  kinds.push_back(k);
+  locs.push_back(loc);
+  texts.push_back(s);
+}
+
+// Remove the first n tokens of the buffer.
+void
+Token_buffer::erase(std::size_t n) {
+  kinds.erase(kinds.begin(), kinds.begin() + n);
+  locs.erase(locs.begin(), locs.begin() + n);
+  texts.erase(texts.begin(), texts.begin() + n);
+}
+
+// Returns the nth token.
+Token
+Token_buffer::token(std::size_t n) const {
+  String s = texts[n] ? texts[n] : token_name(kinds[n]);
+  return Token(locs[n], kinds[n], s);
+}
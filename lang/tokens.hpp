@@ -2,6 +2,8 @@
 #ifndef TOKENS_HPP
 #define TOKENS_HPP
 
+#include <vector>
+
 #include "string.hpp"
 #include "integer.hpp"
 #include "location.hpp"
@@ -152,8 +154,44 @@ struct Token {
   String     text; // A textual represntation of the symbol
 };
 
-using Tokens = std::vector<Token>;
-using Token_iterator = Tokens::const_iterator;
+// A token buffer stores a sequence of tokens in parallel arrays of
+// their kinds, the locations of their first characters, and their
+// spellings, so that the kinds of consecutive tokens are adjacent in
+// memory. Tokens whose spelling is implied by their kind (symbols) have
+// no spelling in the buffer.
+struct Token_buffer {
+  std::size_t size() const { return kinds.size(); }
+  bool empty() const { return kinds.empty(); }
+
+  void push(Token_kind, Location, String);
+  void erase(std::size_t);
+
+  Location location(std::size_t n) const { return locs[n]; }
+  Token token(std::size_t) const;
+
+  std::vector<Token_kind> kinds; // The kind of each token
+  std::vector<Location>   locs;  // The location of each token
+  std::vector<String>     texts; // The spelling of each token, if any
+};
+
+using Tokens = Token_buffer;
+
+// A token view refers to a token in a buffer by its position, so that
+// its location and spelling are only found when needed. A null view
+// refers to no token.
+struct Token_view {
+  Token_view() : buf(nullptr), pos(0) { }
+  Token_view(const Token_buffer* b, std::size_t n) : buf(b), pos(n) { }
+
+  explicit operator bool() const { return buf; }
+
+  Token_kind kind() const { return buf->kinds[pos]; }
+  Location location() const { return buf->location(pos); }
+  Token token() const { return buf->token(pos); }
+
+  const Token_buffer* buf;
+  std::size_t         pos;
+};
 
 
 // -------------------------------------------------------------------------- //
@@ -177,6 +215,7 @@ template<typename C, typename T>
 void init_token(Token_kind, const char*);
 String token_name(Token_kind);
 Token_kind keyword(String);
+Token_kind keyword(const char*, std::size_t, String&);
 
 // -------------------------------------------------------------------------- //
 // Token elaboration
@@ -5,8 +5,13 @@
 
 extern void init_tokens();
 extern void init_nodes();
+extern void init_trees();
 extern void init_types();
 extern void init_values();
+extern void init_eval();
+extern void init_subst();
+extern void init_same();
+extern void init_less();
 
 namespace {
 // Language initialization flag.
@@ -26,6 +31,11 @@ Language::Language() {
   init_lang();
   init_tokens();
   init_nodes();
+  init_trees();
+  init_eval();
+  init_subst();
+  init_same();
+  init_less();
   init_types();
   init_values();
 }
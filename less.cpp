@@ -3,7 +3,9 @@
 
 #include "lang/debug.hpp"
 
+#include <algorithm>
 #include <cassert>
+#include <cstring>
 
 // -------------------------------------------------------------------------- //
 // Less-than-comparison for expressions
@@ -46,36 +48,94 @@ template<typename T>
     return is_less(a->t3, b->t3);
   }
 
+inline bool
+less_int(Int* a, Int* b) { return a->value() < b->value(); }
+
+// Strings are ordered by their characters (unlike names, which are
+// ordered by their interned representation), so that 'lt' and ordered
+// selections compare strings lexicographically.
+inline bool
+less_str(Str* a, Str* b) {
+  String s1 = a->value();
+  String s2 = b->value();
+  if (s1 == s2)
+    return false;
+  int c = std::memcmp(s1.data(), s2.data(), std::min(s1.size(), s2.size()));
+  return c < 0 or (c == 0 and s1.size() < s2.size());
+}
+
+// Nodes without operands are ordered by kind alone.
+bool
+less_kind(Expr* a, Expr* b) { return false; }
+
+bool
+less_unknown(Expr* a, Expr* b) {
+  lang_unreachable(format("comparison of unknown node '{}'", node_name(a)));
+}
+
+using Less_rule = bool (*)(Expr*, Expr*);
+
+Node_table<Less_rule> less_rules_(less_unknown);
+
+template<typename T, bool (*F)(T*, T*)>
+  bool
+  less_rule(Expr* a, Expr* b) {
+    return F(static_cast<T*>(a), static_cast<T*>(b));
+  }
+
+// Define the rule for nodes of type T.
+template<typename T, bool (*F)(T*, T*)>
+  inline void
+  define_less() { less_rules_.define(T::node_kind, less_rule<T, F>); }
+
+// Define the rule for each of the kinds ks.
+inline void
+define_less(std::initializer_list<Node_kind> ks, Less_rule f) {
+  for (Node_kind k : ks)
+    less_rules_.define(k, f);
+}
+
 } // namespace
 
+// Initialize the ordering rules. Every kind of name, type and term has
+// a rule.
+void
+init_less() {
+  define_less<Id, less_unary<Id>>();
+  define_less<Int, less_int>();
+  define_less<Str, less_str>();
+  define_less<If, less_ternary<If>>();
+  define_less<Succ, less_unary<Succ>>();
+  define_less<Pred, less_unary<Pred>>();
+  define_less<Iszero, less_unary<Iszero>>();
+  define_less<Var, less_binary<Var>>();
+  define_less<Abs, less_binary<Abs>>();
+  define_less<App, less_binary<App>>();
+  define_less<Ref, less_unary<Ref>>();
+  define_less<Def, less_unary<Def>>();
+  define_less<Arrow_type, less_binary<Arrow_type>>();
+  define_less({unit_term, true_term, false_term, kind_type, unit_type,
+               bool_type, nat_type},
+              less_kind);
+  define_less({and_term, or_term, not_term, equals_term, less_term, fn_term,
+               call_term, closure_term, tuple_term, list_term, record_term,
+               variant_term, comma_term, proj_term, mem_term, col_term,
+               init_term, table_term, select_term, group_term, agg_term,
+               order_term, join_on_term, union_term, intersect_term,
+               except_term, load_term, save_term, csv_term, print_term,
+               prog_term, str_type, fn_type, tuple_type, list_type, record_type,
+               variant_type, wild_type},
+              less_unknown);
+  less_rules_.check(name_class, "ordering");
+  less_rules_.check(type_class, "ordering");
+  less_rules_.check(term_class, "ordering");
+}
+
 bool
 is_less(Expr* a, Expr* b) {
   if (a->kind < b->kind)
     return true;
   if (b->kind < a->kind)
     return false;
-  switch(a->kind) {
-  case id_expr: return less_unary(as<Id>(a), as<Id>(b));
-  case unit_term: return false;
-  case true_term: return false;
-  case false_term: return false;
-  case int_term: return as<Int>(a)->value() < as<Int>(b)->value();
-  case if_term: return less_ternary(as<If>(a), as<If>(b));
-  case succ_term: return less_unary(as<Succ>(a), as<Succ>(b));
-  case pred_term: return less_unary(as<Pred>(a), as<Pred>(b));
-  case iszero_term: return less_unary(as<Iszero>(a), as<Iszero>(b));
-  case var_term: return less_binary(as<Var>(a), as<Var>(b));
-  case abs_term: return less_binary(as<Abs>(a), as<Abs>(b));
-  case app_term: return less_binary(as<App>(a), as<App>(a));
-  case ref_term: return less_unary(as<Ref>(a), as<Ref>(b));
-  case def_term: return less_unary(as<Def>(a), as<Def>(b));
-  case kind_type: return false;
-  case unit_type: return false;
-  case bool_type: return false;
-  case nat_type: return false;
-  case arrow_type: return less_binary(as<Arrow_type>(a), as<Arrow_type>(b));
-  default: break;
-  }
-  lang_unreachable(format("comparison of unknown node '{}'", node_name(a)));
+  return less_rules_[a->kind](a, b);
 }
-
@@ -5,6 +5,7 @@
 #include "lexer.hpp"
 
 #include "lang/lexing.hpp"
+#include "lang/debug.hpp"
 
 namespace {
 
@@ -72,14 +73,65 @@ lex_tokens(Lexer& lex) {
 
 } // namespace
 
+// Lex the characters in [f, l), which are added to the sources of the
+// program as an unnamed source.
 Tokens
 Lexer::operator()(Iterator f, Iterator l) {
+  start(f, l, add_source(std::string(), f, l));
+  while (next())
+    ;
+  return toks;
+}
+
+// Start lexing the characters in [f, l), the first of which is at the
+// given location of the source.
+void
+Lexer::start(Iterator f, Iterator l, Location n) {
   first = f;
   last = l;
-  loc = Location();
-  use_diagnostics(diags);
-  while (first != last)
+  src = f;
+  loc = n;
+  toks = Tokens();
+}
+
+// Lex characters until at least one token has been saved, or until
+// the end of input. Returns false when no more tokens can be lexed.
+//
+// Lexical errors are diagnosed in the lexer's diagnostics, even when
+// lexing is interleaved with another phase.
+bool
+Lexer::next() {
+  Context_guard guard(cxt);
+  std::size_t n = toks.size();
+  while (first != last and toks.size() == n)
     lex_tokens(*this);
-  return toks;
+  return toks.size() != n;
 }
 
+
+// -------------------------------------------------------------------------- //
+// Token stream
+
+// Pull tokens from the lexer until the nth position of the stream is
+// buffered. Returns false if the stream ends before that position.
+bool
+Token_stream::fill(std::size_t n) {
+  if (not lex)
+    return false;
+  lang_assert(n >= base, "access to a discarded token");
+  while (n - base >= lex->toks.size())
+    if (not lex->next())
+      return false;
+  return true;
+}
+
+// Discard the buffered tokens preceding the nth position, unless the
+// stream is being held. Tokens are discarded in batches so that the
+// cost of shifting the lookahead is amortized.
+void
+Token_stream::discard(std::size_t n) {
+  if (not lex or holds or n - base < discard_size)
+    return;
+  lex->toks.erase(n - base);
+  base = n;
+}
@@ -1,24 +1,79 @@
-
 #ifndef LEXER_HPP
 #define LEXER_HPP
 
 #include "token.hpp"
 
-#include "lang/error.hpp"
+#include "lang/context.hpp"
 
 // The lexer is responsible for decomposing a character stream into
 // a token stream.
+//
+// The lexer can be used in one of two ways. Calling the lexer with
+// a character sequence lexes the entire sequence, returning the
+// resulting tokens. Alternatively, the lexer can be started on a
+// sequence and then advanced one token at a time (see Token_stream).
+//
+// Note that the lexer only accesses characters through a pair of
+// pointers, so that the input may be a string or a memory-mapped file.
 struct Lexer {
-  using Iterator = std::string::const_iterator;
+  using Iterator = const char*;
+
+  Lexer() : cxt(diags) { }
 
   Tokens operator()(const std::string&);
   Tokens operator()(Iterator, Iterator);
 
+  void start(Iterator, Iterator, Location);
+
+  // Returns the location of the current character.
+  Location location() const { return loc + (first - src); }
+  bool next();
+
   Iterator    first;
   Iterator    last;
-  Location    loc;
+  Iterator    src;   // The first character
+  Location    loc;   // The location of the first character
   Tokens      toks;
   Diagnostics diags;
+  Context     cxt;
+};
+
+
+// A token stream provides on-demand access to a sequence of tokens.
+// Tokens are identified by their position in the stream, and are
+// pulled from the lexer as they are needed. Tokens before a given
+// position can be discarded once they are no longer needed, so
+// only the lookahead of the parser (and at most discard_size
+// consumed tokens) is buffered in the lexer.
+//
+// A token stream can also be constructed over an existing sequence
+// of tokens. In that case, nothing is ever discarded.
+//
+// The parser mostly tests the kinds of the tokens in its lookahead,
+// which are read directly from the buffer. Other properties of a token
+// are found through a view of its position (see Token_view).
+//
+// Discarding tokens can be suspended (e.g., during a tentative parse)
+// by holding the stream.
+struct Token_stream {
+  static constexpr std::size_t discard_size = 256;
+
+  Token_stream(Lexer&);
+  Token_stream(const Tokens&);
+
+  Token_kind kind(std::size_t);
+  Token_view get(std::size_t);
+  void discard(std::size_t);
+
+  void hold() { ++holds; }
+  void unhold() { --holds; }
+
+  bool fill(std::size_t);
+
+  Lexer*        lex;   // The source of tokens, if any
+  const Tokens* buf;   // The buffered tokens
+  std::size_t   base;  // The position of the first buffered token
+  int           holds; // The number of holds on the stream
 };
 
 #include "lexer.ipp"
@@ -1,5 +1,33 @@
 
 inline Tokens
 Lexer::operator()(const std::string& s) {
-  return (*this)(s.begin(), s.end());
+  return (*this)(s.data(), s.data() + s.size());
+}
+
+inline
+Token_stream::Token_stream(Lexer& l)
+  : lex(&l), buf(&l.toks), base(0), holds(0) { }
+
+inline
+Token_stream::Token_stream(const Tokens& toks)
+  : lex(nullptr), buf(&toks), base(0), holds(0) { }
+
+// Returns the kind of the token at the nth position of the stream, or
+// error_tok if the stream ends before that position.
+inline Token_kind
+Token_stream::kind(std::size_t n) {
+  if (n - base < buf->size() or fill(n))
+    return buf->kinds[n - base];
+  return error_tok;
+}
+
+// Returns a view of the token at the nth position of the stream, which
+// is null if the stream ends before that position. The view is only
+// valid until the next access to the stream; consumed tokens must be
+// created from their views.
+inline Token_view
+Token_stream::get(std::size_t n) {
+  if (n - base < buf->size() or fill(n))
+    return Token_view(buf, n - base);
+  return Token_view();
 }
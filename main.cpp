@@ -1,75 +1,345 @@
 
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
 #include <iostream>
 
 #include "language.hpp"
 #include "lexer.hpp"
 #include "parser.hpp"
+#include "source.hpp"
 #include "syntax.hpp"
 #include "elab.hpp"
 #include "ast.hpp"
 #include "eval.hpp"
+#include "vm.hpp"
+#include "session.hpp"
+#include "cache.hpp"
+#include "memo.hpp"
+#include "jit.hpp"
+#include "spill.hpp"
+#include "worker.hpp"
+#include "fold.hpp"
+#include "stats.hpp"
+#include "profile.hpp"
+#include "output.hpp"
+#include "table_file.hpp"
+
+#include "lang/mapped_file.hpp"
+#include "lang/thread_pool.hpp"
 
 //remove after testing
 #include "type.hpp"
 
-int main() {
+namespace {
+
+// Stop profiling and write the profile to the named file, if any.
+void
+finish_profile(const char* profile) {
+  if (not profile)
+    return;
+  stop_profile();
+  if (not write_profile(profile))
+    std::cerr << "warning: cannot write '" << profile << "'\n";
+}
+
+// Run a session. The file at path (if any) is run as a prelude, and
+// requests are then read from standard input. A request is a sequence
+// of lines, the last of which ends with ';'. The result of each request
+// is written when the request is complete.
+int
+run_session(Engine engine, const char* path) {
+  Session session(engine);
+  if (path) {
+    Mapped_file file;
+    if (not file.open(path)) {
+      std::cerr << "error: cannot read '" << path << "': " 
+                << std::strerror(errno) << '\n';
+      return -1;
+    }
+    if (not session(file.first, file.last))
+      return -1;
+    std::cout << std::flush;
+  }
+
+  std::string req;
+  std::string line;
+  while (std::getline(std::cin, line)) {
+    req += line;
+    req += '\n';
+    std::size_t n = line.find_last_not_of(" \t\r");
+    if (n == std::string::npos or line[n] != ';')
+      continue;
+    session(req);
+    std::cout << std::flush;
+    req.clear();
+  }
+  if (req.find_first_not_of(" \t\r\n") != std::string::npos)
+    session(req);
+  return 0;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
   Language lang;
 
+  // ------------------------------------------------------------------------ //
+  // Options
+  //
+  // The evaluation engine can be selected with --engine=vm (the default),
+  // --engine=subst, or --engine=env. The compiled code is printed with
+  // --code. Queries over large tables use one thread per core, unless a
+  // number of threads is given with --threads=n. Calls to pure functions
+  // over scalars are memoized with --memo=n, which remembers up to n calls
+  // of each function (see memo.hpp). With --lazy, definitions are evaluated
+  // when first referenced (see eval.hpp). With --jit=n, the virtual machine
+  // compiles numeric functions to native code after n calls (see jit.hpp).
+  // With --memory=n, the rows kept by sorts, groupings, and joins are held
+  // to about n kilobytes, and spilled to temporary files beyond that (see
+  // spill.hpp). With --workers=n, queries over large tables are run by n
+  // worker processes, each over a partition of the table (see worker.hpp).
+  // With --fuel=n, an evaluation by the virtual machine fails after n
+  // instructions (see vm.hpp). With --stats, a report of the work done by
+  // each phase is written to standard error (see stats.hpp). With
+  // --profile=file, samples of the evaluation are written to the file as
+  // collapsed stacks (see profile.hpp). The dumps of the parsed and
+  // elaborated programs are omitted with --quiet, and printed lists and
+  // tables are cut off after n elements with --print-limit=n (see
+  // output.hpp). The program is read from the named file, if given, and
+  // from standard input otherwise.
+  Engine engine = vm_engine;
+  bool code = false;
+  bool session = false;
+  bool quiet = false;
+  const char* cache = nullptr;
+  const char* profile = nullptr;
+  const char* path = nullptr;
+  for (int i = 1; i < argc; ++i) {
+    if (std::strcmp(argv[i], "--engine=vm") == 0)
+      engine = vm_engine;
+    else if (std::strcmp(argv[i], "--engine=subst") == 0)
+      engine = subst_engine;
+    else if (std::strcmp(argv[i], "--engine=env") == 0)
+      engine = env_engine;
+    else if (std::strcmp(argv[i], "--code") == 0)
+      code = true;
+    else if (std::strcmp(argv[i], "--session") == 0)
+      session = true;
+    else if (std::strcmp(argv[i], "--quiet") == 0)
+      quiet = true;
+    else if (std::strcmp(argv[i], "--stats") == 0)
+      enable_stats();
+    else if (std::strncmp(argv[i], "--cache=", 8) == 0)
+      cache = argv[i] + 8;
+    else if (std::strncmp(argv[i], "--threads=", 10) == 0)
+      set_thread_count(std::atoi(argv[i] + 10));
+    else if (std::strncmp(argv[i], "--memo=", 7) == 0)
+      set_memo_limit(std::atoi(argv[i] + 7));
+    else if (std::strcmp(argv[i], "--lazy") == 0)
+      set_lazy_defs(true);
+    else if (std::strncmp(argv[i], "--jit=", 6) == 0)
+      set_jit_threshold(std::atoi(argv[i] + 6));
+    else if (std::strncmp(argv[i], "--memory=", 9) == 0)
+      set_memory_budget(std::strtoul(argv[i] + 9, nullptr, 10) * 1024);
+    else if (std::strncmp(argv[i], "--workers=", 10) == 0)
+      set_worker_count(std::atoi(argv[i] + 10));
+    else if (std::strncmp(argv[i], "--fuel=", 7) == 0)
+      set_fuel_limit(std::strtoul(argv[i] + 7, nullptr, 10));
+    else if (std::strncmp(argv[i], "--profile=", 10) == 0)
+      profile = argv[i] + 10;
+    else if (std::strncmp(argv[i], "--print-limit=", 14) == 0)
+      get_standard_output().limit = std::atoi(argv[i] + 14);
+    else if (argv[i][0] != '-' and not path)
+      path = argv[i];
+    else {
+      std::cerr << "usage: " << argv[0] 
+                << " [--engine=vm|subst|env] [--code] [--session] [--quiet]"
+                << " [--cache=dir] [--threads=n] [--memo=n] [--lazy] [--jit=n]"
+                << " [--memory=n] [--workers=n] [--fuel=n] [--stats]"
+                << " [--profile=file] [--print-limit=n] [file]\n";
+      return -1;
+    }
+  }
+
   // ------------------------------------------------------------------------ //
   // Character input
-  using Iter = std::istreambuf_iterator<char>;
-  std::string text(Iter(std::cin), Iter());
+  //
+  // A source file is mapped into memory rather than copied. Standard
+  // input is read into a string. The text of tokens is interned as they
+  // are lexed, so the input need not outlive the lexer.
+  // In a session, the file is a prelude.
+  if (session) {
+    if (profile)
+      start_profile(path ? path : "<stdin>");
+    int status = run_session(engine, path);
+    finish_profile(profile);
+    print_stats(std::cerr);
+    return status;
+  }
+
+  // The tables loaded by the program are read while it is elaborated
+  // (see table_file.hpp).
+  set_preload_tables(true);
+
+  Mapped_file file;
+  std::string text;
+  const char* first;
+  const char* last;
+  if (path) {
+    if (not file.open(path)) {
+      std::cerr << "error: cannot read '" << path << "': " 
+                << std::strerror(errno) << '\n';
+      return -1;
+    }
+    first = file.first;
+    last = file.last;
+  } else {
+    using Iter = std::istreambuf_iterator<char>;
+    text.assign(Iter(std::cin), Iter());
+    first = text.data();
+    last = text.data() + text.size();
+  }
 
+  // The locations of the program are offsets in its source (see
+  // location.hpp).
+  Location loc;
+  try {
+    loc = add_source(path ? path : "<stdin>", first, last);
+  } catch (Assertion_error& err) {
+    std::cerr << "error: " << err.what() << '\n';
+    return -1;
+  }
 
   // ------------------------------------------------------------------------ //
-  // Lexical analysis
+  // Program cache
   //
-  // Lex the given input text.
-  Lexer lex;
-  Tokens toks = lex(text);
-  if (not lex.diags.empty()) {
-    std::cerr << lex.diags;
-    return -1;
+  // If the program was elaborated by an earlier run, load it from the
+  // cache instead of analyzing it again.
+  Elaborator elab;
+  Expr* prog = nullptr;
+  std::uint64_t key = 0;
+  std::string cached;
+  if (cache) {
+    key = hash_source(first, last);
+    cached = cache_path(cache, key);
+    begin_phase("load");
+    Arena_guard guard(elab.arena);
+    prog = load_program(cached, key, loc);
   }
 
+  if (not prog) {
+    // ---------------------------------------------------------------------- //
+    // Lexical and syntactic analysis
+    //
+    // The parser pulls tokens from the lexer as it needs them, so the
+    // token sequence is never fully materialized. Large programs are
+    // split into chunks that are parsed in parallel (see source.hpp).
+    begin_phase("parse");
+    Source_parser parse;
+    Tree* tree = parse(first, last, loc);
+    if (not parse.lex_diags.empty()) {
+      std::cerr << parse.lex_diags;
+      return -1;
+    }
+    if (not parse.diags.empty()) {
+      std::cerr << parse.diags;
+      return -1;
+    }
+    if (not quiet)
+      std::cout << "== parsed ==\n" << pretty(tree) << '\n';
+
+    // ---------------------------------------------------------------------- //
+    // Elaboration
+    //
+    // Elaborate the parse tree, producing a fully typed abstract
+    // syntax tree. The parse tree is no longer needed after this.
+    begin_phase("elaborate");
+    prog = elab(tree);
+    if (not elab.diags.empty()) {
+      std::cerr << elab.diags;
+      return -1;
+    }
+    if (cache and prog and not save_program(cached, key, loc, prog))
+      std::cerr << "warning: cannot write '" << cached << "'\n";
+  }
+  if (not quiet)
+    std::cout << "== elaborated ==\n" << pretty(prog) << '\n';
 
   // ------------------------------------------------------------------------ //
-  // Syntactic analysis
+  // Folding
   //
-  // Parse the result.
-  Parser parse;
-  Tree* tree = parse(toks);
-  if (not parse.diags.empty()) {
-    std::cerr << parse.diags;
-    return -1;
+  // Simplify the program before it is evaluated (see fold.hpp). The
+  // cached program is the elaborated one, so the folding is repeated
+  // when it is loaded.
+  record_size("elaborated", prog);
+  if (prog) {
+    begin_phase("fold");
+    Arena_guard guard(elab.arena);
+    prog = fold_program(prog);
+    record_size("folded", prog);
   }
-  std::cout << "== parsed ==\n" << pretty(tree) << '\n';
 
   // ------------------------------------------------------------------------ //
-  // Elaboration
+  // Result cache
   //
-  // Elaborate the parse tree, producing a fully typed abstract
-  // syntax tree.
-  Elaborator elab;
-  Expr* prog = elab(tree);
-  if (not elab.diags.empty()) {
-    std::cerr << elab.diags;
-    return -1;
+  // The results of definitions computed by an earlier run over the same
+  // inputs replace those definitions before the program is compiled.
+  // The other results are saved after it is evaluated (see cache.hpp).
+  Result_cache results(cache ? cache : "");
+  if (cache) {
+    if (Prog* p = as<Prog>(prog)) {
+      Arena_guard guard(elab.arena);
+      results.load(p);
+    }
   }
-  std::cout << "== elaborated ==\n" << pretty(prog) << '\n';
 
   // ------------------------------------------------------------------------ //
   // Evaluation
   //
   // Evaluate the syntax tree, producing a partially evalutaed
-  // abstract syntax tree.
+  // abstract syntax tree. With the virtual machine, the syntax tree
+  // is first compiled into bytecode.
   if (Term* term = as<Term>(prog)) {
-    Evaluator eval;
-    std::cout << "== output ==\n";
-    Expr* result = eval(term);
-    std::cout << "== result ==\n" << pretty(result) << '\n';
+    Evaluator eval(engine);
+    Expr* result;
+    if (engine == vm_engine) {
+      begin_phase("compile");
+      Code* obj = eval.compile(term);
+      if (code) {
+        std::cout << "== compiled ==\n";
+        dump(std::cout, obj);
+      }
+      std::cout << "== output ==\n";
+      begin_phase("evaluate");
+      if (profile)
+        start_profile(path ? path : "<stdin>");
+      try {
+        result = eval(obj);
+      } catch (Fuel_error& err) {
+        // The output printed before the fuel ran out was flushed when
+        // the evaluation unwound.
+        std::cout.flush();
+        std::cerr << "error: " << err.what() << '\n';
+        return -1;
+      }
+    } else {
+      std::cout << "== output ==\n";
+      begin_phase("evaluate");
+      if (profile)
+        start_profile(path ? path : "<stdin>");
+      result = eval(term);
+    }
+    end_phase();
+    finish_profile(profile);
+    if (cache)
+      results.save();
+    record_size("result", result);
+    std::cout << "== result ==\n";
+    eval.out->print(result);
+    eval.out->flush();
   } else {
     std::cout << "== no evaluation ==\n";
   }
-
+  print_stats(std::cerr);
 }
@@ -0,0 +1,203 @@
+#include "memo.hpp"
+#include "type.hpp"
+#include "value.hpp"
+
+#include "lang/debug.hpp"
+
+#include <list>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+// A remembered scalar value. Unlike a term, a scalar does not live in
+// an arena, so it can be kept across evaluations.
+struct Scalar {
+  Node_kind kind;
+  Integer n;
+  String s;
+};
+
+inline bool
+operator==(const Scalar& a, const Scalar& b) {
+  return a.kind == b.kind and a.n == b.n and a.s == b.s;
+}
+
+// The arguments of a remembered call. The hash of the key is that of
+// the arguments (see hash.cpp), and is computed once.
+struct Memo_key {
+  std::vector<Scalar> args;
+  std::size_t hash;
+};
+
+inline bool
+operator==(const Memo_key& a, const Memo_key& b) {
+  return a.hash == b.hash and a.args == b.args;
+}
+
+struct Memo_hash {
+  std::size_t operator()(const Memo_key& k) const { return k.hash; }
+};
+
+// The remembered calls of a function, in order of use. The most
+// recently used call is at the front of the list.
+struct Memo_table {
+  using Entry = std::pair<Memo_key, Scalar>;
+  using Entry_list = std::list<Entry>;
+  using Entry_iter = Entry_list::iterator;
+
+  Entry_list entries;
+  std::unordered_map<Memo_key, Entry_iter, Memo_hash> index;
+};
+
+Abs::~Abs() { delete t4; }
+
+Fn::~Fn() { delete t4; }
+
+namespace {
+
+std::size_t memo_limit_ = 0;
+
+// The memo tables of all functions are guarded by a single mutex. A
+// lookup is cheap compared to the evaluation of a call.
+std::mutex memo_mutex_;
+
+using Memo_lock = std::lock_guard<std::mutex>;
+
+inline std::size_t
+hash_combine(std::size_t seed, std::size_t h) {
+  return seed ^ (h + 0x9e3779b9 + (seed << 6) + (seed >> 2));
+}
+
+// Returns true if t is a Unit, Bool, Nat, or Str type.
+inline bool
+is_scalar_type(Type* t) {
+  return is_unit_type(t) or is_bool_type(t) or is_nat_type(t) or is_str_type(t);
+}
+
+// Copy the value t into a scalar.
+Scalar
+get_scalar(Term* t) {
+  switch (t->kind) {
+  case unit_term:
+  case true_term:
+  case false_term:
+    return {t->kind, Integer(), String()};
+  case int_term:
+    return {t->kind, as<Int>(t)->value(), String()};
+  case str_term:
+    return {t->kind, Integer(), as<Str>(t)->value()};
+  default:
+    break;
+  }
+  lang_unreachable(format("cannot memoize value '{}'", node_name(t)));
+}
+
+// Returns the value of the scalar s, allocated in the current arena.
+Term*
+get_term(const Scalar& s) {
+  switch (s.kind) {
+  case unit_term: return get_unit();
+  case true_term: return get_true();
+  case false_term: return get_false();
+  case int_term: return new Int(get_nat_type(), s.n);
+  case str_term: return new Str(get_str_type(), s.s);
+  default: break;
+  }
+  lang_unreachable("ill-formed memo entry");
+}
+
+Memo_key
+get_key(Term* const* args, std::size_t n) {
+  Memo_key k;
+  k.args.reserve(n);
+  k.hash = n;
+  for (std::size_t i = 0; i < n; ++i) {
+    k.args.push_back(get_scalar(args[i]));
+    k.hash = hash_combine(k.hash, hash_value(args[i]));
+  }
+  return k;
+}
+
+// Returns a reference to the memo table of the function f.
+Memo_table*&
+get_table(Term* f) {
+  if (Abs* abs = as<Abs>(f))
+    return abs->t4;
+  if (Fn* fn = as<Fn>(f))
+    return fn->t4;
+  lang_unreachable(format("cannot memoize calls to '{}'", node_name(f)));
+}
+
+} // namespace
+
+// Set the number of calls remembered by each function. A limit of 0
+// disables memoization.
+void
+set_memo_limit(std::size_t n) { memo_limit_ = n; }
+
+std::size_t
+get_memo_limit() { return memo_limit_; }
+
+// Returns true if calls to a function of type t can be memoized. That
+// is, t is an arrow or function type whose parameters and result are
+// all scalars.
+bool
+is_memo_type(Type* t) {
+  if (Arrow_type* a = as<Arrow_type>(t))
+    return is_scalar_type(a->parm()) and is_scalar_type(a->result());
+  if (Fn_type* f = as<Fn_type>(t)) {
+    for (Type* p : *f->parms())
+      if (not is_scalar_type(p))
+        return false;
+    return is_scalar_type(f->result());
+  }
+  return false;
+}
+
+// Returns true if calls to the function f are memoized.
+bool
+is_memo_fn(Term* f) {
+  if (memo_limit_ == 0)
+    return false;
+  if (Abs* abs = as<Abs>(f))
+    return abs->memo();
+  if (Fn* fn = as<Fn>(f))
+    return fn->memo();
+  return false;
+}
+
+// Returns the remembered value of the call of f with the n arguments
+// args, or nullptr if the call is not remembered.
+Term*
+find_memo(Term* f, Term* const* args, std::size_t n) {
+  Memo_key k = get_key(args, n);
+  Memo_lock lock(memo_mutex_);
+  Memo_table* table = get_table(f);
+  if (not table)
+    return nullptr;
+  auto iter = table->index.find(k);
+  if (iter == table->index.end())
+    return nullptr;
+  table->entries.splice(table->entries.begin(), table->entries, iter->second);
+  return get_term(iter->second->second);
+}
+
+// Remember v as the value of the call of f with the n arguments args.
+// When the table is full, the least recently used call is forgotten.
+void
+save_memo(Term* f, Term* const* args, std::size_t n, Term* v) {
+  Memo_key k = get_key(args, n);
+  Scalar s = get_scalar(v);
+  Memo_lock lock(memo_mutex_);
+  Memo_table*& table = get_table(f);
+  if (not table)
+    table = new Memo_table();
+  if (table->index.count(k))
+    return;
+  if (table->entries.size() == memo_limit_) {
+    table->index.erase(table->entries.back().first);
+    table->entries.pop_back();
+  }
+  table->entries.emplace_front(k, std::move(s));
+  table->index.emplace(std::move(k), table->entries.begin());
+}
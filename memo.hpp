@@ -0,0 +1,39 @@
+#ifndef MEMO_HPP
+#define MEMO_HPP
+
+#include "ast.hpp"
+
+#include <cstddef>
+
+// -------------------------------------------------------------------------- //
+// Memoization
+//
+// Calls to pure functions over scalar values can be memoized: the value
+// of each call is remembered in a table attached to the function, and
+// a later call with the same arguments returns that value rather than
+// evaluating the body of the function again.
+//
+// A function is pure when its value depends only on its arguments (see
+// Scope in scope.hpp), and it is memoizable when, in addition, each of
+// its parameters and its result are of type Unit, Bool, Nat, or Str.
+// Both properties are determined during elaboration, and recorded in
+// the memo flag of the abstraction (see Abs and Fn in ast.hpp).
+//
+// Memoization is disabled unless a limit is set with set_memo_limit.
+// The limit is the number of calls remembered by each function; when
+// a table is full, the least recently used call is forgotten. Entries
+// are copied out of the arena in which they were computed, and so the
+// table of a function outlives the evaluation that filled it. Tables
+// may be shared by concurrent evaluations (see sched.hpp), and so they
+// are guarded by a mutex.
+
+void set_memo_limit(std::size_t);
+std::size_t get_memo_limit();
+
+bool is_memo_type(Type*);
+bool is_memo_fn(Term*);
+
+Term* find_memo(Term*, Term* const*, std::size_t);
+void save_memo(Term*, Term* const*, std::size_t, Term*);
+
+#endif
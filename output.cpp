@@ -0,0 +1,183 @@
+#include "output.hpp"
+#include "ast.hpp"
+
+#include "lang/debug.hpp"
+
+#include <iostream>
+
+namespace {
+
+// The size of the buffer at which it is written to the stream.
+constexpr std::size_t flush_size = 1 << 16;
+
+Output* current_ = nullptr;
+
+// Write the pending output of out to its stream.
+void
+drain(Output& out) {
+  if (out.buf.empty())
+    return;
+  out.os.write(out.buf.data(), out.buf.size());
+  out.os.flush();
+  out.buf.clear();
+}
+
+// Append the rendering of e using the pretty printer.
+void
+append_pretty(Output& out, Expr* e) {
+  out.tmp.str(std::string());
+  out.tmp << pretty(e);
+  out.buf += out.tmp.str();
+}
+
+// Append the value t, writing scalars directly.
+void
+append_value(Output& out, Term* t) {
+  switch (t->kind) {
+  case unit_term:
+    out.buf += "unit";
+    return;
+  case true_term:
+    out.buf += "true";
+    return;
+  case false_term:
+    out.buf += "false";
+    return;
+  case int_term:
+    out.buf += to_string(as<Int>(t)->value());
+    return;
+  case str_term: {
+    String s = as<Str>(t)->value();
+    out.buf.append(s.data(), s.size());
+    return;
+  }
+  default:
+    append_pretty(out, t);
+    return;
+  }
+}
+
+// Returns the number of the n elements of a list that are printed.
+inline std::size_t
+get_count(const Output& out, std::size_t n) {
+  return out.limit and out.limit < n ? out.limit : n;
+}
+
+// Append the number of the n elements of a list that are omitted when
+// m are printed, if any.
+inline void
+append_omitted(Output& out, std::size_t n, std::size_t m) {
+  if (m == n)
+    return;
+  if (m != 0)
+    out.buf += ", ";
+  out.buf += "... ";
+  out.buf += std::to_string(n - m);
+  out.buf += " more";
+}
+
+void
+append_list(Output& out, List* t) {
+  Term_seq* elems = t->elems();
+  std::size_t n = get_count(out, elems->size());
+  out.buf += '[';
+  for (std::size_t i = 0; i < n; ++i) {
+    if (i != 0)
+      out.buf += ", ";
+    append_value(out, (*elems)[i]);
+  }
+  append_omitted(out, elems->size(), n);
+  out.buf += ']';
+}
+
+// Tables are printed as lists of records, as by the pretty printer.
+// The names of the columns are rendered once.
+void
+append_table(Output& out, Table* t) {
+  List_type* lt = as<List_type>(t->tr);
+  Term_seq* vars = as<Record_type>(lt->type())->members();
+  Column_seq* cols = t->columns();
+  std::vector<std::string> names;
+  for (Term* v : *vars) {
+    out.tmp.str(std::string());
+    out.tmp << pretty(as<Var>(v)->name()) << " = ";
+    names.push_back(out.tmp.str());
+  }
+
+  std::size_t n = get_count(out, t->rows());
+  out.buf += '[';
+  for (std::size_t i = 0; i < n; ++i) {
+    if (i != 0)
+      out.buf += ", ";
+    out.buf += '{';
+    for (std::size_t j = 0; j < names.size(); ++j) {
+      if (j != 0)
+        out.buf += ", ";
+      out.buf += names[j];
+      append_value(out, (*(*cols)[j])[i]);
+    }
+    out.buf += '}';
+    if (out.buf.size() >= flush_size)
+      drain(out);
+  }
+  append_omitted(out, t->rows(), n);
+  out.buf += ']';
+}
+
+} // namespace
+
+Output::Output(std::ostream& os, std::size_t n)
+  : os(os), limit(n)
+{ }
+
+Output::~Output() {
+  flush();
+}
+
+// Print the expression e, followed by a newline.
+void
+Output::print(Expr* e) {
+  std::lock_guard<std::mutex> lock(mutex);
+  if (List* t = as<List>(e))
+    append_list(*this, t);
+  else if (Table* t = as<Table>(e))
+    append_table(*this, t);
+  else if (Term* t = as<Term>(e))
+    append_value(*this, t);
+  else
+    append_pretty(*this, e);
+  buf += '\n';
+  if (buf.size() >= flush_size)
+    drain(*this);
+}
+
+// Write the pending output to the stream.
+void
+Output::flush() {
+  std::lock_guard<std::mutex> lock(mutex);
+  drain(*this);
+}
+
+// Returns the sink that writes to standard output.
+Output&
+get_standard_output() {
+  static Output out(std::cout);
+  return out;
+}
+
+// Returns the current sink, or the standard output if there is none.
+Output&
+get_output() {
+  return current_ ? *current_ : get_standard_output();
+}
+
+Output_guard::Output_guard(Output& o)
+  : out(&o), prev(current_)
+{
+  current_ = out;
+}
+
+Output_guard::~Output_guard() {
+  current_ = prev;
+  out->flush();
+}
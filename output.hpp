@@ -0,0 +1,56 @@
+#ifndef OUTPUT_HPP
+#define OUTPUT_HPP
+
+#include <cstddef>
+#include <iosfwd>
+#include <mutex>
+#include <sstream>
+#include <string>
+
+struct Expr;
+
+// -------------------------------------------------------------------------- //
+// Output
+//
+// The values printed by a program are written to an output sink, which
+// collects them in a buffer and writes the buffer to its stream when it
+// is full, and when the sink is flushed. An evaluator has a sink, which
+// is made current while the evaluator runs (see Output_guard), and is
+// flushed when it returns, so that the output of a program is not
+// interleaved with other writes to the same stream.
+//
+// Lists and tables are written without recursion when their elements
+// are scalars. When the sink has a limit, at most that many elements
+// of a printed list or table are written, followed by the number of
+// elements that were omitted. A limit of 0 writes all elements.
+struct Output {
+  Output(std::ostream& os, std::size_t n = 0);
+  ~Output();
+
+  Output(const Output&) = delete;
+  Output& operator=(const Output&) = delete;
+
+  void print(Expr*);
+  void flush();
+
+  std::ostream& os;        // The stream written by the sink
+  std::size_t limit;       // The number of elements printed, if not 0
+  std::string buf;         // The pending output
+  std::ostringstream tmp;  // Renders values without a fast path
+  std::mutex mutex;        // Guards concurrent prints
+};
+
+Output& get_standard_output();
+Output& get_output();
+
+// The output guard makes the given sink current, restoring the previous
+// sink on exit. The sink is flushed on exit.
+struct Output_guard {
+  Output_guard(Output&);
+  ~Output_guard();
+
+  Output* out;
+  Output* prev;
+};
+
+#endif
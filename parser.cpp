@@ -1,6 +1,7 @@
 
 #include "parser.hpp"
 #include "syntax.hpp"
+#include "lexer.hpp"
 
 #include "lang/parsing.hpp"
 #include "lang/debug.hpp"
@@ -24,7 +25,10 @@ Tree* parse_primary_expr(Parser&);
 Tree* parse_postfix_expr(Parser&);
 Tree* parse_prefix_expr(Parser&);
 Tree* parse_expr(Parser&);
+Tree* parse_load_expr(Parser&);
+Tree* parse_csv_expr(Parser&);
 Tree* parse_name(Parser&);
+Tree* parse_dot_expr(Parser&, Tree*);
 
 
 // Parse a name.
@@ -83,7 +87,7 @@ parse_string_lit(Parser& p) {
 
 // Parse a type literal.
 //
-//    type-literal ::= 'Unit' | 'Bool' | 'Nat'
+//    type-literal ::= 'Unit' | 'Bool' | 'Nat' | 'Str'
 Tree*
 parse_type_lit(Parser& p) {
   if (const Token* k = parse::accept(p, unit_type_tok))
@@ -92,6 +96,8 @@ parse_type_lit(Parser& p) {
     return new Lit_tree(k);
   if (const Token* k = parse::accept(p, nat_type_tok))
     return new Lit_tree(k);
+  if (const Token* k = parse::accept(p, str_type_tok))
+    return new Lit_tree(k);
   return nullptr;
 }
 
@@ -314,7 +320,7 @@ parse_list_expr(Parser& p) {
 //    tuple-expr ::= '<' t1, ..., tn '>'
 Tree*
 parse_variant_expr(Parser& p) {
-  parse_enclosed_seq<Variant_tree>(p, langle_tok, rangle_tok);
+  return parse_enclosed_seq<Variant_tree>(p, langle_tok, rangle_tok);
 }
 
 // Parse a grouped expression.
@@ -358,18 +364,62 @@ parse_grouped_expr(Parser& p) {
   return nullptr;
 }
 
-// Parse selection.
+// Parse the ordering and limit of the selection t1, if any.
+//
+//    order-clause ::= ['order' 'by' col ['asc' | 'desc']] ['limit' nat]
+Tree*
+parse_order(Parser& p, Tree* t1) {
+  Tree* t2 = nullptr;
+  bool desc = false;
+  if (parse::accept(p, order_tok)) {
+    if (not parse::expect(p, by_tok))
+      return nullptr;
+    t2 = parse_expr(p);
+    if (not t2) {
+      parse::parse_error(p) << "expected 'expr' after 'by'";
+      return nullptr;
+    }
+    if (parse::accept(p, desc_tok))
+      desc = true;
+    else
+      parse::accept(p, asc_tok);
+  }
+  Tree* t3 = nullptr;
+  if (parse::accept(p, limit_tok)) {
+    t3 = parse_expr(p);
+    if (not t3) {
+      parse::parse_error(p) << "expected 'expr' after 'limit'";
+      return nullptr;
+    }
+  }
+  if (not t2 and not t3)
+    return t1;
+  return new Order_tree(t1, t2, desc, t3);
+}
+
+// Parse selection. Aggregates may appear in the projection list.
 //
-//    stmt ::= select col from table where bool
+//    stmt ::= select col from table where bool [group by col] order-clause
 Tree*
 parse_select_expr(Parser& p) {
     if(const Token* s = parse::accept(p, select_tok)) {
-      if (Tree* t1 = parse_expr(p)) {
+      bool projection = p.projection;
+      p.projection = true;
+      Tree* t1 = parse_expr(p);
+      p.projection = projection;
+      if (t1) {
         if(parse::expect(p, from_tok)) {
           if (Tree* t2 = parse_expr(p)) {
             if(parse::expect(p, where_tok)) {
               if (Tree* t3 = parse_expr(p)) { 
-                return new Select_tree(s,t1,t2,t3);
+                if (not parse::accept(p, group_tok))
+                  return parse_order(p, new Select_tree(s,t1,t2,t3));
+                if (parse::expect(p, by_tok)) {
+                  if (Tree* t4 = parse_expr(p))
+                    return parse_order(p, new Select_tree(s,t1,t2,t3,t4));
+                  else
+                    parse::parse_error(p) << "expected 'expr' after 'by'";
+                }
               }
             }
           }
@@ -379,13 +429,38 @@ parse_select_expr(Parser& p) {
     return nullptr;
 }
 
+// Parse an aggregate of a column. This is only parsed within the
+// projection list of a selection, where an aggregate name followed by
+// an identifier cannot otherwise appear.
+//
+//    aggregate-expr ::= aggregate-name primary-expr ['.' primary-expr]*
+//    aggregate-name ::= 'count' | 'sum' | 'min' | 'max'
+Tree*
+parse_aggregate_expr(Parser& p) {
+  if (not p.projection or not parse::next_token_is(p, identifier_tok)
+      or not parse::nth_token_is(p, 1, identifier_tok)
+      or not is_aggregate_name(parse::peek(p).token().text))
+    return nullptr;
+  const Token* k = parse::consume(p);
+  if (Tree* t = parse_primary_expr(p)) {
+    while (Tree* t2 = parse_dot_expr(p, t))
+      t = t2;
+    return new Agg_tree(k, t);
+  }
+  parse::parse_error(p) << "expected 'primary-expr' after '" << k->text << "'";
+  return nullptr;
+}
+
 // Parse a primary expression.
 //
 //    primary-term ::= primary-lambda-term | grouped-term
+//                   | load-expr | csv-expr | aggregate-expr
 Tree*
 parse_primary_expr(Parser& p) {
   if (Tree* t = parse_literal_expr(p))
     return t;
+  if (Tree* t = parse_aggregate_expr(p))
+    return t;
   if (Tree* t = parse_lambda_expr(p))
     return t;
   if (Tree* t = parse_id_expr(p))
@@ -398,6 +473,10 @@ parse_primary_expr(Parser& p) {
     return t;
   if (Tree* t = parse_grouped_expr(p))
     return t;
+  if (Tree* t = parse_load_expr(p))
+    return t;
+  if (Tree* t = parse_csv_expr(p))
+    return t;
   return nullptr;
 }
 
@@ -505,6 +584,7 @@ parse_intersect(Parser& p, Tree* t1) {
     else
       parse::parse_error(p) << "expected 'expr' after 'intersect'";
   }
+  return nullptr;
 }
 
 // Parse an except expression
@@ -518,6 +598,7 @@ parse_except(Parser& p, Tree* t1) {
     else
       parse::parse_error(p) << "expected 'table_expr' after 'Join'";
   }
+  return nullptr;
 }
 
 // Parse Join.
@@ -671,6 +752,57 @@ parse_print_expr(Parser& p) {
   return nullptr;
 }
 
+// Parse a load expression.
+//
+//    load-expr ::= 'load' string-literal
+Tree*
+parse_load_expr(Parser& p) {
+  if (const Token* k = parse::accept(p, load_tok)) {
+    if (Tree* t = parse_string_lit(p))
+      return new Load_tree(k, t);
+    else
+      parse::parse_error(p) << "expected 'string-literal' after 'load'";
+  }
+  return nullptr;
+}
+
+// Parse a save expression.
+//
+//    save-expr ::= 'save' string-literal expr
+Tree*
+parse_save_expr(Parser& p) {
+  if (const Token* k = parse::accept(p, save_tok)) {
+    if (Tree* t1 = parse_string_lit(p)) {
+      if (Tree* t2 = parse_expr(p))
+        return new Save_tree(k, t1, t2);
+      else
+        parse::parse_error(p) << "expected 'expr' after 'string-literal'";
+    }
+    else
+      parse::parse_error(p) << "expected 'string-literal' after 'save'";
+  }
+  return nullptr;
+}
+
+// Parse a CSV source expression. The type of the table is given
+// after the path.
+//
+//    csv-expr ::= 'csv' string-literal primary-expr
+Tree*
+parse_csv_expr(Parser& p) {
+  if (const Token* k = parse::accept(p, csv_tok)) {
+    if (Tree* t1 = parse_string_lit(p)) {
+      if (Tree* t2 = parse_primary_expr(p))
+        return new Csv_tree(k, t1, t2);
+      else
+        parse::parse_error(p) << "expected 'type' after 'string-literal'";
+    }
+    else
+      parse::parse_error(p) << "expected 'string-literal' after 'csv'";
+  }
+  return nullptr;
+}
+
 // Parse a typeof expression.
 //
 //    typeof-expr ::= 'typeof' expr
@@ -722,6 +854,7 @@ parse_schema_expr(Parser& p) {
 //
 //    prefix-expr ::= if-expr | succ-epxr | pred-expr | iszero-expr
 //                    | not-expr | print-expr | typeof-expr
+//                    | save-expr
 Tree*
 parse_prefix_expr(Parser& p) {
   if (Tree* t = parse_if_expr(p))
@@ -738,6 +871,8 @@ parse_prefix_expr(Parser& p) {
     return t;
   if (Tree* t = parse_typeof_expr(p))
     return t;
+  if (Tree* t = parse_save_expr(p))
+    return t;
   if (Tree* t = parse_not_expr(p))
     return t;
   return parse_postfix_expr(p);
@@ -841,17 +976,36 @@ parse_def_decl(Parser& p) {
       else 
         return d1;
   }
-  else 
-   return nullptr;
+  return nullptr;
+}
+
+// Parse an insert statement.
+//
+//    insert-stmt ::= 'insert' name expr
+Tree*
+parse_insert_stmt(Parser& p) {
+  if (const Token* k = parse::accept(p, insert_tok)) {
+    if (Tree* n = parse_name(p)) {
+      if (Tree* t = parse_expr(p))
+        return new Insert_tree(k, n, t);
+      else
+        parse::parse_error(p) << "expected 'expr' after 'name'";
+    }
+    else
+      parse::parse_error(p) << "expected 'name' after 'insert'";
+  }
+  return nullptr;
 }
 
 // Parse a statement.
 //
-//    stmt ::= def-stmt | expr-stmt
+//    stmt ::= def-stmt | insert-stmt | expr-stmt
 Tree*
 parse_stmt(Parser& p) {
   if (Tree* t = parse_def_decl(p))
     return t;
+  if (Tree* t = parse_insert_stmt(p))
+    return t;
   if (Tree* t = parse_expr(p))
     return t;
   return nullptr;
@@ -883,16 +1037,22 @@ parse_program(Parser& p) {
 // -------------------------------------------------------------------------- //
 // Parser
 
-// Parse a range of tokens.
+// Parse a sequence of tokens.
 Tree*
-Parser::operator()(Token_iterator f, Token_iterator l) {
-  if (f == l)
-    return nullptr;
-  first = f; 
-  last = l;
-  current = first; 
-  use_diagnostics(diags);
-  return parse_program(*this);
+Parser::operator()(const Tokens& toks) {
+  Token_stream ts(toks);
+  return (*this)(ts);
 }
 
-
+Tree*
+Parser::operator()(Token_stream& ts) {
+  Context_guard guard(cxt);
+  toks = &ts;
+  current = 0;
+  prev = nullptr;
+  Tree* t = nullptr;
+  if (not parse::end_of_stream(*this))
+    t = parse_program(*this);
+  toks = nullptr;
+  return t;
+}
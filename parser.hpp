@@ -4,28 +4,41 @@
 
 #include "token.hpp"
 
-#include "lang/error.hpp"
+#include "lang/context.hpp"
 
-// Declaration
+// Declarations
 struct Tree;
+struct Token_stream;
 
 // The parser transforms a token stream into a parse tree. For
 // this language, the parse tree is indistinguishable from the
 // abstract syntax tree.
 //
-// FIXME: Rewrite in terms of a pair of token iterators.
+// The parser pulls tokens from a token stream as they are needed, and
+// discards them once consumed. Each token referred to by a parse tree
+// is copied into the parser's arena when it is consumed, so the trees
+// do not depend on the lifetime of the stream.
+//
+// Parse trees are allocated in the parser's arena, and are destroyed
+// with the parser (or when the arena is released).
 struct Parser {
   using Token_type = Token;
+  using View_type = Token_view;
 
-  Tree* operator()(const Tokens&);
-  Tree* operator()(Token_iterator, Token_iterator);
+  Parser()
+    : toks(nullptr), current(0), prev(nullptr), projection(false),
+      cxt(diags, &arena) { }
 
-  Token_iterator first;   // The beginning token
-  Token_iterator last;    // Past the end of the last token
-  Token_iterator current; // The current token
-  Diagnostics    diags;   // The current diagnostics
+  Tree* operator()(const Tokens&);
+  Tree* operator()(Token_stream&);
+
+  Token_stream* toks;    // The token stream
+  std::size_t   current; // The position of the current token
+  const Token*  prev;    // The last consumed token
+  bool          projection; // True within the projection list of a selection
+  Diagnostics   diags;   // The current diagnostics
+  Arena         arena;   // Storage for parse trees
+  Context       cxt;     // The context of the parser
 };
 
-#include "parser.ipp"
-
 #endif
@@ -0,0 +1,2301 @@
+
+#include "plan.hpp"
+#include "csv.hpp"
+#include "eval.hpp"
+#include "query.hpp"
+#include "sched.hpp"
+#include "spill.hpp"
+#include "subst.hpp"
+#include "table_file.hpp"
+#include "type.hpp"
+#include "value.hpp"
+#include "worker.hpp"
+
+#include "lang/arena.hpp"
+#include "lang/debug.hpp"
+#include "lang/thread_pool.hpp"
+
+#include <algorithm>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <unordered_set>
+
+namespace {
+
+// -------------------------------------------------------------------------- //
+// Operators
+
+// The base class of plan operators. Each call to next() returns the
+// next batch of the result, or nullptr when there are no more rows.
+// Alternatively, drain() returns the entire result as a single table,
+// allocated in the current arena.
+//
+// When an operator is transient, the values in its batches may have
+// been allocated with those batches (e.g., the cells read from a CSV
+// file), and must be copied if they are kept after the next batch is
+// pulled.
+struct Plan {
+  Plan(Type* t, bool v)
+    : type(t), transient(v) { }
+  virtual ~Plan() { }
+
+  virtual Table* next() = 0;
+  virtual Table* drain();
+
+  Type* type;
+  bool transient;
+};
+
+using Plan_ptr = std::unique_ptr<Plan>;
+
+Plan* make_plan(Term*);
+
+// The copies of the strings of a column, so that copies of equal
+// strings are shared.
+using Str_map = std::unordered_map<String, Term*>;
+
+// Returns a copy of the cell v of a table, allocated in the current
+// arena.
+Term*
+copy_cell(Term* v, Str_map& strs) {
+  if (Int* n = as<Int>(v))
+    return new Int(get_type(n), n->value());
+  if (Str* s = as<Str>(v)) {
+    Term*& str = strs[s->value()];
+    if (not str)
+      str = new Str(get_type(s), s->value());
+    return str;
+  }
+  return v;
+}
+
+// A row buffer collects rows from the batches of an operator into a
+// table, allocated in the arena that is current when the buffer is
+// constructed. The cells of transient batches are copied.
+struct Row_buf {
+  Row_buf(Type*);
+
+  void append(Table*, std::size_t, std::size_t, bool);
+  void append(Table* t, bool copy) { append(t, 0, t->rows(), copy); }
+  void assign(std::size_t, Table*, std::size_t, bool);
+
+  Arena& arena;
+  Table* table;
+  std::vector<Str_map> strs;
+};
+
+Row_buf::Row_buf(Type* t)
+  : arena(current_arena()), table(make_table(t)),
+    strs(table->columns()->size()) { }
+
+// Append the rows [first, last) of the table t.
+void
+Row_buf::append(Table* t, std::size_t first, std::size_t last, bool copy) {
+  Arena_guard guard(arena);
+  for (std::size_t j = 0; j < table->columns()->size(); ++j) {
+    Term_seq* from = (*t->columns())[j];
+    Term_seq* to = (*table->columns())[j];
+    if (copy) {
+      for (std::size_t i = first; i < last; ++i)
+        to->push_back(copy_cell((*from)[i], strs[j]));
+    } else {
+      to->insert(to->end(), from->begin() + first, from->begin() + last);
+    }
+  }
+  table->t3 += last - first;
+}
+
+// Replace the row k of the buffer with the row i of the table t.
+void
+Row_buf::assign(std::size_t k, Table* t, std::size_t i, bool copy) {
+  Arena_guard guard(arena);
+  for (std::size_t j = 0; j < table->columns()->size(); ++j) {
+    Term* v = (*(*t->columns())[j])[i];
+    (*(*table->columns())[j])[k] = copy ? copy_cell(v, strs[j]) : v;
+  }
+}
+
+// By default, the result is collected from the batches of the operator.
+// When the operator produces a single batch that is not transient, that
+// batch is the result.
+Table*
+Plan::drain() {
+  Table* first = next();
+  if (not first)
+    return make_table(type);
+  Row_buf rows(type);
+  if (transient) {
+    rows.append(first, true);
+    first = nullptr;
+  }
+
+  Arena in;
+  while (true) {
+    Table* batch;
+    {
+      Arena_guard guard(in);
+      batch = next();
+    }
+    if (not batch)
+      break;
+    if (first) {
+      rows.append(first, false);
+      first = nullptr;
+    }
+    rows.append(batch, transient);
+    in.release();
+  }
+  return first ? first : rows.table;
+}
+
+
+// -------------------------------------------------------------------------- //
+// Runs
+
+// A run holds rows kept by an operator outside of its batches, to be
+// read back a batch at a time: the rows are spilled to a file (see
+// spill.hpp), or, when they cannot be, kept in memory together with the
+// arena holding them.
+struct Run {
+  Run()
+    : type(nullptr), table(nullptr), done(false) { }
+
+  Table* read(std::size_t = plan_batch_rows);
+  void reset();
+
+  Type* type;                  // The type of the rows
+  std::unique_ptr<Spill_file> file;
+  std::unique_ptr<Arena> rows; // The arena of a run kept in memory
+  Table* table;                // The rows of a run kept in memory
+  Arena in;                    // The arena of the current batch
+  bool done;                   // True when the kept rows have been read
+};
+
+using Run_ptr = std::unique_ptr<Run>;
+
+// Returns the next batch of the run, or nullptr when there are no more
+// rows. A batch read from a file has at most n rows, and is valid until
+// the next is read.
+Table*
+Run::read(std::size_t n) {
+  if (table) {
+    if (done)
+      return nullptr;
+    done = true;
+    return table;
+  }
+  in.release();
+  Arena_guard guard(in);
+  return file->read(n);
+}
+
+// Read the run again from its first row.
+void
+Run::reset() {
+  done = false;
+  if (file)
+    file->open(type);
+}
+
+// Returns a run that keeps the table t in memory. Its nodes are
+// allocated in the arena a, or in an arena that outlives the run when
+// a is null.
+Run_ptr
+keep_run(Table* t, std::unique_ptr<Arena> a) {
+  Run_ptr r(new Run());
+  r->type = get_type(t);
+  r->rows = std::move(a);
+  r->table = t;
+  return r;
+}
+
+// Returns a run holding the table t, which is spilled if possible, and
+// its arena a is then released. Otherwise, the table is kept.
+Run_ptr
+make_run(Table* t, std::unique_ptr<Arena> a) {
+  std::unique_ptr<Spill_file> f(new Spill_file());
+  if (not f->write(t) or not f->open(get_type(t)))
+    return keep_run(t, std::move(a));
+  Run_ptr r(new Run());
+  r->type = get_type(t);
+  r->file = std::move(f);
+  return r;
+}
+
+// A merge produces the rows of a sequence of runs in the order of their
+// key column, ascending or (when desc is true) descending. Rows having
+// equal keys are produced in the order of their runs, so runs of
+// consecutive rows, each stably sorted, are merged into a stable sort.
+// The batches of the merge have the type t, whose columns are a prefix
+// of those of the runs, and their cells are copied into the arena in
+// which they are pulled. The runs are read in batches that together
+// fit within the memory budget.
+struct Run_merge {
+  Run_merge(Type* t, Name* n, bool d)
+    : type(t), key(n), desc(d), rows(0), started(false) { }
+
+  void add(Run_ptr);
+  Table* next();
+
+  // The current position of a run.
+  struct Cursor {
+    Run_ptr run;
+    Table* batch;
+    Term_seq* keys;
+    std::size_t pos;
+  };
+
+  bool fill(Cursor&);
+  bool after(std::size_t, std::size_t) const;
+
+  Type* type;
+  Name* key;
+  bool desc;
+  std::size_t rows; // The number of rows in each batch of a run
+  std::vector<Cursor> runs;
+  std::vector<std::size_t> heap; // The runs having rows, by their next row
+  bool started;
+};
+
+void
+Run_merge::add(Run_ptr r) {
+  runs.push_back({std::move(r), nullptr, nullptr, 0});
+}
+
+// Advance the cursor c past the batches that have been produced.
+// Returns false when its run has no more rows.
+bool
+Run_merge::fill(Cursor& c) {
+  while (not c.batch or c.pos == c.batch->rows()) {
+    c.batch = c.run->read(rows);
+    c.pos = 0;
+    if (not c.batch)
+      return false;
+    c.keys = find_column(c.batch, key);
+    lang_assert(c.keys, format("no column named '{}'", pretty(key)));
+  }
+  return true;
+}
+
+// Returns true if the next row of the run a follows that of the run b.
+inline bool
+Run_merge::after(std::size_t a, std::size_t b) const {
+  Term* k1 = (*runs[a].keys)[runs[a].pos];
+  Term* k2 = (*runs[b].keys)[runs[b].pos];
+  if (desc ? is_less(k1, k2) : is_less(k2, k1))
+    return true;
+  if (desc ? is_less(k2, k1) : is_less(k1, k2))
+    return false;
+  return a > b;
+}
+
+Table*
+Run_merge::next() {
+  auto follows = [this](std::size_t a, std::size_t b) { return after(a, b); };
+  if (not started) {
+    started = true;
+    std::size_t n = plan_batch_rows;
+    if (not runs.empty())
+      n = std::min(n, get_budget_rows(runs[0].run->type)) / runs.size();
+    rows = std::max<std::size_t>(n, 1);
+    for (std::size_t i = 0; i < runs.size(); ++i)
+      if (fill(runs[i]))
+        heap.push_back(i);
+    std::make_heap(heap.begin(), heap.end(), follows);
+  }
+  if (heap.empty())
+    return nullptr;
+
+  Row_buf out(type);
+  while (not heap.empty() and out.table->rows() < plan_batch_rows) {
+    std::pop_heap(heap.begin(), heap.end(), follows);
+    Cursor& c = runs[heap.back()];
+    out.append(c.batch, c.pos, c.pos + 1, true);
+    ++c.pos;
+    if (fill(c))
+      std::push_heap(heap.begin(), heap.end(), follows);
+    else
+      heap.pop_back();
+  }
+  return out.table;
+}
+
+
+// -------------------------------------------------------------------------- //
+// Scans
+
+// A scan produces a table that is already in memory, as a single batch.
+struct Scan_plan : Plan {
+  Scan_plan(Table* t)
+    : Plan(get_type(t), false), table(t) { }
+
+  Table* next() override;
+
+  Table* table;
+};
+
+Table*
+Scan_plan::next() {
+  Table* t = table;
+  table = nullptr;
+  return t;
+}
+
+// A CSV scan produces the rows of a CSV file, a chunk at a time. The
+// cells of each chunk are allocated with it.
+struct Csv_plan : Plan {
+  Csv_plan(Csv* c)
+    : Plan(get_type(c), true),
+      reader(get_file_path(c->path()), get_type(c)), open(false) { }
+
+  Table* next() override;
+
+  Csv_reader reader;
+  bool open;
+};
+
+Table*
+Csv_plan::next() {
+  if (not open) {
+    if (not reader.open())
+      lang_unreachable(format("cannot read '{}'", reader.path));
+    open = true;
+  }
+  return reader.next();
+}
+
+
+// -------------------------------------------------------------------------- //
+// Selection
+
+// Returns the declaration of the table in 'select t1 from t2 where t3'.
+// t2 should be a Def (when written 't as x') or a Ref to a Def.
+Expr*
+get_select_decl(Term* t) {
+  if (Ref* ref = as<Ref>(t))
+    return as<Def>(ref->decl());
+  return as<Def>(t);
+}
+
+// -------------------------------------------------------------------------- //
+// Shared scans
+
+// A shared scan tests the conditions of several top-level selections
+// from the same table together (see select_shared). The selection that
+// is evaluated first tests its own condition and each other condition
+// whose references are among its own, so that no definition is
+// evaluated before the statements that depend on it. The rows selected
+// for the other conditions are kept until their selections ask for them.
+struct Shared_cond {
+  Term* cond;              // The condition
+  std::vector<Expr*> refs; // The definitions referred to by cond
+  bool done;               // True when the rows have been selected
+  Row_seq rows;            // The selected rows
+};
+
+struct Shared_scan {
+  std::mutex mutex;
+  std::vector<Shared_cond> conds;
+};
+
+using Shared_scan_ptr = std::shared_ptr<Shared_scan>;
+
+// The shared scans of the program being evaluated, by condition.
+std::mutex shared_mutex;
+std::unordered_map<Term*, std::pair<Shared_scan_ptr, std::size_t>> shared_scans;
+
+// Returns true if the condition t of a selection from the table decl
+// compiles to a pure row predicate (see Row_pred). Each declaration
+// other than the table that t refers to must be in defs, the top-level
+// definitions of the program; those are added to refs.
+bool
+is_shared_cond(Term* t, Expr* decl, const std::unordered_set<Expr*>& defs,
+               std::vector<Expr*>& refs) {
+  switch (t->kind) {
+  case unit_term:
+  case true_term:
+  case false_term:
+  case int_term:
+  case str_term:
+    return true;
+
+  case mem_term: {
+    Mem* m = as<Mem>(t);
+    Ref* x = as<Ref>(m->record());
+    return x and x->decl() == decl and is<Ref>(m->member());
+  }
+
+  case ref_term: {
+    Expr* d = as<Ref>(t)->decl();
+    if (d == decl or not defs.count(d))
+      return false;
+    refs.push_back(d);
+    return true;
+  }
+
+  case equals_term:
+    return is_shared_cond(as<Equals>(t)->t1, decl, defs, refs)
+       and is_shared_cond(as<Equals>(t)->t2, decl, defs, refs);
+  case less_term:
+    return is_shared_cond(as<Less>(t)->t1, decl, defs, refs)
+       and is_shared_cond(as<Less>(t)->t2, decl, defs, refs);
+  case and_term:
+    return is_shared_cond(as<And>(t)->t1, decl, defs, refs)
+       and is_shared_cond(as<And>(t)->t2, decl, defs, refs);
+  case or_term:
+    return is_shared_cond(as<Or>(t)->t1, decl, defs, refs)
+       and is_shared_cond(as<Or>(t)->t2, decl, defs, refs);
+  case not_term:
+    return is_shared_cond(as<Not>(t)->t1, decl, defs, refs);
+
+  default:
+    return false;
+  }
+}
+
+// Returns true if the statement t ('print q' or q, where q is a
+// selection, a grouped selection, or an ordered selection) selects
+// from a table. The condition and table of the selection are stored in
+// cond and table.
+bool
+get_shared_select(Term* t, Term*& cond, Term*& table) {
+  if (Print* p = as<Print>(t))
+    t = as<Term>(p->expr());
+  if (Order_by* o = as<Order_by>(t))
+    t = o->query();
+  if (Select_from_where* s = as<Select_from_where>(t)) {
+    cond = s->cond();
+    table = s->table();
+    return true;
+  }
+  if (Group_by* g = as<Group_by>(t)) {
+    cond = g->cond();
+    table = g->table();
+    return true;
+  }
+  return false;
+}
+
+// Returns true if each element of a is in b.
+bool
+is_subset(const std::vector<Expr*>& a, const std::vector<Expr*>& b) {
+  for (Expr* e : a) {
+    if (std::find(b.begin(), b.end(), e) == b.end())
+      return false;
+  }
+  return true;
+}
+
+// Stores the rows of the table t selected by the condition cond of a
+// shared scan in sel. Returns false if cond is not part of a shared
+// scan, or t is not the value of the scanned table decl (e.g., the
+// table is the result of a query that has not yet been evaluated).
+bool
+take_shared_rows(Term* cond, Expr* decl, Table* t, Row_seq& sel, Arena& arena) {
+  Shared_scan_ptr scan;
+  std::size_t n;
+  {
+    std::lock_guard<std::mutex> lock(shared_mutex);
+    auto iter = shared_scans.find(cond);
+    if (iter == shared_scans.end())
+      return false;
+    scan = iter->second.first;
+    n = iter->second.second;
+  }
+  Def* def = as<Def>(decl);
+  if (not def or def->value() != t)
+    return false;
+
+  std::lock_guard<std::mutex> lock(scan->mutex);
+  std::vector<Shared_cond>& conds = scan->conds;
+  if (not conds[n].done) {
+    Arena_guard guard(arena);
+    std::deque<Row_pred> preds;
+    std::vector<const Row_pred*> ps;
+    std::vector<std::size_t> which;
+    for (std::size_t i = 0; i < conds.size(); ++i) {
+      if (conds[i].done or not is_subset(conds[i].refs, conds[n].refs))
+        continue;
+      preds.emplace_back(conds[i].cond, decl, t);
+      ps.push_back(&preds.back());
+      which.push_back(i);
+    }
+    std::vector<Row_seq> rows = select_shared(ps);
+    for (std::size_t i = 0; i < which.size(); ++i) {
+      conds[which[i]].rows = std::move(rows[i]);
+      conds[which[i]].done = true;
+    }
+  }
+  sel = std::move(conds[n].rows);
+  {
+    std::lock_guard<std::mutex> guard(shared_mutex);
+    shared_scans.erase(cond);
+  }
+  return true;
+}
+
+// A filter selects the rows of each batch that satisfy the condition
+// of 'select t1 from t2 where t3'. The condition is compiled into a
+// row predicate for each batch (see query.hpp). Because evaluating a
+// term may update the definitions that it refers to (see eval_def),
+// the condition is evaluated in the arena of the plan.
+struct Filter_plan : Plan {
+  Filter_plan(Plan* in, Term* c, Expr* d)
+    : Plan(in->type, in->transient), input(in), cond(c), decl(d),
+      arena(current_arena()) { }
+
+  Table* next() override;
+
+  Plan_ptr input;
+  Term* cond;   // The condition
+  Expr* decl;   // The declaration of the table in the condition
+  Arena& arena; // The arena of the plan
+};
+
+Table*
+Filter_plan::next() {
+  Table* batch = input->next();
+  if (not batch)
+    return nullptr;
+  Row_seq sel;
+  if (not take_shared_rows(cond, decl, batch, sel, arena)) {
+    Arena_guard guard(arena);
+    Row_pred pred(cond, decl, batch);
+    sel = pred.select();
+  }
+  if (sel.size() == batch->rows())
+    return batch;
+  return select_rows(batch, sel);
+}
+
+// A projection selects the columns named by the projection list t1 of
+// 'select t1 from t2 where t3'. The columns are shared with the batches
+// of the input.
+struct Project_plan : Plan {
+  Project_plan(Plan*, Term*);
+
+  Table* next() override;
+
+  Plan_ptr input;
+  Term_seq* vars; // The projected columns
+};
+
+// Returns the columns named by the projection list t, whose members
+// are column references of the form 'x.a'.
+Term_seq*
+get_projected_vars(Term* t) {
+  Term_seq* vars = new Term_seq();
+  auto add = [vars](Expr* e) {
+    Ref* member = as<Ref>(as<Mem>(e)->member());
+    vars->push_back(as<Var>(member->decl()));
+  };
+  if (Comma* c = as<Comma>(t)) {
+    for (Expr* e : *c->elems())
+      add(e);
+  } else {
+    add(t);
+  }
+  return vars;
+}
+
+Project_plan::Project_plan(Plan* in, Term* t)
+  : Plan(nullptr, in->transient), input(in), vars(get_projected_vars(t))
+{
+  type = get_list_type(get_record_type(vars));
+}
+
+Table*
+Project_plan::next() {
+  Table* batch = input->next();
+  if (not batch)
+    return nullptr;
+  Column_seq* cols = new Column_seq();
+  cols->reserve(vars->size());
+  for (Term* v : *vars) {
+    Term_seq* col = find_column(batch, as<Var>(v)->name());
+    lang_assert(col, format("no column named '{}'", pretty(as<Var>(v)->name())));
+    cols->push_back(col);
+  }
+  return make_table(type, cols, batch->rows());
+}
+
+
+// -------------------------------------------------------------------------- //
+// Joins
+
+// Returns the declaration of the table referred to by t, or nullptr
+// if t does not refer to a named table.
+Expr*
+get_table_decl(Term* t) {
+  if (Ref* ref = as<Ref>(t))
+    return ref->decl();
+  return nullptr;
+}
+
+// If t is a column reference of the form 'x.a' where 'x' refers
+// to the table declaration d, returns the member variable 'a'.
+// Otherwise, returns nullptr.
+Var*
+get_column(Term* t, Expr* d) {
+  if (not d)
+    return nullptr;
+  if (Mem* m = as<Mem>(t))
+    if (Ref* x = as<Ref>(m->record()))
+      if (x->decl() == d)
+        if (Ref* a = as<Ref>(m->member()))
+          return as<Var>(a->decl());
+  return nullptr;
+}
+
+// The relation between the key columns of a join.
+enum Join_op {
+  join_eq,   // a eq b
+  join_lt,   // a lt b
+  join_gt,   // b lt a
+  join_band, // a lt b and b lt c
+};
+
+// The key columns of a join condition 'x.a eq y.b' or 'x.a lt y.b',
+// where 'a' is a column of the left table and 'b' is a column of the
+// right. The key of a band condition 'x.a lt y.b and y.b lt x.c' also
+// has the upper column 'c' of the left table.
+struct Join_key {
+  Var* left;
+  Var* right;
+  Join_op op;
+  Var* upper;
+};
+
+// Determine if the join condition has the form 'x.a eq y.b' or
+// 'x.a lt y.b' where 'x' is the left table and 'y' is the right table
+// (or vice versa), or is a band condition: the conjunction of a lower
+// and an upper bound on the same column of the right table, in either
+// order. If so, returns the key columns. Otherwise, the both columns
+// of the key are null.
+Join_key
+get_join_key(Term* cond, Expr* d1, Expr* d2) {
+  if (d1 == d2)
+    return {nullptr, nullptr, join_eq};
+  if (And* both = as<And>(cond)) {
+    Join_key k1 = get_join_key(both->t1, d1, d2);
+    Join_key k2 = get_join_key(both->t2, d1, d2);
+    if (k1.op == join_gt)
+      std::swap(k1, k2);
+    if (k1.left and k2.left and k1.op == join_lt and k2.op == join_gt
+        and k1.right == k2.right)
+      return {k1.left, k1.right, join_band, k2.left};
+    return {nullptr, nullptr, join_eq};
+  }
+  if (Equals* eq = as<Equals>(cond)) {
+    if (Var* a = get_column(eq->t1, d1))
+      if (Var* b = get_column(eq->t2, d2))
+        return {a, b, join_eq};
+    if (Var* b = get_column(eq->t1, d2))
+      if (Var* a = get_column(eq->t2, d1))
+        return {a, b, join_eq};
+  }
+  if (Less* lt = as<Less>(cond)) {
+    if (Var* a = get_column(lt->t1, d1))
+      if (Var* b = get_column(lt->t2, d2))
+        return {a, b, join_lt};
+    if (Var* b = get_column(lt->t1, d2))
+      if (Var* a = get_column(lt->t2, d1))
+        return {a, b, join_gt};
+  }
+  return {nullptr, nullptr, join_eq};
+}
+
+// A match is a pair of (left, right) row indexes satisfying a join
+// condition.
+using Match = std::pair<std::size_t, std::size_t>;
+using Match_seq = std::vector<Match>;
+
+// Returns the table of type t whose rows are the matched rows of t1
+// followed by the matched rows of t2.
+Table*
+join_tables(Table* t1, Table* t2, const Match_seq& matches, Type* t) {
+  Column_seq* cols = new Column_seq();
+  cols->reserve(t1->columns()->size() + t2->columns()->size());
+  for (Term_seq* c : *t1->columns()) {
+    Term_seq* col = new Term_seq();
+    col->reserve(matches.size());
+    for (Match m : matches)
+      col->push_back((*c)[m.first]);
+    cols->push_back(col);
+  }
+  for (Term_seq* c : *t2->columns()) {
+    Term_seq* col = new Term_seq();
+    col->reserve(matches.size());
+    for (Match m : matches)
+      col->push_back((*c)[m.second]);
+    cols->push_back(col);
+  }
+  return make_table(t, cols, matches.size());
+}
+
+// A join of 't1 join t2 on t3' produces the merged rows (r1, r2) for
+// each r1 in t1 and r2 in t2 such that t3 is true for that pair.
+//
+// The right table is collected when the first batch is pulled. The
+// rows of the left table are then matched against it, a batch at a
+// time, so the matches are in the same order as a nested loop over the
+// left and right tables would produce. When t3 has the form 'x.a eq
+// y.b', the rows are matched by probing a hash index on the right key
+// column, and when it has the form 'x.a lt y.b' or is a band condition
+// 'x.a lt y.b and y.b lt x.c', by searching a sorted index for the
+// range of values within the bounds. The sorted index orders values as
+// 'lt' does, as does a sort (see Sort_plan). The index is cached with
+// the right table (see table.hpp), so that it is built only once for
+// tables that are joined repeatedly. Otherwise, the condition is
+// evaluated for each pair of rows.
+//
+// When the left table is scanned from memory and is smaller than the
+// right, its rows are matched at once, by probing a hash index on the
+// left key column with the right key column instead.
+//
+// Under a memory budget (see spill.hpp), once the right table of a join
+// on 'x.a eq y.b' exceeds the budget, its rows are spilled to partitions
+// by the hash of their key, so that the matches of each left row are in
+// a single partition, in the order of the right table. Each batch of
+// the left table is then matched against the partitions of its rows, a
+// partition at a time, and the matched rows of each partition are
+// copied into the batch of the result, so its batches are transient.
+struct Join_plan : Plan {
+  Join_plan(Join*, Plan*, Plan*);
+
+  Table* next() override;
+
+  void collect(std::size_t);
+  void spill(Table*);
+  void flush();
+  Table* load(std::size_t);
+  Table* partition_join(std::size_t, std::size_t);
+  Match_seq probe_left();
+  Match_seq hash_join(std::size_t, std::size_t);
+  Match_seq range_join(std::size_t, std::size_t);
+  Match_seq loop_join(std::size_t, std::size_t);
+
+  Plan_ptr left;
+  Plan_ptr right;
+  Term* cond;        // The join condition
+  Expr* d1;          // The declaration of the left table
+  Expr* d2;          // The declaration of the right table
+  Join_key key;      // The key columns, if any
+  Arena& arena;      // The arena of the plan
+  Table* table;      // The right table
+  Term_seq* rows;    // The rows of the right table, for loop joins
+  std::size_t c1;    // The left key column of the current batch
+  std::size_t c2;    // The right key column
+  std::size_t c3;    // The upper key column of the current batch, if any
+  Arena in;          // The arena of the current left batch
+  Table* batch;      // The current left batch
+  std::size_t pos;   // The next row of the current left batch
+  bool scan;         // True when the left table is scanned from memory
+
+  // Spilling
+  std::size_t budget; // The number of right rows kept in memory
+  std::unique_ptr<Arena> kept; // The arena of the right table
+  std::size_t held;   // The number of spilled rows not yet written
+  std::vector<std::unique_ptr<Arena>> bufs;   // The arena of each partition
+  std::vector<std::unique_ptr<Row_buf>> pending; // The rows not yet written
+  std::vector<std::vector<Run_ptr>> parts;    // The runs of each partition
+};
+
+Join_plan::Join_plan(Join* t, Plan* l, Plan* r)
+  : Plan(get_type(t), l->transient), left(l), right(r),
+    cond(t->join_cond()), d1(get_table_decl(t->t1)),
+    d2(get_table_decl(t->t2)), key(get_join_key(cond, d1, d2)),
+    arena(current_arena()), table(nullptr), rows(nullptr),
+    c1(no_column), c2(no_column), c3(no_column), batch(nullptr), pos(0),
+    scan(dynamic_cast<Scan_plan*>(l) != nullptr), budget(no_budget), held(0)
+{
+  if (key.left and key.op == join_eq)
+    budget = get_budget_rows(r->type);
+  transient = transient or budget != no_budget;
+}
+
+// Collect the right table in an arena of its own, so that it can be
+// released once n rows have been collected: those rows are then
+// spilled, as are the rest.
+void
+Join_plan::collect(std::size_t n) {
+  kept.reset(new Arena());
+  std::unique_ptr<Row_buf> all;
+  {
+    Arena_guard guard(*kept);
+    all.reset(new Row_buf(right->type));
+  }
+  Arena in;
+  while (true) {
+    Table* t;
+    {
+      Arena_guard guard(in);
+      t = right->next();
+    }
+    if (not t)
+      break;
+    if (all) {
+      all->append(t, right->transient);
+      if (all->table->rows() >= n) {
+        spill(all->table);
+        all.reset();
+        kept.reset();
+      }
+    } else {
+      spill(t);
+    }
+    if (held >= n)
+      flush();
+    in.release();
+  }
+  if (all)
+    table = all->table;
+  else
+    flush();
+}
+
+// Add the rows of the right table t to their partitions.
+void
+Join_plan::spill(Table* t) {
+  if (parts.empty()) {
+    bufs.resize(spill_partitions);
+    pending.resize(spill_partitions);
+    parts.resize(spill_partitions);
+  }
+  Term_seq* col = find_column(t, key.right->name());
+  lang_assert(col, "ill-formed join key");
+  std::vector<Row_seq> sel(spill_partitions);
+  for (std::size_t i = 0; i < col->size(); ++i)
+    sel[Expr_hash()((*col)[i]) % spill_partitions].push_back(i);
+  for (std::size_t p = 0; p < spill_partitions; ++p) {
+    if (sel[p].empty())
+      continue;
+    if (not bufs[p]) {
+      bufs[p].reset(new Arena());
+      Arena_guard guard(*bufs[p]);
+      pending[p].reset(new Row_buf(right->type));
+    }
+    Table* part;
+    {
+      Arena_guard guard(*bufs[p]);
+      part = select_rows(t, sel[p]);
+    }
+    pending[p]->append(part, true);
+    held += sel[p].size();
+  }
+}
+
+// Write the rows of each partition not yet written.
+void
+Join_plan::flush() {
+  for (std::size_t p = 0; p < bufs.size(); ++p) {
+    if (not bufs[p])
+      continue;
+    Table* t = pending[p]->table;
+    pending[p].reset();
+    parts[p].push_back(make_run(t, std::move(bufs[p])));
+  }
+  held = 0;
+}
+
+// Returns the rows of the partition p of the right table, allocated in
+// the current arena.
+Table*
+Join_plan::load(std::size_t p) {
+  Row_buf all(right->type);
+  for (Run_ptr& r : parts[p]) {
+    r->reset();
+    while (Table* t = r->read())
+      all.append(t, true);
+  }
+  return all.table;
+}
+
+// Match the rows [first, last) of the current batch against the
+// partitions of their keys, and return the joined rows. The rows of
+// each left row are matched in a single partition, so the matches are
+// ordered by the left row first, and then by the right table.
+Table*
+Join_plan::partition_join(std::size_t first, std::size_t last) {
+  Term_seq* probe = (*batch->columns())[c1];
+  std::vector<Row_seq> sel(spill_partitions);
+  for (std::size_t i = first; i < last; ++i)
+    sel[Expr_hash()((*probe)[i]) % spill_partitions].push_back(i);
+
+  Row_buf found(right->type);
+  Match_seq matches;
+  for (std::size_t p = 0; p < spill_partitions; ++p) {
+    if (sel[p].empty() or parts[p].empty())
+      continue;
+    Arena part;
+    Arena_guard guard(part);
+    Table* t = load(p);
+    std::size_t c = find_column_index(t, key.right->name());
+    lang_assert(c != no_column, "ill-formed join key");
+    Hash_index* index = make_hash_index(t, c);
+    for (std::size_t i : sel[p]) {
+      auto iter = index->find((*probe)[i]);
+      if (iter == index->end())
+        continue;
+      for (std::size_t j : iter->second) {
+        matches.emplace_back(i, found.table->rows());
+        found.append(t, j, j + 1, true);
+      }
+    }
+  }
+  std::stable_sort(matches.begin(), matches.end(), [](Match a, Match b) {
+    return a.first < b.first;
+  });
+  return join_tables(batch, found.table, matches, type);
+}
+
+Table*
+Join_plan::next() {
+  // Collect the right table, and build the index used to match rows.
+  if (not table and parts.empty()) {
+    Arena_guard guard(arena);
+    if (budget == no_budget)
+      table = right->drain();
+    else
+      collect(budget);
+    if (not parts.empty()) {
+      // The right table is spilled (see partition_join).
+    } else if (key.left) {
+      c2 = find_column_index(table, key.right->name());
+      lang_assert(c2 != no_column, "ill-formed join key");
+      if (key.op != join_eq)
+        make_sorted_index(table, c2);
+    } else if (not d2 or d1 == d2) {
+      rows = get_rows(table);
+    }
+  }
+
+  // Pull the next batch of rows from the left table.
+  while (not batch or pos == batch->rows()) {
+    in.release();
+    {
+      Arena_guard guard(in);
+      batch = left->next();
+    }
+    pos = 0;
+    if (not batch)
+      return nullptr;
+    if (key.left) {
+      c1 = find_column_index(batch, key.left->name());
+      lang_assert(c1 != no_column, "ill-formed join key");
+    }
+    if (key.upper) {
+      c3 = find_column_index(batch, key.upper->name());
+      lang_assert(c3 != no_column, "ill-formed join key");
+    }
+    if (scan and table and key.left and key.op == join_eq
+        and batch->rows() < table->rows()) {
+      pos = batch->rows();
+      return join_tables(batch, table, probe_left(), type);
+    }
+  }
+
+  std::size_t first = pos;
+  pos = std::min(pos + plan_batch_rows, batch->rows());
+  if (not parts.empty())
+    return partition_join(first, pos);
+  Match_seq matches;
+  if (key.left and key.op == join_eq)
+    matches = hash_join(first, pos);
+  else if (key.left)
+    matches = range_join(first, pos);
+  else
+    matches = loop_join(first, pos);
+  return join_tables(batch, table, matches, type);
+}
+
+// Match the rows of the current batch by probing the hash index of its
+// key column with the key column of the right table. Chunks of rows are
+// probed in parallel. The matches are ordered by the right table, so
+// the nested loop order is restored.
+Match_seq
+Join_plan::probe_left() {
+  Hash_index* index = make_hash_index(batch, c1);
+  Term_seq* probe = (*table->columns())[c2];
+  std::vector<Match_seq> parts(Thread_pool::chunk_count(probe->size()));
+  auto probe_rows = [&](std::size_t c, std::size_t first, std::size_t last) {
+    Match_seq& part = parts[c];
+    for (std::size_t j = first; j < last; ++j) {
+      auto iter = index->find((*probe)[j]);
+      if (iter == index->end())
+        continue;
+      for (std::size_t i : iter->second)
+        part.emplace_back(i, j);
+    }
+  };
+  get_thread_pool().run(probe->size(), probe_rows);
+  Match_seq matches = concat_chunks(parts);
+  std::sort(matches.begin(), matches.end());
+  return matches;
+}
+
+// Match the rows [first, last) of the current batch by probing the
+// hash index of the right table. Chunks of rows are probed in parallel.
+Match_seq
+Join_plan::hash_join(std::size_t first, std::size_t last) {
+  Hash_index* index = make_hash_index(table, c2);
+  Term_seq* probe = (*batch->columns())[c1];
+  std::vector<Match_seq> parts(Thread_pool::chunk_count(last - first));
+  auto probe_rows = [&](std::size_t c, std::size_t i0, std::size_t i1) {
+    Match_seq& part = parts[c];
+    for (std::size_t i = first + i0; i < first + i1; ++i) {
+      auto iter = index->find((*probe)[i]);
+      if (iter == index->end())
+        continue;
+      for (std::size_t j : iter->second)
+        part.emplace_back(i, j);
+    }
+  };
+  get_thread_pool().run(last - first, probe_rows);
+  return concat_chunks(parts);
+}
+
+// Match the rows [first, last) of the current batch on 'x.a lt y.b'
+// (or 'y.b lt x.a', or a band condition) by searching the sorted index
+// of the right table. The rows are searched in parallel.
+Match_seq
+Join_plan::range_join(std::size_t first, std::size_t last) {
+  Term_seq* col = (*batch->columns())[c1];
+  Term_seq* upper = key.upper ? (*batch->columns())[c3] : nullptr;
+  std::vector<Match_seq> parts(Thread_pool::chunk_count(last - first));
+  auto search_rows = [&](std::size_t c, std::size_t i0, std::size_t i1) {
+    Match_seq& part = parts[c];
+    for (std::size_t i = first + i0; i < first + i1; ++i) {
+      Row_seq found;
+      if (key.op == join_band)
+        found = find_rows_between(table, c2, (*col)[i], (*upper)[i]);
+      else if (key.op == join_lt)
+        found = find_rows_greater(table, c2, (*col)[i]);
+      else
+        found = find_rows_less(table, c2, (*col)[i]);
+      for (std::size_t j : found)
+        part.emplace_back(i, j);
+    }
+  };
+  get_thread_pool().run(last - first, search_rows);
+  return concat_chunks(parts);
+}
+
+// Match the rows [first, last) of the current batch by evaluating the
+// condition with the table references in the condition replaced by
+// each pair of rows. Like the conditions of a filter, the condition is
+// evaluated in the arena of the plan.
+//
+// When the right table is named, the reference to the left table is
+// replaced by each left row instead, and the rows of the right table
+// are selected by the resulting condition as if by a filter, which can
+// then use an index or be vectorized (see query.hpp).
+Match_seq
+Join_plan::loop_join(std::size_t first, std::size_t last) {
+  Arena_guard guard(arena);
+  Match_seq matches;
+  if (not rows) {
+    for (std::size_t i = first; i < last; ++i) {
+      Term* c = cond;
+      if (d1) {
+        Subst sub {d1, get_row(batch, i)};
+        c = subst_term(cond, sub);
+      }
+      Row_pred pred(c, d2, table);
+      for (std::size_t j : pred.select())
+        matches.emplace_back(i, j);
+    }
+    return matches;
+  }
+  for (std::size_t i = first; i < last; ++i) {
+    Record* r1 = get_row(batch, i);
+    for (std::size_t j = 0; j < rows->size(); ++j) {
+      Subst sub;
+      if (d1)
+        sub.insert({d1, r1});
+      if (d2)
+        sub.insert({d2, (*rows)[j]});
+      if (is_true(eval(subst_term(cond, sub))))
+        matches.emplace_back(i, j);
+    }
+  }
+  return matches;
+}
+
+
+// -------------------------------------------------------------------------- //
+// Set operations
+
+// Returns the hash of each row of the table t. Rows are hashed in
+// parallel.
+std::vector<std::size_t>
+hash_rows(Table* t) {
+  std::vector<std::size_t> hashes(t->rows());
+  auto hash = [&](std::size_t, std::size_t first, std::size_t last) {
+    for (std::size_t i = first; i < last; ++i)
+      hashes[i] = hash_row(t, i);
+  };
+  get_thread_pool().run(t->rows(), hash);
+  return hashes;
+}
+
+// A set operation produces the distinct rows of 't1 union t2', 't1
+// intersect t2', or 't1 except t2', each in its first position. A
+// union produces the rows of each of its inputs in turn; a chain of
+// unions like '(t1 union t2) union t3' is a single operator over all
+// of their operands, so that rows are hashed and collected only once.
+// An intersection (or difference) produces the rows of t1 that are (or
+// are not) rows of t2, whose rows are collected when the first batch is
+// pulled.
+//
+// The distinct rows are collected as they are produced, so that later
+// duplicates can be found. A batch whose rows are all kept is produced
+// as it is, unless it is transient; other batches are produced from the
+// collected rows. Batches are never transient.
+struct Set_plan : Plan {
+  Set_plan(Term*, std::vector<Plan_ptr>&, Plan*);
+
+  Table* next() override;
+  Table* drain() override;
+
+  Table* collect(bool&);
+
+  Node_kind kind;   // The kind of operation
+  std::vector<Plan_ptr> inputs; // The operators producing rows
+  Plan_ptr right;   // The operator producing t2, if not a union
+  std::size_t input; // The current input
+  Arena& arena;     // The arena of the plan
+  Table* table;     // The rows of t2, for intersections and differences
+  Row_set rows;     // The rows of that table
+  Row_buf buf;      // The distinct rows produced so far
+  Row_set seen;     // The set of those rows
+};
+
+Set_plan::Set_plan(Term* t, std::vector<Plan_ptr>& in, Plan* r)
+  : Plan(in.front()->type, false), kind(t->kind), inputs(std::move(in)),
+    right(r), input(0), arena(current_arena()), table(nullptr),
+    buf(type) { }
+
+// Pull the next batch from the inputs, and collect its distinct rows
+// that belong to the result. Returns the batch, or nullptr when there
+// are no more rows. The flag all is set when every row of the batch
+// was collected.
+Table*
+Set_plan::collect(bool& all) {
+  if (right and not table) {
+    Arena_guard guard(arena);
+    table = right->drain();
+    std::vector<std::size_t> hashes = hash_rows(table);
+    rows.reserve(table->rows());
+    for (std::size_t i = 0; i < table->rows(); ++i)
+      rows.insert({table, i, hashes[i]});
+  }
+
+  Table* batch = nullptr;
+  while (input < inputs.size() and not (batch = inputs[input]->next()))
+    ++input;
+  if (not batch)
+    return nullptr;
+
+  // Hash the rows of the batch, and look them up in t2, in parallel.
+  std::vector<std::size_t> hashes(batch->rows());
+  std::vector<char> keep(batch->rows(), true);
+  auto find = [&](std::size_t, std::size_t first, std::size_t last) {
+    for (std::size_t i = first; i < last; ++i) {
+      hashes[i] = hash_row(batch, i);
+      if (right) {
+        bool found = rows.count({batch, i, hashes[i]}) != 0;
+        keep[i] = found == (kind == intersect_term);
+      }
+    }
+  };
+  get_thread_pool().run(batch->rows(), find);
+
+  // Collect the rows not seen before.
+  bool copy = inputs[input]->transient;
+  std::size_t n = buf.table->rows();
+  for (std::size_t i = 0; i < batch->rows(); ++i) {
+    if (not keep[i] or seen.count({batch, i, hashes[i]}))
+      continue;
+    std::size_t k = buf.table->rows();
+    buf.append(batch, i, i + 1, copy);
+    seen.insert({buf.table, k, hashes[i]});
+  }
+  all = buf.table->rows() - n == batch->rows();
+  return batch;
+}
+
+Table*
+Set_plan::next() {
+  std::size_t n = buf.table->rows();
+  bool all;
+  Table* batch = collect(all);
+  if (not batch)
+    return nullptr;
+  if (all and not inputs[input]->transient)
+    return batch;
+
+  // The batch holds the rows collected from this batch.
+  Row_seq sel(buf.table->rows() - n);
+  for (std::size_t i = 0; i < sel.size(); ++i)
+    sel[i] = n + i;
+  return select_rows(buf.table, sel);
+}
+
+// The result of a set operation is the table of distinct rows.
+Table*
+Set_plan::drain() {
+  Arena in;
+  while (true) {
+    Arena_guard guard(in);
+    bool all;
+    if (not collect(all))
+      break;
+    in.release();
+  }
+  return buf.table;
+}
+
+
+// -------------------------------------------------------------------------- //
+// Grouping
+
+// Returns the subterms of the comma term t, or t itself.
+Term_seq*
+get_comma_terms(Term* t) {
+  Term_seq* ts = new Term_seq();
+  if (Comma* c = as<Comma>(t)) {
+    for (Expr* e : *c->elems())
+      ts->push_back(as<Term>(e));
+  } else {
+    ts->push_back(t);
+  }
+  return ts;
+}
+
+// Returns the value of a cell of a column of natural numbers.
+inline const Integer&
+get_nat(Term* v) {
+  Int* n = as<Int>(v);
+  lang_assert(n, format("'{}' is not a natural number", pretty(v)));
+  return n->value();
+}
+
+// The groups of the rows seen by a grouping: the key of each group, the
+// aggregates of each item, and the position in the input of the first
+// row of each group. The keys are collected in the arena that is
+// current when the set is constructed.
+struct Group_set {
+  Group_set(Type* t, std::size_t n)
+    : groups(t), values(n) { }
+
+  Row_buf groups;      // The key of each group
+  Row_set index;       // The set of those keys
+  std::vector<std::vector<Integer>> values; // The aggregates of each group
+  std::vector<std::size_t> first;           // The first row of each group
+};
+
+// A grouping of 'select t1 from t2 where t3 group by t4' produces a row
+// for each distinct key t4 of the rows of its input, in the order in
+// which the keys first occur. The input is aggregated in a single pass
+// over its batches: the key of each row is looked up in a hash table
+// of the keys seen so far (the keys are hashed in parallel), and the
+// aggregates of its group are updated with that row. The result is
+// produced as a single batch once the input is exhausted.
+//
+// The keys of the groups are collected in the arena of the plan. The
+// key columns of the result are those keys, and its aggregates are
+// also allocated in that arena, so that the batch is not transient.
+//
+// Under a memory budget (see spill.hpp), once the groups fill half of
+// the budget, no more groups are started. The rows of the input that do
+// not belong to an existing group (their key, aggregated columns, and
+// position in the input) are spilled to partitions by the hash of their
+// key, so that the rows of each group are in a single partition; they
+// are written whenever they fill the other half. Once the input is
+// exhausted, each partition is grouped in turn, and its groups are
+// spilled with the position of their first row. The result is produced
+// by merging the groups kept in memory with those of each partition in
+// the order of those positions, a batch at a time, and those batches
+// are transient.
+struct Group_plan : Plan {
+  Group_plan(Group_by*, Plan*);
+
+  Table* next() override;
+
+  void add(Group_set&, Table*, bool, Term_seq*);
+  void spill(Table*, const std::vector<Row_seq>&);
+  void flush();
+  Table* get_groups(Group_set&, bool);
+  void merge_groups();
+
+  Plan_ptr input;
+  Term_seq* items;     // The members of the projection list
+  Term_seq* keys;      // The key columns
+  Type* key_type;      // The type of the keys
+  std::vector<Agg*> aggs; // The aggregate of each item, if any
+  Group_set groups;    // The groups kept in memory
+  bool done;
+
+  // Spilling
+  Name* seq_name;      // The name of the position of a spilled row
+  Type* spill_type;    // The type of spilled rows
+  Type* seq_type;      // The type of spilled groups
+  std::size_t budget;  // The number of groups kept in memory
+  std::size_t seq;     // The position of the next row of the input
+  std::size_t held;    // The number of spilled rows not yet written
+  std::vector<std::unique_ptr<Arena>> bufs;   // The arena of each partition
+  std::vector<std::unique_ptr<Row_buf>> pending; // The rows not yet written
+  std::vector<std::vector<Run_ptr>> parts;    // The runs of each partition
+  std::unique_ptr<Run_merge> merge;
+};
+
+// Returns the member aggregated by a.
+inline Var*
+get_agg_var(Agg* a) {
+  return as<Var>(as<Ref>(as<Mem>(a->column())->member())->decl());
+}
+
+// Returns the list type whose rows have the members vs and the natural
+// number n.
+Type*
+get_seq_type(Term_seq* vs, Name* n) {
+  Term_seq* vars = new Term_seq(*vs);
+  vars->push_back(new Var(n, get_nat_type()));
+  return get_list_type(get_record_type(vars));
+}
+
+Group_plan::Group_plan(Group_by* t, Plan* in)
+  : Plan(get_type(t), false), input(in),
+    items(get_comma_terms(t->projection_list())),
+    keys(get_projected_vars(t->key())),
+    key_type(get_list_type(get_record_type(keys))),
+    aggs(items->size()), groups(key_type, items->size()), done(false),
+    seq_name(new Id(String("#seq"))), seq(0), held(0)
+{
+  Term_seq* cols = new Term_seq(*keys);
+  for (std::size_t j = 0; j < items->size(); ++j) {
+    aggs[j] = as<Agg>((*items)[j]);
+    if (not aggs[j] or aggs[j]->op() == agg_count)
+      continue;
+    Var* v = get_agg_var(aggs[j]);
+    if (std::find(cols->begin(), cols->end(), v) == cols->end())
+      cols->push_back(v);
+  }
+  spill_type = get_seq_type(cols, seq_name);
+  seq_type = get_seq_type(get_row_type(type)->members(), seq_name);
+  budget = no_budget;
+  if (is_table_file_type(seq_type))
+    budget = std::max<std::size_t>(get_budget_rows(spill_type) / 2, 1);
+  transient = budget != no_budget;
+}
+
+// Add the rows of the batch t to the groups g, copying their keys if
+// copy is true. The position of each row is given by seqs, if given,
+// and otherwise the batch follows the rows seen so far. Once the groups
+// kept in memory exceed the budget, rows for new groups are spilled.
+void
+Group_plan::add(Group_set& g, Table* t, bool copy, Term_seq* seqs) {
+  Column_seq* cols = new Column_seq();
+  cols->reserve(keys->size());
+  for (Term* v : *keys) {
+    Term_seq* col = find_column(t, as<Var>(v)->name());
+    lang_assert(col, format("no column named '{}'", pretty(as<Var>(v)->name())));
+    cols->push_back(col);
+  }
+  Table* key = make_table(key_type, cols, t->rows());
+  std::vector<Term_seq*> args(items->size());
+  for (std::size_t j = 0; j < items->size(); ++j) {
+    if (aggs[j] and aggs[j]->op() != agg_count) {
+      args[j] = find_column(t, get_agg_var(aggs[j])->name());
+      lang_assert(args[j], "ill-formed aggregate");
+    }
+  }
+
+  static const Integer one(1);
+  bool full = &g == &groups and g.groups.table->rows() >= budget;
+  std::vector<Row_seq> spilled(full ? spill_partitions : 0);
+  std::vector<std::size_t> hashes = hash_rows(key);
+  for (std::size_t i = 0; i < t->rows(); ++i) {
+    auto iter = g.index.find({key, i, hashes[i]});
+    std::size_t k;
+    if (iter == g.index.end()) {
+      if (full) {
+        spilled[hashes[i] % spill_partitions].push_back(i);
+        continue;
+      }
+
+      // Start a new group, whose minimum and maximum are this row.
+      k = g.groups.table->rows();
+      g.groups.append(key, i, i + 1, copy);
+      g.index.insert({g.groups.table, k, hashes[i]});
+      g.first.push_back(seqs ? get_nat((*seqs)[i]).word() : seq + i);
+      for (std::size_t j = 0; j < items->size(); ++j) {
+        if (not aggs[j])
+          continue;
+        Agg_op op = aggs[j]->op();
+        bool first = op == agg_min or op == agg_max;
+        g.values[j].push_back(first ? get_nat((*args[j])[i]) : Integer());
+      }
+      if (&g == &groups and k + 1 == budget) {
+        full = true;
+        spilled.resize(spill_partitions);
+      }
+    } else {
+      k = iter->i;
+    }
+
+    for (std::size_t j = 0; j < items->size(); ++j) {
+      if (not aggs[j])
+        continue;
+      Integer& v = g.values[j][k];
+      switch (aggs[j]->op()) {
+      case agg_count:
+        v += one;
+        break;
+      case agg_sum:
+        v += get_nat((*args[j])[i]);
+        break;
+      case agg_min:
+        if (get_nat((*args[j])[i]) < v)
+          v = get_nat((*args[j])[i]);
+        break;
+      case agg_max:
+        if (v < get_nat((*args[j])[i]))
+          v = get_nat((*args[j])[i]);
+        break;
+      }
+    }
+  }
+  if (full)
+    spill(t, spilled);
+  if (not seqs)
+    seq += t->rows();
+}
+
+// Add the given rows of the batch t to each partition, and write the
+// partitions once the rows not yet written exceed the budget.
+void
+Group_plan::spill(Table* t, const std::vector<Row_seq>& spilled) {
+  if (bufs.empty()) {
+    bufs.resize(spill_partitions);
+    pending.resize(spill_partitions);
+    parts.resize(spill_partitions);
+  }
+  Term_seq* vars = get_row_type(spill_type)->members();
+  for (std::size_t p = 0; p < spill_partitions; ++p) {
+    const Row_seq& sel = spilled[p];
+    if (sel.empty())
+      continue;
+    if (not bufs[p]) {
+      bufs[p].reset(new Arena());
+      Arena_guard guard(*bufs[p]);
+      pending[p].reset(new Row_buf(spill_type));
+    }
+
+    // Select the spilled columns of the rows, and their positions.
+    Column_seq* cols = new Column_seq();
+    cols->reserve(vars->size());
+    for (std::size_t j = 0; j + 1 < vars->size(); ++j) {
+      Term_seq* col = find_column(t, as<Var>((*vars)[j])->name());
+      Term_seq* part = new Term_seq();
+      part->reserve(sel.size());
+      for (std::size_t i : sel)
+        part->push_back((*col)[i]);
+      cols->push_back(part);
+    }
+    Term_seq* pos = new Term_seq();
+    pos->reserve(sel.size());
+    for (std::size_t i : sel)
+      pos->push_back(new Int(get_nat_type(), Integer(long(seq + i))));
+    cols->push_back(pos);
+    pending[p]->append(make_table(spill_type, cols, sel.size()), true);
+    held += sel.size();
+  }
+  if (held >= budget)
+    flush();
+}
+
+// Write the rows of each partition not yet written.
+void
+Group_plan::flush() {
+  for (std::size_t p = 0; p < bufs.size(); ++p) {
+    if (not bufs[p])
+      continue;
+    Table* t = pending[p]->table;
+    pending[p].reset();
+    parts[p].push_back(make_run(t, std::move(bufs[p])));
+  }
+  held = 0;
+}
+
+// Returns the table of the groups g, allocated in the arena of those
+// groups. When seqs is true, the table gives the position of the first
+// row of each group in its last column.
+Table*
+Group_plan::get_groups(Group_set& g, bool seqs) {
+  Arena_guard guard(g.groups.arena);
+  std::size_t n = g.groups.table->rows();
+  Column_seq* cols = new Column_seq();
+  cols->reserve(items->size() + 1);
+  for (std::size_t j = 0; j < items->size(); ++j) {
+    if (not aggs[j]) {
+      Ref* member = as<Ref>(as<Mem>((*items)[j])->member());
+      cols->push_back(find_column(g.groups.table, as<Var>(member->decl())->name()));
+      continue;
+    }
+    Term_seq* col = new Term_seq();
+    col->reserve(n);
+    for (const Integer& v : g.values[j])
+      col->push_back(new Int(get_nat_type(), v));
+    cols->push_back(col);
+  }
+  if (seqs) {
+    Term_seq* col = new Term_seq();
+    col->reserve(n);
+    for (std::size_t k : g.first)
+      col->push_back(new Int(get_nat_type(), Integer(long(k))));
+    cols->push_back(col);
+  }
+  return make_table(seqs ? seq_type : type, cols, n);
+}
+
+// Group the rows of each partition, and merge the resulting groups with
+// those kept in memory.
+void
+Group_plan::merge_groups() {
+  flush();
+  merge.reset(new Run_merge(type, seq_name, false));
+  merge->add(keep_run(get_groups(groups, true), nullptr));
+  for (std::vector<Run_ptr>& runs : parts) {
+    if (runs.empty())
+      continue;
+    std::unique_ptr<Arena> buf(new Arena());
+    std::unique_ptr<Group_set> g;
+    {
+      Arena_guard guard(*buf);
+      g.reset(new Group_set(key_type, items->size()));
+    }
+    Arena in;
+    for (Run_ptr& r : runs) {
+      while (Table* t = r->read()) {
+        Arena_guard guard(in);
+        add(*g, t, true, find_column(t, seq_name));
+        in.release();
+      }
+    }
+    Table* t = get_groups(*g, true);
+    g.reset();
+    runs.clear();
+    merge->add(make_run(t, std::move(buf)));
+  }
+}
+
+Table*
+Group_plan::next() {
+  if (merge)
+    return merge->next();
+  if (done)
+    return nullptr;
+  done = true;
+
+  Arena in;
+  while (true) {
+    Arena_guard guard(in);
+    Table* batch = input->next();
+    if (not batch)
+      break;
+    add(groups, batch, input->transient, nullptr);
+    in.release();
+  }
+  if (not parts.empty()) {
+    merge_groups();
+    return merge->next();
+  }
+  return get_groups(groups, false);
+}
+
+
+// -------------------------------------------------------------------------- //
+// Ordering
+
+// Returns the name of the column by which 't1 order by t2' is ordered:
+// that of the column 'x.a' or the aggregate named by t2.
+Name*
+get_order_name(Order_by* t) {
+  if (Name* n = as<Name>(t->key()))
+    return n;
+  Ref* member = as<Ref>(as<Mem>(t->key())->member());
+  return as<Var>(member->decl())->name();
+}
+
+// The position of a row kept by a sort. The sequence number is that
+// of the row in the input, and orders rows with equal keys.
+struct Sort_entry {
+  std::size_t row;
+  std::size_t seq;
+};
+
+// A sort orders the rows of its input by the key column, using the
+// ordering of terms (see is_less). Rows with equal keys are kept in
+// the order of the input. The result is produced as a single batch
+// once the input is exhausted.
+//
+// When the sort has a limit k, only the first k rows of the result are
+// kept: the kept rows form a heap whose top is the last of those rows,
+// and a row of the input is kept only if it precedes that row, which
+// it then replaces. Only the rows of the input that are kept are
+// copied out of its batches.
+//
+// Under a memory budget (see spill.hpp), a sort without a limit is an
+// external merge sort: the input is divided into runs of consecutive
+// rows that fit within the budget, each run is sorted and spilled, and
+// the result is produced by merging the runs, a batch at a time. Those
+// batches are transient.
+struct Sort_plan : Plan {
+  Sort_plan(Plan* in, Name* n, bool d, std::size_t k, bool l)
+    : Plan(in->type, false), input(in), key(n), desc(d), limit(k),
+      limited(l), budget(l ? no_budget : get_budget_rows(type)),
+      done(false) { transient = budget != no_budget; }
+
+  Table* next() override;
+
+  bool before(Term*, std::size_t, Term*, std::size_t) const;
+  Row_seq sort_rows(Term_seq*) const;
+  void spill_runs(std::size_t);
+
+  Plan_ptr input;
+  Name* key;         // The name of the key column
+  bool desc;         // True if the rows are in descending order
+  std::size_t limit; // The greatest number of rows in the result
+  bool limited;      // True if the number of rows is limited
+  std::size_t budget; // The number of rows in each run, if spilled
+  bool done;
+  std::unique_ptr<Run_merge> merge; // The merge of the runs, if spilled
+};
+
+// Returns true if the row with key k1 and sequence number s1 precedes
+// that with key k2 and sequence number s2.
+inline bool
+Sort_plan::before(Term* k1, std::size_t s1, Term* k2, std::size_t s2) const {
+  if (desc ? is_less(k2, k1) : is_less(k1, k2))
+    return true;
+  if (desc ? is_less(k1, k2) : is_less(k2, k1))
+    return false;
+  return s1 < s2;
+}
+
+// Returns the rows of a table in sorted order, given its key column.
+Row_seq
+Sort_plan::sort_rows(Term_seq* keys) const {
+  Row_seq rows(keys->size());
+  for (std::size_t i = 0; i < rows.size(); ++i)
+    rows[i] = i;
+  std::sort(rows.begin(), rows.end(), [this, keys](std::size_t a, std::size_t b) {
+    return before((*keys)[a], a, (*keys)[b], b);
+  });
+  return rows;
+}
+
+// Divide the input into runs of at least n rows (each batch of the
+// input is in a single run), and add each run to the merge once it is
+// sorted.
+void
+Sort_plan::spill_runs(std::size_t n) {
+  merge.reset(new Run_merge(type, key, desc));
+  std::unique_ptr<Arena> run;
+  std::unique_ptr<Row_buf> rows;
+  Arena in;
+  while (true) {
+    if (not rows) {
+      run.reset(new Arena());
+      Arena_guard guard(*run);
+      rows.reset(new Row_buf(type));
+    }
+    Table* batch;
+    {
+      Arena_guard guard(in);
+      batch = input->next();
+    }
+    if (batch) {
+      rows->append(batch, input->transient);
+      in.release();
+      if (rows->table->rows() < n)
+        continue;
+    }
+    if (rows->table->rows() != 0) {
+      Arena_guard guard(*run);
+      Term_seq* keys = find_column(rows->table, key);
+      lang_assert(keys, format("no column named '{}'", pretty(key)));
+      Table* sorted = select_rows(rows->table, sort_rows(keys));
+      rows.reset();
+      merge->add(make_run(sorted, std::move(run)));
+    }
+    if (not batch)
+      break;
+  }
+}
+
+Table*
+Sort_plan::next() {
+  if (merge)
+    return merge->next();
+  if (done)
+    return nullptr;
+  done = true;
+  if (budget != no_budget) {
+    spill_runs(budget);
+    return merge->next();
+  }
+
+  Row_buf rows(type);
+  Term_seq* keys = find_column(rows.table, key);
+  lang_assert(keys, format("no column named '{}'", pretty(key)));
+  std::vector<Sort_entry> kept;
+  auto precedes = [this, &keys](const Sort_entry& a, const Sort_entry& b) {
+    return before((*keys)[a.row], a.seq, (*keys)[b.row], b.seq);
+  };
+
+  std::size_t seq = 0;
+  Arena in;
+  while (not limited or limit != 0) {
+    Arena_guard guard(in);
+    Table* batch = input->next();
+    if (not batch)
+      break;
+    if (not limited) {
+      rows.append(batch, input->transient);
+      in.release();
+      continue;
+    }
+
+    Term_seq* col = find_column(batch, key);
+    lang_assert(col, format("no column named '{}'", pretty(key)));
+    for (std::size_t i = 0; i < batch->rows(); ++i, ++seq) {
+      if (kept.size() < limit) {
+        rows.append(batch, i, i + 1, input->transient);
+        kept.push_back({kept.size(), seq});
+        std::push_heap(kept.begin(), kept.end(), precedes);
+        continue;
+      }
+      const Sort_entry& last = kept.front();
+      if (not before((*col)[i], seq, (*keys)[last.row], last.seq))
+        continue;
+      std::pop_heap(kept.begin(), kept.end(), precedes);
+      rows.assign(kept.back().row, batch, i, input->transient);
+      kept.back().seq = seq;
+      std::push_heap(kept.begin(), kept.end(), precedes);
+    }
+    in.release();
+  }
+
+  if (not limited)
+    return select_rows(rows.table, sort_rows(keys));
+  std::sort_heap(kept.begin(), kept.end(), precedes);
+  Row_seq sel;
+  sel.reserve(kept.size());
+  for (const Sort_entry& e : kept)
+    sel.push_back(e.row);
+  return select_rows(rows.table, sel);
+}
+
+// A limit produces the first n rows of its input. Once those rows have
+// been produced, no more batches are pulled from the input, so that
+// the rest of a CSV file is not read. Note that a table in memory is
+// scanned as a single batch, which is filtered as a whole.
+struct Limit_plan : Plan {
+  Limit_plan(Plan* in, std::size_t n)
+    : Plan(in->type, in->transient), input(in), rest(n) { }
+
+  Table* next() override;
+
+  Plan_ptr input;
+  std::size_t rest; // The number of rows left to produce
+};
+
+Table*
+Limit_plan::next() {
+  if (rest == 0)
+    return nullptr;
+  Table* batch = input->next();
+  if (not batch)
+    return nullptr;
+  if (batch->rows() <= rest) {
+    rest -= batch->rows();
+    return batch;
+  }
+  Row_seq sel(rest);
+  for (std::size_t i = 0; i < rest; ++i)
+    sel[i] = i;
+  rest = 0;
+  return select_rows(batch, sel);
+}
+
+
+// -------------------------------------------------------------------------- //
+// Partitioned execution
+
+// Returns a scan of the table t of the query q when q can be run by
+// worker processes (see worker.hpp), and nullptr otherwise. The table
+// must be a definition whose value is already a table of at least
+// worker_min_rows rows, and q must have no effects, since it is run
+// once by each worker. Workers are not run within a loop of the thread
+// pool (e.g., by the parallel evaluation of a program, see sched.hpp).
+Scan_plan*
+make_partitioned_scan(Term* q, Term* t) {
+  if (get_worker_count() < 2 or Thread_pool::in_loop())
+    return nullptr;
+  Ref* ref = as<Ref>(t);
+  Def* def = ref ? as<Def>(ref->decl()) : nullptr;
+  Table* table = def ? as<Table>(def->value()) : nullptr;
+  if (not table or table->rows() < worker_min_rows)
+    return nullptr;
+  Stmt_seq deps;
+  if (not find_deps(q, Def_map(), deps))
+    return nullptr;
+  return new Scan_plan(table);
+}
+
+// Run the plan p in workers, each of which scans its own partition of
+// the table of part, a leaf of p: the rows of the table are divided
+// into as many ranges of consecutive rows as there are workers. Returns
+// the result of each worker, in the order of their partitions, or an
+// empty sequence if the workers cannot be run, or if their results
+// cannot be saved to table files (see table_file.hpp).
+std::vector<Table*>
+run_partitioned(Plan* p, Scan_plan* part) {
+  if (not is_table_file_type(p->type))
+    return {};
+  Table* table = part->table;
+  std::size_t rows = table->rows();
+  auto run = [p, part, table, rows](std::size_t i, std::size_t n) {
+    Row_seq sel;
+    sel.reserve(rows / n + 1);
+    for (std::size_t k = rows * i / n; k < rows * (i + 1) / n; ++k)
+      sel.push_back(k);
+    part->table = select_rows(table, sel);
+    return p->drain();
+  };
+  return run_workers(std::min(get_worker_count(), rows), run);
+}
+
+// A gather produces the results of the workers of a query, in the
+// order of their partitions, a result at a time.
+struct Gather_plan : Plan {
+  Gather_plan(Type* t, std::vector<Table*> p)
+    : Plan(t, false), parts(std::move(p)), pos(0) { }
+
+  Table* next() override;
+
+  std::vector<Table*> parts;
+  std::size_t pos; // The next result
+};
+
+Table*
+Gather_plan::next() {
+  if (pos == parts.size())
+    return nullptr;
+  return parts[pos++];
+}
+
+// Returns true if each key column of the grouping t is projected, so
+// that the groups of its partial results can be merged.
+bool
+has_projected_keys(Group_by* t) {
+  Term_seq* items = get_comma_terms(t->projection_list());
+  for (Term* k : *get_projected_vars(t->key())) {
+    auto is_key = [k](Term* item) {
+      Mem* m = as<Mem>(item);
+      return m and as<Ref>(m->member())->decl() == k;
+    };
+    if (std::none_of(items->begin(), items->end(), is_key))
+      return false;
+  }
+  return true;
+}
+
+// Returns the grouping t of the rows of its table, given the groupings
+// parts of the partitions of those rows, in order. The groups of the
+// parts are merged in the order in which their keys first occur, so the
+// groups are in the same order as those of a single grouping: counts
+// and sums are added, and the least of the minimums (or greatest of the
+// maximums) is kept. The key columns of the result are those of the
+// parts.
+Table*
+merge_partial_groups(Group_by* t, const std::vector<Table*>& parts) {
+  Term_seq* items = get_comma_terms(t->projection_list());
+  Term_seq* keys = get_projected_vars(t->key());
+  Type* key_type = get_list_type(get_record_type(keys));
+  std::vector<std::size_t> key_items;
+  for (Term* k : *keys) {
+    for (std::size_t j = 0; j < items->size(); ++j) {
+      Mem* m = as<Mem>((*items)[j]);
+      if (m and as<Ref>(m->member())->decl() == k) {
+        key_items.push_back(j);
+        break;
+      }
+    }
+  }
+
+  Group_set g(key_type, items->size());
+  for (Table* part : parts) {
+    Column_seq* cols = new Column_seq();
+    cols->reserve(keys->size());
+    for (std::size_t j : key_items)
+      cols->push_back((*part->columns())[j]);
+    Table* key = make_table(key_type, cols, part->rows());
+    std::vector<std::size_t> hashes = hash_rows(key);
+    for (std::size_t i = 0; i < part->rows(); ++i) {
+      auto iter = g.index.find({key, i, hashes[i]});
+      if (iter == g.index.end()) {
+        std::size_t k = g.groups.table->rows();
+        g.groups.append(key, i, i + 1, false);
+        g.index.insert({g.groups.table, k, hashes[i]});
+        for (std::size_t j = 0; j < items->size(); ++j) {
+          if (is<Agg>((*items)[j]))
+            g.values[j].push_back(get_nat((*(*part->columns())[j])[i]));
+        }
+        continue;
+      }
+      for (std::size_t j = 0; j < items->size(); ++j) {
+        Agg* a = as<Agg>((*items)[j]);
+        if (not a)
+          continue;
+        Integer& v = g.values[j][iter->i];
+        const Integer& w = get_nat((*(*part->columns())[j])[i]);
+        switch (a->op()) {
+        case agg_count:
+        case agg_sum:
+          v += w;
+          break;
+        case agg_min:
+          if (w < v)
+            v = w;
+          break;
+        case agg_max:
+          if (v < w)
+            v = w;
+          break;
+        }
+      }
+    }
+  }
+
+  std::size_t n = g.groups.table->rows();
+  Column_seq* cols = new Column_seq();
+  cols->reserve(items->size());
+  for (std::size_t j = 0; j < items->size(); ++j) {
+    if (not is<Agg>((*items)[j])) {
+      Ref* member = as<Ref>(as<Mem>((*items)[j])->member());
+      cols->push_back(find_column(g.groups.table, as<Var>(member->decl())->name()));
+      continue;
+    }
+    Term_seq* col = new Term_seq();
+    col->reserve(n);
+    for (const Integer& v : g.values[j])
+      col->push_back(new Int(get_nat_type(), v));
+    cols->push_back(col);
+  }
+  return make_table(get_type(t), cols, n);
+}
+
+// -------------------------------------------------------------------------- //
+// Plan construction
+
+// Returns the operator producing the rows of the table t. A table
+// named by 't as x' (or a reference to it) is produced by the operator
+// for t, which is not evaluated until then (see eval_ref). A table that
+// is not produced by a query or read from a CSV file is evaluated, and
+// then scanned.
+Plan*
+make_source(Term* t) {
+  Term* t0 = t;
+  if (Def* d = as<Def>(get_select_decl(t)))
+    t0 = as<Term>(d->value());
+  if (is_plan_term(t0))
+    return make_plan(t0);
+  if (Csv* c = as<Csv>(t0))
+    return new Csv_plan(c);
+  return new Scan_plan(eval_table(t));
+}
+
+// Returns a plan producing the results of the workers of the plan p,
+// or p itself if p does not scan part (see make_partitioned_scan), or
+// if the workers cannot be run.
+Plan*
+make_gather_plan(Plan* p, Scan_plan* part) {
+  Plan_ptr plan(p);
+  if (not part)
+    return plan.release();
+  std::vector<Table*> parts = run_partitioned(p, part);
+  if (parts.empty())
+    return plan.release();
+  return new Gather_plan(p->type, std::move(parts));
+}
+
+// A selection from a large table is run by workers (see worker.hpp),
+// whose results are produced in the order of their partitions.
+Plan*
+make_select_plan(Select_from_where* t) {
+  Scan_plan* part = make_partitioned_scan(t, t->table());
+  Plan_ptr in(part ? part : make_source(t->table()));
+  Plan_ptr filter(new Filter_plan(in.release(), t->cond(), get_select_decl(t->table())));
+  Plan_ptr project(new Project_plan(filter.release(), t->projection_list()));
+  return make_gather_plan(project.release(), part);
+}
+
+// A grouping of a large table is run by workers when its key columns
+// are projected, and their groups are merged (see merge_partial_groups).
+Plan*
+make_group_plan(Group_by* t) {
+  Scan_plan* part = has_projected_keys(t) ? make_partitioned_scan(t, t->table()) : nullptr;
+  Plan_ptr in(part ? part : make_source(t->table()));
+  Plan_ptr filter(new Filter_plan(in.release(), t->cond(), get_select_decl(t->table())));
+  Plan_ptr group(new Group_plan(t, filter.release()));
+  if (part) {
+    std::vector<Table*> parts = run_partitioned(group.get(), part);
+    if (not parts.empty())
+      return new Scan_plan(merge_partial_groups(t, parts));
+  }
+  return group.release();
+}
+
+// The rows of a selection are ordered and limited before they are
+// projected, so that the key need not be in the projection list. The
+// limit is evaluated when the plan is made. A limit that does not fit
+// in a word does not limit the result.
+//
+// When a selection from a large table is run by workers, each worker
+// orders and limits the rows of its partition, and their results are
+// ordered and limited again. Because a sort keeps rows with equal keys
+// in the order of its input, the result is the same.
+Plan*
+make_order_plan(Order_by* t) {
+  std::size_t n = 0;
+  bool limited = false;
+  if (t->limit()) {
+    const Integer& k = get_nat(eval(t->limit()));
+    limited = k.is_small() and k.word() >= 0;
+    n = limited ? k.word() : 0;
+  }
+
+  Select_from_where* s = as<Select_from_where>(t->query());
+  Scan_plan* part = nullptr;
+  Plan_ptr in;
+  if (s) {
+    part = make_partitioned_scan(t, s->table());
+    in.reset(part ? part : make_source(s->table()));
+    in.reset(new Filter_plan(in.release(), s->cond(), get_select_decl(s->table())));
+  } else {
+    in.reset(make_plan(t->query()));
+  }
+  auto order = [&]() {
+    if (t->key())
+      in.reset(new Sort_plan(in.release(), get_order_name(t), t->desc(), n, limited));
+    else if (limited)
+      in.reset(new Limit_plan(in.release(), n));
+  };
+  order();
+  if (part) {
+    std::vector<Table*> parts = run_partitioned(in.get(), part);
+    if (not parts.empty()) {
+      in.reset(new Gather_plan(in->type, std::move(parts)));
+      order();
+    }
+  }
+  if (s)
+    in.reset(new Project_plan(in.release(), s->projection_list()));
+  return in.release();
+}
+
+// A join whose left table is large is run by workers, each of which
+// joins its partition of the left table with the whole of the right.
+Plan*
+make_join_plan(Join* t) {
+  Scan_plan* part = make_partitioned_scan(t, t->t1);
+  Plan_ptr left(part ? part : make_source(t->t1));
+  Plan_ptr right(make_source(t->t2));
+  Plan_ptr join(new Join_plan(t, left.release(), right.release()));
+  return make_gather_plan(join.release(), part);
+}
+
+// Add the operators producing the operands of the union t to in. The
+// operands of a nested union of tables are added in its place.
+void
+add_union_inputs(Union* t, std::vector<Plan_ptr>& in) {
+  for (Term* ti : {t->t1, t->t2}) {
+    Union* u = as<Union>(ti);
+    if (u and is_plan_term(u))
+      add_union_inputs(u, in);
+    else
+      in.emplace_back(make_source(ti));
+  }
+}
+
+Plan*
+make_set_plan(Union* t) {
+  std::vector<Plan_ptr> in;
+  add_union_inputs(t, in);
+  return new Set_plan(t, in, nullptr);
+}
+
+template<typename T>
+  Plan*
+  make_set_plan(T* t) {
+    std::vector<Plan_ptr> in;
+    in.emplace_back(make_source(t->t1));
+    Plan_ptr right(make_source(t->t2));
+    return new Set_plan(t, in, right.release());
+  }
+
+// Returns the plan of the relational term t.
+Plan*
+make_plan(Term* t) {
+  switch (t->kind) {
+  case select_term: return make_select_plan(as<Select_from_where>(t));
+  case group_term: return make_group_plan(as<Group_by>(t));
+  case order_term: return make_order_plan(as<Order_by>(t));
+  case join_on_term: return make_join_plan(as<Join>(t));
+  case union_term: return make_set_plan(as<Union>(t));
+  case intersect_term: return make_set_plan(as<Intersect>(t));
+  case except_term: return make_set_plan(as<Except>(t));
+  default: break;
+  }
+  lang_unreachable(format("'{}' is not a query", pretty(t)));
+}
+
+} // namespace
+
+// Find the top-level selections of the program p that share a scan of
+// their table: those selecting from the same defined table whose
+// conditions are comparisons of its columns with literals and other
+// top-level definitions.
+void
+find_shared_scans(Prog* p) {
+  std::lock_guard<std::mutex> lock(shared_mutex);
+  shared_scans.clear();
+
+  std::unordered_set<Expr*> defs;
+  std::unordered_map<Expr*, Shared_scan_ptr> scans;
+  for (Term* s : *p->stmts()) {
+    Term* cond;
+    Term* table;
+    if (get_shared_select(s, cond, table) and is<Ref>(table)) {
+      Expr* decl = get_select_decl(table);
+      std::vector<Expr*> refs;
+      if (decl and is_shared_cond(cond, decl, defs, refs)) {
+        Shared_scan_ptr& scan = scans[decl];
+        if (not scan)
+          scan.reset(new Shared_scan());
+        scan->conds.push_back({cond, refs, false, {}});
+      }
+    }
+    if (Def* d = as<Def>(s))
+      defs.insert(d);
+  }
+
+  for (auto& x : scans) {
+    Shared_scan_ptr& scan = x.second;
+    if (scan->conds.size() < 2)
+      continue;
+    for (std::size_t i = 0; i < scan->conds.size(); ++i)
+      shared_scans.insert({scan->conds[i].cond, {scan, i}});
+  }
+}
+
+// Discard the shared scans of the program whose evaluation has ended.
+void
+clear_shared_scans() {
+  std::lock_guard<std::mutex> lock(shared_mutex);
+  shared_scans.clear();
+}
+
+// Returns true when t is a relational term over tables. The operands
+// of a select or join are always tables; those of a set operation may
+// also be lists. A select has no row type of its own (see elab_select),
+// so a set operation over selects is also a query.
+bool
+is_plan_term(Term* t) {
+  switch (t->kind) {
+  case select_term:
+  case group_term:
+  case order_term:
+  case join_on_term:
+    return true;
+  case union_term:
+  case intersect_term:
+  case except_term: {
+    Type* type = get_type(t);
+    return get_row_type(type) or is_kind(type);
+  }
+  default:
+    return false;
+  }
+}
+
+// Evaluate the relational term t by running its plan, returning the
+// resulting table.
+Table*
+eval_plan(Term* t) {
+  Plan_ptr plan(make_plan(t));
+  return plan->drain();
+}
+
+// Returns the rows of the selection t (not grouped) from the rows of
+// its table in the table r.
+Table*
+eval_select_rows(Select_from_where* t, Table* r) {
+  Plan_ptr in(new Scan_plan(r));
+  in.reset(new Filter_plan(in.release(), t->cond(), get_select_decl(t->table())));
+  in.reset(new Project_plan(in.release(), t->projection_list()));
+  return in->drain();
+}
+
+// Returns the rows added to the result of the join t when rows are
+// appended to its tables, whose values are now t1 and t2, and which
+// had n1 and n2 rows. The new rows of t1 are matched with every row of
+// t2 by probing the hash index of the right key column, and then the
+// other rows of t1 with the new rows of t2 by probing the hash index of
+// the left key column, so the work is proportional to the new rows and
+// their matches. Returns nullptr if the condition of t does not have
+// the form 'x.a eq y.b'.
+Table*
+eval_join_rows(Join* t, Table* t1, std::size_t n1, Table* t2, std::size_t n2) {
+  Expr* d1 = get_table_decl(t->t1);
+  Expr* d2 = get_table_decl(t->t2);
+  Join_key key = get_join_key(t->join_cond(), d1, d2);
+  if (not key.left or key.op != join_eq)
+    return nullptr;
+  std::size_t c1 = find_column_index(t1, key.left->name());
+  std::size_t c2 = find_column_index(t2, key.right->name());
+  Term_seq* col1 = (*t1->columns())[c1];
+  Term_seq* col2 = (*t2->columns())[c2];
+
+  Match_seq matches;
+  if (n1 < t1->rows()) {
+    Hash_index* index = make_hash_index(t2, c2);
+    for (std::size_t i = n1; i < t1->rows(); ++i) {
+      auto iter = index->find((*col1)[i]);
+      if (iter == index->end())
+        continue;
+      for (std::size_t j : iter->second)
+        matches.emplace_back(i, j);
+    }
+  }
+  if (n2 < t2->rows()) {
+    Hash_index* index = make_hash_index(t1, c1);
+    for (std::size_t j = n2; j < t2->rows(); ++j) {
+      auto iter = index->find((*col2)[j]);
+      if (iter == index->end())
+        continue;
+      for (std::size_t i : iter->second) {
+        if (i >= n1)
+          break;
+        matches.emplace_back(i, j);
+      }
+    }
+  }
+  return join_tables(t1, t2, matches, get_type(t));
+}
@@ -0,0 +1,58 @@
+#ifndef PLAN_HPP
+#define PLAN_HPP
+
+#include "table.hpp"
+
+// -------------------------------------------------------------------------- //
+// Query plans
+//
+// A query plan is a relational term (select, join, union, intersect,
+// or except over tables) compiled into a tree of operators: scans,
+// filters, projections, joins, and set operations. Each operator
+// produces the rows of its result in batches, on demand, by pulling
+// batches from the operators below it. A batch is a table of its own.
+// The result of a query is materialized only at the root of its plan,
+// so a query like '(x join y on c) union z' never holds the result of
+// the join as a whole.
+//
+// A batch is allocated in the arena that is current when it is pulled,
+// and is valid until the next batch is pulled from the same operator.
+// Each consumer pulls batches into an arena of its own, and releases
+// that arena once a batch has been consumed. Rows that are kept across
+// batches (the right side of a join, and the rows seen by a set
+// operation) are collected in the arena that was current when the plan
+// was made. Under a memory budget, the rows kept by sorts, groupings,
+// and joins may instead be spilled to disk (see spill.hpp).
+//
+// The leaves of a plan are scans. A table that is already in memory is
+// scanned as a single batch, so that operators over that table use (and
+// keep) the indexes cached with it (see table.hpp). A CSV source is
+// scanned a chunk at a time (see csv.hpp), and only the rows that reach
+// the root of the plan are kept.
+//
+// The top-level selections of a program that select from the same
+// defined table share a scan: their conditions are tested in a single
+// pass over the rows of the table, when the first of them is evaluated
+// (see find_shared_scans). Each selection still produces its result
+// when its own statement is evaluated.
+//
+// With worker processes (see worker.hpp), a selection, grouping, or
+// ordering of a large defined table, or a join whose left table is one,
+// is run by each worker over its own range of the rows of that table,
+// and the results of the workers are combined in the order of their
+// ranges, so the result is the same as that of a single plan.
+
+// The number of rows of the left table matched by a join in each
+// batch of its result.
+constexpr std::size_t plan_batch_rows = 64 * 1024;
+
+bool is_plan_term(Term*);
+Table* eval_plan(Term*);
+
+Table* eval_select_rows(Select_from_where*, Table*);
+Table* eval_join_rows(Join*, Table*, std::size_t, Table*, std::size_t);
+
+void find_shared_scans(Prog*);
+void clear_shared_scans();
+
+#endif
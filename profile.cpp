@@ -0,0 +1,221 @@
+#include "profile.hpp"
+
+#include "lang/debug.hpp"
+
+#include <signal.h>
+#include <sys/time.h>
+
+#include <algorithm>
+#include <fstream>
+#include <map>
+#include <sstream>
+
+bool profiling = false;
+
+namespace {
+
+// A frame is the location and kind of a term, packed into a word so
+// that it can be read atomically: the location is in the high 32 bits,
+// and the class and id of the kind in the low 16. Locations are mapped
+// to lines and columns when the profile is written.
+using Frame = std::uint64_t;
+
+inline Frame
+make_frame(Term* t) {
+  Node_kind k = t->kind;
+  std::uint64_t kind = (get_node_class(k) << 10) | (k & (max_node_id - 1));
+  return (std::uint64_t(t->loc.offset) << 32) | kind;
+}
+
+inline Location
+get_location(Frame f) { return Location(std::uint32_t(f >> 32)); }
+
+inline Node_kind
+get_kind(Frame f) {
+  return make_node_class((f >> 10) & (max_node_class - 1)) | (f & (max_node_id - 1));
+}
+
+// The frames of the evaluations in progress on a thread. Frames beyond
+// the capacity of the stack are counted but not recorded. The stack is
+// read by the signal handler of its thread, and by those of the threads
+// of a pool working for it.
+struct Shadow_stack {
+  std::atomic<int> depth;
+  std::atomic<Frame> frames[max_profile_depth];
+};
+
+thread_local Shadow_stack stack_;
+
+// The stack of the thread that last started a query.
+std::atomic<Shadow_stack*> query_stack_;
+
+// Samples are appended to a buffer that is allocated when profiling
+// starts. Each sample is a count n followed by n frames, from the root.
+// A sample that does not fit is dropped. When the stack of a sample has
+// more than max_sample_depth frames, the count has truncated_flag set.
+constexpr std::size_t sample_capacity = std::size_t(1) << 22;
+constexpr Frame truncated_flag = Frame(1) << 63;
+
+Frame* samples_ = nullptr;
+std::atomic<std::size_t> used_;
+std::atomic<std::size_t> dropped_;
+
+std::string source_;
+
+inline bool
+is_query(Term* t) {
+  return t->kind == select_term or t->kind == group_term
+      or t->kind == order_term or t->kind == join_on_term;
+}
+
+// Record a sample of the shadow stack of the interrupted thread. This
+// runs in a signal handler, and so only touches atomics and the buffer.
+void
+sample(int) {
+  Shadow_stack* s = &stack_;
+  int depth = s->depth.load(std::memory_order_acquire);
+  if (depth == 0) {
+    if (Shadow_stack* q = query_stack_.load(std::memory_order_acquire)) {
+      s = q;
+      depth = s->depth.load(std::memory_order_acquire);
+    }
+  }
+  depth = std::min(depth, max_profile_depth);
+  int n = std::min(depth, max_sample_depth);
+  std::size_t first = used_.fetch_add(n + 1, std::memory_order_relaxed);
+  if (first + n + 1 > sample_capacity) {
+    dropped_.fetch_add(1, std::memory_order_relaxed);
+    return;
+  }
+  samples_[first] = Frame(n) | (depth > n ? truncated_flag : 0);
+  for (int i = 0; i < n; ++i)
+    samples_[first + 1 + i] = s->frames[depth - n + i].load(std::memory_order_relaxed);
+}
+
+// Set the profiling timer to the given interval, in microseconds. An
+// interval of 0 stops the timer.
+void
+set_timer(long us) {
+  itimerval t;
+  t.it_interval.tv_sec = us / 1000000;
+  t.it_interval.tv_usec = us % 1000000;
+  t.it_value = t.it_interval;
+  setitimer(ITIMER_PROF, &t, nullptr);
+}
+
+// Returns the name of the frame f, which is its file, line, and column,
+// and the kind of its term. Terms with no location are at line 0.
+std::string
+get_frame_name(Frame f) {
+  std::ostringstream ss;
+  Location loc = get_location(f);
+  if (loc.is_internal() or loc.is_eof()) {
+    ss << source_ << ":0:0";
+  } else {
+    Position pos = get_position(loc);
+    ss << (pos.file->empty() ? source_ : *pos.file) << ':'
+       << pos.line << ':' << pos.col;
+  }
+  ss << ' ' << node_name(get_kind(f)).str();
+  return ss.str();
+}
+
+} // namespace
+
+// Start profiling the evaluation of the program read from source,
+// which names the root of each sampled stack.
+void
+start_profile(const std::string& source) {
+  source_ = source;
+  if (not samples_)
+    samples_ = new Frame[sample_capacity];
+  profiling = true;
+
+  struct sigaction sa;
+  sa.sa_handler = sample;
+  sigemptyset(&sa.sa_mask);
+  sa.sa_flags = SA_RESTART;
+  sigaction(SIGPROF, &sa, nullptr);
+  set_timer(profile_interval);
+}
+
+// Stop the timer. Frames pushed before are still popped.
+void
+stop_profile() {
+  if (not profiling)
+    return;
+  set_timer(0);
+  profiling = false;
+}
+
+// Write the samples to the file at path in the collapsed stack format.
+// Returns false if the file cannot be written.
+bool
+write_profile(const std::string& path) {
+  std::map<std::string, std::size_t> stacks;
+  std::size_t used = std::min(used_.load(), sample_capacity);
+  std::size_t i = 0;
+  while (i < used) {
+    Frame h = samples_[i];
+    std::size_t n = h & ~truncated_flag;
+    if (i + 1 + n > used)
+      break;
+    std::string s = source_;
+    if (h & truncated_flag)
+      s += ";...";
+    for (std::size_t j = 0; j < n; ++j)
+      s += ';' + get_frame_name(samples_[i + 1 + j]);
+    ++stacks[s];
+    i += n + 1;
+  }
+
+  std::ofstream os(path);
+  if (not os)
+    return false;
+  for (const auto& s : stacks)
+    os << s.first << ' ' << s.second << '\n';
+  if (std::size_t n = dropped_.load())
+    os << source_ << ";[dropped] " << n << '\n';
+  return bool(os);
+}
+
+// Push the frame of the term t onto the shadow stack of this thread.
+void
+push_frame(Term* t) {
+  Shadow_stack& s = stack_;
+  int d = s.depth.load(std::memory_order_relaxed);
+  if (d < max_profile_depth)
+    s.frames[d].store(make_frame(t), std::memory_order_relaxed);
+  s.depth.store(d + 1, std::memory_order_release);
+  if (is_query(t))
+    query_stack_.store(&s, std::memory_order_release);
+}
+
+// Replace the innermost frame with that of the term t.
+void
+replace_frame(Term* t) {
+  Shadow_stack& s = stack_;
+  int d = s.depth.load(std::memory_order_relaxed);
+  lang_assert(d > 0, "empty shadow stack");
+  if (d <= max_profile_depth)
+    s.frames[d - 1].store(make_frame(t), std::memory_order_release);
+  if (is_query(t))
+    query_stack_.store(&s, std::memory_order_release);
+}
+
+// Pop the innermost frame.
+void
+pop_frame() {
+  Shadow_stack& s = stack_;
+  s.depth.store(s.depth.load(std::memory_order_relaxed) - 1,
+                std::memory_order_release);
+}
+
+// Returns the depth of the shadow stack of this thread.
+int
+get_frame_depth() { return stack_.depth.load(std::memory_order_relaxed); }
+
+// Restore the depth of the shadow stack of this thread, discarding the
+// frames of evaluations that failed.
+void
+set_frame_depth(int d) { stack_.depth.store(d, std::memory_order_release); }
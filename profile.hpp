@@ -0,0 +1,78 @@
+#ifndef PROFILE_HPP
+#define PROFILE_HPP
+
+#include "ast.hpp"
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+// -------------------------------------------------------------------------- //
+// Profiling
+//
+// The profiler attributes the time spent evaluating a program to the
+// lines of its source. Each thread keeps a shadow stack of the terms
+// whose evaluation is in progress: applications, calls, selections,
+// and joins. A timer interrupts the running thread at regular intervals
+// of CPU time, and the shadow stack of that thread is recorded as a
+// sample. The threads of a pool that are working for a query have no
+// terms of their own, and their samples are attributed to the stack of
+// the thread that last started a query.
+//
+// A tail call replaces the frame of its caller, just as it does in the
+// evaluators, so that the depth of the shadow stack does not grow with
+// iteration. The shadow stack holds at most max_profile_depth frames;
+// only the innermost max_sample_depth frames are kept in a sample.
+//
+// Samples are written in the collapsed stack format read by flame
+// graph tools: each line gives the frames of a stack, from the root,
+// separated by semicolons, followed by the number of samples of that
+// stack. Frames are named by the location of their term and its kind.
+
+constexpr int max_profile_depth = 1024;
+constexpr int max_sample_depth = 64;
+
+// The interval between samples, in microseconds of CPU time.
+constexpr long profile_interval = 1000;
+
+extern bool profiling;
+
+void start_profile(const std::string&);
+void stop_profile();
+bool write_profile(const std::string&);
+
+void push_frame(Term*);
+void replace_frame(Term*);
+void pop_frame();
+
+int get_frame_depth();
+void set_frame_depth(int);
+
+// A profile frame is the frame pushed by an evaluation, which is popped
+// when the evaluation ends (even if it fails). Entering the frame again
+// replaces it, as for a tail call.
+struct Profile_frame {
+  Profile_frame() : pushed(false) { }
+  ~Profile_frame() {
+    if (pushed)
+      pop_frame();
+  }
+
+  Profile_frame(const Profile_frame&) = delete;
+  Profile_frame& operator=(const Profile_frame&) = delete;
+
+  void enter(Term* t) {
+    if (not profiling)
+      return;
+    if (pushed) {
+      replace_frame(t);
+    } else {
+      push_frame(t);
+      pushed = true;
+    }
+  }
+
+  bool pushed;
+};
+
+#endif
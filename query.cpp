@@ -0,0 +1,450 @@
+
+#include "query.hpp"
+#include "eval.hpp"
+#include "subst.hpp"
+#include "type.hpp"
+#include "value.hpp"
+
+#include "lang/debug.hpp"
+#include "lang/thread_pool.hpp"
+
+#include <algorithm>
+#include <functional>
+#include <utility>
+
+// -------------------------------------------------------------------------- //
+// Compilation
+
+// Compile the condition t, where decl is the declaration of the table
+// referred to in t (this may be null).
+Row_pred::Row_pred(Term* t, Expr* decl, Table* table)
+  : decl_(decl), table_(table), root_(nullptr), pure_(true)
+{ 
+  root_ = compile(t);
+}
+
+Row_expr*
+Row_pred::make(Row_op op, Term* t, std::size_t c, Row_expr* e1, Row_expr* e2) {
+  exprs_.push_back({op, t, c, e1, e2});
+  return &exprs_.back();
+}
+
+// Compile the term t into a row expression.
+Row_expr*
+Row_pred::compile(Term* t) {
+  switch (t->kind) {
+  case unit_term: 
+  case true_term:
+  case false_term:
+  case int_term:
+  case str_term:
+    return make(row_value, t);
+
+  case mem_term: {
+    // A reference to a column of the table.
+    Mem* m = as<Mem>(t);
+    if (Ref* x = as<Ref>(m->record()))
+      if (decl_ and x->decl() == decl_)
+        if (Ref* a = as<Ref>(m->member())) {
+          std::size_t c = find_column_index(table_, as<Var>(a->decl())->name());
+          if (c != no_column)
+            return make(row_column, nullptr, c);
+        }
+
+    // A member of a record value (e.g., a row substituted for the other
+    // table of a join) is a constant.
+    if (is<Record>(m->record()))
+      return make(row_value, ::eval(t));
+    break;
+  }
+
+  case ref_term:
+    // A reference to a declaration other than the table is a constant.
+    if (as<Ref>(t)->decl() != decl_)
+      return make(row_value, ::eval(t));
+    break;
+
+  case equals_term: {
+    Equals* e = as<Equals>(t);
+    return make(row_eq, t, no_column, compile(e->t1), compile(e->t2));
+  }
+  case less_term: {
+    Less* e = as<Less>(t);
+    return make(row_less, t, no_column, compile(e->t1), compile(e->t2));
+  }
+  case and_term: {
+    And* e = as<And>(t);
+    return make(row_and, t, no_column, compile(e->t1), compile(e->t2));
+  }
+  case or_term: {
+    Or* e = as<Or>(t);
+    return make(row_or, t, no_column, compile(e->t1), compile(e->t2));
+  }
+  case not_term:
+    return make(row_not, t, no_column, compile(as<Not>(t)->t1));
+
+  default: 
+    break;
+  }
+  pure_ = false;
+  return make(row_term, t);
+}
+
+
+// -------------------------------------------------------------------------- //
+// Evaluation
+
+// Evaluate the row expression e for the ith row of the table.
+Term*
+Row_pred::eval(Row_expr* e, std::size_t i) const {
+  switch (e->op) {
+  case row_value: 
+    return e->term;
+  case row_column: 
+    return (*(*table_->columns())[e->col])[i];
+  case row_term: {
+    if (not decl_)
+      return ::eval(e->term);
+    Subst sub {decl_, get_row(table_, i)};
+    return ::eval(subst_term(e->term, sub));
+  }
+  default:
+    return test(e, i) ? get_true() : get_false();
+  }
+}
+
+// Returns true when the row expression e is true for the ith row of 
+// the table. The operands of 'and' and 'or' are evaluated only as 
+// needed.
+bool
+Row_pred::test(Row_expr* e, std::size_t i) const {
+  switch (e->op) {
+  case row_eq: 
+    return is_same(eval(e->e1, i), eval(e->e2, i));
+  case row_less: 
+    return is_less(eval(e->e1, i), eval(e->e2, i));
+  case row_and: 
+    return test(e->e1, i) and test(e->e2, i);
+  case row_or: 
+    return test(e->e1, i) or test(e->e2, i);
+  case row_not: {
+    Term* t = eval(e->e1, i);
+    if (is_true(t))
+      return false;
+    if (is_false(t))
+      return true;
+    lang_unreachable(format("'{}' is not a boolean value", pretty(t)));
+  }
+  default:
+    return is_true(eval(e, i));
+  }
+}
+
+// Returns true when the condition is true for the ith row.
+bool
+Row_pred::operator()(std::size_t i) const { return test(root_, i); }
+
+// Determine if the rows satisfying e can be found using an index.
+// That is the case when e has one of the forms 'x.a eq v', 'x.a lt v'
+// or 'v lt x.a' (or their commuted forms), or when e is a conjunction
+// and either operand can be found using an index. If so, rows is set
+// to the candidate rows, in ascending order.
+//
+// The index on 'a' is built if it does not already exist. 
+bool
+Row_pred::lookup(Row_expr* e, Row_seq& rows) const {
+  if (e->op == row_and)
+    return lookup(e->e1, rows) or lookup(e->e2, rows);
+  if (e->op != row_eq and e->op != row_less)
+    return false;
+
+  Row_expr* c = e->e1;
+  Row_expr* v = e->e2;
+  bool flip = c->op != row_column;
+  if (flip)
+    std::swap(c, v);
+  if (c->op != row_column or v->op != row_value)
+    return false;
+
+  if (e->op == row_eq) {
+    Hash_index* index = make_hash_index(table_, c->col);
+    auto iter = index->find(v->term);
+    if (iter != index->end())
+      rows = iter->second;
+    return true;
+  }
+  if (flip)
+    rows = find_rows_greater(table_, c->col, v->term);
+  else
+    rows = find_rows_less(table_, c->col, v->term);
+  return true;
+}
+
+// Returns the rows satisfying the condition among the first n candidate
+// rows, or among the first n rows of the table when rows is null. When
+// the condition is pure, the candidates are tested in parallel, and
+// the results for each chunk are concatenated in order.
+Row_seq
+Row_pred::filter(const Row_seq* rows, std::size_t n) const {
+  std::vector<Row_seq> parts(pure_ ? Thread_pool::chunk_count(n) : 1);
+  auto test_rows = [&](std::size_t c, std::size_t first, std::size_t last) {
+    Row_seq& part = parts[c];
+    for (std::size_t k = first; k < last; ++k) {
+      std::size_t i = rows ? (*rows)[k] : k;
+      if (test(root_, i))
+        part.push_back(i);
+    }
+  };
+  if (pure_)
+    get_thread_pool().run(n, test_rows);
+  else
+    test_rows(0, 0, n);
+  return concat_chunks(parts);
+}
+
+
+
+// -------------------------------------------------------------------------- //
+// Vectorization
+
+// Returns the kind of the packed values of the row expression e, or
+// pack_none if e cannot be vectorized. Conditions have the kind
+// pack_bool. The operands of 'eq' and 'lt' must be columns or values
+// of the same kind, and only natural numbers are ordered.
+Pack_kind
+Row_pred::get_pack_kind(Row_expr* e) const {
+  switch (e->op) {
+  case row_value:
+    if (Int* n = as<Int>(e->term))
+      return n->value().is_small() ? pack_nat : pack_none;
+    if (is_true(e->term) or is_false(e->term))
+      return pack_bool;
+    return pack_none;
+
+  case row_column: {
+    Term_seq* vars = get_row_type(table_)->members();
+    Type* t = as<Var>((*vars)[e->col])->type();
+    if (is_nat_type(t))
+      return pack_nat;
+    if (is_bool_type(t))
+      return pack_bool;
+    return pack_none;
+  }
+
+  case row_eq:
+  case row_less: {
+    Row_expr* a = e->e1;
+    Row_expr* b = e->e2;
+    if (a->op != row_column and a->op != row_value)
+      return pack_none;
+    if (b->op != row_column and b->op != row_value)
+      return pack_none;
+    Pack_kind k = get_pack_kind(a);
+    if (k == pack_none or k != get_pack_kind(b))
+      return pack_none;
+    if (e->op == row_less and k != pack_nat)
+      return pack_none;
+    return pack_bool;
+  }
+
+  case row_and:
+  case row_or:
+    if (get_pack_kind(e->e1) != pack_bool)
+      return pack_none;
+    return get_pack_kind(e->e2);
+
+  case row_not:
+    return get_pack_kind(e->e1) == pack_bool ? pack_bool : pack_none;
+
+  default:
+    return pack_none;
+  }
+}
+
+// Pack the columns and values of the row expression e, whose kind is
+// not pack_none. Returns false if some column cannot be packed (i.e.,
+// it holds numbers that do not fit in a word).
+bool
+Row_pred::pack(Row_expr* e) const {
+  switch (e->op) {
+  case row_value:
+    if (Int* n = as<Int>(e->term))
+      e->word = n->value().word();
+    else
+      e->word = is_true(e->term);
+    return true;
+  case row_column:
+    e->packed = make_packed_column(table_, e->col);
+    return e->packed->kind != pack_none;
+  case row_not:
+    return pack(e->e1);
+  default:
+    return pack(e->e1) and pack(e->e2);
+  }
+}
+
+namespace {
+
+// Set m[k] to cmp(a, b) for the operands a and b of a comparison, for
+// the rows [first, first + n). Each operand is a packed column or a
+// packed value.
+template<typename Cmp>
+  void
+  compare_block(Row_expr* a, Row_expr* b, std::size_t first, std::size_t n,
+                unsigned char* m, Cmp cmp) {
+    if (a->op == row_column and b->op == row_column) {
+      const long* x = a->packed->words.data() + first;
+      const long* y = b->packed->words.data() + first;
+      for (std::size_t k = 0; k < n; ++k)
+        m[k] = cmp(x[k], y[k]);
+    } else if (a->op == row_column) {
+      const long* x = a->packed->words.data() + first;
+      long y = b->word;
+      for (std::size_t k = 0; k < n; ++k)
+        m[k] = cmp(x[k], y);
+    } else if (b->op == row_column) {
+      long x = a->word;
+      const long* y = b->packed->words.data() + first;
+      for (std::size_t k = 0; k < n; ++k)
+        m[k] = cmp(x, y[k]);
+    } else {
+      std::fill(m, m + n, cmp(a->word, b->word));
+    }
+  }
+
+} // namespace
+
+// Set m[k] to 1 if the vectorized condition e is true for the row
+// first + k, and to 0 otherwise, for each k < n. At most row_block_size
+// rows are tested. Both operands of 'and' and 'or' are tested, which
+// is not observable since neither can fail.
+void
+Row_pred::test_block(Row_expr* e, std::size_t first, std::size_t n, 
+                     unsigned char* m) const {
+  switch (e->op) {
+  case row_value:
+    std::fill(m, m + n, e->word);
+    return;
+  case row_column: {
+    const long* x = e->packed->words.data() + first;
+    for (std::size_t k = 0; k < n; ++k)
+      m[k] = x[k] != 0;
+    return;
+  }
+  case row_eq:
+    return compare_block(e->e1, e->e2, first, n, m, std::equal_to<long>());
+  case row_less:
+    return compare_block(e->e1, e->e2, first, n, m, std::less<long>());
+  case row_and: {
+    unsigned char m2[row_block_size];
+    test_block(e->e1, first, n, m);
+    test_block(e->e2, first, n, m2);
+    for (std::size_t k = 0; k < n; ++k)
+      m[k] &= m2[k];
+    return;
+  }
+  case row_or: {
+    unsigned char m2[row_block_size];
+    test_block(e->e1, first, n, m);
+    test_block(e->e2, first, n, m2);
+    for (std::size_t k = 0; k < n; ++k)
+      m[k] |= m2[k];
+    return;
+  }
+  case row_not:
+    test_block(e->e1, first, n, m);
+    for (std::size_t k = 0; k < n; ++k)
+      m[k] ^= 1;
+    return;
+  default:
+    lang_unreachable("ill-formed vectorized condition");
+  }
+}
+
+// Returns the rows satisfying the vectorized condition among the first
+// n rows of the table. Blocks of rows are tested in parallel.
+Row_seq
+Row_pred::filter_blocks(std::size_t n) const {
+  std::vector<Row_seq> parts(Thread_pool::chunk_count(n, row_block_size));
+  auto test_rows = [&](std::size_t c, std::size_t first, std::size_t last) {
+    unsigned char m[row_block_size];
+    test_block(root_, first, last - first, m);
+    Row_seq& part = parts[c];
+    for (std::size_t k = 0; k < last - first; ++k) {
+      if (m[k])
+        part.push_back(first + k);
+    }
+  };
+  get_thread_pool().run(n, test_rows, row_block_size);
+  return concat_chunks(parts);
+}
+
+// Returns the rows of the table satisfying the condition, in
+// ascending order. Rows found using an index are tested one at a time.
+// Otherwise, the condition is vectorized if possible.
+Row_seq
+Row_pred::select() const {
+  Row_seq rows;
+  if (lookup(root_, rows))
+    return filter(&rows, rows.size());
+  if (get_pack_kind(root_) == pack_bool and pack(root_))
+    return filter_blocks(table_->rows());
+  return filter(nullptr, table_->rows());
+}
+
+// Returns the rows satisfying each of the pure predicates ps, which
+// test the same table, in ascending order. The rows are tested in one
+// pass: each block of rows is tested by every predicate before the next
+// block is read, so the columns of the table are read from memory once
+// rather than once for each predicate. Blocks are tested in parallel,
+// and each predicate is vectorized if possible. A predicate whose rows
+// can be found using an index is not tested by the pass.
+std::vector<Row_seq>
+select_shared(const std::vector<const Row_pred*>& ps) {
+  std::vector<Row_seq> result(ps.size());
+  std::vector<std::size_t> scan;  // The predicates tested by the pass
+  std::vector<char> packed;       // True for each vectorized predicate
+  for (std::size_t i = 0; i < ps.size(); ++i) {
+    const Row_pred* p = ps[i];
+    lang_assert(p->pure_ and p->table_ == ps[0]->table_, "ill-formed shared scan");
+    Row_seq rows;
+    if (p->lookup(p->root_, rows)) {
+      result[i] = p->filter(&rows, rows.size());
+      continue;
+    }
+    scan.push_back(i);
+    packed.push_back(p->get_pack_kind(p->root_) == pack_bool and p->pack(p->root_));
+  }
+  if (scan.empty())
+    return result;
+
+  std::size_t n = ps[0]->table_->rows();
+  std::size_t chunks = Thread_pool::chunk_count(n, row_block_size);
+  std::vector<std::vector<Row_seq>> parts(scan.size(), std::vector<Row_seq>(chunks));
+  auto test_rows = [&](std::size_t c, std::size_t first, std::size_t last) {
+    unsigned char m[row_block_size];
+    for (std::size_t b = first; b < last; b += row_block_size) {
+      std::size_t e = std::min(b + row_block_size, last);
+      for (std::size_t k = 0; k < scan.size(); ++k) {
+        const Row_pred* p = ps[scan[k]];
+        Row_seq& part = parts[k][c];
+        if (packed[k]) {
+          p->test_block(p->root_, b, e - b, m);
+          for (std::size_t j = 0; j < e - b; ++j) {
+            if (m[j])
+              part.push_back(b + j);
+          }
+        } else {
+          for (std::size_t i = b; i < e; ++i) {
+            if (p->test(p->root_, i))
+              part.push_back(i);
+          }
+        }
+      }
+    }
+  };
+  get_thread_pool().run(n, test_rows, row_block_size);
+  for (std::size_t k = 0; k < scan.size(); ++k)
+    result[scan[k]] = concat_chunks(parts[k]);
+  return result;
+}
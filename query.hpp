@@ -0,0 +1,100 @@
+
+#ifndef QUERY_HPP
+#define QUERY_HPP
+
+#include "table.hpp"
+
+#include <deque>
+
+// -------------------------------------------------------------------------- //
+// Row predicates
+//
+// A row predicate is the condition of a 'select ... from x where t'
+// compiled against the rows of the table x. Compilation resolves each
+// column reference 'x.a' in t to a column of the table once, so that
+// testing a row does not require substituting that row into a copy of
+// the condition. Subterms that do not refer to the table are evaluated
+// once, when the predicate is compiled. Other subterms are evaluated
+// by substitution, as in eval.cpp.
+//
+// When the condition is of the form 'x.a eq v' or 'x.a lt v' (possibly
+// as one of a conjunction of conditions), only the rows found in an
+// index on 'a' are tested. Indexes are built on demand, and cached
+// with the table (see table.hpp).
+//
+// When every subterm of the condition is compiled to an operation on
+// columns and values, testing a row does not allocate, and the rows
+// of large tables are tested in parallel (see lang/thread_pool.hpp).
+//
+// When, in addition, the condition compares columns of natural numbers
+// or booleans with each other or with values, it is vectorized: the
+// columns are packed into machine words (see table.hpp), and the
+// condition is tested for a block of rows at a time, computing a mask
+// of the selected rows with a loop over the words for each operation.
+// Those loops are simple enough to be compiled to SIMD instructions.
+//
+// The conditions of several selections over the same table can be
+// tested together, in one pass over its rows (see select_shared).
+
+// The operations of compiled row expressions.
+enum Row_op {
+  row_value,  // A value computed during compilation
+  row_column, // The value of a column of the current row
+  row_term,   // A term evaluated by substitution
+  row_eq,     // e1 eq e2
+  row_less,   // e1 lt e2
+  row_and,    // e1 and e2
+  row_or,     // e1 or e2
+  row_not,    // not e1
+};
+
+// A compiled row expression.
+struct Row_expr {
+  Row_op op;
+  Term* term;      // The value or substituted term
+  std::size_t col; // The column index
+  Row_expr* e1;
+  Row_expr* e2;
+  Packed_column* packed; // The packed column, when vectorized
+  long word;             // The packed value, when vectorized
+};
+
+// The number of rows tested at once by a vectorized condition.
+constexpr std::size_t row_block_size = 1024;
+
+struct Row_pred;
+
+std::vector<Row_seq> select_shared(const std::vector<const Row_pred*>&);
+
+struct Row_pred {
+  Row_pred(Term*, Expr*, Table*);
+
+  bool operator()(std::size_t) const;
+  Row_seq select() const;
+
+  bool is_pure() const { return pure_; }
+
+  friend std::vector<Row_seq> select_shared(const std::vector<const Row_pred*>&);
+
+private:
+  Row_expr* compile(Term*);
+  Row_expr* make(Row_op, Term* = nullptr, std::size_t = no_column, 
+                 Row_expr* = nullptr, Row_expr* = nullptr);
+  bool lookup(Row_expr*, Row_seq&) const;
+  Row_seq filter(const Row_seq*, std::size_t) const;
+  Term* eval(Row_expr*, std::size_t) const;
+  bool test(Row_expr*, std::size_t) const;
+
+  Pack_kind get_pack_kind(Row_expr*) const;
+  bool pack(Row_expr*) const;
+  Row_seq filter_blocks(std::size_t) const;
+  void test_block(Row_expr*, std::size_t, std::size_t, unsigned char*) const;
+
+  Expr* decl_;              // The table declaration
+  Table* table_;            // The table
+  Row_expr* root_;          // The compiled condition
+  bool pure_;               // True if no subterm is substituted
+  std::deque<Row_expr> exprs_; // Storage for compiled expressions
+};
+
+#endif
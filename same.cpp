@@ -30,25 +30,14 @@ template<typename T>
 template<typename T>
   inline bool
   same_binary(T* a, T* b) {
-    if(is_same(a->t1, b->t1))
-      return true;
-    if (is_same(b->t1, a->t1))
-      return false;
-    return is_same(a->t2, b->t2);
+    return is_same(a->t1, b->t1) and is_same(a->t2, b->t2);
   }
 
 template<typename T>
   inline bool
   same_ternary(T* a, T* b) {
-    if(is_same(a->t1, b->t1))
-      return true;
-    if (is_same(b->t1, a->t1))
-      return false;
-    if(is_same(a->t2, b->t2))
-      return true;
-    if (is_same(b->t2, a->t2))
-      return false;
-    return is_same(a->t3, b->t3);
+    return is_same(a->t1, b->t1) and is_same(a->t2, b->t2) and
+           is_same(a->t3, b->t3);
   }
 
 // Two refs are the same when they refer to the same declaration.
@@ -71,26 +60,6 @@ same_var(Var* a, Var* b) {
   return (is_same(a->name(), b->name()) and is_same(a->type(), b->type()));
 }
 
-// Two record types are the same if each respective label and type 
-inline bool
-same_record_type(Record_type* a, Record_type* b) {
-  if(a->members()->size() == b->members()->size()) {
-    Term_seq* type_a = a->members();
-    Term_seq* type_b = b->members();
-
-    auto it_a = type_a->begin();
-    auto it_b = type_b->begin();
-    for(it_a; it_a != type_a->end(); ++it_a) {
-      if (!is_same(*it_a, *it_b))
-        return false;
-      ++it_b;
-    }
-    return true;
-  }
-  else
-    return false;
-}
-
 // Two records are the same if every subterm of type Init is the same
 inline bool
 same_record(Record* a, Record* b) {
@@ -111,35 +80,139 @@ same_record(Record* a, Record* b) {
   return true;
 }
 
+// Two sequences are the same if they have the same length and each
+// respective element is the same.
+inline bool
+same_seq(Term_seq* a, Term_seq* b) {
+  if (a->size() != b->size())
+    return false;
+  for (std::size_t i = 0; i < a->size(); ++i)
+    if (not is_same((*a)[i], (*b)[i]))
+      return false;
+  return true;
+}
+
+// Two tables are the same if they have the same number of rows, and
+// each respective row is the same.
+inline bool
+same_table(Table* a, Table* b) {
+  if (a->rows() != b->rows())
+    return false;
+  for (std::size_t i = 0; i < a->rows(); ++i)
+    if (not is_same_row(a, i, b, i))
+      return false;
+  return true;
+}
+
+inline bool
+same_int(Int* a, Int* b) { return a->value() == b->value(); }
+
+inline bool
+same_str(Str* a, Str* b) { return a->value() == b->value(); }
+
+inline bool
+same_tuple(Tuple* a, Tuple* b) { return same_seq(a->elems(), b->elems()); }
+
+inline bool
+same_list(List* a, List* b) { return same_seq(a->elems(), b->elems()); }
+
+// Nodes without operands are the same when they have the same kind.
+bool
+same_kind(Expr* a, Expr* b) { return true; }
+
+// Composite types are interned (see type.cpp).
+bool
+same_interned(Expr* a, Expr* b) { return a == b; }
+
+bool
+same_unknown(Expr* a, Expr* b) {
+  lang_unreachable(format("comparison of unknown node '{}'", node_name(a)));
+}
+
+using Same_rule = bool (*)(Expr*, Expr*);
+
+Node_table<Same_rule> same_rules_(same_unknown);
+
+template<typename T, bool (*F)(T*, T*)>
+  bool
+  same_rule(Expr* a, Expr* b) {
+    return F(static_cast<T*>(a), static_cast<T*>(b));
+  }
+
+// Define the rule for nodes of type T.
+template<typename T, bool (*F)(T*, T*)>
+  inline void
+  define_same() { same_rules_.define(T::node_kind, same_rule<T, F>); }
+
+// Define the rule for each of the kinds ks.
+inline void
+define_same(std::initializer_list<Node_kind> ks, Same_rule f) {
+  for (Node_kind k : ks)
+    same_rules_.define(k, f);
+}
+
 } // namespace
 
 
+// Returns true when the ith row of table a is the same as the jth
+// row of table b. This is the same as comparing those rows as records
+// (i.e., each respective member has the same name and value).
+bool
+is_same_row(Table* a, std::size_t i, Table* b, std::size_t j) {
+  Term_seq* va = as<Record_type>(as<List_type>(a->tr)->type())->members();
+  Term_seq* vb = as<Record_type>(as<List_type>(b->tr)->type())->members();
+  if (va->size() != vb->size())
+    return false;
+  for (std::size_t k = 0; k < va->size(); ++k) {
+    if (not is_same(as<Var>((*va)[k])->name(), as<Var>((*vb)[k])->name()))
+      return false;
+    if (not is_same((*(*a->columns())[k])[i], (*(*b->columns())[k])[j]))
+      return false;
+  }
+  return true;
+}
+
+// Initialize the comparison rules. Every kind of name, type and term has
+// a rule. Terms that are not values cannot be compared.
+void
+init_same() {
+  define_same<Id, same_unary<Id>>();
+  define_same<Int, same_int>();
+  define_same<Str, same_str>();
+  define_same<If, same_ternary<If>>();
+  define_same<Succ, same_unary<Succ>>();
+  define_same<Pred, same_unary<Pred>>();
+  define_same<Iszero, same_unary<Iszero>>();
+  define_same<Var, same_var>();
+  define_same<Abs, same_binary<Abs>>();
+  define_same<App, same_binary<App>>();
+  define_same<Ref, same_ref>();
+  define_same<Init, same_init>();
+  define_same<Record, same_record>();
+  define_same<Tuple, same_tuple>();
+  define_same<List, same_list>();
+  define_same<Table, same_table>();
+  define_same({unit_term, true_term, false_term, kind_type, unit_type,
+               bool_type, nat_type, str_type},
+              same_kind);
+  define_same({arrow_type, fn_type, tuple_type, list_type, record_type,
+               wild_type},
+              same_interned);
+  define_same({and_term, or_term, not_term, equals_term, less_term, fn_term,
+               call_term, closure_term, variant_term, comma_term, proj_term,
+               mem_term, col_term, def_term, select_term, group_term,
+               agg_term, order_term, join_on_term, union_term,
+               intersect_term, except_term, load_term, save_term, csv_term,
+               print_term, prog_term, variant_type},
+              same_unknown);
+  same_rules_.check(name_class, "comparison");
+  same_rules_.check(type_class, "comparison");
+  same_rules_.check(term_class, "comparison");
+}
+
 bool
 is_same(Expr* a, Expr* b) {
   if (a->kind != b->kind)
     return false;
-  switch (a->kind) {
-  case id_expr: return same_unary(as<Id>(a), as<Id>(b));
-  case unit_term: return true;
-  case true_term: return true;
-  case false_term: return true;
-  case int_term: return as<Int>(a)->value() == as<Int>(b)->value();
-  case if_term: return same_ternary(as<If>(a), as<If>(b));
-  case succ_term: return same_unary(as<Succ>(a), as<Succ>(b));
-  case pred_term: return same_unary(as<Pred>(a), as<Pred>(b));
-  case iszero_term: return same_unary(as<Iszero>(a), as<Iszero>(b));
-  case var_term: return same_var(as<Var>(a), as<Var>(b));
-  case abs_term: return same_binary(as<Var>(a), as<Var>(b));
-  case app_term: return same_binary(as<Var>(a), as<Var>(b));
-  case ref_term: return same_ref(as<Ref>(a), as<Ref>(b));
-  case init_term: return same_init(as<Init>(a), as<Init>(b));
-  case record_term: return same_record(as<Record>(a), as<Record>(b));
-  case kind_type: return true;
-  case unit_type: return true;
-  case bool_type: return true;
-  case nat_type: return true;
-  case arrow_type: return same_binary(as<Arrow_type>(a), as<Arrow_type>(b));
-  case record_type: return same_record_type(as<Record_type>(a), as<Record_type>(b));
-  case list_type: return is_same(as<List_type>(a)->type(), as<List_type>(b)->type());
-  }
+  return same_rules_[a->kind](a, b);
 }
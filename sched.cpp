@@ -0,0 +1,234 @@
+
+#include "sched.hpp"
+
+#include "lang/arena.hpp"
+#include "lang/thread_pool.hpp"
+
+#include <algorithm>
+#include <exception>
+#include <unordered_map>
+
+// -------------------------------------------------------------------------- //
+// Dependencies
+
+namespace {
+
+// The dependency finder collects the statements referred to by a
+// term, and determines if that term is pure. When locals are needed,
+// the definitions of tables named by 'as' that the term refers to are
+// collected, and their values are searched as part of the term.
+struct Dep_finder {
+  Dep_finder(const Def_map& m, Stmt_seq& d, std::vector<Def*>* l)
+    : defs(m), deps(d), locals(l), pure(true) { }
+
+  void operator()(Expr*);
+
+  template<typename T>
+    void walk_binary(T* t) { (*this)(t->t1); (*this)(t->t2); }
+
+  template<typename T>
+    void walk_ternary(T* t) { walk_binary(t); (*this)(t->t3); }
+
+  template<typename T>
+    void walk_seq(T*);
+
+  const Def_map& defs;
+  Stmt_seq& deps;
+  std::vector<Def*>* locals;
+  bool pure;
+};
+
+template<typename T>
+  void
+  Dep_finder::walk_seq(T* seq) {
+    for (Expr* e : *seq)
+      (*this)(e);
+  }
+
+void
+Dep_finder::operator()(Expr* e) {
+  Term* t = as<Term>(e);
+  if (not t)
+    return;
+  switch (t->kind) {
+  case unit_term:
+  case true_term:
+  case false_term:
+  case int_term:
+  case str_term:
+  case var_term:
+  case table_term:
+    return;
+
+  case if_term: return walk_ternary(as<If>(t));
+  case select_term: return walk_ternary(as<Select_from_where>(t));
+  case join_on_term: return walk_ternary(as<Join>(t));
+  case group_term:
+    walk_ternary(as<Group_by>(t));
+    return (*this)(as<Group_by>(t)->t4);
+  case agg_term: return (*this)(as<Agg>(t)->column());
+  case order_term: return walk_ternary(as<Order_by>(t));
+
+  case and_term: return walk_binary(as<And>(t));
+  case or_term: return walk_binary(as<Or>(t));
+  case equals_term: return walk_binary(as<Equals>(t));
+  case less_term: return walk_binary(as<Less>(t));
+  case app_term: return walk_binary(as<App>(t));
+  case proj_term: return walk_binary(as<Proj>(t));
+  case mem_term: return walk_binary(as<Mem>(t));
+  case col_term: return walk_binary(as<Col>(t));
+  case union_term: return walk_binary(as<Union>(t));
+  case intersect_term: return walk_binary(as<Intersect>(t));
+  case except_term: return walk_binary(as<Except>(t));
+
+  case not_term: return (*this)(as<Not>(t)->t1);
+  case succ_term: return (*this)(as<Succ>(t)->t1);
+  case pred_term: return (*this)(as<Pred>(t)->t1);
+  case iszero_term: return (*this)(as<Iszero>(t)->t1);
+  case abs_term: return (*this)(as<Abs>(t)->term());
+  case fn_term: return (*this)(as<Fn>(t)->term());
+  case closure_term: return (*this)(as<Closure>(t)->fn());
+  case def_term: return (*this)(as<Def>(t)->value());
+  case init_term: return (*this)(as<Init>(t)->value());
+
+  case call_term:
+    (*this)(as<Call>(t)->fn());
+    return walk_seq(as<Call>(t)->args());
+  case tuple_term: return walk_seq(as<Tuple>(t)->t1);
+  case list_term: return walk_seq(as<List>(t)->t1);
+  case record_term: return walk_seq(as<Record>(t)->t1);
+  case comma_term: return walk_seq(as<Comma>(t)->elems());
+
+  case ref_term: {
+    Expr* decl = as<Ref>(t)->decl();
+    auto iter = defs.find(decl);
+    if (iter != defs.end()) {
+      deps.push_back(iter->second);
+      return;
+    }
+    Def* def = as<Def>(decl);
+    if (locals and def and
+        std::find(locals->begin(), locals->end(), def) == locals->end()) {
+      locals->push_back(def);
+      (*this)(def->value());
+    }
+    return;
+  }
+
+  case print_term:
+  default:
+    // The term has effects, or its effects are unknown.
+    pure = false;
+    return;
+  }
+}
+
+} // namespace
+
+// Add the numbers of the definitions in defs that are referred to by e
+// to deps. If locals is given, the other definitions that e refers to
+// are added to it. Returns true if e is pure.
+bool
+find_deps(Expr* e, const Def_map& defs, Stmt_seq& deps,
+          std::vector<Def*>* locals) {
+  Dep_finder find(defs, deps, locals);
+  find(e);
+  return find.pure;
+}
+
+// Returns true if the value of the definition d is pure, including the
+// values of the definitions it refers to.
+bool
+is_pure_def(Def* d) {
+  Stmt_seq deps;
+  std::vector<Def*> defs;
+  return find_deps(d->value(), Def_map(), deps, &defs);
+}
+
+// Build the dependency graph of the program p.
+Stmt_graph::Stmt_graph(Prog* p) {
+  Term_seq* stmts = p->stmts();
+  std::size_t n = stmts->size();
+  deps.resize(n);
+  pure.resize(n);
+
+  Def_map defs;
+  std::vector<std::size_t> level(n);
+  for (std::size_t i = 0; i < n; ++i) {
+    Term* s = (*stmts)[i];
+    Dep_finder find(defs, deps[i], nullptr);
+    find(s);
+
+    Stmt_seq& di = deps[i];
+    std::sort(di.begin(), di.end());
+    di.erase(std::unique(di.begin(), di.end()), di.end());
+
+    // A definition may refer only to the definitions before it, so
+    // the purity and level of each dependency are already known.
+    pure[i] = find.pure;
+    level[i] = 0;
+    for (std::size_t j : di) {
+      pure[i] = pure[i] and pure[j];
+      level[i] = std::max(level[i], level[j] + 1);
+    }
+    if (pure[i]) {
+      if (levels.size() <= level[i])
+        levels.resize(level[i] + 1);
+      levels[level[i]].push_back(i);
+    }
+
+    if (is<Def>(s))
+      defs.emplace(s, i);
+  }
+}
+
+
+// -------------------------------------------------------------------------- //
+// Evaluation
+
+// Evaluate the statements of a program using f, returning the value
+// of the last. Pure statements are evaluated on the global thread
+// pool, where each thread allocates nodes in the arena given by its
+// index in the pool (see Thread_pool::thread_index).
+Term*
+eval_stmts(const Stmt_graph& g, const Stmt_fn& f, std::vector<Arena*>& arenas) {
+  std::size_t n = g.size();
+  std::vector<Term*> vals(n);
+  std::vector<std::exception_ptr> errors(n);
+  std::vector<char> done(n);
+
+  // Evaluate the pure statements, level by level. A statement is not
+  // evaluated when one of its dependencies failed, since the failure
+  // is raised before that statement is reached.
+  for (const Stmt_seq& level : g.levels) {
+    auto eval_level = [&](std::size_t, std::size_t first, std::size_t last) {
+      Arena_guard guard(*arenas[Thread_pool::thread_index()]);
+      for (std::size_t k = first; k < last; ++k) {
+        std::size_t i = level[k];
+        bool ok = true;
+        for (std::size_t j : g.deps[i])
+          ok = ok and errors[j] == nullptr and done[j];
+        if (not ok)
+          continue;
+        try {
+          vals[i] = f(i);
+          done[i] = true;
+        } catch (...) {
+          errors[i] = std::current_exception();
+        }
+      }
+    };
+    get_thread_pool().run(level.size(), eval_level, 1);
+  }
+
+  // Evaluate the remaining statements in order.
+  Term* result = nullptr;
+  for (std::size_t i = 0; i < n; ++i) {
+    if (errors[i])
+      std::rethrow_exception(errors[i]);
+    if (not g.pure[i])
+      vals[i] = f(i);
+    result = vals[i];
+  }
+  return result;
+}
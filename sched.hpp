@@ -0,0 +1,57 @@
+
+#ifndef SCHED_HPP
+#define SCHED_HPP
+
+#include "ast.hpp"
+
+#include <functional>
+#include <unordered_map>
+#include <vector>
+
+struct Arena;
+
+// -------------------------------------------------------------------------- //
+// Statement scheduling
+//
+// This module evaluates the statements of a program concurrently,
+// where doing so cannot be observed.
+//
+// A statement depends on the definitions that it refers to. A
+// statement is pure when it does not contain a print statement (or
+// any term whose effects are unknown) and when each statement on
+// which it depends is pure. Pure statements are grouped into levels:
+// the level of a statement is one more than the greatest level of the
+// statements on which it depends. The pure statements of each level
+// are evaluated in parallel, after those of the previous level.
+//
+// The remaining statements are then evaluated in program order. An
+// error raised by a pure statement is raised again when its position
+// in the program is reached, so the output of the program is the same
+// as for sequential evaluation.
+
+// A sequence of statement numbers.
+using Stmt_seq = std::vector<std::size_t>;
+
+// Maps each definition of a program to its statement number.
+using Def_map = std::unordered_map<Expr*, std::size_t>;
+
+bool find_deps(Expr*, const Def_map&, Stmt_seq&, std::vector<Def*>* = nullptr);
+bool is_pure_def(Def*);
+
+// The dependency graph of the statements of a program.
+struct Stmt_graph {
+  Stmt_graph(Prog*);
+
+  std::size_t size() const { return deps.size(); }
+
+  std::vector<Stmt_seq> deps;   // The dependencies of each statement
+  std::vector<char>     pure;   // True for each pure statement
+  std::vector<Stmt_seq> levels; // The pure statements of each level
+};
+
+// Evaluates the ith statement of a program.
+using Stmt_fn = std::function<Term*(std::size_t)>;
+
+Term* eval_stmts(const Stmt_graph&, const Stmt_fn&, std::vector<Arena*>&);
+
+#endif
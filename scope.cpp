@@ -1,6 +1,7 @@
 
 #include "scope.hpp"
 
+#include "lang/context.hpp"
 #include "lang/error.hpp"
 #include "lang/debug.hpp"
 
@@ -8,30 +9,55 @@
 
 namespace {
 
-// The global current scope.
-Scope* current_scope_ = nullptr;
+// Returns the current context, in which the current scope is kept.
+inline Context&
+get_context() {
+  Context* c = current_context();
+  lang_assert(c, "no current context");
+  return *c;
+}
+
+// Returns the key of the name n in a scope.
+inline String
+get_key(Name* n) {
+  Id* id = as<Id>(n);
+  lang_assert(id, format("ill-formed name '{}'", node_name(n)));
+  return id->t1;
+}
 
 } // namespace
 
 void
 push_scope(Scope_kind k) {
-  Scope* s = new Scope(k, current_scope_);
-  current_scope_ = s;
+  Context& c = get_context();
+  c.scope = new Scope(k, c.scope);
 }
 
 void
 pop_scope() {
-  lang_assert(current_scope_, "no current scope");
-  Scope* s = current_scope_->parent;
-  delete current_scope_;
-  current_scope_ = s;
+  Context& c = get_context();
+  lang_assert(c.scope, "no current scope");
+  Scope* s = c.scope->parent;
+  delete c.scope;
+  c.scope = s;
+}
+
+Scope_guard::Scope_guard(Scope_kind k)
+  : scope(k, get_context().scope) 
+{
+  get_context().scope = &scope;
+}
+
+Scope_guard::~Scope_guard() {
+  get_context().scope = scope.parent;
 }
 
 // Returns the current scope.
 Scope* 
 current_scope() {
-  lang_assert(current_scope_, "no current scope");
-  return current_scope_;
+  Scope* s = get_context().scope;
+  lang_assert(s, "no current scope");
+  return s;
 }
 
 // Returns true if the system is currently in global scope.
@@ -47,15 +73,20 @@ bool
 in_member_scope() { return current_scope()->kind == member_scope; }
 
 
-// Associate the term t with the name n in the current scope.
+// Associate the term t with the name n in the current scope. A
+// variable declared in a lambda scope is a parameter of that scope.
 Expr*
 declare(Name* n, Expr* e) {
   Scope* s = current_scope();
-  if (s->count(n) != 0) {
+  int index = -1;
+  if (s->kind == lambda_scope and is<Var>(e))
+    index = s->parms;
+  if (not s->insert({get_key(n), {e, index}}).second) {
     error(e->loc) << format("name '{}' already bound in this scope", pretty(n));
     return nullptr;
   }
-  s->insert({n, e});
+  if (index >= 0)
+    ++s->parms;
   return e;
 }
 
@@ -73,16 +104,49 @@ declare(Expr* t) {
 // or nullptr if no such name exists.
 Expr*
 lookup(Name* n) {
+  int depth, index;
+  return lookup(n, depth, index);
+}
+
+// Return the declaration associated with the name n, or nullptr if no
+// such name exists. When the declaration is a parameter of a lambda
+// scope, its slot is stored in depth and index. Otherwise, both are -1.
+Expr*
+lookup(Name* n, int& depth, int& index) {
+  String key = get_key(n);
   Scope* s = current_scope();
+  int d = 0;
+  depth = index = -1;
   while (s) {
-    auto iter = s->find(n);
-    if (iter != s->end())
-      return iter->second;
+    auto iter = s->find(key);
+    if (iter != s->end()) {
+      const Scope_entry& e = iter->second;
+      if (e.index >= 0) {
+        depth = d;
+        index = e.index;
+      }
+      return e.decl;
+    }
+    if (s->kind == lambda_scope)
+      ++d;
     s = s->parent;
   }
   return nullptr;
 }
 
+// Mark the innermost n lambda scopes as impure, or every lambda scope
+// when n is negative. A reference to a parameter whose slot has depth n
+// makes the abstractions it is nested within impure.
+void
+mark_impure(int n) {
+  for (Scope* s = current_scope(); s and n != 0; s = s->parent) {
+    if (s->kind == lambda_scope) {
+      s->pure = false;
+      --n;
+    }
+  }
+}
+
 // Create a fresh name for this scope.
 Name*
 fresh_name() {
@@ -4,7 +4,7 @@
 
 #include "ast.hpp"
 
-#include <map>
+#include <unordered_map>
 
 // Determines the kind of scope.
 enum Scope_kind {
@@ -13,19 +13,39 @@ enum Scope_kind {
   member_scope
 };
 
+// A declaration in a scope. The index is the position of a parameter
+// of a lambda scope, and -1 for other declarations.
+struct Scope_entry {
+  Expr* decl;
+  int index;
+};
+
 // A scope records a set of named terms (e.g., variables), allowing 
 // the lookup of bound identifiers. Each scope is linked to its 
 // parent or enclosing scope, allowing lookup to work "outwards" 
 // as a declaration corresponding to that name is searched for.
-struct Scope : std::map<Name*, Expr*, Expr_less> {
+//
+// Declarations are keyed by the interned string of their name, so
+// that a lookup hashes and compares pointers, not characters. The
+// variables declared in a lambda scope are its parameters, and are
+// numbered in order of declaration. That number is the index of their
+// slot (see Ref in ast.hpp).
+//
+// A lambda scope is pure when the value of its abstraction depends only
+// on its arguments. That is, the abstraction has no effects (e.g., it
+// does not print, or call a function that prints), and does not refer
+// to the parameters of enclosing abstractions.
+struct Scope : std::unordered_map<String, Scope_entry> {
   Scope(Scope_kind k)
-    : kind(k), parent(nullptr), counter(0) { }
+    : kind(k), parent(nullptr), counter(0), parms(0), pure(true) { }
   Scope(Scope_kind k, Scope* p)
-    : kind(k), parent(p), counter(0) { }
+    : kind(k), parent(p), counter(0), parms(0), pure(true) { }
 
   Scope_kind kind;
   Scope* parent;
   int counter;
+  int parms;
+  bool pure;
 };
 
 void push_scope(Scope_kind);
@@ -39,14 +59,20 @@ bool in_member_scope();
 Expr* declare(Name*, Expr*);
 Expr* declare(Expr*);
 Expr* lookup(Name*);
+Expr* lookup(Name*, int&, int&);
+
+void mark_impure(int = -1);
 
 Name* fresh_name();
 
 // A helper class that guarantees that a scope is popped
-// when it goes out of scope.
+// when it goes out of scope. The scope is stored in the guard,
+// so entering a scope does not allocate.
 struct Scope_guard {
-  Scope_guard(Scope_kind k) { push_scope(k); }
-  ~Scope_guard() { pop_scope(); }
+  Scope_guard(Scope_kind);
+  ~Scope_guard();
+
+  Scope scope;
 };
 
 #endif
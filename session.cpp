@@ -0,0 +1,277 @@
+
+#include "session.hpp"
+#include "lexer.hpp"
+#include "parser.hpp"
+#include "syntax.hpp"
+#include "scope.hpp"
+#include "ast.hpp"
+#include "fold.hpp"
+#include "output.hpp"
+#include "table.hpp"
+#include "type.hpp"
+
+#include "lang/debug.hpp"
+
+#include <iostream>
+
+namespace {
+
+// Returns true if the program t defines names that outlive the
+// request: a top-level 'def', or a top-level table named by 'as'.
+// Names bound by 'as' within a query are local to its request.
+bool
+defines_names(Tree* t) {
+  for (Tree* s : *as<Prog_tree>(t)->stmts())
+    if (is<Def_tree>(s) or is<As_tree>(s))
+      return true;
+  return false;
+}
+
+// Returns the number of statements of the program t that insert rows.
+std::size_t
+count_inserts(Tree* t) {
+  std::size_t n = 0;
+  for (Tree* s : *as<Prog_tree>(t)->stmts())
+    n += is<Insert_tree>(s);
+  return n;
+}
+
+// Evaluate the term e with the given evaluator, printing its value.
+// Returns false if evaluation fails.
+bool
+evaluate(Evaluator& eval, Expr* e) {
+  Term* t = as<Term>(e);
+  if (not t)
+    return true;
+  try {
+    Term* v = eval(t);
+    eval.out->print(v);
+    eval.out->flush();
+  } catch (Assertion_error& err) {
+    std::cerr << "error: " << err.what() << '\n';
+    return false;
+  }
+  return true;
+}
+
+// Force the delayed definitions of the scope s (see lazy_defs), so that
+// their values are kept in the resident storage of the evaluator rather
+// than in that of the request that first refers to them, which is
+// released when the request ends. Returns false if a definition fails.
+bool
+force_delayed(Evaluator& eval, Scope* s) {
+  Context_guard cxt(eval.cxt);
+  Arena_guard guard(eval.arena);
+  try {
+    for (auto& x : *s) {
+      Def* d = as<Def>(x.second.decl);
+      if (d and d->t3)
+        ::eval(new Ref(d));
+    }
+  } catch (Assertion_error& err) {
+    std::cerr << "error: " << err.what() << '\n';
+    return false;
+  }
+  return true;
+}
+
+// Elaborate the tree t in a new scope nested within the global scope,
+// allocating in the given arena. Returns nullptr if elaboration fails,
+// in which case the scope is discarded. The elaborated term is folded
+// (see fold.hpp), but its definitions are kept for later requests.
+Expr*
+elaborate(Elaborator& elab, Scope* globals, Arena& arena, Tree* t) {
+  elab.diags.clear();
+  elab.cxt.scope = new Scope(global_scope, globals);
+  elab.cxt.arena = &arena;
+  Expr* e = elab(t);
+  elab.cxt.arena = &elab.arena;
+  if (not elab.diags.empty()) {
+    std::cerr << elab.diags;
+    e = nullptr;
+  }
+  if (not e) {
+    delete elab.cxt.scope;
+    elab.cxt.scope = nullptr;
+    return nullptr;
+  }
+  Arena_guard guard(arena);
+  return fold(e);
+}
+
+} // namespace
+
+Session::Session(Engine e)
+  : engine(e), globals(new Scope(global_scope)), eval(e), views(eval)
+{ }
+
+Session::~Session() {
+  delete globals;
+}
+
+// Run the request in the string s.
+bool
+Session::operator()(const std::string& s) {
+  return (*this)(s.data(), s.data() + s.size());
+}
+
+// Run the request in the characters [first, last). The result of the
+// request (or any diagnostics) are printed. Returns false if the
+// request fails.
+//
+// The source of a request is kept only when the request inserts rows
+// or successfully defines names, since only then are its nodes kept.
+// Otherwise, its offsets are reused by the next request (see
+// remove_source), so that a long-lived session does not exhaust them.
+bool
+Session::operator()(const char* first, const char* last) {
+  Location loc;
+  try {
+    loc = add_source(std::string(), first, last);
+  } catch (Assertion_error& err) {
+    std::cerr << "error: " << err.what() << '\n';
+    return false;
+  }
+  bool keep = false;
+  bool ok = run(first, last, loc, keep);
+  if (not keep)
+    remove_source(loc);
+  return ok;
+}
+
+// Run the request in the characters [first, last), whose source starts
+// at loc. keep is set if the nodes of the request are kept.
+bool
+Session::run(const char* first, const char* last, Location loc, bool& keep) {
+  Lexer lex;
+  lex.start(first, last, loc);
+  Token_stream toks(lex);
+  Parser parse;
+  Tree* tree = parse(toks);
+  if (not lex.diags.empty()) {
+    std::cerr << lex.diags;
+    return false;
+  }
+  if (not parse.diags.empty()) {
+    std::cerr << parse.diags;
+    return false;
+  }
+  if (not tree)
+    return true;
+  if (std::size_t n = count_inserts(tree)) {
+    if (n != as<Prog_tree>(tree)->stmts()->size()) {
+      std::cerr << "error: a request that inserts rows has no other statements\n";
+      return false;
+    }
+    keep = true;
+    return insert(tree);
+  }
+  if (defines_names(tree))
+    return keep = define(tree);
+  return query(tree);
+}
+
+// Run a request that defines names. After evaluation, the names
+// declared by the request are added to the global scope.
+//
+// A table named by 'as' is converted when it is first referenced (see
+// eval_ref). Tables that were not referenced by the request are
+// converted here, so that the conversion is not done (and lost) by a
+// later query.
+// For the same reason, definitions delayed in lazy mode are forced
+// before the request ends (see force_delayed).
+//
+// The definitions of tables are declared to the views of the session
+// before they are evaluated, so that their defined terms are kept.
+bool
+Session::define(Tree* t) {
+  Expr* e = elaborate(elab, globals, elab.arena, t);
+  if (not e)
+    return false;
+  Scope* s = elab.cxt.scope;
+  elab.cxt.scope = nullptr;
+  if (Prog* p = as<Prog>(e)) {
+    for (Term* stmt : *p->stmts())
+      if (Def* d = as<Def>(stmt))
+        views.declare(d);
+  }
+  bool ok = evaluate(eval, e) and force_delayed(eval, s);
+  if (not ok)
+    views.discard();
+  if (ok) {
+    views.define();
+    Arena_guard guard(elab.arena);
+    for (auto& x : *s) {
+      Def* d = as<Def>(x.second.decl);
+      if (d and is<List>(d->value()))
+        eval(new Ref(d));
+      (*globals)[x.first] = x.second;
+    }
+  }
+  delete s;
+  return ok;
+}
+
+// Run a request that does not define names. Its terms are elaborated
+// and evaluated in temporary storage.
+bool
+Session::query(Tree* t) {
+  Arena arena;
+  Expr* e = elaborate(elab, globals, arena, t);
+  if (not e)
+    return false;
+  delete elab.cxt.scope;
+  elab.cxt.scope = nullptr;
+  Evaluator tmp(engine);
+  return evaluate(tmp, e);
+}
+
+// Run a request whose statements insert rows.
+bool
+Session::insert(Tree* t) {
+  for (Tree* s : *as<Prog_tree>(t)->stmts()) {
+    if (not insert_rows(as<Insert_tree>(s)))
+      return false;
+  }
+  return true;
+}
+
+// Insert the rows of the table computed by 'insert x e' into the table
+// defined by x, and update the views of that table. The rows are
+// computed in the resident arenas, since they become rows of x.
+bool
+Session::insert_rows(Insert_tree* t) {
+  Tree* name = t->name();
+  auto iter = globals->find(as<Id_tree>(name)->value()->text);
+  Def* d = iter != globals->end() ? as<Def>(iter->second.decl) : nullptr;
+  View* v = d ? views.find(d) : nullptr;
+  if (not v or not v->is_base()) {
+    std::cerr << "error: " << format("'{}' is not a table of the session "
+                                     "that rows can be inserted into",
+                                     pretty(name)) << '\n';
+    return false;
+  }
+
+  Expr* e = elaborate(elab, globals, elab.arena, t->expr());
+  if (not e)
+    return false;
+  delete elab.cxt.scope;
+  elab.cxt.scope = nullptr;
+  try {
+    Arena_guard guard(elab.arena);
+    Table* rows = views.eval_table(as<Term>(e));
+    Table* table = views.eval_table(new Ref(d));
+    if (get_type(rows) != get_type(table)) {
+      std::cerr << "error: " << format("cannot insert rows of type '{}' into "
+                                       "'{}' of type '{}'",
+                                       pretty(get_type(rows)), pretty(name),
+                                       pretty(get_type(table))) << '\n';
+      return false;
+    }
+    views.insert(d, rows);
+  } catch (Assertion_error& err) {
+    std::cerr << "error: " << err.what() << '\n';
+    return false;
+  }
+  return true;
+}
@@ -0,0 +1,62 @@
+
+#ifndef SESSION_HPP
+#define SESSION_HPP
+
+#include "elab.hpp"
+#include "eval.hpp"
+#include "view.hpp"
+
+struct Scope;
+struct Tree;
+struct Insert_tree;
+
+// -------------------------------------------------------------------------- //
+// Sessions
+//
+// A session runs a sequence of requests, each of which is a program
+// (e.g., a single statement). The global scope and the values of the
+// definitions of each request remain resident, so that a request pays
+// only for its own lexing, parsing, elaboration and evaluation.
+//
+// Each request is elaborated in a scope nested within the global scope.
+// When a request defines names (i.e., one of its statements is a 'def'
+// or a table named by 'as'), it is elaborated and evaluated in the
+// resident arenas of the session, and the names declared by it are
+// added to the global scope. Defining a name that is already bound
+// replaces that binding for later requests. Other requests (queries)
+// are elaborated and evaluated in storage that is released when the
+// request completes, so queries do not accumulate memory. A request
+// that fails has no effect on the session.
+//
+// A request of the form 'insert x e' appends the rows of the table e
+// to the table defined by x, which must have the same type. Only a
+// table that is not computed from other tables can have rows inserted.
+// The tables defined from that table are then updated (see view.hpp),
+// and later requests see their new values. A request that inserts rows
+// has no other statements.
+
+struct Session {
+  Session(Engine e = vm_engine);
+  ~Session();
+
+  Session(const Session&) = delete;
+  Session& operator=(const Session&) = delete;
+
+  bool operator()(const std::string&);
+  bool operator()(const char*, const char*);
+
+  Engine engine;
+  Scope* globals; // The resident global scope
+  Elaborator elab;
+  Evaluator eval;
+  View_set views; // The tables defined by the session
+
+private:
+  bool run(const char*, const char*, Location, bool&);
+  bool define(Tree*);
+  bool query(Tree*);
+  bool insert(Tree*);
+  bool insert_rows(Insert_tree*);
+};
+
+#endif
@@ -1,14 +1,111 @@
-
 #include "ast.hpp"
 
 #include "lang/debug.hpp"
 
-// TODO: Implement me.
+// -------------------------------------------------------------------------- //
+// Term size
+//
+// The size of a term is the number of term nodes in it. Types are not
+// counted, and references count as a single node; the declarations
+// they refer to are not part of the term. The size of a table counts
+// each of its cells.
+
+namespace {
+
+int size_expr(Expr*);
+
+template<typename T>
+  inline int
+  size_seq(Seq<T>* ts) {
+    int n = 0;
+    for (T* t : *ts)
+      n += size_expr(t);
+    return n;
+  }
+
+template<typename T>
+  inline int
+  size_unary(T* t) { return 1 + size_expr(t->t1); }
+
+template<typename T>
+  inline int
+  size_binary(T* t) { return 1 + size_expr(t->t1) + size_expr(t->t2); }
+
+template<typename T>
+  inline int
+  size_ternary(T* t) {
+    return 1 + size_expr(t->t1) + size_expr(t->t2) + size_expr(t->t3);
+  }
+
+int
+size_table(Table* t) {
+  int n = 1;
+  for (Term_seq* col : *t->columns())
+    n += size_seq(col);
+  return n;
+}
+
+// Returns the size of e, or 0 if e is not a term.
+int
+size_expr(Expr* e) {
+  if (Term* t = as<Term>(e))
+    return size(t);
+  return 0;
+}
+
+} // namespace
+
 int
 size(Term* t) {
+  if (not t)
+    return 0;
   switch(t->kind) {
+  case unit_term:
+  case true_term:
+  case false_term:
+  case int_term:
+  case str_term:
+  case var_term:
+  case ref_term:
+    return 1;
+  case if_term: return size_ternary(as<If>(t));
+  case and_term: return size_binary(as<And>(t));
+  case or_term: return size_binary(as<Or>(t));
+  case not_term: return size_unary(as<Not>(t));
+  case equals_term: return size_binary(as<Equals>(t));
+  case less_term: return size_binary(as<Less>(t));
+  case succ_term: return size_unary(as<Succ>(t));
+  case pred_term: return size_unary(as<Pred>(t));
+  case iszero_term: return size_unary(as<Iszero>(t));
+  case abs_term: return size_binary(as<Abs>(t));
+  case fn_term: return 1 + size_seq(as<Fn>(t)->t1) + size(as<Fn>(t)->t2);
+  case app_term: return size_binary(as<App>(t));
+  case call_term: return 1 + size(as<Call>(t)->t1) + size_seq(as<Call>(t)->t2);
+  case closure_term: return 1 + size(as<Closure>(t)->fn());
+  case tuple_term: return 1 + size_seq(as<Tuple>(t)->t1);
+  case list_term: return 1 + size_seq(as<List>(t)->t1);
+  case record_term: return 1 + size_seq(as<Record>(t)->t1);
+  case comma_term: return 1 + size_seq(as<Comma>(t)->t1);
+  case proj_term: return size_binary(as<Proj>(t));
+  case mem_term: return size_binary(as<Mem>(t));
+  case col_term: return size_binary(as<Col>(t));
+  case def_term: return 1 + size_expr(as<Def>(t)->t2);
+  case init_term: return 1 + size_expr(as<Init>(t)->t2);
+  case table_term: return size_table(as<Table>(t));
+  case select_term: return size_ternary(as<Select_from_where>(t));
+  case join_on_term: return size_ternary(as<Join>(t));
+  case group_term: return size_ternary(as<Group_by>(t)) + size(as<Group_by>(t)->t4);
+  case agg_term: return 1 + size(as<Agg>(t)->column());
+  case order_term: return size_ternary(as<Order_by>(t));
+  case union_term: return size_binary(as<Union>(t));
+  case intersect_term: return size_binary(as<Intersect>(t));
+  case except_term: return size_binary(as<Except>(t));
+  case load_term: return size_unary(as<Load>(t));
+  case save_term: return size_binary(as<Save>(t));
+  case csv_term: return size_unary(as<Csv>(t));
+  case print_term: return size_unary(as<Print>(t));
+  case prog_term: return 1 + size_seq(as<Prog>(t)->t1);
   default: break;
   }
   lang_unreachable(format("size of unhandled term '{}'", node_name(t)));
 }
-
@@ -0,0 +1,109 @@
+#include "source.hpp"
+#include "syntax.hpp"
+
+#include "lang/thread_pool.hpp"
+
+#include <algorithm>
+
+// Returns the chunks of the source [first, last), whose first character
+// is at the location loc. Each chunk ends at the end of a statement and
+// (except for the last) has at least n characters.
+std::vector<Source_chunk>
+split_source(const char* first, const char* last, Location loc, std::size_t n) {
+  std::vector<Source_chunk> chunks;
+  const char* start = first;  // The start of the current chunk
+  int depth = 0;
+  const char* p = first;
+  while (p != last) {
+    switch (*p) {
+    case '/':
+      if (p + 1 != last and p[1] == '/') {
+        p = std::find(p, last, '\n');
+        continue;
+      }
+      break;
+
+    case '"':
+      for (++p; p != last and *p != '"'; ++p) {
+        if (*p == '\\' and p + 1 != last)
+          ++p;
+      }
+      if (p == last)
+        continue;
+      break;
+
+    case '(': case '{': case '[':
+      ++depth;
+      break;
+
+    case ')': case '}': case ']':
+      --depth;
+      break;
+
+    case ';':
+      if (depth == 0 and std::size_t(p + 1 - start) >= n) {
+        chunks.push_back({start, p + 1, loc + (start - first)});
+        start = p + 1;
+      }
+      break;
+    }
+    ++p;
+  }
+  if (start != last or chunks.empty())
+    chunks.push_back({start, last, loc + (start - first)});
+  return chunks;
+}
+
+// Parse the program in [first, last), whose first character is at the
+// location loc. Returns its tree or nullptr if it cannot be parsed (or
+// is empty).
+Tree*
+Source_parser::operator()(const char* first, const char* last, Location loc) {
+  std::vector<Source_chunk> chunks;
+  Thread_pool* pool = nullptr;
+  if (std::size_t(last - first) >= parallel_parse_size) {
+    pool = &get_thread_pool();
+    std::size_t n = (last - first) / (pool->size() * 4);
+    chunks = split_source(first, last, loc, std::max(n, min_parse_chunk));
+  } else {
+    chunks.push_back({first, last, loc});
+  }
+
+  for (std::size_t i = 0; i < chunks.size(); ++i)
+    parts.emplace_back(new Part());
+  auto parse_chunks = [&](std::size_t, std::size_t f, std::size_t l) {
+    for (std::size_t i = f; i != l; ++i) {
+      Part& p = *parts[i];
+      p.lex.start(chunks[i].first, chunks[i].last, chunks[i].loc);
+      Token_stream toks(p.lex);
+      p.tree = p.parse(toks);
+    }
+  };
+  if (pool)
+    pool->run(chunks.size(), parse_chunks, 1);
+  else
+    parse_chunks(0, 0, chunks.size());
+
+  // Collect the diagnostics up to the first chunk that fails.
+  bool ok = true;
+  for (std::unique_ptr<Part>& p : parts) {
+    lex_diags.insert(lex_diags.end(), p->lex.diags.begin(), p->lex.diags.end());
+    if (not p->parse.diags.empty()) {
+      diags = p->parse.diags;
+      ok = false;
+      break;
+    }
+  }
+  if (not ok or not lex_diags.empty())
+    return nullptr;
+  if (parts.size() == 1)
+    return parts.front()->tree;
+
+  Context_guard guard(cxt);
+  Tree_seq* stmts = new Tree_seq();
+  for (std::unique_ptr<Part>& p : parts)
+    if (Tree* t = p->tree)
+      stmts->insert(stmts->end(), as<Prog_tree>(t)->stmts()->begin(),
+                                  as<Prog_tree>(t)->stmts()->end());
+  return new Prog_tree(stmts);
+}
@@ -0,0 +1,67 @@
+#ifndef SOURCE_HPP
+#define SOURCE_HPP
+
+#include "lexer.hpp"
+#include "parser.hpp"
+
+#include <memory>
+#include <vector>
+
+struct Tree;
+
+// -------------------------------------------------------------------------- //
+// Source parsing
+//
+// A program is a sequence of statements, each followed by a semicolon.
+// A large program is split into chunks at the semicolons that end its
+// statements: those that are not within a string, a comment, or any
+// parentheses, braces, or brackets. The chunks are lexed and parsed on
+// the threads of the global pool, each by its own lexer and parser, and
+// started at the location of its first character. The statements of the
+// chunks are then concatenated in order.
+//
+// The diagnostics of the source are those of the first chunk that fails
+// to parse, preceded by the lexical errors of that chunk and of those
+// before it, as they would be if the program were parsed in order. If
+// there are lexical errors, only those are reported.
+//
+// Sources smaller than parallel_parse_size are parsed as a single chunk.
+
+constexpr std::size_t parallel_parse_size = std::size_t(1) << 20;
+
+// The smallest chunk into which a source is split.
+constexpr std::size_t min_parse_chunk = std::size_t(1) << 18;
+
+// A chunk of source text, starting at the given location.
+struct Source_chunk {
+  const char* first;
+  const char* last;
+  Location    loc;
+};
+
+std::vector<Source_chunk>
+split_source(const char*, const char*, Location, std::size_t);
+
+// The source parser parses a program from its text. The trees of the
+// program are allocated in the arenas of its parsers, and are destroyed
+// with the source parser.
+struct Source_parser {
+  Source_parser() : cxt(diags, &arena) { }
+
+  Tree* operator()(const char*, const char*, Location);
+
+  // The lexer and parser of a chunk.
+  struct Part {
+    Lexer  lex;
+    Parser parse;
+    Tree*  tree = nullptr;
+  };
+
+  std::vector<std::unique_ptr<Part>> parts;
+  Diagnostics lex_diags;   // The lexical errors of the program
+  Diagnostics diags;       // The syntax errors of the program
+  Arena       arena;       // Storage for the program tree
+  Context     cxt;         // The context of the program tree
+};
+
+#endif
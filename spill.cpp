@@ -0,0 +1,71 @@
+#include "spill.hpp"
+#include "stats.hpp"
+#include "table.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+
+#include <unistd.h>
+
+namespace {
+
+std::size_t memory_budget = 0;
+
+} // namespace
+
+// Set the memory budget of query plans, in bytes.
+void
+set_memory_budget(std::size_t n) {
+  memory_budget = n;
+}
+
+std::size_t
+get_memory_budget() {
+  return memory_budget;
+}
+
+// Returns the number of rows of the table type t that can be kept
+// within the memory budget, or no_budget if the budget is unlimited or
+// the rows cannot be spilled.
+std::size_t
+get_budget_rows(Type* t) {
+  if (memory_budget == 0 or not is_table_file_type(t))
+    return no_budget;
+  std::size_t row = get_row_type(t)->members()->size() * spill_cell_size;
+  return std::max<std::size_t>(memory_budget / std::max<std::size_t>(row, 1), 1);
+}
+
+// Create an empty file in the temporary directory (given by TMPDIR, or
+// /tmp by default) to hold spilled rows. If it cannot be created, the
+// path is empty, and nothing can be written.
+Spill_file::Spill_file() {
+  const char* dir = std::getenv("TMPDIR");
+  std::string name = std::string(dir and *dir ? dir : "/tmp") + "/waffle-spill-XXXXXX";
+  int fd = ::mkstemp(&name[0]);
+  if (fd < 0)
+    return;
+  ::close(fd);
+  path = name;
+}
+
+Spill_file::~Spill_file() {
+  reader.close();
+  if (not path.empty())
+    std::remove(path.c_str());
+}
+
+// Write the table t to the file. Returns false if it cannot be saved.
+bool
+Spill_file::write(Table* t) {
+  if (path.empty() or not save_table(path, t))
+    return false;
+  count_spill(t->rows());
+  return true;
+}
+
+// Open the file to read back its rows, which have type t.
+bool
+Spill_file::open(Type* t) {
+  return reader.open(path, t);
+}
@@ -0,0 +1,57 @@
+#ifndef SPILL_HPP
+#define SPILL_HPP
+
+#include "table_file.hpp"
+
+#include <string>
+
+// -------------------------------------------------------------------------- //
+// Spilling
+//
+// The operators of a query plan that keep rows across batches (sorts,
+// groupings, and the right side of joins; see plan.cpp) are held to
+// the memory budget set with set_memory_budget. When the rows kept by
+// an operator exceed the budget, they are written to spill files:
+// temporary table files (see table_file.hpp) that are read back a
+// batch at a time, and removed when the operator is done with them.
+//
+// The size of the rows kept is estimated from the number of their
+// cells. Rows whose columns cannot be saved to a table file are never
+// spilled, so the budget is a target rather than a hard limit. A
+// budget of 0 (the default) is unlimited.
+
+// The estimated size (in bytes) of a cell of a kept row: its entry in
+// the column, and the node that it refers to.
+constexpr std::size_t spill_cell_size = 48;
+
+// The number of partitions into which rows are spilled by a hash of
+// their key.
+constexpr std::size_t spill_partitions = 16;
+
+// The number of rows returned by get_budget_rows when rows are never
+// spilled.
+constexpr std::size_t no_budget = -1;
+
+void set_memory_budget(std::size_t);
+std::size_t get_memory_budget();
+
+std::size_t get_budget_rows(Type*);
+
+// A spill file holds a table written by an operator, and is removed
+// when it is destroyed.
+struct Spill_file {
+  Spill_file();
+  ~Spill_file();
+
+  Spill_file(const Spill_file&) = delete;
+  Spill_file& operator=(const Spill_file&) = delete;
+
+  bool write(Table*);
+  bool open(Type*);
+  Table* read(std::size_t n) { return reader.read(n); }
+
+  std::string path;
+  Table_reader reader;
+};
+
+#endif
@@ -0,0 +1,172 @@
+#include "stats.hpp"
+#include "vm.hpp"
+
+#include "lang/debug.hpp"
+
+#include <sys/resource.h>
+
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+bool stats_enabled = false;
+
+Node_counter eval_counts;
+std::atomic<std::uint64_t> op_counts[256];
+std::atomic<std::uint64_t> subst_count;
+std::atomic<std::uint64_t> native_count;
+std::atomic<std::uint64_t> spill_count;
+std::atomic<std::uint64_t> gather_count;
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+// The statistics of a phase. The nodes are those allocated during the
+// phase.
+struct Phase {
+  std::string name;
+  double ms;
+  long rss;
+  Node_counts nodes;
+};
+
+// The statistics of the current phase, when it began.
+struct Phase_start {
+  const char* name;
+  Clock::time_point time;
+  Node_counts nodes;
+};
+
+std::vector<Phase> phases_;
+std::vector<std::pair<std::string, int>> sizes_;
+Phase_start current_ {nullptr, Clock::time_point(), {}};
+
+// Returns the peak resident set size of the process, in kilobytes.
+long
+get_peak_rss() {
+  rusage r;
+  getrusage(RUSAGE_SELF, &r);
+  return r.ru_maxrss;
+}
+
+// Returns the total of the counts.
+std::uint64_t
+get_total(const Node_counts& cs) {
+  std::uint64_t n = 0;
+  for (const auto& c : cs)
+    n += c.second;
+  return n;
+}
+
+// Print the counts, most frequent first.
+void
+print_counts(std::ostream& os, Node_counts cs) {
+  std::stable_sort(cs.begin(), cs.end(), [](const Node_counts::value_type& a,
+                                            const Node_counts::value_type& b) {
+    return a.second > b.second;
+  });
+  for (const auto& c : cs)
+    os << "    " << std::left << std::setw(16) << node_name(c.first).str()
+       << std::right << std::setw(12) << c.second << '\n';
+}
+
+} // namespace
+
+// Enable the collection of statistics, including the counting of
+// nodes as they are allocated.
+void
+enable_stats() {
+  stats_enabled = true;
+  node_counting = true;
+}
+
+// Begin the phase with the given name, ending the current phase, if
+// any.
+void
+begin_phase(const char* name) {
+  if (not stats_enabled)
+    return;
+  end_phase();
+  current_.name = name;
+  current_.nodes = get_counts(node_counts);
+  current_.time = Clock::now();
+}
+
+// End the current phase, if any, and record its statistics.
+void
+end_phase() {
+  if (not stats_enabled or not current_.name)
+    return;
+  std::chrono::duration<double, std::milli> ms = Clock::now() - current_.time;
+  Node_counts nodes = get_difference(get_counts(node_counts), current_.nodes);
+  phases_.push_back({current_.name, ms.count(), get_peak_rss(), nodes});
+  current_.name = nullptr;
+}
+
+// Record the size of the term e (see size.cpp), if it is a term.
+void
+record_size(const char* what, Expr* e) {
+  if (not stats_enabled)
+    return;
+  if (Term* t = as<Term>(e))
+    sizes_.emplace_back(what, size(t));
+}
+
+// Print the statistics collected so far. The current phase is ended.
+void
+print_stats(std::ostream& os) {
+  if (not stats_enabled)
+    return;
+  end_phase();
+  os << "== stats ==\n";
+
+  os << "phases:\n";
+  os << "    " << std::left << std::setw(16) << "phase" << std::right
+     << std::setw(12) << "time (ms)" << std::setw(16) << "peak rss (kB)"
+     << std::setw(12) << "nodes" << '\n';
+  for (const Phase& p : phases_)
+    os << "    " << std::left << std::setw(16) << p.name << std::right
+       << std::setw(12) << std::fixed << std::setprecision(3) << p.ms
+       << std::setw(16) << p.rss << std::setw(12) << get_total(p.nodes) << '\n';
+
+  for (const Phase& p : phases_) {
+    if (p.nodes.empty())
+      continue;
+    os << "nodes allocated by " << p.name << ":\n";
+    print_counts(os, p.nodes);
+  }
+
+  Node_counts evals = get_counts(eval_counts);
+  if (not evals.empty()) {
+    os << "evaluations:\n";
+    print_counts(os, evals);
+  }
+
+  bool ops = false;
+  for (int i = 0; i <= op_print; ++i) {
+    std::uint64_t n = op_counts[i].load(std::memory_order_relaxed);
+    if (n == 0)
+      continue;
+    if (not ops)
+      os << "instructions:\n";
+    ops = true;
+    os << "    " << std::left << std::setw(16) << get_opcode_name(Opcode(i))
+       << std::right << std::setw(12) << n << '\n';
+  }
+
+  os << "substitutions: " << subst_count.load(std::memory_order_relaxed) << '\n';
+  os << "native calls: " << native_count.load(std::memory_order_relaxed) << '\n';
+  os << "spilled rows: " << spill_count.load(std::memory_order_relaxed) << '\n';
+  os << "gathered rows: " << gather_count.load(std::memory_order_relaxed) << '\n';
+
+  if (not sizes_.empty()) {
+    os << "term sizes:\n";
+    for (const auto& s : sizes_)
+      os << "    " << std::left << std::setw(16) << s.first
+         << std::right << std::setw(12) << s.second << '\n';
+  }
+}
@@ -0,0 +1,88 @@
+#ifndef STATS_HPP
+#define STATS_HPP
+
+#include "ast.hpp"
+
+#include <atomic>
+#include <cstdint>
+#include <iosfwd>
+
+// -------------------------------------------------------------------------- //
+// Statistics
+//
+// When statistics are enabled (with --stats), a run is divided into
+// phases (e.g., parsing, elaboration, and evaluation), and the report
+// gives the wall time of each phase, the peak resident set size at its
+// end, and the number of nodes of each kind allocated during it (see
+// Node_counter in lang/nodes.hpp). The report also gives the number of
+// times each kind of term is evaluated by the tree-walking evaluators,
+// the number of instructions of each kind executed by the virtual
+// machine, the number of substitutions, the number of calls run by
+// native code (see jit.hpp), the number of rows spilled to disk by
+// query plans (see spill.hpp), the number of rows returned by worker
+// processes (see worker.hpp), and the sizes of the terms recorded with
+// record_size.
+//
+// Counting is disabled by default, and costs a test of stats_enabled
+// at each counted event. Counts may be incremented concurrently.
+
+extern bool stats_enabled;
+
+extern Node_counter eval_counts;
+extern std::atomic<std::uint64_t> op_counts[256];
+extern std::atomic<std::uint64_t> subst_count;
+extern std::atomic<std::uint64_t> native_count;
+extern std::atomic<std::uint64_t> spill_count;
+extern std::atomic<std::uint64_t> gather_count;
+
+void enable_stats();
+
+// Count the evaluation of a term of kind k.
+inline void
+count_eval(Node_kind k) {
+  if (stats_enabled)
+    eval_counts.add(k);
+}
+
+// Count the execution of an instruction with opcode op.
+inline void
+count_op(std::uint8_t op) {
+  if (stats_enabled)
+    op_counts[op].fetch_add(1, std::memory_order_relaxed);
+}
+
+// Count a substitution into a term.
+inline void
+count_subst() {
+  if (stats_enabled)
+    subst_count.fetch_add(1, std::memory_order_relaxed);
+}
+
+// Count a call run by native code.
+inline void
+count_native() {
+  if (stats_enabled)
+    native_count.fetch_add(1, std::memory_order_relaxed);
+}
+
+// Count n rows spilled to disk.
+inline void
+count_spill(std::uint64_t n) {
+  if (stats_enabled)
+    spill_count.fetch_add(n, std::memory_order_relaxed);
+}
+
+// Count n rows returned by worker processes.
+inline void
+count_gather(std::uint64_t n) {
+  if (stats_enabled)
+    gather_count.fetch_add(n, std::memory_order_relaxed);
+}
+
+void begin_phase(const char*);
+void end_phase();
+void record_size(const char*, Expr*);
+
+void print_stats(std::ostream&);
+
+#endif
@@ -3,6 +3,7 @@
 #include "subst.hpp"
 #include "ast.hpp"
 #include "type.hpp"
+#include "stats.hpp"
 
 #include "lang/debug.hpp"
 
@@ -34,10 +35,14 @@ namespace {
 //
 //    [x->s]op t = op [x->s]t
 //
+// As with each of the following rules, when the substitution does not
+// change any subterm, the term itself is the result.
 template<typename T>
   inline Expr*
   subst_unary_term(T* t, const Subst& sub) {
     Term* t1 = subst_term(t->t1, sub);
+    if (t1 == t->t1)
+      return t;
     return new T(t->loc, get_type(t), t1);
   }
 
@@ -50,6 +55,8 @@ template<typename T>
   subst_binary_term(T* t, const Subst& sub) {
     Term* t1 = subst_term(t->t1, sub);
     Term* t2 = subst_term(t->t2, sub);
+    if (t1 == t->t1 and t2 == t->t2)
+      return t;
     return new T(t->loc, get_type(t), t1, t2);
   }
 
@@ -63,6 +70,8 @@ template<typename T>
     Term* t1 = subst_term(t->t1, sub);
     Term* t2 = subst_term(t->t2, sub);
     Term* t3 = subst_term(t->t3, sub);
+    if (t1 == t->t1 and t2 == t->t2 and t3 == t->t3)
+      return t;
     return new T(t->loc, get_type(t), t1, t2, t3);
   }
 
@@ -99,52 +108,100 @@ inline Expr*
 subst_mem(Mem* t, const Subst& sub) {
   Term* t1 = subst_term(t->t1, sub);
   Term* t2 = subst_term(t->t2, sub);
-  return new Mem(t->loc, get_unit_type(), t1, t2);
+  if (t1 == t->t1 and t2 == t->t2)
+    return t;
+  return new Mem(t->loc, get_unit_type(), t1, t2, t->t3);
+}
+
+// Substitution into a name or type does not change it.
+inline Expr*
+subst_same(Expr* e, const Subst& sub) { return e; }
+
+Expr*
+subst_unknown(Expr* e, const Subst& sub) {
+  lang_unreachable(format("substitution into unkown term '{}'", node_name(e)));
+}
+
+using Subst_rule = Expr* (*)(Expr*, const Subst&);
+
+Node_table<Subst_rule> subst_rules_(subst_unknown);
+
+template<typename T, Expr* (*F)(T*, const Subst&)>
+  Expr*
+  subst_node(Expr* e, const Subst& sub) { return F(static_cast<T*>(e), sub); }
+
+// Define the rule for terms of type T.
+template<typename T, Expr* (*F)(T*, const Subst&)>
+  inline void
+  define_subst() { subst_rules_.define(T::node_kind, subst_node<T, F>); }
+
+// Define the rule for each of the kinds ks.
+inline void
+define_subst(std::initializer_list<Node_kind> ks, Subst_rule f) {
+  for (Node_kind k : ks)
+    subst_rules_.define(k, f);
 }
 
 } // namespace
 
+// Initialize the substitution rules. Every kind of name, type and term
+// has a rule. Substitution into terms that bind or sequence their
+// subterms (e.g., functions and programs) is not supported.
+void
+init_subst() {
+  define_subst<If, subst_ternary_term<If>>();
+  define_subst<And, subst_binary_term<And>>();
+  define_subst<Or, subst_binary_term<Or>>();
+  define_subst<Equals, subst_binary_term<Equals>>();
+  define_subst<Less, subst_binary_term<Less>>();
+  define_subst<Not, subst_unary_term<Not>>();
+  define_subst<Succ, subst_unary_term<Succ>>();
+  define_subst<Pred, subst_unary_term<Pred>>();
+  define_subst<Iszero, subst_unary_term<Iszero>>();
+  define_subst<Var, subst_var>();
+  define_subst<Abs, subst_binary_term<Abs>>();
+  define_subst<App, subst_binary_term<App>>();
+  define_subst<Ref, subst_ref>();
+  define_subst<Mem, subst_mem>();
+  define_subst<Save, subst_binary_term<Save>>();
+  define_subst({unit_term, true_term, false_term, int_term, str_term,
+                closure_term, record_term, table_term, load_term, csv_term},
+               subst_same);
+  define_subst({fn_term, call_term, tuple_term, list_term, variant_term,
+                comma_term, proj_term, col_term, def_term, init_term,
+                select_term, group_term, agg_term, order_term, join_on_term,
+                union_term, intersect_term, except_term, print_term,
+                prog_term},
+               subst_unknown);
+  define_subst({id_expr, kind_type, unit_type, bool_type, nat_type, str_type,
+                arrow_type, fn_type, tuple_type, list_type, record_type,
+                variant_type, wild_type},
+               subst_same);
+  subst_rules_.check(name_class, "substitution");
+  subst_rules_.check(type_class, "substitution");
+  subst_rules_.check(term_class, "substitution");
+}
+
+// Returns the substitution of sub through the expression e. Subterms
+// that are not changed by the substitution are shared with e, so that
+// substituting into a term without references to the substituted
+// declarations allocates nothing.
 Expr*
 subst(Expr* e, const Subst& sub) {
-  switch (e->kind) {
-  case id_expr: return e;
-  case unit_term: return e;
-  case true_term: return e;
-  case false_term: return e;
-  case if_term: return subst_ternary_term(as<If>(e), sub);
-  case int_term: return e;
-  case and_term: return subst_binary_term(as<And>(e), sub);
-  case or_term: return subst_binary_term(as<Or>(e), sub);
-  case equals_term: return subst_binary_term(as<Equals>(e), sub);
-  case less_term: return subst_binary_term(as<Less>(e), sub);
-  case not_term: return subst_unary_term(as<Not>(e), sub);
-  case succ_term: return subst_unary_term(as<Succ>(e), sub);
-  case pred_term: return subst_unary_term(as<Pred>(e), sub);
-  case iszero_term: return subst_unary_term(as<Iszero>(e), sub);
-  case var_term: return subst_var(as<Var>(e), sub);
-  case abs_term: return subst_binary_term(as<Abs>(e), sub);
-  case app_term: return subst_binary_term(as<App>(e), sub);
-  case ref_term: return subst_ref(as<Ref>(e), sub);
-  case mem_term: return subst_mem(as<Mem>(e), sub);
-  case kind_type: return e;
-  case unit_type: return e;
-  case bool_type: return e;
-  case nat_type: return e;
-  case arrow_type: return e;
-  case record_term: return e;
-  default: break;
-  }
-  lang_unreachable(format("substitution into unkown term '{}'", node_name(e)));
+  if (sub.empty())
+    return e;
+  return subst_rules_[e->kind](e, sub);
 }
 
 // Return the substituion of sub throught the given term.
-inline Term*
+Term*
 subst_term(Term* t, const Subst& sub) {
+  count_subst();
   return as<Term>(subst(t, sub));
 }
 
 // Return the substituion of sub throught the given type.
-inline Type*
+Type*
 subst_type(Type* t, const Subst& sub) {
   return as<Type>(subst(t, sub));
 }
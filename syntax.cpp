@@ -12,15 +12,20 @@ init_trees() {
   init_node(def_tree, "def-tree");
   init_node(init_tree, "init-tree");
   init_node(var_tree, "var-tree");
-  init_node(init_tree, "init-tree");
   init_node(abs_tree, "abs-tree");
+  init_node(fn_tree, "fn-tree");
   init_node(app_tree, "app-tree");
+  init_node(func_tree, "func-tree");
   init_node(if_tree, "if-tree");
   init_node(succ_tree, "succ-tree");
   init_node(pred_tree, "pred-tree");
   init_node(iszero_tree, "iszero-tree");
   init_node(arrow_tree, "arrow-tree");
   init_node(print_tree, "print-tree");
+  init_node(load_tree, "load-tree");
+  init_node(save_tree, "save-tree");
+  init_node(csv_tree, "csv-tree");
+  init_node(insert_tree, "insert-tree");
   init_node(typeof_tree, "typeof-tree");
   init_node(tuple_tree, "tuple-tree");
   init_node(list_tree, "list-tree");
@@ -32,6 +37,8 @@ init_trees() {
   init_node(union_tree, "union-tree");
   init_node(intersect_tree, "intersect-tree");
   init_node(except_tree, "except-tree");
+  init_node(agg_tree, "agg-tree");
+  init_node(order_tree, "order-tree");
   init_node(and_tree, "and-tree");
   init_node(or_tree, "or-tree");
   init_node(not_tree, "not-tree");
@@ -41,6 +48,19 @@ init_trees() {
   init_node(as_tree, "as-tree");
 }
 
+// Returns true if s names an aggregate. The names of aggregates are not
+// keywords; they are recognized only in the projection list of a
+// selection (see parse_aggregate_expr).
+bool
+is_aggregate_name(String s) {
+  static const String names[] = {"count", "sum", "min", "max"};
+  for (String n : names) {
+    if (s == n)
+      return true;
+  }
+  return false;
+}
+
 // -------------------------------------------------------------------------- //
 // Pretty printing
 
@@ -123,6 +143,26 @@ pp_print(std::ostream& os, Print_tree* t) {
   os  << "print " << pretty(t->expr());
 }
 
+void
+pp_load(std::ostream& os, Load_tree* t) {
+  os  << "load " << pretty(t->path());
+}
+
+void
+pp_save(std::ostream& os, Save_tree* t) {
+  os  << "save " << pretty(t->path()) << ' ' << pretty(t->expr());
+}
+
+void
+pp_csv(std::ostream& os, Csv_tree* t) {
+  os  << "csv " << pretty(t->path()) << ' ' << pretty(t->type());
+}
+
+void
+pp_insert(std::ostream& os, Insert_tree* t) {
+  os  << "insert " << pretty(t->name()) << ' ' << pretty(t->expr());
+}
+
 void
 pp_typeof(std::ostream& os, Typeof_tree* t) {
   os  << "typeof " << pretty(t->expr());
@@ -158,6 +198,22 @@ pp_select(std::ostream& os, Select_tree* t) {
   os << "select " << pretty(t->t1) 
      << " from " << pretty(t->t2) 
      << " where " << pretty(t->t3);
+  if (t->t4)
+    os << " group by " << pretty(t->t4);
+}
+
+void
+pp_order(std::ostream& os, Order_tree* t) {
+  os << pretty(t->t1);
+  if (t->t2)
+    os << " order by " << pretty(t->t2) << (t->desc ? " desc" : "");
+  if (t->t3)
+    os << " limit " << pretty(t->t3);
+}
+
+void
+pp_agg(std::ostream& os, Agg_tree* t) {
+  os << t->op()->text << ' ' << pretty(t->column());
 }
 
 void
@@ -239,6 +295,10 @@ print(std::ostream& os, Tree* t) {
   case arrow_tree: return pp_arrow(os, as<Arrow_tree>(t));
   case def_tree: return pp_def(os, as<Def_tree>(t));
   case print_tree: return pp_print(os, as<Print_tree>(t));
+  case load_tree: return pp_load(os, as<Load_tree>(t));
+  case save_tree: return pp_save(os, as<Save_tree>(t));
+  case csv_tree: return pp_csv(os, as<Csv_tree>(t));
+  case insert_tree: return pp_insert(os, as<Insert_tree>(t));
   case typeof_tree: return pp_typeof(os, as<Typeof_tree>(t));
   case tuple_tree: return pp_tuple(os, as<Tuple_tree>(t));
   case list_tree: return pp_list(os, as<List_tree>(t));
@@ -250,6 +310,8 @@ print(std::ostream& os, Tree* t) {
   case union_tree: return pp_union(os, as<Union_tree>(t));
   case intersect_tree: return pp_intersect(os, as<Intersect_tree>(t));
   case except_tree: return pp_except(os, as<Except_tree>(t));
+  case agg_tree: return pp_agg(os, as<Agg_tree>(t));
+  case order_tree: return pp_order(os, as<Order_tree>(t));
   case and_tree: return pp_and(os, as<And_tree>(t));
   case or_tree: return pp_or(os, as<Or_tree>(t));
   case not_tree: return pp_not(os, as<Not_tree>(t));
@@ -27,13 +27,19 @@ constexpr Node_kind list_tree    = make_tree_node(151); // [t1, ..., tn]
 constexpr Node_kind variant_tree = make_tree_node(152); // <t1, ..., tn>
 constexpr Node_kind comma_tree   = make_tree_node(153); // t1, ..., tn
 constexpr Node_kind dot_tree     = make_tree_node(154); // t1.t2
-constexpr Node_kind select_tree  = make_tree_node(161); // select t1 from t2 where t3
+constexpr Node_kind select_tree  = make_tree_node(161); // select t1 from t2 where t3 [group by t4]
 constexpr Node_kind join_on_tree = make_tree_node(162); // t1 join t2 on t3
 constexpr Node_kind union_tree   = make_tree_node(163); // t1 union t2
 constexpr Node_kind intersect_tree = make_tree_node(164); // t1 intersect t2
 constexpr Node_kind except_tree  = make_tree_node(165); // t1 except t2
+constexpr Node_kind agg_tree     = make_tree_node(166); // f t (e.g., sum x.a)
+constexpr Node_kind order_tree   = make_tree_node(167); // t1 order by t2 limit t3
 constexpr Node_kind print_tree   = make_tree_node(200); // print t
 constexpr Node_kind typeof_tree  = make_tree_node(201); // typeof t
+constexpr Node_kind load_tree    = make_tree_node(202); // load "path"
+constexpr Node_kind save_tree    = make_tree_node(203); // save "path" t
+constexpr Node_kind csv_tree     = make_tree_node(204); // csv "path" T
+constexpr Node_kind insert_tree  = make_tree_node(205); // insert x t
 constexpr Node_kind and_tree     = make_tree_node(300); // t1 and t2
 constexpr Node_kind or_tree      = make_tree_node(301); // t1 or t2
 constexpr Node_kind not_tree     = make_tree_node(302); // t1 not t2
@@ -41,11 +47,18 @@ constexpr Node_kind eq_comp_tree = make_tree_node(303); // t1 == t2
 constexpr Node_kind less_tree    = make_tree_node(304); // t1 < t2
 constexpr Node_kind prog_tree    = make_tree_node(500); // stmts
 
-struct Tree : Node { using Node::Node; };
+struct Tree : Node {
+  static constexpr Node_kind first_kind = make_node_class(tree_class);
+  static constexpr Node_kind last_kind = make_node_class(max_node_class) - 1;
+
+  using Node::Node;
+};
 
 using Tree_seq = Seq<Tree>;
 
 struct Id_tree : Tree {
+  static constexpr Node_kind node_kind = id_tree;
+
   Id_tree(const Token* k)
     : Tree(id_tree, k->loc), t1(k) { }
 
@@ -55,6 +68,8 @@ struct Id_tree : Tree {
 };
 
 struct Lit_tree : Tree {
+  static constexpr Node_kind node_kind = lit_tree;
+
   Lit_tree(const Token* k)
     : Tree(lit_tree, k->loc), t1(k) { }
 
@@ -65,6 +80,8 @@ struct Lit_tree : Tree {
 
 // A labeled initializer of the form 'x=t'.
 struct Init_tree : Tree {
+  static constexpr Node_kind node_kind = init_tree;
+
   Init_tree(Tree* n, Tree* t)
     : Tree(init_tree, n->loc), t1(n), t2(t) { }
 
@@ -78,6 +95,8 @@ struct Init_tree : Tree {
 // Allows users to bind a term to a reference
 // t as id
 struct As_tree : Tree {
+  static constexpr Node_kind node_kind = as_tree;
+
   As_tree(Tree* t, Tree* n)
     : Tree(as_tree, t->loc), t1(t), t2(n) { }
 
@@ -89,6 +108,8 @@ struct As_tree : Tree {
 };
 
 struct Var_tree : Tree {
+  static constexpr Node_kind node_kind = var_tree;
+
   Var_tree(Tree* t1, Tree* t2)
     : Tree(var_tree, t1->loc), t1(t1), t2(t2) { }
 
@@ -100,6 +121,8 @@ struct Var_tree : Tree {
 };
 
 struct Abs_tree : Tree {
+  static constexpr Node_kind node_kind = abs_tree;
+
   Abs_tree(const Token* k, Tree* t1, Tree* t2)
     : Tree(abs_tree, k->loc), t1(t1), t2(t2) { }
 
@@ -111,6 +134,8 @@ struct Abs_tree : Tree {
 };
 
 struct Fn_tree : Tree {
+  static constexpr Node_kind node_kind = fn_tree;
+
   Fn_tree(const Token* k, Tree_seq* t1, Tree* t2)
     : Tree(fn_tree, k->loc), t1(t1), t2(t2) { }
 
@@ -121,6 +146,8 @@ struct Fn_tree : Tree {
 };
 
 struct Func_tree : Tree {
+  static constexpr Node_kind node_kind = func_tree;
+
   Func_tree(Tree* n, Tree_seq* t2, Tree* t3)
     : Tree(func_tree, n->loc), t1(n), t2(t2), t3(t3) { }
 
@@ -135,6 +162,8 @@ struct Func_tree : Tree {
 
 
 struct App_tree : Tree {
+  static constexpr Node_kind node_kind = app_tree;
+
   App_tree(Tree* t1, Tree* t2)
     : Tree(app_tree, t1->loc), t1(t1), t2(t2) { }
 
@@ -146,6 +175,8 @@ struct App_tree : Tree {
 };
 
 struct If_tree : Tree {
+  static constexpr Node_kind node_kind = if_tree;
+
   If_tree(const Token* k, Tree* t1, Tree* t2, Tree* t3)
     : Tree(if_tree, k->loc), t1(t1), t2(t2), t3(t3) { }
 
@@ -159,6 +190,8 @@ struct If_tree : Tree {
 };
 
 struct Succ_tree : Tree {
+  static constexpr Node_kind node_kind = succ_tree;
+
   Succ_tree(const Token* k, Tree* t)
     : Tree(succ_tree, k->loc), t1(t) { }
 
@@ -168,6 +201,8 @@ struct Succ_tree : Tree {
 };
 
 struct Pred_tree : Tree {
+  static constexpr Node_kind node_kind = pred_tree;
+
   Pred_tree(const Token* k, Tree* t)
     : Tree(pred_tree, k->loc), t1(t) { }
 
@@ -177,6 +212,8 @@ struct Pred_tree : Tree {
 };
 
 struct Iszero_tree : Tree {
+  static constexpr Node_kind node_kind = iszero_tree;
+
   Iszero_tree(const Token* k, Tree* t)
     : Tree(iszero_tree, k->loc), t1(t) { }
 
@@ -186,6 +223,8 @@ struct Iszero_tree : Tree {
 };
 
 struct Arrow_tree : Tree {
+  static constexpr Node_kind node_kind = arrow_tree;
+
   Arrow_tree(Tree* t1, Tree* t2)
     : Tree(arrow_tree, t1->loc), t1(t1), t2(t2) { }
 
@@ -197,6 +236,8 @@ struct Arrow_tree : Tree {
 };
 
 struct Def_tree : Tree {
+  static constexpr Node_kind node_kind = def_tree;
+
   Def_tree(const Token* k, Tree* n, Tree* e)
     : Tree(def_tree, k->loc), t1(n), t2(e) { }
 
@@ -208,6 +249,8 @@ struct Def_tree : Tree {
 };
 
 struct Print_tree : Tree {
+  static constexpr Node_kind node_kind = print_tree;
+
   Print_tree(const Token* k, Tree* t)
     : Tree(print_tree, k->loc), t1(t) { }
 
@@ -216,7 +259,61 @@ struct Print_tree : Tree {
   Tree* t1;
 };
 
+struct Load_tree : Tree {
+  static constexpr Node_kind node_kind = load_tree;
+
+  Load_tree(const Token* k, Tree* p)
+    : Tree(load_tree, k->loc), t1(p) { }
+
+  Tree* path() const { return t1; }
+
+  Tree* t1;
+};
+
+struct Save_tree : Tree {
+  static constexpr Node_kind node_kind = save_tree;
+
+  Save_tree(const Token* k, Tree* p, Tree* t)
+    : Tree(save_tree, k->loc), t1(p), t2(t) { }
+
+  Tree* path() const { return t1; }
+  Tree* expr() const { return t2; }
+
+  Tree* t1;
+  Tree* t2;
+};
+
+// Appends the rows of the table t to the table named by x. Rows are
+// inserted only by the requests of a session (see session.hpp).
+struct Insert_tree : Tree {
+  static constexpr Node_kind node_kind = insert_tree;
+
+  Insert_tree(const Token* k, Tree* n, Tree* t)
+    : Tree(insert_tree, k->loc), t1(n), t2(t) { }
+
+  Tree* name() const { return t1; }
+  Tree* expr() const { return t2; }
+
+  Tree* t1;
+  Tree* t2;
+};
+
+struct Csv_tree : Tree {
+  static constexpr Node_kind node_kind = csv_tree;
+
+  Csv_tree(const Token* k, Tree* p, Tree* t)
+    : Tree(csv_tree, k->loc), t1(p), t2(t) { }
+
+  Tree* path() const { return t1; }
+  Tree* type() const { return t2; }
+
+  Tree* t1;
+  Tree* t2;
+};
+
 struct Typeof_tree : Tree {
+  static constexpr Node_kind node_kind = typeof_tree;
+
   Typeof_tree(const Token* k, Tree* t)
     : Tree(typeof_tree, k->loc), t1(t) { }
 
@@ -230,6 +327,8 @@ struct Typeof_tree : Tree {
 // the form 'x=t'. This is used to represent both tuples and 
 // records, and their corresponding types.
 struct Tuple_tree : Tree {
+  static constexpr Node_kind node_kind = tuple_tree;
+
   Tuple_tree(const Token* k, Tree_seq* ts)
     : Tree(tuple_tree, k->loc), t1(ts) { }
 
@@ -241,6 +340,8 @@ struct Tuple_tree : Tree {
 // A list of the form '[t1, ..., tn]' where each 'ti' is simply
 // some other term.
 struct List_tree : Tree {
+  static constexpr Node_kind node_kind = list_tree;
+
   List_tree(const Token* k, Tree_seq* ts)
     : Tree(list_tree, k->loc), t1(ts) { }
 
@@ -249,18 +350,61 @@ struct List_tree : Tree {
   Tree_seq* t1;
 };
 
-// A sql statement of form select t1 from t2 where t3 
+// A sql statement of form select t1 from t2 where t3, optionally
+// followed by group by t4. When t4 is null, the rows are not grouped.
 struct Select_tree : Tree {
-  Select_tree(const Token* k, Tree* t1, Tree* t2, Tree* t3) 
-    : Tree(select_tree, k->loc), t1(t1), t2(t2), t3(t3) { }
+  static constexpr Node_kind node_kind = select_tree;
+
+  Select_tree(const Token* k, Tree* t1, Tree* t2, Tree* t3, Tree* t4 = nullptr)
+    : Tree(select_tree, k->loc), t1(t1), t2(t2), t3(t3), t4(t4) { }
 
   Tree* t1;
   Tree* t2;
   Tree* t3;
+  Tree* t4;
+};
+
+// An aggregate f t in the projection list of a grouped selection,
+// where f is one of count, sum, min, or max. The token k is the name
+// of the aggregate.
+struct Agg_tree : Tree {
+  static constexpr Node_kind node_kind = agg_tree;
+
+  Agg_tree(const Token* k, Tree* t)
+    : Tree(agg_tree, k->loc), t0(k), t1(t) { }
+
+  const Token* op() const { return t0; }
+  Tree* column() const { return t1; }
+
+  const Token* t0;
+  Tree* t1;
+};
+
+bool is_aggregate_name(String);
+
+// A selection t1 followed by order by t2 [asc|desc], limit t3, or both.
+// When t2 is null, the rows are not ordered, and when t3 is null, they
+// are not limited. When desc is true, the rows are in descending order.
+struct Order_tree : Tree {
+  static constexpr Node_kind node_kind = order_tree;
+
+  Order_tree(Tree* t1, Tree* t2, bool desc, Tree* t3)
+    : Tree(order_tree, t1->loc), t1(t1), t2(t2), t3(t3), desc(desc) { }
+
+  Tree* select() const { return t1; }
+  Tree* key() const { return t2; }
+  Tree* limit() const { return t3; }
+
+  Tree* t1;
+  Tree* t2;
+  Tree* t3;
+  bool desc;
 };
 
 // A sql statement of form t1 join t2 on t3
 struct Join_on_tree : Tree {
+  static constexpr Node_kind node_kind = join_on_tree;
+
   Join_on_tree(const Token* k, Tree* t1, Tree* t2, Tree* t3)
     : Tree(join_on_tree, k->loc), t1(t1), t2(t2), t3(t3) { }
 
@@ -271,6 +415,8 @@ struct Join_on_tree : Tree {
 
 // A sql statement of form t1 union t2
 struct Union_tree : Tree {
+  static constexpr Node_kind node_kind = union_tree;
+
   Union_tree(Tree* t1, Tree* t2)
     : Tree(union_tree, t1->loc), t1(t1), t2(t2) { }
 
@@ -280,6 +426,8 @@ struct Union_tree : Tree {
 
 // A sql statement of form t1 intersect t2
 struct Intersect_tree : Tree {
+  static constexpr Node_kind node_kind = intersect_tree;
+
   Intersect_tree(Tree* t1, Tree* t2)
     : Tree(intersect_tree, t1->loc), t1(t1), t2(t2) { }
 
@@ -289,6 +437,8 @@ struct Intersect_tree : Tree {
 
 // A sql statement of form t2 except t2
 struct Except_tree : Tree {
+  static constexpr Node_kind node_kind = except_tree;
+
   Except_tree(Tree* t1, Tree* t2)
     : Tree(except_tree, t1->loc), t1(t1), t2(t2) { }
 
@@ -302,6 +452,8 @@ struct Except_tree : Tree {
 // TODO: Can we allow arbitrary terms? <true, 0> as if the
 // variant type were of the form <0=true, 1=0>?
 struct Variant_tree : Tree {
+  static constexpr Node_kind node_kind = variant_tree;
+
   Variant_tree(const Token* k, Tree_seq* ts)
     : Tree(variant_tree, k->loc), t1(ts) { }
 
@@ -312,6 +464,8 @@ struct Variant_tree : Tree {
 
 // A comma-separated sequence of terms.
 struct Comma_tree : Tree {
+  static constexpr Node_kind node_kind = comma_tree;
+
   Comma_tree(const Token* k, Tree_seq* ts)
     : Tree(comma_tree, k->loc), t1(ts) { }
 
@@ -322,6 +476,8 @@ struct Comma_tree : Tree {
 
 // An expression of the form 't1.t2'.
 struct Dot_tree : Tree {
+  static constexpr Node_kind node_kind = dot_tree;
+
   Dot_tree(Tree* t1, Tree* t2)
     : Tree(dot_tree, t1->loc), t1(t1), t2(t2) { }
 
@@ -334,6 +490,8 @@ struct Dot_tree : Tree {
 
 // A complete program.
 struct Prog_tree : Tree {
+  static constexpr Node_kind node_kind = prog_tree;
+
   Prog_tree(Tree_seq* ts)
     : Tree(prog_tree, no_location), t1(ts) { }
   
@@ -344,6 +502,8 @@ struct Prog_tree : Tree {
 
 // t1 and t2
 struct And_tree : Tree {
+  static constexpr Node_kind node_kind = and_tree;
+
   And_tree(Tree* t1, Tree* t2)
     : Tree(and_tree, t1->loc), t1(t1), t2(t2) { }
 
@@ -353,6 +513,8 @@ struct And_tree : Tree {
 
 // t1 or t2
 struct Or_tree : Tree {
+  static constexpr Node_kind node_kind = or_tree;
+
   Or_tree(Tree* t1, Tree* t2)
     : Tree(or_tree, t1->loc), t1(t1), t2(t2) { }
 
@@ -362,6 +524,8 @@ struct Or_tree : Tree {
 
 // not t1
 struct Not_tree : Tree {
+  static constexpr Node_kind node_kind = not_tree;
+
   Not_tree(const Token* k, Tree* t)
     : Tree(not_tree, k->loc), t1(t) { }
 
@@ -370,6 +534,8 @@ struct Not_tree : Tree {
 
 // t1 == t2
 struct Eq_comp_tree : Tree {
+  static constexpr Node_kind node_kind = eq_comp_tree;
+
   Eq_comp_tree(Tree* t1, Tree* t2)
     : Tree(eq_comp_tree, t1->loc), t1(t1), t2(t2) { }
 
@@ -379,6 +545,8 @@ struct Eq_comp_tree : Tree {
 
 // t1 < t2
 struct Less_tree : Tree {
+  static constexpr Node_kind node_kind = less_tree;
+
   Less_tree(Tree* t1, Tree* t2)
     : Tree(less_tree, t1->loc), t1(t1), t2(t2) { }
 
@@ -0,0 +1,393 @@
+
+#include "table.hpp"
+#include "type.hpp"
+#include "value.hpp"
+
+#include "lang/debug.hpp"
+
+#include <algorithm>
+#include <mutex>
+
+namespace {
+
+// Indexes may be built by concurrent evaluations (see sched.hpp), and
+// so the indexes of all tables are guarded by a mutex.
+std::mutex index_mutex_;
+
+using Index_lock = std::lock_guard<std::mutex>;
+
+// Returns the string naming the column declared by n.
+inline String
+get_column_name(Name* n) {
+  Id* id = as<Id>(n);
+  lang_assert(id, format("ill-formed column name '{}'", pretty(n)));
+  return id->t1;
+}
+
+// Returns the string naming the member variable v.
+inline String
+get_column_name(Term* v) { return get_column_name(as<Var>(v)->name()); }
+
+} // namespace
+
+// Returns the record type of the rows of a list of records, or
+// nullptr if t is not a list of records.
+Record_type*
+get_row_type(Type* t) {
+  if (List_type* l = as<List_type>(t))
+    return as<Record_type>(l->type());
+  return nullptr;
+}
+
+// Returns the record type of the rows of the table t.
+Record_type*
+get_row_type(Table* t) {
+  return get_row_type(get_type(t));
+}
+
+// Construct a table of type t having n rows from the given columns.
+// The columns must be in the order of the members of the row type.
+// If the row type has multiple members with the same name, the
+// first is found by name.
+Table*
+make_table(Type* t, Column_seq* cols, std::size_t n) {
+  Record_type* rt = get_row_type(t);
+  lang_assert(rt, format("'{}' is not a table type", pretty(t)));
+  Term_seq* vars = rt->members();
+  lang_assert(vars->size() == cols->size(), "wrong number of table columns");
+
+  Column_map* names = new Column_map();
+  names->reserve(vars->size());
+  for (std::size_t i = 0; i < vars->size(); ++i)
+    names->emplace(get_column_name((*vars)[i]), i);
+  return new Table(t, cols, names, n);
+}
+
+// Construct a table from a list of records. Each column is populated
+// with the values of the corresponding member of each record.
+Table*
+make_table(List* t) {
+  Type* type = get_type(t);
+  Record_type* rt = get_row_type(type);
+  lang_assert(rt, format("'{}' is not a list of records", pretty(t)));
+
+  Term_seq* rows = t->elems();
+  Column_seq* cols = new Column_seq();
+  cols->reserve(rt->members()->size());
+  for (std::size_t i = 0; i < rt->members()->size(); ++i) {
+    cols->push_back(new Term_seq());
+    cols->back()->reserve(rows->size());
+  }
+
+  Table* table = make_table(type, cols, rows->size());
+  for (Term* r : *rows) {
+    for (Term* m : *as<Record>(r)->members()) {
+      Init* init = as<Init>(m);
+      auto iter = table->names()->find(get_column_name(init->name()));
+      lang_assert(iter != table->names()->end(), 
+                  format("no column named '{}'", pretty(init->name())));
+      (*cols)[iter->second]->push_back(as<Term>(init->value()));
+    }
+  }
+  return table;
+}
+
+// Construct a table of type t having no rows.
+Table*
+make_table(Type* t) {
+  Record_type* rt = get_row_type(t);
+  lang_assert(rt, format("'{}' is not a table type", pretty(t)));
+  Column_seq* cols = new Column_seq();
+  cols->reserve(rt->members()->size());
+  for (std::size_t i = 0; i < rt->members()->size(); ++i)
+    cols->push_back(new Term_seq());
+  return make_table(t, cols, 0);
+}
+
+// Destroy the table, releasing its column sequence, column map,
+// and indexes.
+Table::~Table() {
+  if (t4) {
+    for (Column_index& i : *t4) {
+      delete i.hash;
+      delete i.sorted;
+      delete i.packed;
+    }
+  }
+  delete t4;
+  delete t2;
+  delete t1;
+}
+
+// Returns the index of the column of t named n, or no_column if there
+// is no such column.
+std::size_t
+find_column_index(Table* t, Name* n) {
+  auto iter = t->names()->find(get_column_name(n));
+  if (iter == t->names()->end())
+    return no_column;
+  return iter->second;
+}
+
+// Returns the column of t named n, or nullptr if there is no
+// such column.
+Term_seq*
+find_column(Table* t, Name* n) {
+  std::size_t i = find_column_index(t, n);
+  if (i == no_column)
+    return nullptr;
+  return (*t->columns())[i];
+}
+
+// Returns the ith row of the table t as a record.
+Record*
+get_row(Table* t, std::size_t i) {
+  Record_type* rt = get_row_type(t);
+  Term_seq* vars = rt->members();
+  Term_seq* members = new Term_seq();
+  members->reserve(vars->size());
+  for (std::size_t j = 0; j < vars->size(); ++j) {
+    Var* v = as<Var>((*vars)[j]);
+    Term* val = (*(*t->columns())[j])[i];
+    members->push_back(new Init(v->type(), v->name(), val));
+  }
+  return new Record(rt, members);
+}
+
+// Returns the rows of the table t as a sequence of records.
+Term_seq*
+get_rows(Table* t) {
+  Term_seq* rows = new Term_seq();
+  rows->reserve(t->rows());
+  for (std::size_t i = 0; i < t->rows(); ++i)
+    rows->push_back(get_row(t, i));
+  return rows;
+}
+
+
+// -------------------------------------------------------------------------- //
+// Indexes
+
+namespace {
+
+// Returns the indexes of the ith column of t, allocating the indexes
+// of the table if necessary.
+Column_index&
+get_column_index(Table* t, std::size_t i) {
+  if (not t->indexes())
+    t->t4 = new Index_seq(t->columns()->size(), Column_index {nullptr, nullptr, nullptr});
+  return (*t->indexes())[i];
+}
+
+// Orders rows of a column by their value.
+struct Row_less {
+  bool operator()(std::size_t a, std::size_t b) const {
+    return is_less((*col)[a], (*col)[b]);
+  }
+  Term_seq* col;
+};
+
+// Compares the value of a row of a column with a value.
+struct Row_value_less {
+  bool operator()(std::size_t a, Term* v) const { return is_less((*col)[a], v); }
+  bool operator()(Term* v, std::size_t a) const { return is_less(v, (*col)[a]); }
+  Term_seq* col;
+};
+
+// Returns the rows in [first, last) in ascending order.
+template<typename I>
+  inline Row_seq
+  sorted_rows(I first, I last) {
+    Row_seq rows(first, last);
+    std::sort(rows.begin(), rows.end());
+    return rows;
+  }
+
+} // namespace
+
+// Returns the hash index on the ith column of t, or nullptr if no
+// such index has been built.
+Hash_index*
+find_hash_index(Table* t, std::size_t i) {
+  Index_lock lock(index_mutex_);
+  if (not t->indexes())
+    return nullptr;
+  return (*t->indexes())[i].hash;
+}
+
+// Returns the hash index on the ith column of t, building it if
+// necessary.
+Hash_index*
+make_hash_index(Table* t, std::size_t i) {
+  Index_lock lock(index_mutex_);
+  Column_index& ci = get_column_index(t, i);
+  if (ci.hash)
+    return ci.hash;
+
+  Term_seq* col = (*t->columns())[i];
+  Hash_index* index = new Hash_index();
+  index->reserve(col->size());
+  for (std::size_t r = 0; r < col->size(); ++r)
+    (*index)[(*col)[r]].push_back(r);
+  return ci.hash = index;
+}
+
+// Returns the sorted index on the ith column of t, or nullptr if no
+// such index has been built.
+Sorted_index*
+find_sorted_index(Table* t, std::size_t i) {
+  Index_lock lock(index_mutex_);
+  if (not t->indexes())
+    return nullptr;
+  return (*t->indexes())[i].sorted;
+}
+
+// Returns the sorted index on the ith column of t, building it if
+// necessary.
+Sorted_index*
+make_sorted_index(Table* t, std::size_t i) {
+  Index_lock lock(index_mutex_);
+  Column_index& ci = get_column_index(t, i);
+  if (ci.sorted)
+    return ci.sorted;
+
+  Term_seq* col = (*t->columns())[i];
+  Sorted_index* index = new Sorted_index();
+  index->resize(col->size());
+  for (std::size_t r = 0; r < col->size(); ++r)
+    (*index)[r] = r;
+  std::stable_sort(index->begin(), index->end(), Row_less {col});
+  return ci.sorted = index;
+}
+
+// Returns the packed form of the ith column of t, packing it if
+// necessary. The kind of the result is pack_none when the column holds
+// values other than booleans and natural numbers that fit in a word.
+Packed_column*
+make_packed_column(Table* t, std::size_t i) {
+  Index_lock lock(index_mutex_);
+  Column_index& ci = get_column_index(t, i);
+  if (ci.packed)
+    return ci.packed;
+
+  Term_seq* col = (*t->columns())[i];
+  Packed_column* packed = new Packed_column {pack_none, {}};
+  if (not col->empty()) {
+    Term* v = col->front();
+    if (is<Int>(v))
+      packed->kind = pack_nat;
+    else if (is_true(v) or is_false(v))
+      packed->kind = pack_bool;
+  }
+  packed->words.resize(col->size());
+  for (std::size_t r = 0; r < col->size() and packed->kind != pack_none; ++r) {
+    Term* v = (*col)[r];
+    if (packed->kind == pack_nat) {
+      Int* n = as<Int>(v);
+      if (n and n->value().is_small())
+        packed->words[r] = n->value().word();
+      else
+        packed->kind = pack_none;
+    } else {
+      if (is_true(v))
+        packed->words[r] = 1;
+      else if (is_false(v))
+        packed->words[r] = 0;
+      else
+        packed->kind = pack_none;
+    }
+  }
+  if (packed->kind == pack_none)
+    packed->words.clear();
+  return ci.packed = packed;
+}
+
+// Returns the rows of t whose value in the ith column is less than v,
+// in ascending order.
+Row_seq
+find_rows_less(Table* t, std::size_t i, Term* v) {
+  Sorted_index* index = make_sorted_index(t, i);
+  Row_value_less cmp {(*t->columns())[i]};
+  auto last = std::lower_bound(index->begin(), index->end(), v, cmp);
+  return sorted_rows(index->begin(), last);
+}
+
+// Returns the rows of t whose value in the ith column is greater than
+// v, in ascending order.
+Row_seq
+find_rows_greater(Table* t, std::size_t i, Term* v) {
+  Sorted_index* index = make_sorted_index(t, i);
+  Row_value_less cmp {(*t->columns())[i]};
+  auto first = std::upper_bound(index->begin(), index->end(), v, cmp);
+  return sorted_rows(first, index->end());
+}
+
+// Returns the rows of t whose value in the ith column is greater than
+// v1 and less than v2, in ascending order.
+Row_seq
+find_rows_between(Table* t, std::size_t i, Term* v1, Term* v2) {
+  Sorted_index* index = make_sorted_index(t, i);
+  Row_value_less cmp {(*t->columns())[i]};
+  auto first = std::upper_bound(index->begin(), index->end(), v1, cmp);
+  auto last = std::lower_bound(first, index->end(), v2, cmp);
+  return sorted_rows(first, last);
+}
+
+// Returns a table containing the given rows of t.
+Table*
+select_rows(Table* t, const Row_seq& rows) {
+  Column_seq* cols = new Column_seq();
+  cols->reserve(t->columns()->size());
+  for (Term_seq* c : *t->columns()) {
+    Term_seq* col = new Term_seq();
+    col->reserve(rows.size());
+    for (std::size_t i : rows)
+      col->push_back((*c)[i]);
+    cols->push_back(col);
+  }
+  return make_table(get_type(t), cols, rows.size());
+}
+
+
+// -------------------------------------------------------------------------- //
+// Appending rows
+
+// Returns a table having the rows of t, whose columns are its own.
+Table*
+copy_table(Table* t) {
+  Column_seq* cols = new Column_seq();
+  cols->reserve(t->columns()->size());
+  for (Term_seq* c : *t->columns())
+    cols->push_back(new Term_seq(*c));
+  return make_table(get_type(t), cols, t->rows());
+}
+
+// Append the rows [first, last) of s to t, whose columns must not be
+// shared with another table. The tables have the same type.
+void
+append_rows(Table* t, Table* s, std::size_t first, std::size_t last) {
+  lang_assert(get_type(t) == get_type(s), "appending rows of another type");
+  Index_lock lock(index_mutex_);
+  std::size_t n = t->rows();
+  for (std::size_t i = 0; i < t->columns()->size(); ++i) {
+    Term_seq* col = (*t->columns())[i];
+    Term_seq* src = (*s->columns())[i];
+    col->insert(col->end(), src->begin() + first, src->begin() + last);
+  }
+  t->t3 = n + (last - first);
+
+  if (not t->indexes())
+    return;
+  for (std::size_t i = 0; i < t->indexes()->size(); ++i) {
+    Column_index& ci = (*t->indexes())[i];
+    if (ci.hash) {
+      Term_seq* col = (*t->columns())[i];
+      for (std::size_t r = n; r < t->rows(); ++r)
+        (*ci.hash)[(*col)[r]].push_back(r);
+    }
+    delete ci.sorted;
+    delete ci.packed;
+    ci.sorted = nullptr;
+    ci.packed = nullptr;
+  }
+}
@@ -0,0 +1,123 @@
+
+#ifndef TABLE_HPP
+#define TABLE_HPP
+
+#include "ast.hpp"
+
+#include <unordered_set>
+
+// -------------------------------------------------------------------------- //
+// Tables
+//
+// This module provides support for constructing and querying tables,
+// the columnar representation of lists of records. A list of records
+// is converted to a table when it is evaluated. Columns are shared
+// between tables wherever possible, so that projecting a column is
+// a matter of handing off a pointer rather than copying its values.
+
+Record_type* get_row_type(Type*);
+Record_type* get_row_type(Table*);
+
+Table* make_table(Type*, Column_seq*, std::size_t);
+Table* make_table(List*);
+Table* make_table(Type*);
+
+// The column index returned when a table has no such column.
+constexpr std::size_t no_column = -1;
+
+std::size_t find_column_index(Table*, Name*);
+Term_seq* find_column(Table*, Name*);
+Record* get_row(Table*, std::size_t);
+Term_seq* get_rows(Table*);
+
+
+// -------------------------------------------------------------------------- //
+// Indexes
+
+// A sequence of row numbers.
+using Row_seq = std::vector<std::size_t>;
+
+// Indexes are built on the columns of a table on demand, and are
+// cached with the table. Because the value of a definition is stored
+// in the definition (see eval_def), the indexes of a table bound by
+// 'def' persist for the remainder of the program, and are shared by
+// every query over that table.
+
+// A hash index maps each distinct value of a column to the rows in
+// which it occurs, in ascending order.
+struct Hash_index : std::unordered_map<Term*, Row_seq, Expr_hash, Expr_eq> { };
+
+// A sorted index orders the rows of a table by the values of a column.
+// Rows having the same value are in ascending order.
+struct Sorted_index : Row_seq { };
+
+// A packed column holds the values of a column of natural numbers or
+// booleans as machine words (true is 1 and false is 0), so that
+// conditions on the column can be tested for many rows at once (see
+// query.hpp). A column is packed only if every value fits in a word.
+enum Pack_kind {
+  pack_none, // The column cannot be packed
+  pack_nat,  // The column holds natural numbers
+  pack_bool, // The column holds booleans
+};
+
+struct Packed_column {
+  Pack_kind kind;
+  std::vector<long> words;
+};
+
+// The indexes built on a column of a table.
+struct Column_index {
+  Hash_index* hash;
+  Sorted_index* sorted;
+  Packed_column* packed;
+};
+
+Hash_index* find_hash_index(Table*, std::size_t);
+Hash_index* make_hash_index(Table*, std::size_t);
+Sorted_index* find_sorted_index(Table*, std::size_t);
+Sorted_index* make_sorted_index(Table*, std::size_t);
+Packed_column* make_packed_column(Table*, std::size_t);
+
+Row_seq find_rows_less(Table*, std::size_t, Term*);
+Row_seq find_rows_greater(Table*, std::size_t, Term*);
+Row_seq find_rows_between(Table*, std::size_t, Term*, Term*);
+
+Table* select_rows(Table*, const Row_seq&);
+
+// A reference to a row of a table. Rows are hashed and compared in
+// place, without being materialized as records. The hash of each row
+// is computed once.
+struct Row_ref {
+  Table* table;
+  std::size_t i;
+  std::size_t hash;
+};
+
+struct Row_hash {
+  std::size_t operator()(Row_ref r) const { return r.hash; }
+};
+
+struct Row_eq {
+  bool operator()(Row_ref a, Row_ref b) const {
+    return a.hash == b.hash and is_same_row(a.table, a.i, b.table, b.i);
+  }
+};
+
+using Row_set = std::unordered_set<Row_ref, Row_hash, Row_eq>;
+
+
+// -------------------------------------------------------------------------- //
+// Appending rows
+//
+// The columns of a table are usually shared with other tables (e.g.,
+// by projections), so tables are not modified once they are made. A
+// copy of a table has columns of its own, and can be extended with new
+// rows in place. The hash indexes cached with that table are extended
+// with the new rows; its other indexes are discarded, and are built
+// again when they are next needed.
+
+Table* copy_table(Table*);
+void append_rows(Table*, Table*, std::size_t, std::size_t);
+
+#endif
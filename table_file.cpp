@@ -0,0 +1,787 @@
+#include "table_file.hpp"
+#include "table.hpp"
+#include "type.hpp"
+#include "value.hpp"
+
+#include "lang/arena.hpp"
+#include "lang/debug.hpp"
+#include "lang/mapped_file.hpp"
+
+#include <algorithm>
+#include <climits>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <future>
+#include <mutex>
+#include <unordered_map>
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+// The file begins with a header containing the magic string, the
+// version of the format, the number of columns, and the number of
+// rows. The header is followed by a directory entry for each column,
+// giving the kind of the column, the size and offset of its name, the
+// offset of its cells and, for string columns, the offset and size of
+// its dictionary. The names and cells of the columns follow the
+// directory. All values are little-endian, and the cells of each
+// column start on an 8-byte boundary.
+//
+// Each string in a dictionary is written as its 4-byte size followed
+// by its characters. The cells of a string column are 4-byte indexes
+// into the dictionary of that column.
+//
+// A numeric column holding a value that does not fit in 63 bits is
+// written as a wide column instead. A wide column has the layout of a
+// string column, whose dictionary holds the decimal digits of each
+// distinct value of the column.
+
+namespace {
+
+const char magic[8] = {'w', 'a', 'f', 'f', 'l', 'e', 't', 'f'};
+
+constexpr std::size_t header_size = sizeof(magic) + 4 + 4 + 8;
+constexpr std::size_t entry_size = 4 + 4 + 8 + 8 + 8 + 8;
+
+// The kinds of column, determined by the type of their values.
+enum Column_kind : std::uint32_t {
+  no_column_kind = 0,
+  bool_column = 1,
+  nat_column = 2,
+  str_column = 3,
+  wide_nat_column = 4,
+};
+
+// Returns true if columns of kind k have a dictionary.
+inline bool
+has_dict(Column_kind k) { return k == str_column or k == wide_nat_column; }
+
+// The size of each cell (in bytes) of a column of kind k.
+inline std::size_t
+get_cell_size(Column_kind k) {
+  switch (k) {
+  case bool_column: return 1;
+  case nat_column: return 8;
+  case str_column: return 4;
+  case wide_nat_column: return 4;
+  default: break;
+  }
+  return 0;
+}
+
+// Returns the kind of a column whose values have type t.
+inline Column_kind
+get_column_kind(Type* t) {
+  if (is_bool_type(t))
+    return bool_column;
+  if (is_nat_type(t))
+    return nat_column;
+  if (is_str_type(t))
+    return str_column;
+  return no_column_kind;
+}
+
+// Returns the type of the values of a column of kind k.
+inline Type*
+get_column_type(Column_kind k) {
+  switch (k) {
+  case bool_column: return get_bool_type();
+  case nat_column: return get_nat_type();
+  case wide_nat_column: return get_nat_type();
+  case str_column: return get_str_type();
+  default: break;
+  }
+  return nullptr;
+}
+
+// Append the n byte little-endian representation of v to s.
+inline void
+put_fixed(std::string& s, std::uint64_t v, int n) {
+  for (int i = 0; i < n; ++i)
+    s += char((v >> (8 * i)) & 0xff);
+}
+
+// Overwrite the n bytes of s at pos with the little-endian
+// representation of v.
+inline void
+set_fixed(std::string& s, std::size_t pos, std::uint64_t v, int n) {
+  for (int i = 0; i < n; ++i)
+    s[pos + i] = char((v >> (8 * i)) & 0xff);
+}
+
+// Returns the n byte little-endian value at p.
+inline std::uint64_t
+get_fixed(const char* p, int n) {
+  std::uint64_t v = 0;
+  for (int i = 0; i < n; ++i)
+    v |= std::uint64_t((unsigned char)p[i]) << (8 * i);
+  return v;
+}
+
+// Pad s with zeros to a multiple of n bytes.
+inline void
+align(std::string& s, std::size_t n) {
+  s.resize((s.size() + n - 1) / n * n, '\0');
+}
+
+// -------------------------------------------------------------------------- //
+// Writing
+
+// Write the cells of a boolean column.
+bool
+write_bool_column(std::string& s, Term_seq* col) {
+  for (Term* v : *col) {
+    if (is_true(v))
+      s += '\1';
+    else if (is_false(v))
+      s += '\0';
+    else
+      return false;
+  }
+  return true;
+}
+
+// Returns true if each value of the numeric column col fits in the
+// cells of a numeric column.
+bool
+is_narrow_column(Term_seq* col) {
+  for (Term* v : *col) {
+    Int* n = as<Int>(v);
+    if (n and not (n->value().is_small() and n->value().word() >= 0))
+      return false;
+  }
+  return true;
+}
+
+// Write the cells of a numeric column, whose values are narrow (see
+// is_narrow_column).
+bool
+write_nat_column(std::string& s, Term_seq* col) {
+  for (Term* v : *col) {
+    Int* n = as<Int>(v);
+    if (not n)
+      return false;
+    put_fixed(s, n->value().word(), 8);
+  }
+  return true;
+}
+
+// Write the dictionary strs, and then the cells codes, of a column.
+// The offset of the cells is stored in cells, and the offset and size
+// of the dictionary are stored in dict and count.
+void
+write_dict_column(std::string& s, const std::vector<String>& strs,
+                  const std::vector<std::uint32_t>& codes, std::uint64_t& cells,
+                  std::uint64_t& dict, std::uint64_t& count) {
+  dict = s.size();
+  count = strs.size();
+  for (String str : strs) {
+    put_fixed(s, str.size(), 4);
+    s.append(str.data(), str.size());
+  }
+  align(s, 8);
+  cells = s.size();
+  for (std::uint32_t k : codes)
+    put_fixed(s, k, 4);
+}
+
+// Write a string column (see write_dict_column).
+bool
+write_str_column(std::string& s, Term_seq* col, std::uint64_t& cells,
+                 std::uint64_t& dict, std::uint64_t& count) {
+  std::unordered_map<const void*, std::uint32_t> index;
+  std::vector<String> strs;
+  std::vector<std::uint32_t> codes;
+  codes.reserve(col->size());
+  for (Term* v : *col) {
+    Str* str = as<Str>(v);
+    if (not str)
+      return false;
+    auto ins = index.emplace(str->value().ptr(), strs.size());
+    if (ins.second)
+      strs.push_back(str->value());
+    codes.push_back(ins.first->second);
+  }
+  write_dict_column(s, strs, codes, cells, dict, count);
+  return true;
+}
+
+// Write a wide numeric column, whose dictionary holds the digits of
+// its values (see write_dict_column).
+bool
+write_wide_nat_column(std::string& s, Term_seq* col, std::uint64_t& cells,
+                      std::uint64_t& dict, std::uint64_t& count) {
+  std::unordered_map<Integer, std::uint32_t> index;
+  std::vector<String> strs;
+  std::vector<std::uint32_t> codes;
+  codes.reserve(col->size());
+  for (Term* v : *col) {
+    Int* n = as<Int>(v);
+    if (not n)
+      return false;
+    auto ins = index.emplace(n->value(), strs.size());
+    if (ins.second)
+      strs.push_back(String(to_string(n->value())));
+    codes.push_back(ins.first->second);
+  }
+  write_dict_column(s, strs, codes, cells, dict, count);
+  return true;
+}
+
+// -------------------------------------------------------------------------- //
+// Reading
+
+// A column, as described by the directory of a table file.
+struct Column_entry {
+  Column_kind   kind;
+  String        name;
+  std::uint64_t cells; // The offset of the cells
+  std::uint64_t dict;  // The offset of the dictionary
+  std::uint64_t count; // The number of strings in the dictionary
+};
+
+// The schema of a table file.
+struct Schema {
+  std::uint64_t rows;
+  std::vector<Column_entry> cols;
+};
+
+// Returns true if the n bytes at offset pos are within the file f.
+inline bool
+contains(const Mapped_file& f, std::uint64_t pos, std::uint64_t n) {
+  return pos <= f.size and n <= f.size - pos;
+}
+
+// Read the header and directory of the table file f. Returns false if
+// f is not a table file, or if the cells of a column are not within
+// the file.
+bool
+read_schema(const Mapped_file& f, Schema& s) {
+  const char* p = f.first;
+  if (f.size < header_size
+      or std::memcmp(p, magic, sizeof(magic)) != 0
+      or get_fixed(p + sizeof(magic), 4) != table_file_version)
+    return false;
+  std::uint64_t n = get_fixed(p + sizeof(magic) + 4, 4);
+  s.rows = get_fixed(p + sizeof(magic) + 8, 8);
+  if (not contains(f, header_size, n * entry_size))
+    return false;
+
+  s.cols.resize(n);
+  for (std::size_t i = 0; i < n; ++i) {
+    const char* e = p + header_size + i * entry_size;
+    Column_entry& c = s.cols[i];
+    c.kind = Column_kind(get_fixed(e, 4));
+    std::uint64_t size = get_fixed(e + 4, 4);
+    std::uint64_t name = get_fixed(e + 8, 8);
+    c.cells = get_fixed(e + 16, 8);
+    c.dict = get_fixed(e + 24, 8);
+    c.count = get_fixed(e + 32, 8);
+
+    std::size_t cell = get_cell_size(c.kind);
+    if (cell == 0 or size == 0 or not contains(f, name, size))
+      return false;
+    if (s.rows > f.size / cell or not contains(f, c.cells, s.rows * cell))
+      return false;
+    if (has_dict(c.kind)
+        and (c.count > f.size / 4 or not contains(f, c.dict, c.count * 4)))
+      return false;
+    c.name = String(p + name, size);
+  }
+  return true;
+}
+
+// Returns the table type described by the schema s.
+Type*
+get_table_type(const Schema& s) {
+  Term_seq* vars = new Term_seq();
+  vars->reserve(s.cols.size());
+  for (const Column_entry& c : s.cols)
+    vars->push_back(new Var(new Id(c.name), get_column_type(c.kind)));
+  return get_list_type(get_record_type(vars));
+}
+
+// Read the cells [first, last) of a boolean column.
+Term_seq*
+read_bool_column(const Mapped_file& f, const Column_entry& c,
+                 std::uint64_t first, std::uint64_t last) {
+  Term_seq* col = new Term_seq();
+  col->reserve(last - first);
+  const char* p = f.first + c.cells;
+  for (std::uint64_t i = first; i < last; ++i) {
+    switch (p[i]) {
+    case 0: col->push_back(get_false()); break;
+    case 1: col->push_back(get_true()); break;
+    default: return nullptr;
+    }
+  }
+  return col;
+}
+
+// Read the cells [first, last) of a numeric column.
+Term_seq*
+read_nat_column(const Mapped_file& f, const Column_entry& c,
+                std::uint64_t first, std::uint64_t last) {
+  Type* nat = get_nat_type();
+  Term_seq* col = new Term_seq();
+  col->reserve(last - first);
+  const char* p = f.first + c.cells;
+  for (std::uint64_t i = first; i < last; ++i) {
+    std::uint64_t n = get_fixed(p + i * 8, 8);
+    if (n > LONG_MAX)
+      return nullptr;
+    col->push_back(new Int(nat, Integer(long(n))));
+  }
+  return col;
+}
+
+// Read the dictionary of a string column into strs.
+bool
+read_dict(const Mapped_file& f, const Column_entry& c, std::vector<String>& strs) {
+  strs.reserve(c.count);
+  std::uint64_t pos = c.dict;
+  for (std::uint64_t i = 0; i < c.count; ++i) {
+    if (not contains(f, pos, 4))
+      return false;
+    std::uint64_t n = get_fixed(f.first + pos, 4);
+    if (not contains(f, pos + 4, n))
+      return false;
+    strs.push_back(String(f.first + pos + 4, n));
+    pos += 4 + n;
+  }
+  return true;
+}
+
+// Read the cells [first, last) of a wide numeric column, whose
+// dictionary is strs. Each value of the dictionary is a single node,
+// shared by the rows read having that value.
+Term_seq*
+read_wide_nat_column(const Mapped_file& f, const Column_entry& c,
+                     const std::vector<String>& strs,
+                     std::uint64_t first, std::uint64_t last) {
+  Type* nat = get_nat_type();
+  std::unordered_map<std::uint64_t, Term*> nodes;
+  Term_seq* col = new Term_seq();
+  col->reserve(last - first);
+  const char* p = f.first + c.cells;
+  for (std::uint64_t i = first; i < last; ++i) {
+    std::uint64_t k = get_fixed(p + i * 4, 4);
+    if (k >= strs.size())
+      return nullptr;
+    Term*& node = nodes[k];
+    if (not node) {
+      String digits = strs[k];
+      if (digits.size() == 0
+          or not std::all_of(digits.data(), digits.data() + digits.size(),
+                             [](char c) { return '0' <= c and c <= '9'; }))
+        return nullptr;
+      node = new Int(nat, Integer(digits));
+    }
+    col->push_back(node);
+  }
+  return col;
+}
+
+// Read the cells [first, last) of a string column, whose dictionary is
+// strs. Each string of the dictionary is a single node, shared by the
+// rows read having that string.
+Term_seq*
+read_str_column(const Mapped_file& f, const Column_entry& c,
+                const std::vector<String>& strs,
+                std::uint64_t first, std::uint64_t last) {
+  Type* str = get_str_type();
+  std::unordered_map<std::uint64_t, Term*> nodes;
+  Term_seq* col = new Term_seq();
+  col->reserve(last - first);
+  const char* p = f.first + c.cells;
+  for (std::uint64_t i = first; i < last; ++i) {
+    std::uint64_t k = get_fixed(p + i * 4, 4);
+    if (k >= strs.size())
+      return nullptr;
+    Term*& node = nodes[k];
+    if (not node)
+      node = new Str(str, strs[k]);
+    col->push_back(node);
+  }
+  return col;
+}
+
+// Read the rows [first, last) of the table file f, whose schema is s
+// and whose string columns have the dictionaries dicts. Returns the
+// columns of those rows, or nullptr if a cell is invalid.
+Column_seq*
+read_columns(const Mapped_file& f, const Schema& s,
+             const std::vector<std::vector<String>>& dicts,
+             std::uint64_t first, std::uint64_t last) {
+  Column_seq* cols = new Column_seq();
+  cols->reserve(s.cols.size());
+  for (std::size_t i = 0; i < s.cols.size(); ++i) {
+    const Column_entry& c = s.cols[i];
+    Term_seq* col = nullptr;
+    switch (c.kind) {
+    case bool_column: col = read_bool_column(f, c, first, last); break;
+    case nat_column: col = read_nat_column(f, c, first, last); break;
+    case str_column: col = read_str_column(f, c, dicts[i], first, last); break;
+    case wide_nat_column:
+      col = read_wide_nat_column(f, c, dicts[i], first, last);
+      break;
+    default: break;
+    }
+    if (not col) {
+      delete cols;
+      return nullptr;
+    }
+    cols->push_back(col);
+  }
+  return cols;
+}
+
+// Read the dictionary of each string column of the table file f.
+bool
+read_dicts(const Mapped_file& f, const Schema& s,
+           std::vector<std::vector<String>>& dicts) {
+  dicts.resize(s.cols.size());
+  for (std::size_t i = 0; i < s.cols.size(); ++i) {
+    if (has_dict(s.cols[i].kind) and not read_dict(f, s.cols[i], dicts[i]))
+      return false;
+  }
+  return true;
+}
+
+// Read the table saved in the file at path, which must have type t
+// (see load_table).
+Table*
+read_table(const std::string& path, Type* t) {
+  Mapped_file f;
+  if (not f.open(path.c_str()))
+    return nullptr;
+  Schema s;
+  if (not read_schema(f, s) or get_table_type(s) != t)
+    return nullptr;
+
+  std::vector<std::vector<String>> dicts;
+  if (not read_dicts(f, s, dicts))
+    return nullptr;
+  Column_seq* cols = read_columns(f, s, dicts, 0, s.rows);
+  if (not cols)
+    return nullptr;
+  return make_table(t, cols, s.rows);
+}
+
+// -------------------------------------------------------------------------- //
+// Preloading
+
+// The identity of a file, which changes when the file is written (even
+// under a temporary name that is renamed, as save_table does).
+struct File_id {
+  bool operator==(const File_id& x) const {
+    return dev == x.dev and ino == x.ino and size == x.size
+       and sec == x.sec and nsec == x.nsec;
+  }
+
+  dev_t dev = 0;
+  ino_t ino = 0;
+  off_t size = -1;
+  time_t sec = 0;
+  long nsec = 0;
+};
+
+// Returns the identity of the file at path, or the empty identity if
+// there is no such file.
+File_id
+get_file_id(const std::string& path) {
+  File_id id;
+  struct stat st;
+  if (::stat(path.c_str(), &st) != 0)
+    return id;
+  id.dev = st.st_dev;
+  id.ino = st.st_ino;
+  id.size = st.st_size;
+  id.sec = st.st_mtim.tv_sec;
+  id.nsec = st.st_mtim.tv_nsec;
+  return id;
+}
+
+// A table read in the background. Its nodes are allocated in its own
+// arena, which lives as long as the program, since the table is used
+// by the evaluation of the program.
+struct Preload {
+  Type* type;
+  Arena arena;
+  File_id id;
+  std::future<Table*> table;
+  bool taken = false;
+};
+
+// True if tables are preloaded.
+bool preload_tables_ = false;
+
+// The tables being preloaded, by path. Preloads belong to the process
+// that started them: a worker process (see worker.hpp) has none of the
+// threads reading them, and reads its tables itself.
+struct Preloader {
+  Preloader() : pid(::getpid()) { }
+
+  void start(const std::string&, Type*);
+  Table* take(const std::string&, Type*);
+
+  std::mutex mutex;
+  std::unordered_map<std::string, std::unique_ptr<Preload>> tables;
+  pid_t pid;
+};
+
+// Start reading the table at path, of type t, unless it is already
+// being read.
+void
+Preloader::start(const std::string& path, Type* t) {
+  if (not preload_tables_ or ::getpid() != pid)
+    return;
+  std::lock_guard<std::mutex> lock(mutex);
+  std::unique_ptr<Preload>& p = tables[path];
+  if (p)
+    return;
+  p.reset(new Preload());
+  p->type = t;
+  Preload* pre = p.get();
+  p->table = std::async(std::launch::async, [pre, path]() -> Table* {
+    // If the file is replaced while it is read, the table is not used.
+    Arena_guard guard(pre->arena);
+    File_id id = get_file_id(path);
+    Table* table = read_table(path, pre->type);
+    if (not (get_file_id(path) == id))
+      return nullptr;
+    pre->id = id;
+    return table;
+  });
+}
+
+// Returns the table preloaded from path, if it has type t, waiting for
+// it to be read. Each preloaded table is returned once. Returns nullptr
+// if the table was not preloaded, or if its file has been written
+// since, or cannot be read.
+Table*
+Preloader::take(const std::string& path, Type* t) {
+  if (::getpid() != pid)
+    return nullptr;
+  Preload* pre;
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto iter = tables.find(path);
+    if (iter == tables.end() or iter->second->taken)
+      return nullptr;
+    pre = iter->second.get();
+    pre->taken = true;
+  }
+  Table* table = pre->table.get();
+  if (table and (pre->type != t or not (get_file_id(path) == pre->id)))
+    return nullptr;
+  return table;
+}
+
+Preloader&
+get_preloader() {
+  static Preloader p;
+  return p;
+}
+
+} // namespace
+
+
+// -------------------------------------------------------------------------- //
+// Files
+
+// Returns the path named by the string literal t. The enclosing quotes
+// are removed, and each escaped character is replaced by that
+// character.
+std::string
+get_file_path(Term* t) {
+  Str* str = as<Str>(t);
+  lang_assert(str, format("'{}' is not a path", pretty(t)));
+  String s = str->value();
+  std::string path;
+  const char* first = s.data() + 1;
+  const char* last = s.data() + s.size() - 1;
+  for (; first < last; ++first) {
+    if (*first == '\\' and first + 1 < last)
+      ++first;
+    path += *first;
+  }
+  return path;
+}
+
+// Returns true if t is a table type that can be saved to a file. Each
+// column must have type Bool, Nat, or Str.
+bool
+is_table_file_type(Type* t) {
+  Record_type* rt = get_row_type(t);
+  if (not rt)
+    return false;
+  for (Term* v : *rt->members()) {
+    if (get_column_kind(as<Var>(v)->type()) == no_column_kind)
+      return false;
+  }
+  return true;
+}
+
+// Returns the type of the table saved in the file at path, or nullptr
+// if there is no such file or if it is not a table file.
+Type*
+load_table_type(const std::string& path) {
+  Mapped_file f;
+  if (not f.open(path.c_str(), false))
+    return nullptr;
+  Schema s;
+  if (not read_schema(f, s))
+    return nullptr;
+  return get_table_type(s);
+}
+
+// Load the table saved in the file at path, which must have type t.
+// If the table was preloaded (see preload_table), and its file has not
+// been written since, the preloaded table is returned. Otherwise, the
+// nodes of the table are allocated in the current arena. Returns
+// nullptr if there is no such file, if it is not a table file, or if
+// the table has a different type.
+Table*
+load_table(const std::string& path, Type* t) {
+  if (Table* table = get_preloader().take(path, t))
+    return table;
+  return read_table(path, t);
+}
+
+// Start loading the table saved in the file at path, which must have
+// type t, in the background, if tables are preloaded. The first load of
+// the table waits for it to be read (see load_table).
+void
+preload_table(const std::string& path, Type* t) {
+  get_preloader().start(path, t);
+}
+
+// Set the preloading of tables. This is set before elaboration starts.
+void
+set_preload_tables(bool b) { preload_tables_ = b; }
+
+// The state of an open table file.
+struct Table_reader::File {
+  Mapped_file map;
+  Schema schema;
+  std::vector<std::vector<String>> dicts;
+  Type* type;
+  std::uint64_t pos; // The next row to be read
+};
+
+Table_reader::Table_reader() { }
+
+Table_reader::~Table_reader() { }
+
+// Open the table file at path, which must have type t. Returns false if
+// there is no such file, if it is not a table file, or if the table has
+// a different type.
+bool
+Table_reader::open(const std::string& path, Type* t) {
+  file.reset(new File());
+  File& f = *file;
+  if (not f.map.open(path.c_str())
+      or not read_schema(f.map, f.schema) or get_table_type(f.schema) != t
+      or not read_dicts(f.map, f.schema, f.dicts)) {
+    file.reset();
+    return false;
+  }
+  f.type = t;
+  f.pos = 0;
+  return true;
+}
+
+// Returns a table containing the next n rows of the file, or nullptr
+// when every row has been read or a cell is invalid.
+Table*
+Table_reader::read(std::size_t n) {
+  if (not file or file->pos == file->schema.rows)
+    return nullptr;
+  File& f = *file;
+  std::uint64_t last = f.pos + std::min<std::uint64_t>(n, f.schema.rows - f.pos);
+  Column_seq* cols = read_columns(f.map, f.schema, f.dicts, f.pos, last);
+  if (not cols)
+    return nullptr;
+  Table* t = make_table(f.type, cols, last - f.pos);
+  f.pos = last;
+  return t;
+}
+
+// Close the file, releasing its mapping.
+void
+Table_reader::close() {
+  file.reset();
+}
+
+// Save the table t to the file at path. The file is written under a
+// temporary name and then renamed, so that a concurrent load never
+// sees a partial file. Returns false if the table cannot be saved
+// (e.g., it has a column of another type).
+bool
+save_table(const std::string& path, Table* t) {
+  Type* type = get_type(t);
+  if (not is_table_file_type(type))
+    return false;
+  Term_seq* vars = get_row_type(type)->members();
+  std::size_t n = vars->size();
+
+  std::string file(magic, sizeof(magic));
+  put_fixed(file, table_file_version, 4);
+  put_fixed(file, n, 4);
+  put_fixed(file, t->rows(), 8);
+  file.resize(header_size + n * entry_size, '\0');
+
+  // Write the names of the columns.
+  for (std::size_t i = 0; i < n; ++i) {
+    String name = as<Id>(as<Var>((*vars)[i])->name())->t1;
+    std::size_t e = header_size + i * entry_size;
+    set_fixed(file, e + 4, name.size(), 4);
+    set_fixed(file, e + 8, file.size(), 8);
+    file.append(name.data(), name.size());
+  }
+  align(file, 8);
+
+  // Write the cells of each column.
+  for (std::size_t i = 0; i < n; ++i) {
+    Term_seq* col = (*t->columns())[i];
+    Column_kind k = get_column_kind(as<Var>((*vars)[i])->type());
+    if (k == nat_column and not is_narrow_column(col))
+      k = wide_nat_column;
+    std::uint64_t cells = file.size();
+    std::uint64_t dict = 0;
+    std::uint64_t count = 0;
+    bool ok = false;
+    switch (k) {
+    case bool_column: ok = write_bool_column(file, col); break;
+    case nat_column: ok = write_nat_column(file, col); break;
+    case str_column: ok = write_str_column(file, col, cells, dict, count); break;
+    case wide_nat_column:
+      ok = write_wide_nat_column(file, col, cells, dict, count);
+      break;
+    default: break;
+    }
+    if (not ok)
+      return false;
+    align(file, 8);
+
+    std::size_t e = header_size + i * entry_size;
+    set_fixed(file, e, k, 4);
+    set_fixed(file, e + 16, cells, 8);
+    set_fixed(file, e + 24, dict, 8);
+    set_fixed(file, e + 32, count, 8);
+  }
+
+  std::string tmp = path + '.' + std::to_string(::getpid());
+  {
+    std::ofstream os(tmp, std::ios::binary);
+    if (not os.write(file.data(), file.size()))
+      return false;
+  }
+  if (std::rename(tmp.c_str(), path.c_str()) != 0) {
+    std::remove(tmp.c_str());
+    return false;
+  }
+  return true;
+}
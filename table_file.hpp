@@ -0,0 +1,72 @@
+
+#ifndef TABLE_FILE_HPP
+#define TABLE_FILE_HPP
+
+#include "ast.hpp"
+
+#include <cstdint>
+#include <memory>
+#include <string>
+
+// -------------------------------------------------------------------------- //
+// Table files
+//
+// This module saves tables to a compact, columnar binary file, and
+// loads them again, so that large tables need not be written as list
+// literals in the source of a program.
+//
+// A table file records the schema of the table (the names and types of
+// its columns) followed by the values of each column, stored as arrays
+// of fixed-size cells. The schema is read when a 'load' term is
+// elaborated, so the type of the loaded table is known statically.
+//
+// Columns may have type Bool, Nat, or Str. Boolean columns hold one
+// byte per row, and numeric columns hold one 64-bit integer per row.
+// String columns hold a dictionary of the distinct strings of the
+// column, and the index of its string for each row. A numeric column
+// with a value of 2^63 or more is saved like a string column, whose
+// dictionary holds the digits of its values, so that values of any
+// size can be saved; such columns are slower to load. A file is mapped
+// into memory when it is loaded, and the cells of each column are read
+// from the mapping in place. Loaded tables share the boolean values,
+// and each distinct string of a column is a single node.
+//
+// A table may be preloaded: it is read by a thread of its own, while
+// the program is elaborated, and the first load of the table waits for
+// that thread rather than reading the file. A preloaded table is kept
+// until the program exits, even if it is never loaded, so tables are
+// preloaded only when the program is run once (i.e., not in sessions,
+// whose requests are discarded after they run). The program waits for
+// the tables still being read when it exits.
+
+// The version of the file format. This must be changed whenever the
+// layout of table files changes.
+constexpr std::uint32_t table_file_version = 2;
+
+std::string get_file_path(Term*);
+
+bool is_table_file_type(Type*);
+
+Type* load_table_type(const std::string&);
+Table* load_table(const std::string&, Type*);
+void preload_table(const std::string&, Type*);
+void set_preload_tables(bool);
+bool save_table(const std::string&, Table*);
+
+// A reader of a table file, which loads its rows a batch at a time
+// rather than at once. The file remains mapped while it is open. The
+// nodes of each batch are allocated in the arena that is current when
+// it is read.
+struct Table_reader {
+  Table_reader();
+  ~Table_reader();
+
+  bool open(const std::string&, Type*);
+  Table* read(std::size_t);
+  void close();
+
+  struct File;
+  std::unique_ptr<File> file;
+};
+
+#endif
@@ -27,6 +27,7 @@ init_tokens() {
   init_token(bool_type_tok, "Bool");
   init_token(nat_type_tok, "Nat");
   init_token(unit_type_tok, "Unit");
+  init_token(str_type_tok, "Str");
   // Identifiers and literals
   init_token(identifier_tok, "identifier");
   init_token(decimal_literal_tok, "decimal");
@@ -39,5 +40,15 @@ init_tokens() {
   init_token(union_tok, "union");
   init_token(intersect_tok, "intersect");
   init_token(except_tok, "except");
+  init_token(group_tok, "group");
+  init_token(by_tok, "by");
+  init_token(order_tok, "order");
+  init_token(asc_tok, "asc");
+  init_token(desc_tok, "desc");
+  init_token(limit_tok, "limit");
   init_token(as_tok, "as");
+  init_token(load_tok, "load");
+  init_token(save_tok, "save");
+  init_token(csv_tok, "csv");
+  init_token(insert_tok, "insert");
 }
@@ -46,10 +46,15 @@ constexpr Token_kind not_tok       = make_token(115);
 constexpr Token_kind eq_comp_tok   = make_token(116); // eq
 constexpr Token_kind less_tok      = make_token(117); // lt
 constexpr Token_kind as_tok        = make_token(118);
+constexpr Token_kind load_tok      = make_token(119);
+constexpr Token_kind save_tok      = make_token(120);
+constexpr Token_kind csv_tok       = make_token(121);
+constexpr Token_kind insert_tok    = make_token(122);
 // Type names
 constexpr Token_kind bool_type_tok = make_token(200);
 constexpr Token_kind nat_type_tok  = make_token(201);
 constexpr Token_kind unit_type_tok = make_token(202);
+constexpr Token_kind str_type_tok  = make_token(203);
 
 // Relational algebra keywords
 constexpr Token_kind select_tok    = make_token(301);
@@ -60,5 +65,11 @@ constexpr Token_kind on_tok        = make_token(305);
 constexpr Token_kind union_tok     = make_token(306);
 constexpr Token_kind intersect_tok = make_token(307);
 constexpr Token_kind except_tok    = make_token(308);
+constexpr Token_kind group_tok     = make_token(309);
+constexpr Token_kind by_tok        = make_token(310);
+constexpr Token_kind order_tok     = make_token(311);
+constexpr Token_kind asc_tok       = make_token(312);
+constexpr Token_kind desc_tok      = make_token(313);
+constexpr Token_kind limit_tok     = make_token(314);
 
 #endif
@@ -1,6 +1,11 @@
 
 #include "ast.hpp"
 
+#include "lang/arena.hpp"
+
+#include <mutex>
+#include <unordered_map>
+#include <vector>
 
 // -------------------------------------------------------------------------- //
 // Built-in types
@@ -41,6 +46,145 @@ Type*
 get_str_type() { return str_type_; }
 
 
+// -------------------------------------------------------------------------- //
+// Interned types
+//
+// The composite types (arrows, functions, tuples, lists and records)
+// are interned: each structurally distinct type is created only once.
+// Two composite types are the same exactly when they are the same
+// object, so the same-type relation is a pointer comparison.
+//
+// A composite type is identified by its kind and the (interned) types
+// of its components. Record types are also identified by the names of
+// their members. Interned types are allocated in the global arena, so
+// they outlive the phase in which they were created. Types may be
+// created by concurrent evaluations (see sched.hpp), so the table of
+// interned types (and the global arena) is guarded by a mutex.
+
+namespace {
+
+// The key identifying a composite type: its kind and the objects 
+// (types and member names) of which it is composed.
+struct Type_key {
+  Type_key(Node_kind k)
+    : kind(k) { }
+  Type_key(Node_kind k, std::initializer_list<const void*> ps)
+    : kind(k), parts(ps) { }
+
+  Node_kind kind;
+  std::vector<const void*> parts;
+};
+
+inline bool
+operator==(const Type_key& a, const Type_key& b) {
+  return a.kind == b.kind and a.parts == b.parts;
+}
+
+struct Type_key_hash {
+  std::size_t operator()(const Type_key& k) const {
+    std::size_t h = k.kind;
+    for (const void* p : k.parts)
+      h ^= std::hash<const void*>()(p) + 0x9e3779b9 + (h << 6) + (h >> 2);
+    return h;
+  }
+};
+
+// The table of interned types.
+std::unordered_map<Type_key, Type*, Type_key_hash> types_;
+std::mutex types_mutex_;
+
+using Types_lock = std::lock_guard<std::mutex>;
+
+// Returns the interned type for the key k, or nullptr if there is
+// no such type.
+inline Type*
+find_type(const Type_key& k) {
+  auto iter = types_.find(k);
+  return iter != types_.end() ? iter->second : nullptr;
+}
+
+// Returns the string naming a record member.
+inline String
+get_member_name(Term* v) { return as<Id>(as<Var>(v)->name())->t1; }
+
+} // namespace
+
+// Returns the arrow type 't1 -> t2'.
+Type*
+get_arrow_type(Type* t1, Type* t2) {
+  Type_key k {arrow_type, {t1, t2}};
+  Types_lock lock(types_mutex_);
+  if (Type* t = find_type(k))
+    return t;
+  Arena_guard guard(global_arena());
+  return types_[k] = new Arrow_type(kind_type_, t1, t2);
+}
+
+// Returns the function type '(t1, ..., tn) -> u'.
+Type*
+get_fn_type(Type_seq* ts, Type* u) {
+  Type_key k {fn_type};
+  k.parts.assign(ts->begin(), ts->end());
+  k.parts.push_back(u);
+  Types_lock lock(types_mutex_);
+  if (Type* t = find_type(k))
+    return t;
+  Arena_guard guard(global_arena());
+  Type_seq* types = new Type_seq();
+  types->assign(ts->begin(), ts->end());
+  return types_[k] = new Fn_type(kind_type_, types, u);
+}
+
+// Returns the tuple type '{t1, ..., tn}'.
+Type*
+get_tuple_type(Type_seq* ts) {
+  Type_key k {tuple_type};
+  k.parts.assign(ts->begin(), ts->end());
+  Types_lock lock(types_mutex_);
+  if (Type* t = find_type(k))
+    return t;
+  Arena_guard guard(global_arena());
+  Type_seq* types = new Type_seq();
+  types->assign(ts->begin(), ts->end());
+  return types_[k] = new Tuple_type(kind_type_, types);
+}
+
+// Returns the list type '[t]'.
+Type*
+get_list_type(Type* t1) {
+  Type_key k {list_type, {t1}};
+  Types_lock lock(types_mutex_);
+  if (Type* t = find_type(k))
+    return t;
+  Arena_guard guard(global_arena());
+  return types_[k] = new List_type(kind_type_, t1);
+}
+
+// Returns the record type '{n1:t1, ..., nn:tn}' where each ni:ti
+// is a member variable in vs. The members of the record type are
+// copies of those in vs.
+Type*
+get_record_type(Term_seq* vs) {
+  Type_key k {record_type};
+  for (Term* v : *vs) {
+    k.parts.push_back(get_member_name(v).ptr());
+    k.parts.push_back(as<Var>(v)->type());
+  }
+  Types_lock lock(types_mutex_);
+  if (Type* t = find_type(k))
+    return t;
+  Arena_guard guard(global_arena());
+  Term_seq* vars = new Term_seq();
+  vars->reserve(vs->size());
+  for (Term* v : *vs) {
+    Var* var = as<Var>(v);
+    Id* id = new Id(var->name()->loc, get_member_name(var));
+    vars->push_back(new Var(var->loc, id, var->type()));
+  }
+  return types_[k] = new Record_type(kind_type_, vars);
+}
+
+
 // -------------------------------------------------------------------------- //
 // Typing
 
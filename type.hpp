@@ -13,6 +13,12 @@ Type* get_bool_type();
 Type* get_nat_type();
 Type* get_str_type();
 
+Type* get_arrow_type(Type*, Type*);
+Type* get_fn_type(Type_seq*, Type*);
+Type* get_tuple_type(Type_seq*);
+Type* get_list_type(Type*);
+Type* get_record_type(Term_seq*);
+
 bool is_type(Expr*);
 bool is_unit_type(Type*);
 bool is_bool_type(Type*);
@@ -62,6 +62,10 @@ is_integer_value(Term* t) { return t->kind == int_term; }
 bool 
 is_abs(Term* t) { return t->kind == abs_term; }
 
+// Returns true when t is a closure.
+bool
+is_closure(Term* t) { return t->kind == closure_term; }
+
 // Returns true when t unit.
 bool
 is_unit(Term* t) { return t->kind == unit_term; }
@@ -77,6 +81,11 @@ is_list_value(Term* t) {
   return false;
 }
 
+// Returns true when t is a table. Tables are constructed only from
+// evaluated lists of records.
+bool
+is_table_value(Term* t) { return t->kind == table_term; }
+
 // Returns true if t is a value (in normal form), which is defined
 // inductively as:
 //
@@ -85,7 +94,9 @@ is_list_value(Term* t) {
 //        | integer-value 
 //        | string-value 
 //        | list-value
+//        | table-value
 //        | \x:T.t
+//        | [E]\x:T.t
 //
 // TODO: We're missing value definitions for tuples, records, and
 // variants.
@@ -96,6 +107,8 @@ is_value(Term* t) {
       or is_integer_value(t) 
       or is_string_value(t)
       or is_list_value(t)
-      or is_abs(t);
+      or is_table_value(t)
+      or is_abs(t)
+      or is_closure(t);
 }
 
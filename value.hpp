@@ -17,10 +17,12 @@ bool is_boolean_value(Term*);
 bool is_integer_value(Term*);
 bool is_string_value(Term*);
 bool is_list_value(Term*);
+bool is_table_value(Term*);
 
 bool is_true(Term*);
 bool is_false(Term*);
 bool is_abs(Term*);
+bool is_closure(Term*);
 bool is_unit(Term*);
 
 #endif
@@ -0,0 +1,504 @@
+#include "view.hpp"
+#include "eval.hpp"
+#include "plan.hpp"
+#include "table.hpp"
+#include "type.hpp"
+
+#include "lang/debug.hpp"
+
+#include <algorithm>
+
+// -------------------------------------------------------------------------- //
+// Incremental views
+//
+// The incremental form of a view is a tree of nodes, one for each
+// defined table, selection, join, and set operation of its term. Each
+// node keeps its current value, whose columns are its own (see
+// copy_table), except that a reference keeps the value of the table it
+// refers to. When rows are inserted, each node updates its value from
+// the changes to the values of its operands, and returns the change to
+// its own value. A node that cannot be updated evaluates its term again.
+
+struct View_node {
+  View_node(Term* t)
+    : term(t), table(nullptr) { }
+  virtual ~View_node() { }
+
+  // Build the value of the node and its state. The value of its term
+  // is v, or is computed when v is null.
+  virtual void build(View_set&, Table* v) = 0;
+
+  // Update the value of the node from the changes to its operands.
+  virtual Change update(View_set&, const Change_map&) = 0;
+
+  Change rebuild(View_set&);
+
+  Term* term;   // The term computed by the node
+  Table* table; // The value of that term
+};
+
+namespace {
+
+using Node_ptr = std::unique_ptr<View_node>;
+
+// Returns the change to the value t of the definition d.
+Change
+get_change(const Change_map& changes, Def* d, Table* t) {
+  auto iter = changes.find(d);
+  if (iter == changes.end())
+    return {t->rows(), false};
+  return iter->second;
+}
+
+// Returns true if any of the tables numbered by deps changed.
+bool
+has_change(View_set& vs, const Change_map& changes, const Stmt_seq& deps) {
+  for (std::size_t i : deps) {
+    if (changes.count(vs.views[i]->def))
+      return true;
+  }
+  return false;
+}
+
+// Returns the value of the definition d, which is a table.
+Table*
+get_value(Def* d) {
+  Table* t = as<Table>(d->value());
+  lang_assert(t, format("'{}' is not a table", pretty(d->name())));
+  return t;
+}
+
+// A reference to a defined table.
+struct Ref_node : View_node {
+  Ref_node(Ref* t, Def* d)
+    : View_node(t), def(d) { }
+
+  void build(View_set&, Table*) override;
+  Change update(View_set&, const Change_map&) override;
+
+  Def* def;
+};
+
+void
+Ref_node::build(View_set& vs, Table*) {
+  table = vs.eval_table(term);
+}
+
+Change
+Ref_node::update(View_set&, const Change_map& changes) {
+  Change c = get_change(changes, def, table);
+  table = get_value(def);
+  return c;
+}
+
+// A selection from a defined table. The condition is tested on the new
+// rows of the table. The node is evaluated again when another table
+// that the selection refers to changes.
+struct Select_node : View_node {
+  Select_node(Select_from_where* t, Def* d, const Stmt_seq& s)
+    : View_node(t), def(d), others(s) { }
+
+  void build(View_set&, Table*) override;
+  Change update(View_set&, const Change_map&) override;
+
+  Def* def;        // The selected table
+  Stmt_seq others; // The other tables referred to
+};
+
+void
+Select_node::build(View_set& vs, Table* v) {
+  table = copy_table(v ? v : vs.eval_table(term));
+}
+
+Change
+Select_node::update(View_set& vs, const Change_map& changes) {
+  Table* t = get_value(def);
+  Change c = get_change(changes, def, t);
+  if (c.reset or has_change(vs, changes, others))
+    return rebuild(vs);
+  std::size_t n = table->rows();
+  if (c.first < t->rows()) {
+    Row_seq rows(t->rows() - c.first);
+    for (std::size_t i = 0; i < rows.size(); ++i)
+      rows[i] = c.first + i;
+    Table* s = vs.eval_select(as<Select_from_where>(term), select_rows(t, rows));
+    append_rows(table, s, 0, s->rows());
+  }
+  return {n, false};
+}
+
+// A join of two defined tables. Joins whose conditions are not of the
+// form 'x.a eq y.b' are evaluated again.
+struct Join_node : View_node {
+  Join_node(Join* t, Def* d1, Def* d2, const Stmt_seq& s)
+    : View_node(t), left(d1), right(d2), others(s) { }
+
+  void build(View_set&, Table*) override;
+  Change update(View_set&, const Change_map&) override;
+
+  Def* left;       // The left table
+  Def* right;      // The right table
+  Stmt_seq others; // The other tables referred to
+};
+
+void
+Join_node::build(View_set& vs, Table* v) {
+  table = copy_table(v ? v : vs.eval_table(term));
+}
+
+Change
+Join_node::update(View_set& vs, const Change_map& changes) {
+  Table* t1 = get_value(left);
+  Table* t2 = get_value(right);
+  Change c1 = get_change(changes, left, t1);
+  Change c2 = get_change(changes, right, t2);
+  if (c1.reset or c2.reset or has_change(vs, changes, others))
+    return rebuild(vs);
+  std::size_t n = table->rows();
+  if (c1.first == t1->rows() and c2.first == t2->rows())
+    return {n, false};
+  Table* s = vs.eval_join(as<Join>(term), t1, c1.first, t2, c2.first);
+  if (not s)
+    return rebuild(vs);
+  append_rows(table, s, 0, s->rows());
+  return {n, false};
+}
+
+// A union, intersection, or difference of views. The node keeps the
+// set of the rows of its value, and of the rows of the operands that
+// it must find.
+struct Set_node : View_node {
+  Set_node(Term* t, View_node* l, View_node* r)
+    : View_node(t), left(l), right(r) { }
+
+  void build(View_set&, Table*) override;
+  Change update(View_set&, const Change_map&) override;
+
+  void add(Row_set&, Table*, std::size_t, std::size_t);
+  void keep(Table*, std::size_t);
+
+  Node_ptr left;
+  Node_ptr right;
+  Row_set left_rows;  // The rows of left, for intersections
+  Row_set right_rows; // The rows of right, unless for unions
+  Row_set rows;       // The rows of the value
+};
+
+void
+Set_node::build(View_set& vs, Table* v) {
+  left->build(vs, nullptr);
+  right->build(vs, nullptr);
+  table = copy_table(v ? v : vs.eval_table(term));
+  left_rows.clear();
+  right_rows.clear();
+  rows.clear();
+  if (term->kind == intersect_term)
+    add(left_rows, left->table, 0, left->table->rows());
+  if (term->kind != union_term)
+    add(right_rows, right->table, 0, right->table->rows());
+  add(rows, table, 0, table->rows());
+}
+
+// Add the rows [first, last) of t to s.
+void
+Set_node::add(Row_set& s, Table* t, std::size_t first, std::size_t last) {
+  for (std::size_t i = first; i < last; ++i)
+    s.insert({t, i, hash_row(t, i)});
+}
+
+// Append the row i of t to the value, unless it is already a row.
+void
+Set_node::keep(Table* t, std::size_t i) {
+  Row_ref r {t, i, hash_row(t, i)};
+  if (rows.count(r))
+    return;
+  std::size_t k = table->rows();
+  append_rows(table, t, i, i + 1);
+  rows.insert({table, k, r.hash});
+}
+
+Change
+Set_node::update(View_set& vs, const Change_map& changes) {
+  Change c1 = left->update(vs, changes);
+  Change c2 = right->update(vs, changes);
+  if (c1.reset or c2.reset)
+    return rebuild(vs);
+  Table* t1 = left->table;
+  Table* t2 = right->table;
+  std::size_t n = table->rows();
+  switch (term->kind) {
+  case union_term:
+    for (std::size_t i = c1.first; i < t1->rows(); ++i)
+      keep(t1, i);
+    for (std::size_t i = c2.first; i < t2->rows(); ++i)
+      keep(t2, i);
+    break;
+
+  case intersect_term:
+    add(left_rows, t1, c1.first, t1->rows());
+    add(right_rows, t2, c2.first, t2->rows());
+    for (std::size_t i = c1.first; i < t1->rows(); ++i) {
+      if (right_rows.count({t1, i, hash_row(t1, i)}))
+        keep(t1, i);
+    }
+    for (std::size_t i = c2.first; i < t2->rows(); ++i) {
+      if (left_rows.count({t2, i, hash_row(t2, i)}))
+        keep(t2, i);
+    }
+    break;
+
+  case except_term:
+    // A new row of t2 that is a row of the value removes it.
+    for (std::size_t i = c2.first; i < t2->rows(); ++i) {
+      Row_ref r {t2, i, hash_row(t2, i)};
+      if (rows.count(r))
+        return rebuild(vs);
+      right_rows.insert(r);
+    }
+    for (std::size_t i = c1.first; i < t1->rows(); ++i) {
+      if (not right_rows.count({t1, i, hash_row(t1, i)}))
+        keep(t1, i);
+    }
+    break;
+
+  default:
+    lang_unreachable(format("'{}' is not a set operation", pretty(term)));
+  }
+  return {n, false};
+}
+
+// Returns the incremental form of the set operation t, or nullptr if
+// an operand has none.
+template<typename T>
+  View_node*
+  make_set_node(View_set& vs, T* t) {
+    if (not is_plan_term(t))
+      return nullptr;
+    Node_ptr left(vs.make_node(t->t1));
+    Node_ptr right(vs.make_node(t->t2));
+    if (not left or not right)
+      return nullptr;
+    return new Set_node(t, left.release(), right.release());
+  }
+
+} // namespace
+
+// Evaluate the term of the node again.
+Change
+View_node::rebuild(View_set& vs) {
+  build(vs, nullptr);
+  return {0, true};
+}
+
+
+// -------------------------------------------------------------------------- //
+// Views
+
+View::View(Def* d)
+  : def(d), term(as<Term>(d->value())), pure(true), ready(false) { }
+
+View::~View() { }
+
+// Declare the definition d. Only definitions of tables are kept.
+void
+View_set::declare(Def* d) {
+  Term* t = as<Term>(d->value());
+  if (not t)
+    return;
+  Type* type = get_type(t);
+  if (not is_plan_term(t) and not get_row_type(type) and not is_kind(type))
+    return;
+  View* v = new View(d);
+  std::vector<Def*> locals;
+  v->pure = find_deps(t, numbers, v->deps, &locals);
+  std::sort(v->deps.begin(), v->deps.end());
+  v->deps.erase(std::unique(v->deps.begin(), v->deps.end()), v->deps.end());
+  for (Def* l : locals)
+    v->locals.emplace_back(l, l->value());
+  if (v->pure and not v->is_base() and locals.empty())
+    v->root.reset(make_node(t));
+  numbers[d] = views.size();
+  views.emplace_back(v);
+  ++pending;
+}
+
+// Keep the declarations of the request, which was evaluated.
+void
+View_set::define() {
+  pending = 0;
+}
+
+// Discard the declarations of the request, which failed.
+void
+View_set::discard() {
+  for (; pending != 0; --pending) {
+    numbers.erase(views.back()->def);
+    views.pop_back();
+  }
+}
+
+// Returns the table defined by d, or nullptr if d does not define a
+// table of the session.
+View*
+View_set::find(Def* d) {
+  auto iter = numbers.find(d);
+  if (iter == numbers.end())
+    return nullptr;
+  return views[iter->second].get();
+}
+
+// Insert the rows of r into the base table defined by x, and update
+// the views of that table. The rows of r have the type of that table.
+void
+View_set::insert(Def* x, Table* r) {
+  std::size_t k = numbers.at(x);
+  lang_assert(views[k]->is_base(), "inserting rows into a view");
+
+  // Find the views of x, and build their state before the change.
+  std::vector<char> changed(views.size(), false);
+  changed[k] = true;
+  std::vector<View*> affected;
+  for (std::size_t i = k + 1; i < views.size(); ++i) {
+    View& v = *views[i];
+    if (not v.pure or v.is_base())
+      continue;
+    for (std::size_t j : v.deps) {
+      if (changed[j]) {
+        changed[i] = true;
+        affected.push_back(&v);
+        break;
+      }
+    }
+  }
+  for (View* v : affected)
+    prepare(*v);
+
+  // The table is copied when rows are first inserted, since its columns
+  // may be shared with other tables.
+  Table* t = get_value(x);
+  if (not owned.count(t)) {
+    t = copy_table(t);
+    x->t2 = t;
+    owned.insert(t);
+  }
+  std::size_t n = t->rows();
+  append_rows(t, r, 0, r->rows());
+
+  Change_map changes;
+  changes[x] = {n, false};
+  for (View* v : affected)
+    changes[v->def] = update(*v, changes);
+}
+
+// Build the state of the view v from its current value.
+void
+View_set::prepare(View& v) {
+  if (v.ready)
+    return;
+  v.ready = true;
+  if (v.root)
+    v.root->build(*this, eval_table(new Ref(v.def)));
+}
+
+// Update the view v from the changes to its tables.
+Change
+View_set::update(View& v, const Change_map& changes) {
+  if (not v.root)
+    return recompute(v);
+  Change c = v.root->update(*this, changes);
+  v.def->t2 = v.root->table;
+  return c;
+}
+
+// Evaluate the view v again. The tables named by 'as' within its term
+// are restored to their defined terms, so that they are evaluated
+// again too.
+Change
+View_set::recompute(View& v) {
+  for (auto& l : v.locals)
+    l.first->t2 = l.second;
+  v.def->t2 = eval_table(v.term);
+  return {0, true};
+}
+
+// Evaluate the term t to a table.
+Table*
+View_set::eval_table(Term* t) {
+  Term* v = eval(t);
+  if (Def* d = as<Def>(v))
+    v = as<Term>(d->value());
+  if (List* l = as<List>(v))
+    v = make_table(l);
+  Table* table = as<Table>(v);
+  lang_assert(table, format("'{}' is not a table", pretty(t)));
+  return table;
+}
+
+// Returns the rows of the selection t from the rows of r.
+Table*
+View_set::eval_select(Select_from_where* t, Table* r) {
+  Context_guard guard(eval.cxt);
+  return eval_select_rows(t, r);
+}
+
+// Returns the rows added to the join t (see eval_join_rows).
+Table*
+View_set::eval_join(Join* t, Table* t1, std::size_t n1, Table* t2, std::size_t n2) {
+  Context_guard guard(eval.cxt);
+  return eval_join_rows(t, t1, n1, t2, n2);
+}
+
+// Returns the incremental form of the term t, or nullptr if t has none.
+View_node*
+View_set::make_node(Term* t) {
+  // Returns the definition of a table of the session referred to by e.
+  auto get_def = [this](Term* e) -> Def* {
+    Ref* r = as<Ref>(e);
+    Def* d = r ? as<Def>(r->decl()) : nullptr;
+    return d and numbers.count(d) ? d : nullptr;
+  };
+
+  // Returns the other tables of the session referred to by e.
+  auto get_others = [this](Term* e, Def* d1, Def* d2) {
+    Stmt_seq deps;
+    find_deps(e, numbers, deps);
+    Stmt_seq others;
+    for (std::size_t i : deps) {
+      Def* d = views[i]->def;
+      if (d != d1 and d != d2)
+        others.push_back(i);
+    }
+    return others;
+  };
+
+  switch (t->kind) {
+  case ref_term:
+    if (Def* d = get_def(t))
+      return new Ref_node(as<Ref>(t), d);
+    return nullptr;
+
+  case select_term: {
+    Select_from_where* s = as<Select_from_where>(t);
+    Def* d = get_def(s->table());
+    if (not d)
+      return nullptr;
+    return new Select_node(s, d, get_others(s, d, d));
+  }
+
+  case join_on_term: {
+    Join* j = as<Join>(t);
+    Def* d1 = get_def(j->table_a());
+    Def* d2 = get_def(j->table_b());
+    if (not d1 or not d2 or d1 == d2)
+      return nullptr;
+    return new Join_node(j, d1, d2, get_others(j->join_cond(), d1, d2));
+  }
+
+  case union_term: return make_set_node(*this, as<Union>(t));
+  case intersect_term: return make_set_node(*this, as<Intersect>(t));
+  case except_term: return make_set_node(*this, as<Except>(t));
+
+  default:
+    return nullptr;
+  }
+}
@@ -0,0 +1,104 @@
+#ifndef VIEW_HPP
+#define VIEW_HPP
+
+#include "ast.hpp"
+#include "sched.hpp"
+
+#include <memory>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+struct Evaluator;
+
+// -------------------------------------------------------------------------- //
+// Views
+//
+// In a session, a pure definition of a table computed from the tables
+// defined by earlier definitions is a view of those tables. When rows
+// are inserted into a table (see session.hpp), each view of it is
+// updated, in the order of definition, so that it has the rows that
+// evaluating it again would produce. Only tables that are not views
+// can have rows inserted.
+//
+// A view is updated from the rows added to the tables it refers to when
+// its value is a defined table, a selection from a defined table (whose
+// condition is tested on the new rows only), a join of two defined
+// tables on 'x.a eq y.b' (whose new rows are matched by probing the
+// hash index of the other table, see eval_join_rows), or a union,
+// intersection, or difference of those. A set operation keeps the
+// distinct rows of its operands and its result, so that it can tell
+// which new rows enter the result. New rows are appended to the value
+// of a view, so an updated view has the rows of another evaluation, but
+// not necessarily in the same order.
+//
+// Other views (e.g., groupings and orderings) are evaluated again. A
+// difference whose right operand gains one of its rows is also
+// evaluated again, as are the views of a view that was evaluated
+// again. The state kept to update a view is built when rows are first
+// inserted into one of its tables. Definitions that have effects (e.g.,
+// that print) are not views; they keep the value they were given.
+
+// The rows added to the value of a definition by an update: the rows
+// from first on, or all of them when the value was evaluated again.
+struct Change {
+  std::size_t first;
+  bool reset;
+};
+
+using Change_map = std::unordered_map<Def*, Change>;
+
+struct View_node;
+
+// A table defined by a session. A table that refers to no other table
+// is a base table, into which rows can be inserted. Otherwise the table
+// is a view of the tables numbered by deps.
+struct View {
+  View(Def*);
+  ~View();
+
+  bool is_base() const { return deps.empty(); }
+
+  Def* def;
+  Term* term;     // The defined term
+  Stmt_seq deps;  // The tables that term refers to
+  bool pure;      // True if term has no effects
+  std::vector<std::pair<Def*, Expr*>> locals; // The tables named by 'as'
+  std::unique_ptr<View_node> root; // The incremental form of term, if any
+  bool ready;     // True when the state of root has been built
+};
+
+// The tables defined by a session. A definition is declared before it
+// is evaluated, so that its defined term is known; the declarations of
+// a request are kept when its evaluation succeeds, and discarded when
+// it fails.
+struct View_set {
+  View_set(Evaluator& e)
+    : eval(e), pending(0) { }
+
+  void declare(Def*);
+  void define();
+  void discard();
+
+  View* find(Def*);
+  void insert(Def*, Table*);
+
+  Table* eval_table(Term*);
+  Table* eval_select(Select_from_where*, Table*);
+  Table* eval_join(Join*, Table*, std::size_t, Table*, std::size_t);
+
+  View_node* make_node(Term*);
+
+  Evaluator& eval;
+  Def_map numbers;  // The number of each table
+  std::vector<std::unique_ptr<View>> views; // The tables, by number
+  std::unordered_set<Table*> owned; // The base tables updated in place
+  std::size_t pending; // The number of declarations not yet defined
+
+private:
+  void prepare(View&);
+  Change update(View&, const Change_map&);
+  Change recompute(View&);
+};
+
+#endif
@@ -0,0 +1,460 @@
+
+#include "vm.hpp"
+#include "env.hpp"
+#include "eval.hpp"
+#include "type.hpp"
+#include "value.hpp"
+#include "memo.hpp"
+#include "jit.hpp"
+#include "stats.hpp"
+#include "profile.hpp"
+#include "output.hpp"
+
+#include "lang/debug.hpp"
+
+#include <algorithm>
+
+// -------------------------------------------------------------------------- //
+// Virtual machine
+//
+// The machine executes code on a single stack of values. Each call
+// pushes a frame that records the code being executed, the position
+// of the next instruction, the stack slot of the first argument, and
+// the environments of the call.
+//
+// The arguments of a call are left on the stack, where the callee
+// accesses them as its parameters. When the callee returns, its
+// arguments (and the called function) are replaced by the result.
+//
+// Function calls do not recurse on the native stack, so the depth
+// of evaluation is limited only by memory. Because the state of a run
+// is its stack and frames, a run can also be paused between any two
+// instructions (see Task in vm.hpp).
+//
+// A memoized call (see memo.hpp) is looked up before its frame is
+// pushed. When the call is not remembered, its frame is marked, and
+// its value is remembered when it returns. The body of a memoized
+// function has no tail calls (see compile_fn), so its arguments are
+// still in place when it returns.
+//
+// A call of a function that has native code (see jit.hpp) is run by
+// that code when it can be, without pushing a frame.
+
+namespace {
+
+struct Frame {
+  Code*        code; // The code being executed
+  const Instr* pc;   // The next instruction
+  std::size_t  fp;   // The stack slot of the first argument
+  Env*         env;  // The environment of the parameters
+  Env*         cenv; // The environment captured by the closure
+  bool         memo; // True if the value of the call is remembered
+};
+
+using Stack = std::vector<Term*>;
+
+inline Term*
+pop(Stack& s) {
+  Term* t = s.back();
+  s.pop_back();
+  return t;
+}
+
+// Returns true if the boolean value t is true.
+inline bool
+test(Term* t) {
+  if (is_true(t))
+    return true;
+  if (is_false(t))
+    return false;
+  lang_unreachable(format("'{}' is not a boolean value", pretty(t)));
+}
+
+// Returns the integer value t.
+inline Int*
+get_int(Term* t) {
+  if (Int* n = as<Int>(t))
+    return n;
+  lang_unreachable(format("'{}' is not a numeric value", pretty(t)));
+}
+
+// Returns the binding at position i of the enclosing environment at
+// the given depth, starting from the environment e captured by the
+// current closure.
+inline Term*
+get_free(Env* e, int depth, int i) {
+  while (--depth)
+    e = e->parent;
+  lang_assert(e and std::size_t(i) < e->size(), "invalid environment");
+  return (*e)[i].second;
+}
+
+// Returns the abstraction or function called through the value fn.
+inline Term*
+get_callee(Term* fn) {
+  if (Closure* c = as<Closure>(fn))
+    return c->fn();
+  return fn;
+}
+
+// Returns the code of the function called through the value fn.
+inline Code*
+get_code(Compiler& comp, Term* fn) {
+  if (Closure* c = as<Closure>(fn))
+    return c->code() ? c->code() : comp.get_code(c->fn());
+  if (is<Abs>(fn) or is<Fn>(fn))
+    return comp.get_code(fn);
+  lang_unreachable(format("ill-formed call target '{}'", pretty(fn)));
+}
+
+// Enter the code of the function f, whose n arguments are on the top
+// of the stack.
+void
+enter(Stack& s, Frame& f, Term* fn, Code* code, std::size_t n) {
+  lang_assert(code->vars.size() == n, "invalid function call");
+  Closure* c = as<Closure>(fn);
+  Env* cenv = c ? c->env() : nullptr;
+
+  f.code = code;
+  f.pc = code->instrs.data();
+  f.fp = s.size() - n;
+  f.cenv = cenv;
+  f.env = cenv;
+  f.memo = is_memo_fn(code->fn);
+  if (code->env) {
+    Env* env = new Env(cenv);
+    env->reserve(n);
+    for (std::size_t i = 0; i < n; ++i)
+      env->bind(code->vars[i], s[f.fp + i]);
+    f.env = env;
+  }
+}
+
+// Returns the value of a call of the code with the n arguments args,
+// computed by its native code, or nullptr if the call is run by the
+// machine (see jit.hpp). The call that reaches the threshold compiles
+// the code. Calls are not run natively when profiling, so that each
+// call has a frame.
+inline Term*
+run_native(Code* code, Term* const* args, std::size_t n) {
+  std::size_t limit = get_jit_threshold();
+  if (limit == 0 or profiling)
+    return nullptr;
+  Native_fn* nf = code->native.load(std::memory_order_acquire);
+  if (not nf) {
+    if (code->calls.fetch_add(1, std::memory_order_relaxed) + 1 != limit)
+      return nullptr;
+    nf = compile_native(code->fn);
+    if (not nf)
+      return nullptr;
+    code->native.store(nf, std::memory_order_release);
+  }
+  Term* v = call_native(nf, args, n);
+  if (v)
+    count_native();
+  return v;
+}
+
+// Print the value v for the print statement t. If there is no
+// value, print the expression instead.
+inline void
+print(Print* t, Term* v) {
+  if (v)
+    get_output().print(v);
+  else
+    get_output().print(t->expr());
+}
+
+// Returns the term naming the frame of a call by the instruction ins
+// to the function fn: the call term, if it is in the constant pool,
+// or the function otherwise.
+inline Term*
+get_site(const Frame& f, const Instr& ins, Term* fn) {
+  return ins.b ? f.code->consts[ins.b - 1] : fn;
+}
+
+// Restores the depth of the shadow stack when a run ends, so that the
+// frames of calls that fail are discarded.
+struct Profile_guard {
+  Profile_guard() : depth(profiling ? get_frame_depth() : -1) { }
+  ~Profile_guard() {
+    if (depth >= 0)
+      set_frame_depth(depth);
+  }
+
+  int depth;
+};
+
+// The fuel limit of each evaluation, or 0 if there is none.
+std::size_t fuel_limit_ = 0;
+
+} // namespace
+
+void
+set_fuel_limit(std::size_t n) { fuel_limit_ = n; }
+
+std::size_t
+get_fuel_limit() { return fuel_limit_; }
+
+Fuel_error::Fuel_error(std::size_t n)
+  : Assertion_error(format("evaluation ran out of fuel after {} instructions", n)),
+    limit(n) { }
+
+// The state of a run of the code of a statement (or of a function): the
+// stack of values, the frames of the calls in progress, and the frame
+// of the code being executed. When profile is set, each call pushes a
+// frame onto the shadow stack, and a tail call replaces it.
+struct Machine {
+  Machine(Code* c, bool p)
+    : f {c, c->instrs.data(), 0, nullptr, nullptr, false}, profile(p) { }
+
+  bool run(Compiler&, std::size_t&, Term*&);
+
+  Stack stack;
+  std::vector<Frame> frames;
+  Frame f;
+  bool profile;
+};
+
+// Execute instructions until the code returns, in which case its value
+// is stored in result, or until fuel instructions have been executed, in
+// which case the machine stops before the next instruction. Returns
+// true if the code returned. The fuel that is left is stored in fuel.
+bool
+Machine::run(Compiler& comp, std::size_t& fuel, Term*& result) {
+  std::size_t left = fuel;
+  while (true) {
+    if (left == 0) {
+      fuel = 0;
+      return false;
+    }
+    --left;
+    const Instr& ins = *f.pc++;
+    count_op(ins.op);
+    switch (ins.op) {
+    case op_const:
+      stack.push_back(f.code->consts[ins.a]);
+      break;
+
+    case op_local:
+      stack.push_back(stack[f.fp + ins.a]);
+      break;
+
+    case op_free:
+      stack.push_back(get_free(f.cenv, ins.b, ins.a));
+      break;
+
+    case op_global:
+      stack.push_back(eval(f.code->consts[ins.a]));
+      break;
+
+    case op_eval:
+      stack.push_back(eval(f.code->consts[ins.a], f.env));
+      break;
+
+    case op_pop:
+      stack.pop_back();
+      break;
+
+    case op_jump:
+      f.pc = f.code->instrs.data() + ins.a;
+      break;
+
+    case op_branch:
+      if (not test(pop(stack)))
+        f.pc = f.code->instrs.data() + ins.a;
+      break;
+
+    case op_not:
+      stack.back() = test(stack.back()) ? get_false() : get_true();
+      break;
+
+    case op_equals: {
+      Term* t2 = pop(stack);
+      Term* t1 = pop(stack);
+      stack.push_back(is_same(t1, t2) ? get_true() : get_false());
+      break;
+    }
+
+    case op_less: {
+      Term* t2 = pop(stack);
+      Term* t1 = pop(stack);
+      stack.push_back(is_less(t1, t2) ? get_true() : get_false());
+      break;
+    }
+
+    case op_succ: {
+      Term* t = f.code->consts[ins.a];
+      Int* n = get_int(stack.back());
+      stack.back() = new Int(t->loc, get_type(t), n->value() + 1);
+      break;
+    }
+
+    case op_pred: {
+      Term* t = f.code->consts[ins.a];
+      Int* n = get_int(stack.back());
+      if (n->value() != 0)
+        stack.back() = new Int(t->loc, get_type(t), n->value() - 1);
+      break;
+    }
+
+    case op_iszero:
+      stack.back() = get_int(stack.back())->value() == 0 ? get_true() : get_false();
+      break;
+
+    case op_closure: {
+      Code* c = f.code->fns[ins.a];
+      Term* t = c->fn;
+      stack.push_back(new Closure(t->loc, get_type(t), t, f.env, c));
+      break;
+    }
+
+    case op_call: {
+      std::size_t n = ins.a;
+      Term* fn = get_callee(stack[stack.size() - n - 1]);
+      if (is_memo_fn(fn)) {
+        if (Term* v = find_memo(fn, stack.data() + stack.size() - n, n)) {
+          stack.resize(stack.size() - n - 1);
+          stack.push_back(v);
+          break;
+        }
+      }
+      Term* callee = stack[stack.size() - n - 1];
+      Code* code = get_code(comp, callee);
+      if (Term* v = run_native(code, stack.data() + stack.size() - n, n)) {
+        stack.resize(stack.size() - n - 1);
+        stack.push_back(v);
+        break;
+      }
+      if (profile)
+        push_frame(get_site(f, ins, fn));
+      frames.push_back(f);
+      enter(stack, f, callee, code, n);
+      break;
+    }
+
+    case op_tail: {
+      // The function and its arguments replace those of the current
+      // frame, so the called function returns to the current caller.
+      std::size_t n = ins.a;
+      Term* fn = get_callee(stack[stack.size() - n - 1]);
+      Term* callee = stack[stack.size() - n - 1];
+      Code* code = get_code(comp, callee);
+      Term* v = nullptr;
+      if (is_memo_fn(fn))
+        v = find_memo(fn, stack.data() + stack.size() - n, n);
+      if (not v)
+        v = run_native(code, stack.data() + stack.size() - n, n);
+      if (not v) {
+        if (profile and not frames.empty())
+          replace_frame(get_site(f, ins, fn));
+        std::size_t fp = f.fp - 1;
+        std::copy(stack.end() - n - 1, stack.end(), stack.begin() + fp);
+        stack.resize(fp + n + 1);
+        enter(stack, f, callee, code, n);
+        break;
+      }
+      stack.resize(stack.size() - n - 1);
+      stack.push_back(v);
+    }
+    // A tail call whose value is remembered (or computed by native
+    // code) returns that value from the current frame.
+
+    case op_return: {
+      Term* v = stack.back();
+      if (f.memo)
+        save_memo(f.code->fn, stack.data() + f.fp, f.code->vars.size(), v);
+      if (frames.empty()) {
+        fuel = left;
+        result = v;
+        return true;
+      }
+      if (profile)
+        pop_frame();
+      stack.resize(f.fp - 1);
+      stack.push_back(v);
+      f = frames.back();
+      frames.pop_back();
+      break;
+    }
+
+    case op_define: {
+      Def* d = as<Def>(f.code->consts[ins.a]);
+      d->t2 = stack.back();
+      stack.back() = d;
+      break;
+    }
+
+    case op_delay: {
+      Code* c = f.code->fns[ins.a];
+      Def* d = as<Def>(c->term);
+      if (not d->t3)
+        d->t3 = [&comp, c] { return ::run(comp, c); };
+      stack.push_back(d);
+      break;
+    }
+
+    case op_print: {
+      Print* t = as<Print>(f.code->consts[ins.a]);
+      print(t, ins.b ? pop(stack) : nullptr);
+      stack.push_back(get_unit());
+      break;
+    }
+    }
+  }
+}
+
+// Execute the code, returning the resulting value. The statements
+// of a program are run in order.
+Term*
+run(Compiler& comp, Code* code) {
+  if (is<Prog>(code->term)) {
+    Term* result = get_unit();
+    for (Code* s : code->stmts)
+      result = run(comp, s);
+    return result;
+  }
+
+  Profile_guard guard;
+  Machine m(code, profiling);
+  std::size_t fuel = std::size_t(-1);
+  Term* result;
+  m.run(comp, fuel, result);
+  return result;
+}
+
+Task::Task(Compiler& c, Code* p)
+  : comp(c), code(p), next(0), result(get_unit()), spent(0), done(false) { }
+
+Task::~Task() { }
+
+// Run the task until it is done or until it has executed n more
+// instructions. Returns true if the task is done.
+bool
+Task::resume(std::size_t n) {
+  while (not done) {
+    if (not machine) {
+      Code* c = code;
+      if (is<Prog>(code->term)) {
+        if (next == code->stmts.size()) {
+          done = true;
+          break;
+        }
+        c = code->stmts[next];
+      }
+      machine.reset(new Machine(c, false));
+    }
+    std::size_t fuel = n;
+    bool returned = machine->run(comp, fuel, result);
+    spent += n - fuel;
+    n = fuel;
+    if (not returned)
+      return false;
+    machine.reset();
+    if (is<Prog>(code->term))
+      ++next;
+    else
+      done = true;
+  }
+  return true;
+}
@@ -0,0 +1,196 @@
+
+#ifndef VM_HPP
+#define VM_HPP
+
+#include "ast.hpp"
+
+#include "lang/debug.hpp"
+
+#include <atomic>
+#include <cstdint>
+#include <iosfwd>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+struct Native_fn;
+
+// -------------------------------------------------------------------------- //
+// Bytecode
+//
+// This module defines a compiler that lowers elaborated terms into a
+// linear bytecode, and a stack-based virtual machine that executes
+// that bytecode. The values computed by the machine are terms, just
+// as in the tree-walking evaluators.
+//
+// Each abstraction or function is compiled into its own code object.
+// The parameters of a function are stored in slots on the machine's
+// stack, and references to them are resolved to those slots during
+// compilation. References to the parameters of enclosing functions
+// are resolved to a position in the environment captured by a closure
+// (see env.hpp). Literals and other terms needed at runtime are
+// stored in the constant pool of each code object.
+//
+// Terms for which there is no specific instruction (e.g., queries)
+// are evaluated by the environment-based evaluator, in the current
+// environment.
+
+// The instructions of the virtual machine. The operands a and b of
+// each instruction are given in parens. Most instructions pop their
+// operands from the stack and push their result.
+enum Opcode : std::uint8_t {
+  op_const,   // Push the constant (a)
+  op_local,   // Push the parameter in slot (a)
+  op_free,    // Push the binding (a) of the enclosing environment (b)
+  op_global,  // Push the value of the definition referred to by (a)
+  op_eval,    // Push the evaluation of the term (a) in the environment
+  op_pop,     // Discard the top of the stack
+  op_jump,    // Jump to (a)
+  op_branch,  // Pop a boolean, and jump to (a) if it is false
+  op_not,     // not t1
+  op_equals,  // t1 eq t2
+  op_less,    // t1 lt t2
+  op_succ,    // succ t, for the term (a)
+  op_pred,    // pred t, for the term (a)
+  op_iszero,  // iszero t
+  op_closure, // Push a closure of the function with code (a)
+  op_call,    // Call a function with (a) arguments, for the call term (b - 1)
+  op_tail,    // Call a function with (a) arguments, in place of the current one
+  op_return,  // Return the top of the stack
+  op_define,  // Bind the top of the stack to the definition (a)
+  op_delay,   // Push the definition run by the code (a), delaying its value
+  op_print,   // Print the top of the stack (if b) for the print term (a)
+};
+
+struct Instr {
+  Opcode        op;
+  std::uint16_t b;
+  std::int32_t  a;
+};
+
+using Instr_seq = std::vector<Instr>;
+
+// A code object is the compiled form of an abstraction, a function,
+// or a statement. When the env flag is set, the parameters are also
+// bound in an environment when the code is called, so that closures
+// created by the code (and terms evaluated by fallback) can refer
+// to them.
+//
+// A program is compiled into a code object for each statement, so
+// that statements can be run separately (see sched.hpp). The code of
+// a program has no instructions of its own.
+//
+// The calls of a function are counted, so that it can be compiled to
+// native code once it is hot (see jit.hpp). The native code, if any,
+// is set by the call that reaches the threshold.
+struct Code {
+  Code(Term* f, Term* t = nullptr)
+    : fn(f), term(t), env(false), calls(0), native(nullptr) { }
+
+  Term*              fn;     // The compiled function, if any
+  Term*              term;   // The compiled statement or program, if any
+  std::vector<Expr*> vars;   // The parameters of the function
+  bool               env;    // True if the parameters need an environment
+  Instr_seq          instrs; // The instructions
+  Term_seq           consts; // The constant pool
+  std::vector<Code*> fns;    // The code of functions and delayed definitions
+  std::vector<Code*> stmts;  // The code of each statement of a program
+  std::atomic<std::size_t> calls;  // The number of calls of the function
+  std::atomic<Native_fn*>  native; // The native code of the function
+};
+
+
+// -------------------------------------------------------------------------- //
+// Compiler
+
+// The compiler translates terms into code. Code objects are owned by
+// the compiler, and are destroyed with it. Functions that were not
+// reached during compilation (e.g., those created by the tree-walking
+// evaluator) are compiled when they are first called, possibly by
+// concurrent evaluations. The compiler is guarded by a mutex.
+struct Compiler {
+  Compiler() = default;
+  ~Compiler();
+
+  Compiler(const Compiler&) = delete;
+  Compiler& operator=(const Compiler&) = delete;
+
+  Code* operator()(Term*);
+
+  Code* get_code(Term*);
+
+  std::unordered_map<Term*, Code*> codes; // Compiled functions
+  std::vector<Code*> progs;               // Compiled statements and programs
+  std::mutex mutex;
+  bool lazy = false;                      // True if definitions are delayed
+};
+
+const char* get_opcode_name(Opcode);
+void dump(std::ostream&, const Code*);
+
+
+// -------------------------------------------------------------------------- //
+// Virtual machine
+
+Term* run(Compiler&, Code*);
+
+
+// -------------------------------------------------------------------------- //
+// Tasks
+//
+// A task is a run of code that can be paused and resumed. Each call to
+// resume executes at most the given number of instructions (its fuel),
+// and then pauses the task before its next instruction, keeping the
+// stack and frames of the machine until the task is resumed. The
+// statements of a program are run in order, and the value of a task is
+// that of its last statement. A scheduler can time-slice many tasks by
+// resuming each with a slice of fuel in turn, and can enforce a
+// deadline by discarding a task that has spent too much fuel.
+//
+// A single instruction may run for an unbounded time: a term evaluated
+// by the environment-based evaluator (e.g., a query), or a delayed
+// definition forced by a reference, is run to completion by the
+// instruction that needs its value. A task is resumed by one thread at
+// a time, and allocates in the arena that is current when it is
+// resumed. The calls of a task are not recorded by the profiler. A task
+// whose run fails (i.e., an instruction throws) cannot be resumed.
+struct Machine;
+
+struct Task {
+  Task(Compiler&, Code*);
+  ~Task();
+
+  Task(const Task&) = delete;
+  Task& operator=(const Task&) = delete;
+
+  bool resume(std::size_t);
+
+  Compiler& comp;
+  Code* code;
+  std::size_t next;   // The next statement of a program
+  std::unique_ptr<Machine> machine; // The run of the current statement
+  Term* result;       // The value of the last statement run
+  std::size_t spent;  // The number of instructions executed
+  bool done;          // True when every statement has been run
+};
+
+// With a fuel limit, the evaluation of a program by the virtual machine
+// fails once it has executed that many instructions (see Evaluator in
+// eval.hpp), by throwing a fuel error. There is no limit by default.
+// The fuel error is an assertion, so that a session reports it as it
+// does any failed request.
+void set_fuel_limit(std::size_t);
+std::size_t get_fuel_limit();
+
+struct Fuel_error : Assertion_error {
+  Fuel_error(std::size_t);
+
+  std::size_t limit; // The fuel limit that was reached
+};
+
+// The number of instructions run by a task between the flushes of the
+// output of its evaluator, when there is a fuel limit.
+constexpr std::size_t fuel_slice = 1 << 16;
+
+#endif
@@ -0,0 +1,102 @@
+#include "worker.hpp"
+#include "spill.hpp"
+#include "stats.hpp"
+#include "table_file.hpp"
+
+#include "lang/thread_pool.hpp"
+
+#include <cerrno>
+#include <memory>
+
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+namespace {
+
+// The number of worker processes.
+std::size_t worker_count_ = 0;
+
+// Run f as the ith of n workers, writing its result to the file at
+// path, and exit.
+[[noreturn]] void
+run_worker(std::size_t i, std::size_t n, const Worker_fn& f,
+           const std::string& path) {
+  worker_count_ = 0;
+  Thread_pool::run_serially();
+  int status = 1;
+  try {
+    Table* t = f(i, n);
+    if (t and save_table(path, t))
+      status = 0;
+  } catch (...) {
+  }
+  // Exit without running destructors or flushing the buffers copied
+  // from the parent.
+  ::_exit(status);
+}
+
+// Wait for the process pid to exit. Returns true if it succeeded.
+bool
+wait_worker(pid_t pid) {
+  int status;
+  while (::waitpid(pid, &status, 0) < 0) {
+    if (errno != EINTR)
+      return false;
+  }
+  return WIFEXITED(status) and WEXITSTATUS(status) == 0;
+}
+
+} // namespace
+
+// Set the number of worker processes.
+void
+set_worker_count(std::size_t n) { worker_count_ = n; }
+
+std::size_t
+get_worker_count() { return worker_count_; }
+
+// Run f in each of n worker processes, and return their results, in
+// order. The results are read in the current arena. Returns an empty
+// sequence if workers cannot be started, or if any of them fails.
+std::vector<Table*>
+run_workers(std::size_t n, const Worker_fn& f) {
+  if (n < 2 or Thread_pool::in_loop())
+    return {};
+
+  std::vector<std::unique_ptr<Spill_file>> files;
+  std::vector<pid_t> pids;
+  bool ok = true;
+  for (std::size_t i = 0; i < n; ++i) {
+    files.emplace_back(new Spill_file());
+    if (files.back()->path.empty()) {
+      ok = false;
+      break;
+    }
+    pid_t pid = ::fork();
+    if (pid < 0) {
+      ok = false;
+      break;
+    }
+    if (pid == 0)
+      run_worker(i, n, f, files.back()->path);
+    pids.push_back(pid);
+  }
+  for (pid_t pid : pids) {
+    if (not wait_worker(pid))
+      ok = false;
+  }
+  if (not ok)
+    return {};
+
+  std::vector<Table*> results;
+  for (auto& file : files) {
+    Type* t = load_table_type(file->path);
+    Table* r = t ? load_table(file->path, t) : nullptr;
+    if (not r)
+      return {};
+    count_gather(r->rows());
+    results.push_back(r);
+  }
+  return results;
+}
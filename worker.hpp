@@ -0,0 +1,43 @@
+#ifndef WORKER_HPP
+#define WORKER_HPP
+
+#include "ast.hpp"
+
+#include <cstddef>
+#include <functional>
+#include <vector>
+
+// -------------------------------------------------------------------------- //
+// Worker processes
+//
+// Queries over large defined tables can be run by worker processes
+// (see plan.hpp). The workers of a query are forked from the process
+// evaluating it, so each has a copy of every table in memory, and
+// computes a partial result over its own partition of the rows. Each
+// worker writes its result to a temporary table file (see spill.hpp),
+// which is read back once every worker has exited; the results are
+// then combined by the evaluating process.
+//
+// A worker runs single-threaded, and does not start workers of its
+// own. A worker that fails (e.g., because the evaluation of its part
+// fails, or because its result cannot be written to a table file) exits
+// with a nonzero status, in which case no results are returned, and
+// the query is evaluated by that process instead. Workers are not
+// started within a loop of the thread pool, where other threads may
+// hold locks that the forked process would never see released.
+//
+// The number of workers is set with set_worker_count. Fewer than two
+// workers (the default) disables them.
+
+void set_worker_count(std::size_t);
+std::size_t get_worker_count();
+
+// The least number of rows of a table whose queries are run by workers.
+constexpr std::size_t worker_min_rows = 64 * 1024;
+
+// The function run by the ith of n workers, returning its result.
+using Worker_fn = std::function<Table*(std::size_t, std::size_t)>;
+
+std::vector<Table*> run_workers(std::size_t, const Worker_fn&);
+
+#endif